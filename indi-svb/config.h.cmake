@@ -6,5 +6,7 @@
 /* Define Driver version */
 #define SVB_VERSION_MAJOR @SVB_VERSION_MAJOR@
 #define SVB_VERSION_MINOR @SVB_VERSION_MINOR@
+/* Define if the kernel headers have io_uring */
+#cmakedefine HAVE_IO_URING 1
 
 #endif // CONFIG_H
@@ -0,0 +1,92 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+// Shared memory ring reader example
+// Reads the frames the driver publishes in its shared memory ring, as named by the
+// SHARED_RING_NAME property, and prints their size, mean and latency.
+//
+//   svb_shm_reader /indi_svb_SVBONY_SV305_0
+
+#include "svb_sharedring.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+static double mean(const SharedRing::Frame &frame)
+{
+    uint64_t sum = 0;
+    size_t samples = frame.bitDepth == 16 ? frame.size / 2 : frame.size;
+    for (size_t i = 0; i < samples; i++)
+        sum += frame.bitDepth == 16 ? reinterpret_cast<const uint16_t *>(frame.data)[i] : frame.data[i];
+    return samples > 0 ? double(sum) / samples : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s ring_name\n", argv[0]);
+        return 1;
+    }
+
+    SharedRing::Reader reader;
+    for (;;)
+    {
+        if (!reader.isOpen() && !reader.open(argv[1]))
+        {
+            fprintf(stderr, "waiting for %s (%s)\n", argv[1], strerror(errno));
+            sleep(1);
+            continue;
+        }
+
+        SharedRing::Frame frame;
+        if (!reader.next(frame, 1000))
+        {
+            // the driver restarted the ring
+            if (errno == EPIPE)
+                reader.close();
+            continue;
+        }
+
+        // the frame is used in place, then checked
+        double value = mean(frame);
+        if (!reader.isValid(frame))
+        {
+            printf("frame %llu overwritten while reading\n", static_cast<unsigned long long>(frame.sequence));
+            continue;
+        }
+
+        auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()).count();
+        printf("frame %llu %ux%u %u bits, mean %.1f, latency %.2f ms, skipped %llu\n",
+               static_cast<unsigned long long>(frame.sequence), frame.width, frame.height, frame.bitDepth, value,
+               (now - static_cast<int64_t>(frame.timestamp)) / 1000.0, static_cast<unsigned long long>(reader.skipped()));
+    }
+}
@@ -72,6 +72,10 @@ make DESTDIR=%{buildroot} install
 %files
 %{_bindir}/*
 %{_datadir}/indi
+%{_libdir}/libsvbdelta.a
+%{_libdir}/libsvbshm.a
+%{_includedir}/libsvb/svb_delta.h
+%{_includedir}/libsvb/svb_sharedring.h
 
 %changelog
 * Sun Jul 19 2020 Jim Howard <jh.xsnrg+fedora@gmail.com> 1.8.7.git-1
@@ -0,0 +1,138 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_autoexposure.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+constexpr double AutoExposure::saturationLimit;
+
+void AutoExposure::reset(double exposure, double gain)
+{
+    mExposure = exposure;
+    mGain = gain;
+    mLevel = 0;
+    mSaturated = 0;
+    mSamples = 0;
+    mSettle = settleFrames;
+}
+
+void AutoExposure::measure(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth, uint32_t fullScale,
+                           uint32_t step)
+{
+    memset(mHistogram, 0, sizeof(mHistogram));
+    mSamples = 0;
+
+    // 256 bins over the full scale
+    const double scale = 256.0 / (double(fullScale) + 1);
+    size_t saturated = 0;
+    for (uint32_t y = step / 2; y < height; y += step)
+    {
+        for (uint32_t x = step / 2; x < width; x += step)
+        {
+            uint32_t value = bitDepth > 8 ? reinterpret_cast<const uint16_t *>(frame)[size_t(y) * width + x]
+                             : frame[size_t(y) * width + x];
+            if (value >= fullScale)
+                saturated++;
+            mHistogram[std::min<uint32_t>(static_cast<uint32_t>(value * scale), 255)]++;
+            mSamples++;
+        }
+    }
+
+    mSaturated = mSamples > 0 ? double(saturated) / mSamples : 0;
+}
+
+bool AutoExposure::update(const Settings &settings)
+{
+    if (mSamples == 0)
+        return false;
+
+    // level at the percentile, interpolated in the bin
+    const double rank = settings.percentile * mSamples;
+    double seen = 0;
+    mLevel = 1.0;
+    for (int bin = 0; bin < 256; bin++)
+    {
+        if (seen + mHistogram[bin] >= rank)
+        {
+            double inBin = mHistogram[bin] > 0 ? (rank - seen) / mHistogram[bin] : 0;
+            mLevel = (bin + inBin) / 256.0;
+            break;
+        }
+        seen += mHistogram[bin];
+    }
+
+    if (mSettle > 0)
+    {
+        mSettle--;
+        return false;
+    }
+
+    // hysteresis, unless saturating
+    double ratio;
+    if (mSaturated > saturationLimit && mLevel >= settings.target)
+        ratio = 1.0 / settings.maxStep;
+    else if (std::abs(mLevel - settings.target) <= settings.tolerance * settings.target)
+        return false;
+    else
+        ratio = settings.target / std::max(mLevel, 1.0 / 256);
+
+    ratio = std::min(std::max(ratio, 1.0 / settings.maxStep), settings.maxStep);
+
+    // gain units are camera specific, gain moves by up to a tenth of its range per stop
+    const double gainStep = (settings.maxGain - settings.minGain) / 10;
+
+    double exposure = mExposure;
+    double gain = mGain;
+    if (ratio > 1)
+    {
+        // brighter, exposure first then gain
+        exposure = std::min(mExposure * ratio, settings.maxExposure);
+        double remaining = ratio * mExposure / exposure;
+        if (settings.adjustGain && remaining > 1.01 && mGain < settings.maxGain)
+            gain = std::min(mGain + std::max(1.0, gainStep * std::log2(remaining)), settings.maxGain);
+    }
+    else
+    {
+        // darker, gain first then exposure
+        if (settings.adjustGain && mGain > settings.minGain)
+            gain = std::max(mGain - std::max(1.0, gainStep * std::log2(1 / ratio)), settings.minGain);
+        else
+            exposure = std::max(mExposure * ratio, settings.minExposure);
+    }
+
+    exposure = std::round(exposure);
+    gain = std::round(gain);
+    if (exposure == mExposure && gain == mGain)
+        return false;
+
+    mExposure = exposure;
+    mGain = gain;
+    mSettle = settleFrames;
+    return true;
+}
@@ -0,0 +1,77 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Closed loop exposure and gain for streaming
+// The level of a frame is a percentile of a subsampled 8 bits histogram. Exposure then gain
+// are corrected by bounded multiplicative steps when the level leaves the tolerance band
+// around the target, and the loop waits for the change to reach the frames.
+class AutoExposure
+{
+    public:
+        struct Settings
+        {
+            double target;          // level, fraction of full scale
+            double percentile;      // 0.5 for the median, 0.99 for bright targets
+            double tolerance;       // hysteresis, fraction of the target
+            double maxStep;         // largest ratio of a correction
+            double minExposure, maxExposure;    // us
+            double minGain, maxGain;
+            bool adjustGain;
+        };
+
+        /** Start from the current camera settings */
+        void reset(double exposure, double gain);
+
+        /** Level and saturated fraction of a frame, sampling one pixel out of step in both directions */
+        void measure(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth, uint32_t fullScale,
+                     uint32_t step = 4);
+
+        /** Compute the next exposure and gain from the last measure, true when they changed */
+        bool update(const Settings &settings);
+
+        double exposure() const { return mExposure; }
+        double gain() const { return mGain; }
+        double level() const { return mLevel; }
+        double saturated() const { return mSaturated; }
+
+    private:
+        // frames of the old settings still in the camera pipeline
+        static const int settleFrames = 2;
+        // saturated fraction forcing a decrease, whatever the level
+        static constexpr double saturationLimit = 0.005;
+
+        double mExposure = 0;
+        double mGain = 0;
+        double mLevel = 0;
+        double mSaturated = 0;
+        uint32_t mHistogram[256];
+        size_t mSamples = 0;
+        int mSettle = 0;
+};
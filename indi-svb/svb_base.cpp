@@ -27,6 +27,8 @@
 #include "config.h"
 #include "svb_base.h"
 #include "svb_helpers.h"
+#include <cerrno>
+#include <cstring>
 #include <unistd.h>
 
 SVBBase::SVBBase()
@@ -40,6 +42,12 @@ SVBBase::~SVBBase()
     {
         Disconnect();
     }
+
+    // the frame buffer belongs to the pool, the chip must not free it
+    if (PrimaryCCD.getFrameBuffer() == mFramePool.buffer(0))
+        PrimaryCCD.setFrameBuffer(nullptr);
+    mFramePool.release();
+    MemoryBudget::instance().unregisterClient(mBudgetClient);
 }
 
 const char *SVBBase::getDefaultName()
@@ -107,7 +115,7 @@ bool SVBBase::Connect()
 
     // set camera ROI and BIN
     SetCCDParams(cameraProperty.MaxWidth, cameraProperty.MaxHeight, bitDepth, pixelSize, pixelSize);
-    status = SVBSetROIFormat(mCameraInfo.CameraID, 0, 0, cameraProperty.MaxWidth, cameraProperty.MaxHeight, 1);
+    status = setTransferROI(0, 0, cameraProperty.MaxWidth, cameraProperty.MaxHeight);
     if (status != SVB_SUCCESS)
     {
         LOGF_ERROR("Error, camera set ROI failed (%s)", Helpers::toString(status));
@@ -138,6 +146,33 @@ bool SVBBase::Connect()
     // set CCD up
     updateCCDParams();
 
+    // guide pulses
+    if (HasST4Port())
+    {
+        mPulseScheduler.resetTiming();
+        mPulseScheduler.start([this](PulseScheduler::Axis axis, int ms)
+        {
+            SVB_GUIDE_DIRECTION direction;
+            if (axis == PulseScheduler::RA)
+                direction = ms > 0 ? SVB_GUIDE_WEST : SVB_GUIDE_EAST;
+            else
+                direction = ms > 0 ? SVB_GUIDE_NORTH : SVB_GUIDE_SOUTH;
+
+            auto status = SVBPulseGuide(mCameraInfo.CameraID, direction, std::abs(ms));
+            if (status != SVB_SUCCESS)
+            {
+                LOGF_ERROR("Error, camera guide pulse failed (%s)", Helpers::toString(status));
+                return false;
+            }
+            return true;
+        },
+        [this](PulseScheduler::Axis axis)
+        {
+            GuideComplete(axis == PulseScheduler::RA ? AXIS_RA : AXIS_DE);
+            publishPulseTiming();
+        });
+    }
+
     /* Success! */
     LOG_INFO("CCD is online. Retrieving basic data.\n");
     return true;
@@ -152,12 +187,26 @@ bool SVBBase::Disconnect()
 
     Streamer->setStream(false);
 
+    // running pulses end before the camera is closed
+    mPulseScheduler.stop();
+
     if (isSimulation() == false)
     {
         SVBStopVideoCapture(mCameraInfo.CameraID);
         SVBCloseCamera(mCameraInfo.CameraID);
     }
 
+    // the frame buffer returns to the memory budget, unless an exposure still writes it
+    if (!isCapturing())
+    {
+        if (PrimaryCCD.getFrameBuffer() == mFramePool.buffer(0))
+            PrimaryCCD.setFrameBuffer(nullptr);
+        mFramePool.release();
+        MemoryBudget::instance().unregisterClient(mBudgetClient);
+        mBudgetClient = -1;
+        mFramePool.setBudgetClient(mBudgetClient);
+    }
+
     LOG_INFO("CCD is offline.\n");
 
     setConnected(false, IPS_IDLE);
@@ -219,17 +268,20 @@ bool SVBBase::updateProperties()
     // Set format first if connected.
     if (isConnected())
     {
-        // N.B. AFAIK, there is no way to switch image formats.
-        CaptureFormat format;
+        // 16 bits (RAW16 and unpacked RAW10/RAW12) then 8 bits, see CAPTURE_FORMAT_16 and CAPTURE_FORMAT_8
+        CaptureFormat format16, format8;
         if (GetCCDCapability() & CCD_HAS_BAYER)
         {
-            format = {"INDI_RAW", "RAW", 16, true};
+            format16 = {"INDI_RAW", "RAW 16", 16, bitDepth != 8};
+            format8 = {"INDI_RAW_8", "RAW 8", 8, bitDepth == 8};
         }
         else
         {
-            format = {"INDI_MONO", "Mono", 16, true};
+            format16 = {"INDI_MONO", "Mono 16", 16, bitDepth != 8};
+            format8 = {"INDI_MONO_8", "Mono 8", 8, bitDepth == 8};
         }
-        addCaptureFormat(format);
+        addCaptureFormat(format16);
+        addCaptureFormat(format8);
     }
 
     INDI::CCD::updateProperties();
@@ -249,6 +301,7 @@ bool SVBBase::updateProperties()
 
         // define frame format
         defineProperty(&FormatSP);
+        defineProperty(StreamFormatSP);
         // define frame rate
         defineProperty(&SpeedSP);
 
@@ -260,6 +313,22 @@ bool SVBBase::updateProperties()
         // Workaround settings
         defineProperty(WorkaroundExpSP);
         defineProperty(WorkaroundExpNP);
+
+        // guide pulses
+        if (HasST4Port())
+        {
+            defineProperty(PulsePolicySP);
+            defineProperty(PulseTimingNP);
+        }
+
+        // frame buffer
+        defineProperty(FrameBufferSP);
+        defineProperty(MemoryUsageNP);
+
+        // memory budget shared by the cameras of the driver
+        defineProperty(MemoryBudgetNP);
+        defineProperty(MemoryBudgetInfoNP);
+        publishMemoryUsage();
     }
     else
     {
@@ -277,6 +346,7 @@ bool SVBBase::updateProperties()
 
         // delete frame format
         deleteProperty(FormatSP.name);
+        deleteProperty(StreamFormatSP.getName());
         // delete frame rate
         deleteProperty(SpeedSP.name);
 
@@ -289,6 +359,21 @@ bool SVBBase::updateProperties()
         // Workaround settings
         deleteProperty(WorkaroundExpSP.getName());
         deleteProperty(WorkaroundExpNP.getName());
+
+        // guide pulses
+        if (HasST4Port())
+        {
+            deleteProperty(PulsePolicySP.getName());
+            deleteProperty(PulseTimingNP.getName());
+        }
+
+        // frame buffer
+        deleteProperty(FrameBufferSP.getName());
+        deleteProperty(MemoryUsageNP.getName());
+
+        // memory budget
+        deleteProperty(MemoryBudgetNP.getName());
+        deleteProperty(MemoryBudgetInfoNP.getName());
     }
 
     return true;
@@ -501,32 +586,65 @@ bool SVBBase::createControls(int piNumberOfControls)
     }
 
     // set frame format and feed UI
-    IUFillSwitch(&FormatS[FORMAT_RAW8], "FORMAT_RAW8", "Raw 8 bits", ISS_OFF);
-    IUFillSwitch(&FormatS[FORMAT_RAW16], "FORMAT_RAW16", "Raw 16 bits", ISS_ON);
-    IUFillSwitchVector(&FormatSP, FormatS, 2, getDeviceName(), "FRAME_FORMAT", "Frame Format", MAIN_CONTROL_TAB,
+    // packed formats are only offered when the camera lists them
+    const char *formatNames[4] = {"FORMAT_RAW16", "FORMAT_RAW8", "FORMAT_RAW12", "FORMAT_RAW10"};
+    const char *formatLabels[4] = {"Raw 16 bits", "Raw 8 bits", "Raw 12 bits", "Raw 10 bits"};
+    int formatCount = 0;
+    for (int format = FORMAT_RAW16; format <= FORMAT_RAW10; format++)
+    {
+        if (format != FORMAT_RAW16 && format != FORMAT_RAW8 && !isFrameFormatSupported(format))
+            continue;
+
+        IUFillSwitch(&FormatS[formatCount], formatNames[format], formatLabels[format],
+                     format == FORMAT_RAW16 ? ISS_ON : ISS_OFF);
+        formatSwitchMapping[formatCount++] = format;
+    }
+    IUFillSwitchVector(&FormatSP, FormatS, formatCount, getDeviceName(), "FRAME_FORMAT", "Frame Format", MAIN_CONTROL_TAB,
                        IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
 
     // NOTE : SV305M PRO only supports Y8 and Y16 frame format
-    if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") == 0)
-    {
-        status = SVBSetOutputImageType(mCameraInfo.CameraID, frameFormatMapping[FORMAT_Y16]);
-    }
-    else
+    if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") != 0)
     {
         IUSaveText(&BayerT[0], "0");
         IUSaveText(&BayerT[1], "0");
         IUSaveText(&BayerT[2], bayerPatternMapping[cameraProperty.BayerPattern]);
-        status = SVBSetOutputImageType(mCameraInfo.CameraID, frameFormatMapping[FORMAT_RAW16]);
     }
-    if (status != SVB_SUCCESS)
+    if (!setFrameFormat(FORMAT_RAW16))
     {
-        LOGF_ERROR("Error, camera set frame format failed (%s).", Helpers::toString(status));
         return false;
     }
-    bitDepth = 16;
-    frameFormat = FORMAT_RAW16;
     LOG_INFO("Camera set frame format mode\n");
 
+    // stream frame format
+    StreamFormatSP[STREAM_FORMAT_CAPTURE].fill("STREAM_FORMAT_CAPTURE", "Capture format", ISS_ON);
+    StreamFormatSP[STREAM_FORMAT_RAW8].fill("STREAM_FORMAT_RAW8", "Raw 8 bits", ISS_OFF);
+    StreamFormatSP.fill(getDeviceName(), "STREAM_FRAME_FORMAT", "Stream Format", STREAM_TAB, IP_RW, ISR_1OFMANY, 60,
+                        IPS_IDLE);
+    exposureFrameFormat = -1;
+
+    // frame buffer pages
+    FrameBufferSP[FRAME_BUFFER_HUGE_PAGES].fill("FRAME_BUFFER_HUGE_PAGES", "Huge pages", ISS_OFF);
+    FrameBufferSP[FRAME_BUFFER_LOCKED].fill("FRAME_BUFFER_LOCKED", "Locked in memory", ISS_OFF);
+    FrameBufferSP.fill(getDeviceName(), "FRAME_BUFFER_OPTIONS", "Frame buffer", OPTIONS_TAB, IP_RW, ISR_NOFMANY, 60,
+                       IPS_IDLE);
+
+    MemoryUsageNP[MEMORY_FRAME_BUFFER].fill("MEMORY_FRAME_BUFFER", "Frame buffer (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryUsageNP[MEMORY_LOCKED].fill("MEMORY_LOCKED", "Locked (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryUsageNP[MEMORY_HUGE_PAGES].fill("MEMORY_HUGE_PAGES", "Huge pages (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryUsageNP[MEMORY_RESIDENT].fill("MEMORY_RESIDENT", "Driver resident (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryUsageNP.fill(getDeviceName(), "MEMORY_USAGE", "Memory", OPTIONS_TAB, IP_RO, 60, IPS_IDLE);
+
+    // memory budget, the cap is shared by every camera of the driver, the last one set wins
+    MemoryBudgetNP[MEMORY_BUDGET_CAP].fill("MEMORY_BUDGET_CAP", "Driver cap (MB, 0 off)", "%.0f", 0, 65536, 64, 0);
+    MemoryBudgetNP[MEMORY_BUDGET_PRIORITY].fill("MEMORY_BUDGET_PRIORITY", "Priority", "%.0f", 0, 10, 1, 5);
+    MemoryBudgetNP.fill(getDeviceName(), "MEMORY_BUDGET", "Memory budget", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+    MemoryBudgetInfoNP[MEMORY_BUDGET_USED].fill("MEMORY_BUDGET_USED", "Driver used (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_GRANTED].fill("MEMORY_BUDGET_GRANTED", "Granted (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_DEMAND].fill("MEMORY_BUDGET_DEMAND", "Wanted (MB)", "%.1f", 0, 1e6, 0, 0);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_THROTTLED].fill("MEMORY_BUDGET_THROTTLED", "Throttled", "%.0f", 0, 1e9, 0, 0);
+    MemoryBudgetInfoNP.fill(getDeviceName(), "MEMORY_BUDGET_INFO", "Budget usage", OPTIONS_TAB, IP_RO, 60, IPS_IDLE);
+
     // set bit stretching and feed UI
     IUFillSwitch(&StretchS[STRETCH_OFF], "STRETCH_OFF", "Off", ISS_ON);
     IUFillSwitch(&StretchS[STRETCH_X2], "STRETCH_X2", "x2", ISS_OFF);
@@ -548,6 +666,34 @@ bool SVBBase::createControls(int piNumberOfControls)
     WorkaroundExpNP[0].fill("WORKAROUND_DURATION", "Duration", "%.2f", 0.1, 60, 0.001, 0.5);
     WorkaroundExpNP.fill(getDeviceName(), "EXP_WOKAROUND_DURATION", "ExpWorkaround", "Extra", IP_RW, 60, IPS_IDLE);
 
+    // guide pulses
+    PulsePolicySP[PULSE_POLICY_MERGE].fill("PULSE_POLICY_MERGE", "Merge", ISS_ON);
+    PulsePolicySP[PULSE_POLICY_REPLACE].fill("PULSE_POLICY_REPLACE", "Replace", ISS_OFF);
+    PulsePolicySP.fill(getDeviceName(), "GUIDE_PULSE_POLICY", "Pending pulses", GUIDE_CONTROL_TAB, IP_RW, ISR_1OFMANY, 60,
+                       IPS_IDLE);
+
+    PulseTimingNP[PULSE_TIMING_PULSES].fill("PULSE_TIMING_PULSES", "Pulses", "%.f", 0, 1e9, 0, 0);
+    PulseTimingNP[PULSE_TIMING_MERGED].fill("PULSE_TIMING_MERGED", "Merged", "%.f", 0, 1e9, 0, 0);
+    PulseTimingNP[PULSE_TIMING_FAILED].fill("PULSE_TIMING_FAILED", "Failed", "%.f", 0, 1e9, 0, 0);
+    PulseTimingNP[PULSE_TIMING_MEAN_JITTER].fill("PULSE_TIMING_MEAN_JITTER", "Mean jitter (ms)", "%.2f", -1e6, 1e6, 0, 0);
+    PulseTimingNP[PULSE_TIMING_MAX_JITTER].fill("PULSE_TIMING_MAX_JITTER", "Max jitter (ms)", "%.2f", 0, 1e6, 0, 0);
+    PulseTimingNP[PULSE_TIMING_LATENCY].fill("PULSE_TIMING_LATENCY", "Mean latency (ms)", "%.2f", 0, 1e6, 0, 0);
+    for (size_t i = 0; i < PulseScheduler::histogramBins; i++)
+    {
+        // jitter bins, open ended on both sides
+        char name[32], label[32];
+        snprintf(name, sizeof(name), "PULSE_TIMING_JITTER_%zu", i);
+        if (i == 0)
+            snprintf(label, sizeof(label), "Jitter < %g ms", PulseScheduler::histogramLimits[0]);
+        else if (i == PulseScheduler::histogramBins - 1)
+            snprintf(label, sizeof(label), "Jitter >= %g ms", PulseScheduler::histogramLimits[i - 1]);
+        else
+            snprintf(label, sizeof(label), "Jitter %g to %g ms", PulseScheduler::histogramLimits[i - 1],
+                     PulseScheduler::histogramLimits[i]);
+        PulseTimingNP[PULSE_TIMING_HISTOGRAM + i].fill(name, label, "%.f", 0, 1e9, 0, 0);
+    }
+    PulseTimingNP.fill(getDeviceName(), "GUIDE_PULSE_TIMING", "Pulse timing", GUIDE_CONTROL_TAB, IP_RO, 60, IPS_IDLE);
+
     guard.unlock();
 
     return true;
@@ -654,6 +800,17 @@ bool SVBBase::ISNewNumber(const char *dev, const char *name, double values[], ch
         return true;
     }
 
+    if (MemoryBudgetNP.isNameMatch(name))
+    {
+        MemoryBudgetNP.update(values, names, n);
+        MemoryBudgetNP.setState(IPS_OK);
+        MemoryBudgetNP.apply();
+        MemoryBudget::instance().setCap(static_cast<size_t>(MemoryBudgetNP[MEMORY_BUDGET_CAP].getValue()) << 20);
+        MemoryBudget::instance().setPriority(mBudgetClient, MemoryBudgetNP[MEMORY_BUDGET_PRIORITY].getValue());
+        publishMemoryUsage();
+        return true;
+    }
+
     return INDI::CCD::ISNewNumber(dev, name, values, names, n);
 }
 
@@ -687,47 +844,28 @@ bool SVBBase::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
             tmpFormat = IUFindOnSwitchIndex(&FormatSP);
             if (tmpFormat == -1)
             {
-                tmpFormat = FORMAT_RAW16; // Set Frame Format as FORMAT_RAW16 if frameFromat is -1
+                tmpFormat = 0; // Set Frame Format as FORMAT_RAW16 if frameFromat is -1
             }
 
-            // adjust frame format for SV305M
-            if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") == 0)
+            // streaming in 8 bits, the format is applied when the stream stops
+            if (exposureFrameFormat != -1)
             {
-                // offset format mapper to Y16 and Y8 modes
-                tmpFormat += FORMAT_Y16;
+                exposureFrameFormat = formatSwitchMapping[tmpFormat];
+                LOGF_INFO("Frame format %s will be set when streaming stops", FormatS[tmpFormat].label);
+                syncCaptureFormat(exposureFrameFormat);
+                FormatSP.s = IPS_OK;
+                IDSetSwitch(&FormatSP, NULL);
+                return true;
             }
 
-            // set new format
-            status = SVBSetOutputImageType(mCameraInfo.CameraID, frameFormatMapping[tmpFormat]);
-            if (status != SVB_SUCCESS)
+            if (!setFrameFormat(formatSwitchMapping[tmpFormat]))
             {
-                LOGF_ERROR("Error, camera set frame format failed (%s)", Helpers::toString(status));
-            }
-            // set frame format back for SV305M
-            if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") == 0)
-            {
-                tmpFormat -= FORMAT_Y16;
+                FormatSP.s = IPS_ALERT;
+                IDSetSwitch(&FormatSP, NULL);
+                return false;
             }
             LOGF_INFO("Frame format is now %s", FormatS[tmpFormat].label);
-
-            frameFormat = tmpFormat;
-
-            // pixel depth
-            switch (frameFormat)
-            {
-            case FORMAT_RAW8:
-                bitDepth = 8;
-                break;
-            case FORMAT_RAW16:
-                bitDepth = 16;
-                break;
-            default:
-                frameFormat = FORMAT_RAW16; // Set frameFormat as FORMAT_RAW16 if frameFromat is unknown
-                bitDepth = 16;
-                break;
-            }
-            // update CCD parameters
-            updateCCDParams();
+            syncCaptureFormat(frameFormat);
 
             FormatSP.s = IPS_OK;
             IDSetSwitch(&FormatSP, NULL);
@@ -796,6 +934,16 @@ bool SVBBase::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
             return true;
         }
 
+        // Stream frame format
+        if (StreamFormatSP.isNameMatch(name))
+        {
+            StreamFormatSP.update(states, names, n);
+            StreamFormatSP.setState(IPS_OK);
+            StreamFormatSP.apply();
+            LOGF_INFO("Stream format is now %s", StreamFormatSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
         // Exposure workaround enable
         if (WorkaroundExpSP.isNameMatch(name))
         {
@@ -806,6 +954,33 @@ bool SVBBase::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
             exposureWorkaroundEnable = WorkaroundExpSP[0].getState() == ISS_ON;
             return true;
         }
+
+        // pending guide pulses policy
+        if (PulsePolicySP.isNameMatch(name))
+        {
+            PulsePolicySP.update(states, names, n);
+            PulsePolicySP.setState(IPS_OK);
+            PulsePolicySP.apply();
+            return true;
+        }
+
+        // frame buffer pages, the buffer is mapped again when no capture uses it
+        if (FrameBufferSP.isNameMatch(name))
+        {
+            FrameBufferSP.update(states, names, n);
+            if (isCapturing())
+            {
+                FrameBufferSP.setState(IPS_BUSY);
+                LOG_INFO("Frame buffer options apply at the next connection, a capture is running");
+            }
+            else
+            {
+                std::unique_lock<std::mutex> guard(ccdBufferLock);
+                FrameBufferSP.setState(allocateFrameBuffer() ? IPS_OK : IPS_ALERT);
+            }
+            FrameBufferSP.apply();
+            return true;
+        }
     }
 
     // If we did not process the switch, let us pass it to the parent class to process it
@@ -830,64 +1005,75 @@ bool SVBBase::saveConfigItems(FILE *fp)
 
     // Frame format
     IUSaveConfigSwitch(fp, &FormatSP);
+    StreamFormatSP.save(fp);
     IUSaveConfigSwitch(fp, &SpeedSP);
 
     // bit stretching
     IUSaveConfigSwitch(fp, &StretchSP);
 
+    // guide pulses
+    if (HasST4Port())
+        PulsePolicySP.save(fp);
+
+    // frame buffer
+    FrameBufferSP.save(fp);
+    MemoryBudgetNP.save(fp);
+
     return true;
 }
 
 IPState SVBBase::GuideNorth(uint32_t ms)
 {
-    auto status = SVBPulseGuide(mCameraInfo.CameraID, SVB_GUIDE_NORTH, ms);
-    if (status != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, camera guide North failed (%s)", Helpers::toString(status));
-        return IPS_ALERT;
-    }
-    LOG_INFO("Guiding North\n");
-
-    return IPS_OK;
+    return guidePulse(PulseScheduler::DEC, static_cast<int>(ms));
 }
 
 IPState SVBBase::GuideSouth(uint32_t ms)
 {
-    auto status = SVBPulseGuide(mCameraInfo.CameraID, SVB_GUIDE_SOUTH, ms);
-    if (status != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, camera guide South failed (%s)", Helpers::toString(status));
-        return IPS_ALERT;
-    }
-    LOG_INFO("Guiding South\n");
-
-    return IPS_OK;
+    return guidePulse(PulseScheduler::DEC, -static_cast<int>(ms));
 }
 
 IPState SVBBase::GuideEast(uint32_t ms)
 {
-    auto status = SVBPulseGuide(mCameraInfo.CameraID, SVB_GUIDE_EAST, ms);
-    if (status != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, camera guide East failed (%s)", Helpers::toString(status));
-        return IPS_ALERT;
-    }
-    LOG_INFO("Guiding East\n");
-
-    return IPS_OK;
+    return guidePulse(PulseScheduler::RA, -static_cast<int>(ms));
 }
 
 IPState SVBBase::GuideWest(uint32_t ms)
 {
-    auto status = SVBPulseGuide(mCameraInfo.CameraID, SVB_GUIDE_WEST, ms);
-    if (status != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, camera guide West failed (%s)", Helpers::toString(status));
-        return IPS_ALERT;
-    }
-    LOG_INFO("Guiding North\n");
+    return guidePulse(PulseScheduler::RA, static_cast<int>(ms));
+}
+
+IPState SVBBase::guidePulse(PulseScheduler::Axis axis, int ms)
+{
+    // the scheduler thread of the axis completes the pulse, unless the merge left nothing to run
+    bool queued = mPulseScheduler.request(axis, ms, pulsePolicy());
+    LOGF_DEBUG("Guide pulse %s %d ms", axis == PulseScheduler::RA ? (ms > 0 ? "West" : "East") : (ms > 0 ? "North" : "South"),
+               std::abs(ms));
+    if (!queued)
+        return IPS_OK;
+
+    return IPS_BUSY;
+}
+
+PulseScheduler::Policy SVBBase::pulsePolicy()
+{
+    return PulsePolicySP[PULSE_POLICY_REPLACE].getState() == ISS_ON ? PulseScheduler::REPLACE : PulseScheduler::MERGE;
+}
 
-    return IPS_OK;
+void SVBBase::publishPulseTiming()
+{
+    PulseScheduler::Timing timing = mPulseScheduler.timing();
+
+    std::unique_lock<std::mutex> guard(mPulseTimingLock);
+    PulseTimingNP[PULSE_TIMING_PULSES].setValue(timing.pulses);
+    PulseTimingNP[PULSE_TIMING_MERGED].setValue(timing.merged);
+    PulseTimingNP[PULSE_TIMING_FAILED].setValue(timing.failed);
+    PulseTimingNP[PULSE_TIMING_MEAN_JITTER].setValue(timing.meanJitter);
+    PulseTimingNP[PULSE_TIMING_MAX_JITTER].setValue(timing.maxJitter);
+    PulseTimingNP[PULSE_TIMING_LATENCY].setValue(timing.meanLatency);
+    for (size_t i = 0; i < PulseScheduler::histogramBins; i++)
+        PulseTimingNP[PULSE_TIMING_HISTOGRAM + i].setValue(timing.histogram[i]);
+    PulseTimingNP.setState(timing.failed > 0 ? IPS_ALERT : IPS_OK);
+    PulseTimingNP.apply();
 }
 
 #if INDI_VERSION_MAJOR >= 1 && INDI_VERSION_MINOR >= 9 && INDI_VERSION_RELEASE >= 7
@@ -928,17 +1114,255 @@ void SVBBase::addFITSKeywords(fitsfile *fptr, INDI::CCDChip *targetChip)
     fits_update_key_dbl(fptr, "16 bits stretch factor (bit shift)", bitStretch, 3, "Stretch factor", &_status);
 }
 
+bool SVBBase::isFrameFormatSupported(int format)
+{
+    // adjust frame format for SV305M
+    if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") == 0)
+    {
+        // offset format mapper to Y modes
+        format += FORMAT_Y16;
+    }
+
+    for (int i = 0; i < 8 && cameraProperty.SupportedVideoFormat[i] != SVB_IMG_END; i++)
+    {
+        if (cameraProperty.SupportedVideoFormat[i] == frameFormatMapping[format])
+            return true;
+    }
+
+    return false;
+}
+
+// set frame format
+bool SVBBase::setFrameFormat(int format)
+{
+    SVB_IMG_TYPE imageType = frameFormatMapping[format];
+
+    // adjust frame format for SV305M
+    if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") == 0)
+    {
+        // offset format mapper to Y modes
+        imageType = frameFormatMapping[format + FORMAT_Y16];
+    }
+
+    // set new format
+    auto status = SVBSetOutputImageType(mCameraInfo.CameraID, imageType);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera set frame format failed (%s)", Helpers::toString(status));
+        return false;
+    }
+
+    mCurrentVideoFormat = imageType;
+    frameFormat = format;
+    mPackedTransfer = true;
+
+    // pixel depth, packed formats are unpacked to 16 bits
+    bitDepth = (format == FORMAT_RAW8) ? 8 : 16;
+
+    // update CCD parameters
+    updateCCDParams();
+
+    return true;
+}
+
+// keep the INDI capture format in line with the frame format bit depth
+void SVBBase::syncCaptureFormat(int format)
+{
+    if (CaptureFormatSP.size() > CAPTURE_FORMAT_8)
+    {
+        CaptureFormatSP.reset();
+        CaptureFormatSP[format == FORMAT_RAW8 ? CAPTURE_FORMAT_8 : CAPTURE_FORMAT_16].setState(ISS_ON);
+        CaptureFormatSP.setState(IPS_OK);
+        CaptureFormatSP.apply();
+    }
+}
+
+bool SVBBase::SetCaptureFormat(uint8_t index)
+{
+    int current = (exposureFrameFormat != -1) ? exposureFrameFormat : frameFormat;
+    int format = (index == CAPTURE_FORMAT_8) ? FORMAT_RAW8 : FORMAT_RAW16;
+
+    // RAW10 and RAW12 are 16 bits capture formats too
+    if (index == CAPTURE_FORMAT_16 && current != FORMAT_RAW8)
+        format = current;
+
+    if (format == current)
+        return true;
+
+    if (exposureFrameFormat != -1)
+    {
+        exposureFrameFormat = format;
+    }
+    else if (!setFrameFormat(format))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < FormatSP.nsp; i++)
+    {
+        FormatS[i].s = (formatSwitchMapping[i] == format) ? ISS_ON : ISS_OFF;
+    }
+    FormatSP.s = IPS_OK;
+    IDSetSwitch(&FormatSP, NULL);
+
+    return true;
+}
+
 // set CCD parameters
 bool SVBBase::updateCCDParams()
 {
     // set CCD parameters
     PrimaryCCD.setBPP(bitDepth);
 
-    // Let's calculate required buffer
-    int nbuf = PrimaryCCD.getXRes() * PrimaryCCD.getYRes() * PrimaryCCD.getBPP() / 8;
-    PrimaryCCD.setFrameBufferSize(nbuf);
+    // the pool holds a full 16 bits frame, the chip buffer is sized for the transfer
+    if (!allocateFrameBuffer())
+        return false;
+    updateTransfer();
 
-    LOGF_INFO("PrimaryCCD buffer size : %d\n", nbuf);
+    LOGF_INFO("PrimaryCCD buffer size : %d\n", static_cast<int>(mTransfer.bytes));
 
     return true;
 }
+
+SVB_ERROR_CODE SVBBase::setTransferROI(int x, int y, int width, int height)
+{
+    // the driver bins, the camera always transfers unbinned pixels
+    auto status = SVBSetROIFormat(mCameraInfo.CameraID, x, y, width, height, 1);
+    if (status == SVB_SUCCESS)
+    {
+        mTransfer.x = x;
+        mTransfer.y = y;
+        mTransfer.width = width;
+        mTransfer.height = height;
+        mTransfer.bin = 1;
+        updateTransfer();
+    }
+    return status;
+}
+
+void SVBBase::updateTransfer()
+{
+    mTransfer.bitDepth = bitDepth;
+    mTransfer.bytes = size_t(mTransfer.width) * mTransfer.height * (bitDepth / 8);
+
+    // the pool buffer holds a full 16 bits frame, only the size the chip reports changes,
+    // a buffer the chip allocated itself is resized so that the transfer cannot overrun it
+    uint8_t *pool = mFramePool.buffer(0);
+    bool pooled = pool == nullptr || PrimaryCCD.getFrameBuffer() == pool;
+    if (!pooled)
+        LOG_ERROR("The chip frame buffer is not the pool buffer, it is reallocated for the transfer\n");
+    else if (pool != nullptr && mTransfer.bytes > mFramePool.bufferSize())
+    {
+        LOGF_ERROR("Transfer of %d bytes larger than the frame buffer\n", static_cast<int>(mTransfer.bytes));
+        mTransfer.bytes = mFramePool.bufferSize();
+    }
+    PrimaryCCD.setFrameBufferSize(mTransfer.bytes, !pooled);
+}
+
+bool SVBBase::allocateFrameBuffer()
+{
+    size_t size = size_t(PrimaryCCD.getXRes()) * PrimaryCCD.getYRes() * 2;
+    FramePool::Options options;
+    options.hugePages = FrameBufferSP[FRAME_BUFFER_HUGE_PAGES].getState() == ISS_ON;
+    options.locked = FrameBufferSP[FRAME_BUFFER_LOCKED].getState() == ISS_ON;
+
+    // the frame buffer is the first grant of the camera, under the cap of the budget
+    if (mBudgetClient < 0)
+    {
+        mBudgetClient = MemoryBudget::instance().registerClient(getDeviceName(),
+                        MemoryBudgetNP[MEMORY_BUDGET_PRIORITY].getValue());
+        mFramePool.setBudgetClient(mBudgetClient);
+    }
+
+    bool mapped = mFramePool.allocate(1, size, options);
+    if (mFramePool.buffer(0) == nullptr)
+    {
+        if (errno == ENOMEM)
+            LOGF_ERROR("Failed to allocate the frame buffer of %.1f MB, out of memory or denied by the memory budget",
+                       size / 1048576.0);
+        else
+            LOGF_ERROR("Failed to allocate the frame buffer (%s)", strerror(errno));
+        PrimaryCCD.setFrameBuffer(nullptr);
+        return false;
+    }
+    if (!mapped)
+        LOGF_WARN("Failed to lock the frame buffer in memory (%s), raise the memlock limit", strerror(errno));
+
+    PrimaryCCD.setFrameBuffer(mFramePool.buffer(0));
+    publishMemoryUsage();
+    return true;
+}
+
+bool SVBBase::isCapturing()
+{
+    return Streamer->isStreaming();
+}
+
+void SVBBase::publishMemoryUsage()
+{
+    FramePool::Usage usage = mFramePool.usage();
+    MemoryUsageNP[MEMORY_FRAME_BUFFER].setValue(usage.mapped / 1048576.0);
+    MemoryUsageNP[MEMORY_LOCKED].setValue(usage.locked / 1048576.0);
+    MemoryUsageNP[MEMORY_HUGE_PAGES].setValue(usage.huge / 1048576.0);
+    MemoryUsageNP[MEMORY_RESIDENT].setValue(FramePool::residentSize() / 1048576.0);
+    MemoryUsageNP.setState(IPS_OK);
+    MemoryUsageNP.apply();
+
+    MemoryBudget::Usage budget = MemoryBudget::instance().usage(mBudgetClient);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_USED].setValue(budget.used / 1048576.0);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_GRANTED].setValue(budget.granted / 1048576.0);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_DEMAND].setValue(budget.demand / 1048576.0);
+    MemoryBudgetInfoNP[MEMORY_BUDGET_THROTTLED].setValue(budget.throttled);
+    MemoryBudgetInfoNP.setState(budget.granted < budget.demand ? IPS_ALERT : IPS_OK);
+    MemoryBudgetInfoNP.apply();
+}
+
+bool SVBBase::reserveMemory(MemoryBudget::Grant &grant, size_t wanted, size_t minimum, const char *what)
+{
+    MemoryBudget &budget = MemoryBudget::instance();
+    budget.release(mBudgetClient, grant);
+    grant = budget.reserve(mBudgetClient, wanted, minimum);
+    if (grant.bytes == 0)
+        LOGF_ERROR("%s denied by the memory budget, it needs %.1f MB", what, minimum / 1048576.0);
+    else if (grant.bytes < wanted)
+        LOGF_WARN("%s throttled by the memory budget to %.1f of %.1f MB", what, grant.bytes / 1048576.0,
+                  wanted / 1048576.0);
+    publishMemoryUsage();
+    return grant.bytes > 0;
+}
+
+void SVBBase::releaseMemory(MemoryBudget::Grant &grant)
+{
+    if (grant.bytes == 0)
+        return;
+    MemoryBudget::instance().release(mBudgetClient, grant);
+    publishMemoryUsage();
+}
+
+bool SVBBase::resizeBuffer(BudgetBuffer &buffer, size_t size, const char *what)
+{
+    // the buffer keeps its capacity, the grant only grows with it
+    if (size > buffer.grant.bytes)
+    {
+        if (size == buffer.denied)
+            return false;
+        if (!reserveMemory(buffer.grant, size, size, what))
+        {
+            buffer.denied = size;
+            buffer.bytes.clear();
+            buffer.bytes.shrink_to_fit();
+            return false;
+        }
+        buffer.denied = 0;
+    }
+    buffer.bytes.resize(size);
+    return true;
+}
+
+void SVBBase::releaseBuffer(BudgetBuffer &buffer)
+{
+    buffer.bytes.clear();
+    buffer.bytes.shrink_to_fit();
+    buffer.denied = 0;
+    releaseMemory(buffer.grant);
+}
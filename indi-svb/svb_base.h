@@ -29,6 +29,11 @@
 #include "indipropertytext.h"
 
 #include "libsv305/SVBCameraSDK.h"
+#include "svb_pulseguide.h"
+#include "svb_bufferpool.h"
+
+#include <mutex>
+#include <vector>
 
 
 class SVBBase: public INDI::CCD
@@ -66,6 +71,9 @@ class SVBBase: public INDI::CCD
         // Save config
         virtual bool saveConfigItems(FILE *fp) override;
 
+        // Capture format, 16 bits or 8 bits
+        virtual bool SetCaptureFormat(uint8_t index) override;
+
         #if INDI_VERSION_MAJOR >= 1 && INDI_VERSION_MINOR >= 9 && INDI_VERSION_RELEASE >=7
             virtual void addFITSKeywords(INDI::CCDChip *targetChip) override;
         #else
@@ -136,11 +144,53 @@ class SVBBase: public INDI::CCD
         // the camera is able to output RGB24, but not supported by INDI
         // -> ignored
 	    // NOTE : SV305M PRO doesn't support RAW8 and RAW16, only Y8 and Y16
-        ISwitch FormatS[2];
+        // RAW10 and RAW12 are transferred packed and unpacked to 16 bits by the driver,
+        // they are only offered when listed in cameraProperty.SupportedVideoFormat
+        ISwitch FormatS[4];
         ISwitchVectorProperty FormatSP;
-        enum { FORMAT_RAW16, FORMAT_RAW8, FORMAT_Y16, FORMAT_Y8};
-        SVB_IMG_TYPE frameFormatMapping[4] = {SVB_IMG_RAW16, SVB_IMG_RAW8, SVB_IMG_Y16, SVB_IMG_Y8};
+        enum { FORMAT_RAW16, FORMAT_RAW8, FORMAT_RAW12, FORMAT_RAW10, FORMAT_Y16, FORMAT_Y8, FORMAT_Y12, FORMAT_Y10};
+        SVB_IMG_TYPE frameFormatMapping[8] = {SVB_IMG_RAW16, SVB_IMG_RAW8, SVB_IMG_RAW12, SVB_IMG_RAW10,
+                                              SVB_IMG_Y16, SVB_IMG_Y8, SVB_IMG_Y12, SVB_IMG_Y10};
+        // format switch index -> frame format
+        int formatSwitchMapping[4];
         int frameFormat;
+
+        /** Is the frame format listed by the camera, Y formats are used for SV305M PRO */
+        bool isFrameFormatSupported(int format);
+
+        /** Set camera output image type, bit depth and CCD buffer for a frame format */
+        bool setFrameFormat(int format);
+
+        // active transfer, the camera ROI and the frame format, frames are read and processed at this size
+        struct Transfer
+        {
+            uint32_t x, y, width, height;
+            uint32_t bin;           // hardware binning
+            uint32_t bitDepth;      // packed formats are unpacked to 16 bits
+            size_t bytes;
+        };
+        Transfer mTransfer {};
+
+        // cleared when the SDK delivers 16 bits containers for the packed format, set again on format changes
+        bool mPackedTransfer = true;
+
+        /** Set the camera ROI and the transfer geometry */
+        SVB_ERROR_CODE setTransferROI(int x, int y, int width, int height);
+
+        /** Size the transfer and the chip buffer for the ROI and the frame format */
+        void updateTransfer();
+
+        /** Turn on the capture format switch matching a frame format */
+        void syncCaptureFormat(int format);
+
+        // registered capture formats
+        enum { CAPTURE_FORMAT_16, CAPTURE_FORMAT_8 };
+
+        // stream frame format, RAW8 while streaming halves the bytes per frame
+        INDI::PropertySwitch StreamFormatSP {2};
+        enum { STREAM_FORMAT_CAPTURE, STREAM_FORMAT_RAW8 };
+        // frame format to restore when streaming stops, -1 if not overridden
+        int exposureFrameFormat = -1;
         const char* bayerPatternMapping[4] = {"RGGB", "BGGR", "GRBG", "GBRG"};
 
 
@@ -151,4 +201,71 @@ class SVBBase: public INDI::CCD
         // Default control values
         std::map<SVB_CONTROL_TYPE, long> defaultValues;
 
+        // guide pulses, RA and DEC run concurrently on the scheduler threads
+        PulseScheduler mPulseScheduler;
+        std::mutex mPulseTimingLock;
+
+        /** Queue a signed guide pulse, > 0 west or north */
+        IPState guidePulse(PulseScheduler::Axis axis, int ms);
+
+        /** Policy for a pulse requested while its axis is busy */
+        PulseScheduler::Policy pulsePolicy();
+
+        /** Publish the pulse timing, from the scheduler threads */
+        void publishPulseTiming();
+
+        INDI::PropertySwitch PulsePolicySP {2};
+        enum { PULSE_POLICY_MERGE, PULSE_POLICY_REPLACE };
+        INDI::PropertyNumber PulseTimingNP {6 + PulseScheduler::histogramBins};
+        enum { PULSE_TIMING_PULSES, PULSE_TIMING_MERGED, PULSE_TIMING_FAILED, PULSE_TIMING_MEAN_JITTER, PULSE_TIMING_MAX_JITTER,
+               PULSE_TIMING_LATENCY, PULSE_TIMING_HISTOGRAM
+             };
+
+        // frame buffer, mapped once for a full 16 bits frame
+        FramePool mFramePool;
+
+        /** Map the frame buffer with the configured options and give it to the chip */
+        bool allocateFrameBuffer();
+
+        /** Is an exposure or a stream using the frame buffer */
+        virtual bool isCapturing();
+
+        /** Publish the memory of the frame buffer, of the driver and of the budget */
+        void publishMemoryUsage();
+
+        // client of the memory budget, registered with the frame buffer
+        int mBudgetClient = -1;
+
+        /** Replace a grant of the memory budget, logs when it is throttled or denied */
+        bool reserveMemory(MemoryBudget::Grant &grant, size_t wanted, size_t minimum, const char *what);
+
+        /** Return a grant to the memory budget */
+        void releaseMemory(MemoryBudget::Grant &grant);
+
+        // processing buffer of the frames, its capacity is granted by the memory budget
+        struct BudgetBuffer
+        {
+            std::vector<uint8_t> bytes;
+            MemoryBudget::Grant grant;
+            size_t denied = 0;      // size refused by the budget, asked again when it changes
+
+            uint8_t *data() { return bytes.data(); }
+            size_t size() const { return bytes.size(); }
+        };
+
+        /** Resize a processing buffer within the memory budget, false and the buffer freed when it is denied */
+        bool resizeBuffer(BudgetBuffer &buffer, size_t size, const char *what);
+
+        /** Free a processing buffer and return its grant */
+        void releaseBuffer(BudgetBuffer &buffer);
+
+        INDI::PropertySwitch FrameBufferSP {2};
+        enum { FRAME_BUFFER_HUGE_PAGES, FRAME_BUFFER_LOCKED };
+        INDI::PropertyNumber MemoryUsageNP {4};
+        enum { MEMORY_FRAME_BUFFER, MEMORY_LOCKED, MEMORY_HUGE_PAGES, MEMORY_RESIDENT };
+        INDI::PropertyNumber MemoryBudgetNP {2};
+        enum { MEMORY_BUDGET_CAP, MEMORY_BUDGET_PRIORITY };
+        INDI::PropertyNumber MemoryBudgetInfoNP {4};
+        enum { MEMORY_BUDGET_USED, MEMORY_BUDGET_GRANTED, MEMORY_BUDGET_DEMAND, MEMORY_BUDGET_THROTTLED };
+
 };
@@ -0,0 +1,234 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_binning.h"
+#include "svb_cfa.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void accumulateRow(const uint8_t *row, uint32_t *accumulator, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i *a = reinterpret_cast<__m128i *>(accumulator + i);
+        _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), _mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), _mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_si128(a + 2, _mm_add_epi32(_mm_loadu_si128(a + 2), _mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_si128(a + 3, _mm_add_epi32(_mm_loadu_si128(a + 3), _mm_unpackhi_epi16(hi, zero)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t v = vmovl_u8(vld1_u8(row + i));
+        vst1q_u32(accumulator + i, vaddw_u16(vld1q_u32(accumulator + i), vget_low_u16(v)));
+        vst1q_u32(accumulator + i + 4, vaddw_u16(vld1q_u32(accumulator + i + 4), vget_high_u16(v)));
+    }
+#endif
+    for (; i < n; i++)
+        accumulator[i] += row[i];
+}
+
+void accumulateRow(const uint16_t *row, uint32_t *accumulator, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i *a = reinterpret_cast<__m128i *>(accumulator + i);
+        _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), _mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), _mm_unpackhi_epi16(v, zero)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t v = vld1q_u16(row + i);
+        vst1q_u32(accumulator + i, vaddw_u16(vld1q_u32(accumulator + i), vget_low_u16(v)));
+        vst1q_u32(accumulator + i + 4, vaddw_u16(vld1q_u32(accumulator + i + 4), vget_high_u16(v)));
+    }
+#endif
+    for (; i < n; i++)
+        accumulator[i] += row[i];
+}
+
+void ColorBinning::mono(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t bin, int bitDepth)
+{
+    if (bitDepth > 8)
+        mono(reinterpret_cast<const uint16_t *>(src), reinterpret_cast<uint16_t *>(dst), width, height, bin);
+    else
+        mono(src, dst, width, height, bin);
+}
+
+void ColorBinning::bayer(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t bin, int bitDepth)
+{
+    if (bitDepth > 8)
+        bayer(reinterpret_cast<const uint16_t *>(src), reinterpret_cast<uint16_t *>(dst), width, height, bin);
+    else
+        bayer(src, dst, width, height, bin);
+}
+
+void ColorBinning::superpixel(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t bin,
+                              SVB_BAYER_PATTERN pattern, int bitDepth, bool planar)
+{
+    if (bitDepth > 8)
+        superpixel(reinterpret_cast<const uint16_t *>(src), reinterpret_cast<uint16_t *>(dst), width, height, bin, pattern,
+                   planar);
+    else
+        superpixel(src, dst, width, height, bin, pattern, planar);
+}
+
+template <typename T>
+void ColorBinning::mono(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t bin)
+{
+    const uint32_t outWidth = width / bin;
+    const uint32_t outHeight = height / bin;
+    const uint32_t maximum = std::numeric_limits<T>::max();
+    const uint32_t divisor = sizeof(T) == 1 ? bin * bin / 2 : 1;
+    std::vector<uint32_t> &accumulator = mAccumulator[0];
+
+    for (uint32_t oy = 0; oy < outHeight; oy++)
+    {
+        accumulator.assign(width, 0);
+        for (uint32_t l = 0; l < bin; l++)
+            accumulateRow(src + size_t(oy * bin + l) * width, accumulator.data(), width);
+
+        T *out = dst + size_t(oy) * outWidth;
+        for (uint32_t ox = 0; ox < outWidth; ox++)
+        {
+            uint32_t sum = 0;
+            for (uint32_t k = 0; k < bin; k++)
+                sum += accumulator[ox * bin + k];
+            out[ox] = static_cast<T>(std::min(sum / divisor, maximum));
+        }
+    }
+}
+
+template <typename T>
+void ColorBinning::bayer(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t bin)
+{
+    const uint32_t outWidth = width / bin;
+    const uint32_t outHeight = height / bin;
+    std::vector<uint32_t> &accumulator = mAccumulator[0];
+
+    // output site (x, y) of cell (X, Y) sums the input sites 2 * bin * X + x + 2 * k, k < bin
+    for (uint32_t oy = 0; oy < outHeight; oy++)
+    {
+        accumulator.assign(width, 0);
+        uint32_t rows = 0;
+        for (uint32_t l = 0; l < bin; l++)
+        {
+            uint32_t y = 2 * bin * (oy >> 1) + (oy & 1) + 2 * l;
+            if (y >= height)
+                break;
+            accumulateRow(src + size_t(y) * width, accumulator.data(), width);
+            rows++;
+        }
+
+        T *out = dst + size_t(oy) * outWidth;
+        for (uint32_t ox = 0; ox < outWidth; ox++)
+        {
+            uint32_t sum = 0, count = 0;
+            for (uint32_t k = 0; k < bin; k++)
+            {
+                uint32_t x = 2 * bin * (ox >> 1) + (ox & 1) + 2 * k;
+                if (x >= width)
+                    break;
+                sum += accumulator[x];
+                count += rows;
+            }
+            out[ox] = count > 0 ? static_cast<T>((sum + count / 2) / count) : 0;
+        }
+    }
+}
+
+template <typename T>
+void ColorBinning::superpixel(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t bin,
+                              SVB_BAYER_PATTERN pattern, bool planar)
+{
+    const uint32_t outWidth = width / bin;
+    const uint32_t outHeight = height / bin;
+    const size_t plane = size_t(outWidth) * outHeight;
+
+    // bin is even, every block holds (bin / 2)^2 complete cells
+    const uint32_t cells = (bin / 2) * (bin / 2);
+
+    for (uint32_t oy = 0; oy < outHeight; oy++)
+    {
+        // one accumulator per row parity
+        mAccumulator[0].assign(width, 0);
+        mAccumulator[1].assign(width, 0);
+        for (uint32_t l = 0; l < bin; l++)
+        {
+            uint32_t y = oy * bin + l;
+            accumulateRow(src + size_t(y) * width, mAccumulator[y & 1].data(), width);
+        }
+
+        for (uint32_t ox = 0; ox < outWidth; ox++)
+        {
+            uint32_t sum[3] = {0, 0, 0};
+            for (uint32_t parity = 0; parity < 2; parity++)
+            {
+                const uint32_t *accumulator = mAccumulator[parity].data();
+                for (uint32_t k = 0; k < bin; k++)
+                {
+                    uint32_t x = ox * bin + k;
+                    sum[Cfa::color(pattern, x, parity)] += accumulator[x];
+                }
+            }
+
+            T rgb[3];
+            rgb[0] = static_cast<T>((sum[Cfa::RED] + cells / 2) / cells);
+            rgb[1] = static_cast<T>((sum[Cfa::GREEN] + cells) / (2 * cells));
+            rgb[2] = static_cast<T>((sum[Cfa::BLUE] + cells / 2) / cells);
+
+            size_t index = size_t(oy) * outWidth + ox;
+            if (planar)
+            {
+                dst[index] = rgb[0];
+                dst[plane + index] = rgb[1];
+                dst[2 * plane + index] = rgb[2];
+            }
+            else
+            {
+                std::copy(rgb, rgb + 3, dst + index * 3);
+            }
+        }
+    }
+}
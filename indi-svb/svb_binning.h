@@ -0,0 +1,70 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "libsv305/SVBCameraSDK.h"
+
+// Colour preserving binning of bayer frames
+// Rows of a bin are summed in 32 bits accumulators (SIMD), then the same colour sites of
+// each output pixel are averaged, keeping the frame bit depth.
+class ColorBinning
+{
+    public:
+        /**
+         * Bin all sites of bin x bin blocks as the INDI chip does, 16 bits sums saturate and
+         * 8 bits sums are divided by bin^2 / 2. The output is width / bin x height / bin.
+         */
+        void mono(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t bin, int bitDepth);
+
+        /**
+         * Bin same colour sites, the output is a bayer mosaic of width / bin x height / bin
+         * with the pattern of the input, partial cells at the edges average the sites they hold.
+         */
+        void bayer(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t bin, int bitDepth);
+
+        /**
+         * Average the R, G and B sites of each bin x bin block (bin even), the output is RGB of
+         * width / bin x height / bin, interleaved or in three planes.
+         */
+        void superpixel(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t bin,
+                        SVB_BAYER_PATTERN pattern, int bitDepth, bool planar);
+
+    private:
+        template <typename T> void mono(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t bin);
+        template <typename T> void bayer(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t bin);
+        template <typename T> void superpixel(const T *src, T *dst, uint32_t width, uint32_t height, uint32_t bin,
+                                              SVB_BAYER_PATTERN pattern, bool planar);
+
+        std::vector<uint32_t> mAccumulator[2];
+};
+
+/** Add a row to 32 bits accumulators */
+void accumulateRow(const uint8_t *row, uint32_t *accumulator, size_t n);
+void accumulateRow(const uint16_t *row, uint32_t *accumulator, size_t n);
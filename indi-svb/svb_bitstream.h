@@ -0,0 +1,100 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bit stream and Rice block codes
+// Shared by the FITS tile compression and the delta stream codec, both write most significant
+// bit first. A block starts with a code on codeBits: 0 for a block of zeros, k + 1 for Rice codes
+// of split k, or a raw code followed by the values on bBits. Internal header, not installed.
+namespace BitStream
+{
+
+struct Writer
+{
+    uint8_t *out;
+    uint64_t bits = 0;
+    int count = 0;
+
+    explicit Writer(uint8_t *out) : out(out) {}
+
+    void put(uint32_t value, int n)
+    {
+        bits = (bits << n) | value;
+        count += n;
+        while (count >= 8)
+        {
+            count -= 8;
+            *out++ = static_cast<uint8_t>(bits >> count);
+        }
+    }
+
+    void zeros(uint32_t n)
+    {
+        for (; n > 24; n -= 24)
+            put(0, 24);
+        put(0, n);
+    }
+
+    void flush()
+    {
+        if (count > 0)
+            *out++ = static_cast<uint8_t>(bits << (8 - count));
+        count = 0;
+    }
+};
+
+/** Block of zeros, only its code */
+inline void putZeroBlock(Writer &writer, int codeBits)
+{
+    writer.put(0, codeBits);
+}
+
+/** Block stored raw, the values on bBits */
+template <typename T>
+void putRawBlock(Writer &writer, const T *values, size_t count, int codeBits, uint32_t rawCode, int bBits)
+{
+    writer.put(rawCode, codeBits);
+    for (size_t j = 0; j < count; j++)
+        writer.put(values[j], bBits);
+}
+
+/** Block of Rice codes of split k: the quotient in unary, zeros ended by a one, then the k low bits */
+template <typename T>
+void putRiceBlock(Writer &writer, const T *values, size_t count, int codeBits, int k)
+{
+    writer.put(k + 1, codeBits);
+    uint32_t mask = (1u << k) - 1;
+    for (size_t j = 0; j < count; j++)
+    {
+        writer.zeros(values[j] >> k);
+        writer.put((1u << k) | (values[j] & mask), k + 1);
+    }
+}
+
+}
@@ -0,0 +1,316 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_bufferpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+static size_t alignUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+MemoryBudget &MemoryBudget::instance()
+{
+    // never destroyed, cameras of the static loader release their grants at exit
+    static MemoryBudget *budget = new MemoryBudget;
+    return *budget;
+}
+
+void MemoryBudget::setCap(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mCap = bytes;
+}
+
+int MemoryBudget::registerClient(const std::string &name, int priority)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    int client = mNextClient++;
+    mClients[client] = Client {name, priority, 0, 0, 0};
+    return client;
+}
+
+void MemoryBudget::unregisterClient(int client)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mClients.find(client);
+    if (it == mClients.end())
+        return;
+    mUsed -= it->second.granted;
+    mClients.erase(it);
+}
+
+void MemoryBudget::setPriority(int client, int priority)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mClients.find(client);
+    if (it != mClients.end())
+        it->second.priority = priority;
+}
+
+size_t MemoryBudget::shareOf(int client) const
+{
+    std::vector<int> priorities;
+    for (const auto &it : mClients)
+        priorities.push_back(it.second.priority);
+    std::sort(priorities.begin(), priorities.end(), std::greater<int>());
+    priorities.erase(std::unique(priorities.begin(), priorities.end()), priorities.end());
+
+    // tiers by priority, highest first, each splits what the higher ones left max-min fairly
+    size_t remaining = mCap;
+    for (int priority : priorities)
+    {
+        std::vector<std::pair<size_t, int>> tier;
+        for (const auto &it : mClients)
+            if (it.second.priority == priority && it.second.demand > 0)
+                tier.emplace_back(it.second.demand, it.first);
+        std::sort(tier.begin(), tier.end());
+
+        for (size_t i = 0; i < tier.size(); i++)
+        {
+            size_t share = std::min(tier[i].first, remaining / (tier.size() - i));
+            if (tier[i].second == client)
+                return share;
+            remaining -= share;
+        }
+    }
+    return 0;
+}
+
+MemoryBudget::Grant MemoryBudget::reserve(int client, size_t wanted, size_t minimum)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    Grant grant;
+    grant.wanted = wanted;
+
+    auto it = mClients.find(client);
+    if (it == mClients.end())
+    {
+        // not accounted
+        grant.bytes = wanted;
+        return grant;
+    }
+    Client &c = it->second;
+
+    c.demand += wanted;
+    size_t bytes = wanted;
+    if (mCap > 0)
+    {
+        size_t share = shareOf(client);
+        bytes = std::min(bytes, share > c.granted ? share - c.granted : 0);
+        bytes = std::min(bytes, mCap > mUsed ? mCap - mUsed : 0);
+    }
+    if (bytes < wanted)
+        c.throttled++;
+    if (bytes < minimum || bytes == 0)
+    {
+        // denied, the demand is withdrawn
+        c.demand -= wanted;
+        grant.wanted = 0;
+        return grant;
+    }
+
+    grant.bytes = bytes;
+    c.granted += bytes;
+    mUsed += bytes;
+    return grant;
+}
+
+void MemoryBudget::release(int client, Grant &grant)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mClients.find(client);
+    if (it != mClients.end())
+    {
+        Client &c = it->second;
+        c.granted -= grant.bytes;
+        c.demand -= grant.wanted;
+        mUsed -= grant.bytes;
+    }
+    grant = Grant();
+}
+
+MemoryBudget::Usage MemoryBudget::usage(int client) const
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    Usage usage {mCap, mUsed, 0, 0, 0};
+    auto it = mClients.find(client);
+    if (it != mClients.end())
+    {
+        usage.granted = it->second.granted;
+        usage.demand = it->second.demand;
+        usage.throttled = it->second.throttled;
+    }
+    return usage;
+}
+
+FramePool::~FramePool()
+{
+    release();
+}
+
+bool FramePool::allocate(size_t count, size_t size, const Options &options)
+{
+    if (mMap != nullptr && count <= mCount && size <= mSize && options.hugePages == mOptions.hugePages &&
+            options.locked == mOptions.locked)
+        return true;
+    release();
+
+    if (count == 0 || size == 0)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    size_t stride = alignUp(size, options.hugePages ? hugePageSize : pageSize);
+    size_t mapSize = count * stride;
+
+    // the buffers are granted whole under the cap, the camera cannot capture with less
+    mGrant = MemoryBudget::instance().reserve(mBudgetClient, mapSize, mapSize);
+    if (mGrant.bytes == 0)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    void *map = MAP_FAILED;
+    bool explicitHuge = false;
+    if (options.hugePages)
+    {
+        // reserved huge pages first, they are populated by the kernel
+#ifdef MAP_HUGETLB
+        map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        explicitHuge = map != MAP_FAILED;
+#endif
+        if (map == MAP_FAILED)
+        {
+            // transparent huge pages need a 2 MB aligned range
+            void *range = mmap(nullptr, mapSize + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (range == MAP_FAILED)
+            {
+                int error = errno;
+                release();
+                errno = error;
+                return false;
+            }
+            uint8_t *start = static_cast<uint8_t *>(range);
+            uint8_t *aligned = reinterpret_cast<uint8_t *>(alignUp(reinterpret_cast<uintptr_t>(start), hugePageSize));
+            if (aligned > start)
+                munmap(start, aligned - start);
+            munmap(aligned + mapSize, start + hugePageSize - aligned);
+            map = aligned;
+#ifdef MADV_HUGEPAGE
+            madvise(map, mapSize, MADV_HUGEPAGE);
+#endif
+        }
+    }
+    else
+    {
+        map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+        {
+            int error = errno;
+            release();
+            errno = error;
+            return false;
+        }
+    }
+
+    mMap = static_cast<uint8_t *>(map);
+    mMapSize = mapSize;
+    mCount = count;
+    mSize = size;
+    mStride = stride;
+    mOptions = options;
+    mExplicitHuge = explicitHuge;
+
+    // fault every page in now, written so that no zero page is shared
+    for (size_t offset = 0; offset < mapSize; offset += pageSize)
+        *reinterpret_cast<volatile uint8_t *>(mMap + offset) = 0;
+
+    // locking needs RLIMIT_MEMLOCK or CAP_IPC_LOCK, the buffers stay usable without it
+    mLocked = options.locked && mlock(mMap, mMapSize) == 0;
+    return mLocked == options.locked;
+}
+
+void FramePool::release()
+{
+    if (mMap != nullptr)
+        munmap(mMap, mMapSize);
+    MemoryBudget::instance().release(mBudgetClient, mGrant);
+    mMap = nullptr;
+    mMapSize = 0;
+    mCount = mSize = mStride = 0;
+    mLocked = false;
+    mExplicitHuge = false;
+}
+
+FramePool::Usage FramePool::usage() const
+{
+    Usage usage {mMapSize, mLocked ? mMapSize : 0, mExplicitHuge ? mMapSize : 0, mExplicitHuge};
+    if (mMap == nullptr || mExplicitHuge)
+        return usage;
+
+    // transparent huge pages of the areas overlapping the buffers
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == nullptr)
+        return usage;
+    uintptr_t begin = reinterpret_cast<uintptr_t>(mMap), end = begin + mMapSize;
+    bool overlaps = false;
+    char line[256];
+    while (fgets(line, sizeof(line), smaps) != nullptr)
+    {
+        unsigned long start, stop, kb;
+        if (sscanf(line, "%lx-%lx ", &start, &stop) == 2)
+            overlaps = start < end && stop > begin;
+        else if (overlaps && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+            usage.huge += kb << 10;
+    }
+    fclose(smaps);
+    return usage;
+}
+
+size_t FramePool::residentSize()
+{
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
@@ -0,0 +1,159 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Memory budget
+// Every camera of the driver process takes its buffers from one budget with an optional cap.
+// Grants are shared by priority tiers, highest first, each tier splitting what is left max-min
+// fairly between its cameras. The frame buffers are asked whole first, then the rings and the
+// processing buffers. A grant smaller than wanted counts as a throttle.
+class MemoryBudget
+{
+    public:
+        struct Grant
+        {
+            size_t bytes = 0;
+            size_t wanted = 0;
+        };
+
+        struct Usage
+        {
+            size_t cap;             // process cap, 0 when unlimited
+            size_t used;            // bytes granted to every camera
+            size_t granted;         // bytes granted to the camera
+            size_t demand;          // bytes wanted by the camera
+            uint64_t throttled;     // grants of the camera smaller than wanted
+        };
+
+        /** Budget of the driver process */
+        static MemoryBudget &instance();
+
+        /** Set the process cap in bytes, 0 for unlimited, current grants are kept */
+        void setCap(size_t bytes);
+
+        /** Register a camera, higher priorities are served first */
+        int registerClient(const std::string &name, int priority);
+
+        /** Unregister a camera, its grants are returned */
+        void unregisterClient(int client);
+
+        void setPriority(int client, int priority);
+
+        /** Grant up to wanted bytes, at least minimum or nothing (bytes 0) */
+        Grant reserve(int client, size_t wanted, size_t minimum);
+
+        /** Return a grant, it is cleared */
+        void release(int client, Grant &grant);
+
+        Usage usage(int client) const;
+
+    private:
+        struct Client
+        {
+            std::string name;
+            int priority;
+            size_t granted;         // bytes of the grants
+            size_t demand;          // bytes wanted by the grants
+            uint64_t throttled;
+        };
+
+        /** Fair share of the memory for a client, lock held */
+        size_t shareOf(int client) const;
+
+        mutable std::mutex mLock;
+        size_t mCap = 0;
+        size_t mUsed = 0;
+        int mNextClient = 0;
+        std::map<int, Client> mClients;
+};
+
+// Frame buffer pool
+// Frame buffers are mapped once for the largest frame, so that format and subframe changes do not
+// reallocate. The mapping is 2 MB aligned for huge pages: explicit ones when the system reserved
+// some, transparent ones otherwise. Every page is touched at allocation and may be locked in
+// memory, the first frame does not pay the page faults. Functions returning false set errno,
+// ENOMEM when the memory budget denies the buffers.
+class FramePool
+{
+    public:
+        struct Options
+        {
+            bool hugePages;
+            bool locked;
+        };
+
+        struct Usage
+        {
+            size_t mapped;          // bytes of the buffers
+            size_t locked;          // bytes locked in memory
+            size_t huge;            // bytes on huge pages
+            bool explicitHuge;      // hugetlb pages rather than transparent ones
+        };
+
+        static const size_t pageSize = 4096;
+        static const size_t hugePageSize = 2 << 20;
+
+        ~FramePool();
+
+        /**
+         * Map count buffers of size bytes, the current ones are kept when they fit with the same options.
+         * Returns false when the mapping failed, or when the buffers could not be locked: they are then usable.
+         */
+        bool allocate(size_t count, size_t size, const Options &options);
+
+        /** Unmap the buffers */
+        void release();
+
+        /** Account the buffers to a memory budget client, they are granted whole or not mapped */
+        void setBudgetClient(int client) { mBudgetClient = client; }
+
+        uint8_t *buffer(size_t index) const { return index < mCount ? mMap + index * mStride : nullptr; }
+        size_t count() const { return mCount; }
+        size_t bufferSize() const { return mSize; }
+
+        /** Memory of the buffers, huge pages as reported by the kernel */
+        Usage usage() const;
+
+        /** Resident memory of the process */
+        static size_t residentSize();
+
+    private:
+        uint8_t *mMap = nullptr;
+        size_t mMapSize = 0;
+        size_t mCount = 0, mSize = 0, mStride = 0;
+        Options mOptions {false, false};
+        bool mLocked = false;
+        bool mExplicitHuge = false;
+        int mBudgetClient = -1;
+        MemoryBudget::Grant mGrant;
+};
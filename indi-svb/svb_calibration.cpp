@@ -0,0 +1,504 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_calibration.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Calibration
+{
+
+static size_t bytesPerPixel(const MasterKey &key)
+{
+    return key.bitDepth > 8 ? 2 : 1;
+}
+
+static bool readHeader(int fd, MasterHeader &header)
+{
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header))
+        return false;
+
+    return memcmp(header.magic, masterMagic, sizeof(masterMagic)) == 0 &&
+           header.version == masterVersion &&
+           header.dataOffset >= sizeof(header);
+}
+
+MasterFrame::~MasterFrame()
+{
+    if (mMap != nullptr)
+        munmap(mMap, mSize);
+}
+
+std::shared_ptr<MasterFrame> MasterFrame::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    MasterHeader header;
+    struct stat st;
+    if (!readHeader(fd, header) || fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < header.dataOffset +
+        size_t(header.key.width) * header.key.height * bytesPerPixel(header.key))
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return nullptr;
+
+    // masters are read sequentially, row after row
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    std::shared_ptr<MasterFrame> master(new MasterFrame());
+    master->mPath = path;
+    master->mMap = map;
+    master->mSize = st.st_size;
+    master->mHeader = static_cast<const MasterHeader *>(map);
+    return master;
+}
+
+const uint8_t *MasterFrame::row(uint32_t x, uint32_t y) const
+{
+    const MasterKey &k = mHeader->key;
+    size_t index = size_t(y - k.y) * k.width + (x - k.x);
+    return static_cast<const uint8_t *>(mMap) + mHeader->dataOffset + index * bytesPerPixel(k);
+}
+
+bool MasterFrame::covers(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+{
+    const MasterKey &k = mHeader->key;
+    return x >= k.x && y >= k.y && x + width <= k.x + k.width && y + height <= k.y + k.height;
+}
+
+void Library::setDirectory(const std::string &directory)
+{
+    mDirectory = directory;
+    rescan();
+}
+
+void Library::rescan()
+{
+    mEntries.clear();
+
+    DIR *dir = opendir(mDirectory.c_str());
+    if (dir == nullptr)
+        return;
+
+    const size_t extensionLength = strlen(masterExtension);
+    while (struct dirent *entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name.size() <= extensionLength || name.compare(name.size() - extensionLength, extensionLength, masterExtension) != 0)
+            continue;
+
+        std::string path = mDirectory + "/" + name;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            continue;
+
+        MasterHeader header;
+        struct stat st;
+        if (readHeader(fd, header) && fstat(fd, &st) == 0)
+            mEntries.push_back({path, header.key, st.st_mtime});
+        ::close(fd);
+    }
+    closedir(dir);
+}
+
+std::shared_ptr<MasterFrame> Library::find(const MasterKey &key, double exposureTolerance, double temperatureTolerance) const
+{
+    const Entry *best = nullptr;
+    double bestScore = 0;
+
+    for (const auto &entry : mEntries)
+    {
+        const MasterKey &k = entry.key;
+
+        if (k.gain != key.gain || k.offset != key.offset || k.bitDepth != key.bitDepth ||
+            k.stretch != key.stretch || k.bin != key.bin)
+            continue;
+
+        // the master must cover the subframe
+        if (key.x < k.x || key.y < k.y || key.x + key.width > k.x + k.width || key.y + key.height > k.y + k.height)
+            continue;
+
+        double temperatureDelta = 0;
+        if (!std::isnan(key.temperature) && !std::isnan(k.temperature))
+        {
+            temperatureDelta = std::abs(key.temperature - k.temperature);
+            if (temperatureDelta > temperatureTolerance)
+                continue;
+        }
+
+        // darks are preferred, closest exposure then closest temperature
+        double score;
+        if (k.type == MASTER_DARK)
+        {
+            double ratio = key.exposure > 0 ? std::abs(k.exposure - key.exposure) / key.exposure : 1;
+            if (ratio > exposureTolerance)
+                continue;
+            score = ratio + temperatureDelta / 100;
+        }
+        else if (k.type == MASTER_BIAS)
+        {
+            score = 1000 + temperatureDelta / 100;
+        }
+        else
+        {
+            continue;
+        }
+
+        if (best == nullptr || score < bestScore)
+        {
+            best = &entry;
+            bestScore = score;
+        }
+    }
+
+    return best != nullptr ? MasterFrame::open(best->path) : nullptr;
+}
+
+std::shared_ptr<MasterFrame> Library::findFlat(const MasterKey &key) const
+{
+    const Entry *best = nullptr;
+
+    // flats are normalized, only the coverage and binning matter
+    for (const auto &entry : mEntries)
+    {
+        const MasterKey &k = entry.key;
+
+        if (k.type != MASTER_FLAT || k.bin != key.bin)
+            continue;
+
+        if (key.x < k.x || key.y < k.y || key.x + key.width > k.x + k.width || key.y + key.height > k.y + k.height)
+            continue;
+
+        if (best == nullptr || entry.modified > best->modified)
+            best = &entry;
+    }
+
+    return best != nullptr ? MasterFrame::open(best->path) : nullptr;
+}
+
+std::string Library::save(const MasterKey &key, const uint8_t *data)
+{
+    if (!makeDirectory(mDirectory))
+        return std::string();
+
+    static const char *typeNames[] = {"bias", "dark", "flat"};
+
+    char name[256];
+    snprintf(name, sizeof(name), "/%s_g%d_o%d_e%.6f_%ux%u_%u_%u_b%u_%ubit_s%u_t%+.1f%s",
+             typeNames[key.type <= uint32_t(MASTER_FLAT) ? key.type : uint32_t(MASTER_DARK)], key.gain, key.offset, key.exposure, key.width, key.height,
+             key.x, key.y, key.bin, key.bitDepth, key.stretch, std::isnan(key.temperature) ? 0.0 : key.temperature,
+             masterExtension);
+    std::string path = mDirectory + name;
+
+    MasterHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, masterMagic, sizeof(masterMagic));
+    header.version = masterVersion;
+    header.dataOffset = sizeof(header);
+    header.key = key;
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr)
+        return std::string();
+
+    size_t size = size_t(key.width) * key.height * bytesPerPixel(key);
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(data, 1, size, fp) == size;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok)
+    {
+        int error = errno;
+        unlink(path.c_str());
+        errno = error;
+        return std::string();
+    }
+
+    rescan();
+    return path;
+}
+
+bool makeDirectory(const std::string &path)
+{
+    // every parent first, the existing ones are skipped
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+        std::string parent = path.substr(0, slash);
+        if (mkdir(parent.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+        if (slash == std::string::npos)
+            break;
+    }
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    if (!S_ISDIR(st.st_mode))
+    {
+        errno = ENOTDIR;
+        return false;
+    }
+    return true;
+}
+
+bool sameSettings(const MasterKey &a, const MasterKey &b)
+{
+    bool sameTemperature = (std::isnan(a.temperature) && std::isnan(b.temperature)) ||
+                           std::abs(a.temperature - b.temperature) < 0.5;
+
+    return a.width == b.width && a.height == b.height && a.x == b.x && a.y == b.y && a.bin == b.bin &&
+           a.bitDepth == b.bitDepth && a.stretch == b.stretch && a.gain == b.gain && a.offset == b.offset &&
+           a.exposure == b.exposure && sameTemperature;
+}
+
+void subtract(uint16_t *frame, const uint16_t *master, size_t pixels)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= pixels; i += 8)
+    {
+        __m128i *f = reinterpret_cast<__m128i *>(frame + i);
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+        _mm_storeu_si128(f, _mm_subs_epu16(_mm_loadu_si128(f), m));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= pixels; i += 8)
+    {
+        vst1q_u16(frame + i, vqsubq_u16(vld1q_u16(frame + i), vld1q_u16(master + i)));
+    }
+#endif
+    for (; i < pixels; i++)
+        frame[i] = frame[i] > master[i] ? frame[i] - master[i] : 0;
+}
+
+void subtract(uint8_t *frame, const uint8_t *master, size_t pixels)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= pixels; i += 16)
+    {
+        __m128i *f = reinterpret_cast<__m128i *>(frame + i);
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(master + i));
+        _mm_storeu_si128(f, _mm_subs_epu8(_mm_loadu_si128(f), m));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= pixels; i += 16)
+    {
+        vst1q_u8(frame + i, vqsubq_u8(vld1q_u8(frame + i), vld1q_u8(master + i)));
+    }
+#endif
+    for (; i < pixels; i++)
+        frame[i] = frame[i] > master[i] ? frame[i] - master[i] : 0;
+}
+
+void multiply(uint16_t *frame, const uint16_t *reciprocal, size_t pixels)
+{
+    const uint32_t half = 1u << (FlatField::fractionBits - 1);
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i round = _mm_set1_epi32(half);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 8 <= pixels; i += 8)
+    {
+        __m128i *f = reinterpret_cast<__m128i *>(frame + i);
+        __m128i v = _mm_loadu_si128(f);
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(reciprocal + i));
+        // 32 bits products from the low and high halves
+        __m128i lo = _mm_mullo_epi16(v, r);
+        __m128i hi = _mm_mulhi_epu16(v, r);
+        __m128i p0 = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), FlatField::fractionBits);
+        __m128i p1 = _mm_srli_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), FlatField::fractionBits);
+        // unsigned saturation through the signed pack
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(p0, bias32), _mm_sub_epi32(p1, bias32));
+        _mm_storeu_si128(f, _mm_xor_si128(packed, bias16));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= pixels; i += 8)
+    {
+        uint16x8_t v = vld1q_u16(frame + i);
+        uint16x8_t r = vld1q_u16(reciprocal + i);
+        uint16x4_t p0 = vqrshrn_n_u32(vmull_u16(vget_low_u16(v), vget_low_u16(r)), FlatField::fractionBits);
+        uint16x4_t p1 = vqrshrn_n_u32(vmull_u16(vget_high_u16(v), vget_high_u16(r)), FlatField::fractionBits);
+        vst1q_u16(frame + i, vcombine_u16(p0, p1));
+    }
+#endif
+    for (; i < pixels; i++)
+    {
+        uint32_t p = (uint32_t(frame[i]) * reciprocal[i] + half) >> FlatField::fractionBits;
+        frame[i] = p > 0xFFFF ? 0xFFFF : p;
+    }
+}
+
+void multiply(uint8_t *frame, const uint16_t *reciprocal, size_t pixels)
+{
+    const uint32_t half = 1u << (FlatField::fractionBits - 1);
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(half);
+    for (; i + 8 <= pixels; i += 8)
+    {
+        __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(frame + i)), zero);
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(reciprocal + i));
+        __m128i lo = _mm_mullo_epi16(v, r);
+        __m128i hi = _mm_mulhi_epu16(v, r);
+        // 8 bits products stay below 2^24, no signed overflow in the packs
+        __m128i p0 = _mm_srli_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), FlatField::fractionBits);
+        __m128i p1 = _mm_srli_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), FlatField::fractionBits);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), zero);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(frame + i), packed);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= pixels; i += 8)
+    {
+        uint16x8_t v = vmovl_u8(vld1_u8(frame + i));
+        uint16x8_t r = vld1q_u16(reciprocal + i);
+        uint16x4_t p0 = vqrshrn_n_u32(vmull_u16(vget_low_u16(v), vget_low_u16(r)), FlatField::fractionBits);
+        uint16x4_t p1 = vqrshrn_n_u32(vmull_u16(vget_high_u16(v), vget_high_u16(r)), FlatField::fractionBits);
+        vst1_u8(frame + i, vqmovn_u16(vcombine_u16(p0, p1)));
+    }
+#endif
+    for (; i < pixels; i++)
+    {
+        uint32_t p = (uint32_t(frame[i]) * reciprocal[i] + half) >> FlatField::fractionBits;
+        frame[i] = p > 0xFF ? 0xFF : p;
+    }
+}
+
+bool FlatField::load(const MasterFrame &master, bool bayer)
+{
+    clear();
+
+    const MasterKey &k = master.key();
+    const size_t pixels = size_t(k.width) * k.height;
+    if (pixels == 0)
+        return false;
+
+    // mean of each CFA channel, channels follow the sensor parity
+    double sum[4] = {0, 0, 0, 0};
+    size_t count[4] = {0, 0, 0, 0};
+    for (uint32_t y = 0; y < k.height; y++)
+    {
+        const uint8_t *row = master.row(k.x, k.y + y);
+        for (uint32_t x = 0; x < k.width; x++)
+        {
+            int channel = bayer ? (((k.y + y) & 1) << 1) | ((k.x + x) & 1) : 0;
+            sum[channel] += k.bitDepth > 8 ? reinterpret_cast<const uint16_t *>(row)[x] : row[x];
+            count[channel]++;
+        }
+    }
+
+    double mean[4];
+    for (int c = 0; c < 4; c++)
+        mean[c] = count[c] > 0 ? sum[c] / count[c] : 0;
+
+    const double one = 1 << fractionBits;
+    mReciprocal.resize(pixels);
+    for (uint32_t y = 0; y < k.height; y++)
+    {
+        const uint8_t *row = master.row(k.x, k.y + y);
+        uint16_t *reciprocal = mReciprocal.data() + size_t(y) * k.width;
+        for (uint32_t x = 0; x < k.width; x++)
+        {
+            int channel = bayer ? (((k.y + y) & 1) << 1) | ((k.x + x) & 1) : 0;
+            double value = k.bitDepth > 8 ? reinterpret_cast<const uint16_t *>(row)[x] : row[x];
+            // dead pixels are left untouched
+            double gain = value > 0 ? mean[channel] / value : 1.0;
+            reciprocal[x] = static_cast<uint16_t>(std::min(std::round(gain * one), 65535.0));
+        }
+    }
+
+    mKey = k;
+    mPath = master.path();
+    return true;
+}
+
+void FlatField::clear()
+{
+    mReciprocal.clear();
+    mPath.clear();
+}
+
+bool FlatField::covers(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+{
+    return isLoaded() && x >= mKey.x && y >= mKey.y && x + width <= mKey.x + mKey.width &&
+           y + height <= mKey.y + mKey.height;
+}
+
+void FlatField::apply(uint8_t *frame, uint32_t bitDepth, uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+{
+    // slice the subframe out of the flat, row by row
+    for (uint32_t row = 0; row < height; row++)
+    {
+        const uint16_t *reciprocal = mReciprocal.data() + size_t(y + row - mKey.y) * mKey.width + (x - mKey.x);
+        if (bitDepth > 8)
+            multiply(reinterpret_cast<uint16_t *>(frame) + size_t(row) * width, reciprocal, width);
+        else
+            multiply(frame + size_t(row) * width, reciprocal, width);
+    }
+}
+
+void subtract(uint8_t *frame, const MasterFrame &master, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    // the master may be larger than the subframe, subtract row by row
+    for (uint32_t row = 0; row < height; row++)
+    {
+        if (master.key().bitDepth > 8)
+        {
+            uint16_t *line = reinterpret_cast<uint16_t *>(frame) + size_t(row) * width;
+            subtract(line, reinterpret_cast<const uint16_t *>(master.row(x, y + row)), width);
+        }
+        else
+        {
+            subtract(frame + size_t(row) * width, master.row(x, y + row), width);
+        }
+    }
+}
+
+}
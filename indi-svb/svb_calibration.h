@@ -0,0 +1,184 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Calibration masters library
+// Masters are raw little endian frames behind a fixed size header, so that they can be
+// memory mapped and used in place by the capture pipeline.
+namespace Calibration
+{
+
+enum MasterType { MASTER_BIAS, MASTER_DARK, MASTER_FLAT };
+
+// capture settings a master was taken with
+struct MasterKey
+{
+    uint32_t type;
+    uint32_t width, height;     // subframe size
+    uint32_t x, y;              // subframe offset
+    uint32_t bin;               // hardware binning
+    uint32_t bitDepth;
+    uint32_t stretch;           // 16 bits stretch (bit shift)
+    int32_t gain, offset;
+    double exposure;            // seconds
+    double temperature;         // C, NaN if the camera has no sensor temperature
+};
+
+// on disk header, data starts at dataOffset
+struct MasterHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dataOffset;
+    MasterKey key;
+    uint8_t reserved[128 - 16 - sizeof(MasterKey)];
+};
+static_assert(sizeof(MasterHeader) == 128, "master header must stay 128 bytes");
+
+const char masterMagic[8] = {'S', 'V', 'B', 'M', 'A', 'S', 'T', 'R'};
+const uint32_t masterVersion = 1;
+const char masterExtension[] = ".svbm";
+
+// read only memory mapped master
+class MasterFrame
+{
+    public:
+        ~MasterFrame();
+
+        /** Map a master file, nullptr if it is not a valid master */
+        static std::shared_ptr<MasterFrame> open(const std::string &path);
+
+        const MasterKey &key() const { return mHeader->key; }
+        const std::string &path() const { return mPath; }
+
+        /** Row of the master at sensor row y, starting at sensor column x */
+        const uint8_t *row(uint32_t x, uint32_t y) const;
+
+        /** Does the master cover the subframe */
+        bool covers(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+
+    private:
+        MasterFrame() = default;
+
+        std::string mPath;
+        void *mMap = nullptr;
+        size_t mSize = 0;
+        const MasterHeader *mHeader = nullptr;
+};
+
+class Library
+{
+    public:
+        /** Set the library directory and scan it */
+        void setDirectory(const std::string &directory);
+        const std::string &directory() const { return mDirectory; }
+
+        /** Read the headers of every master in the directory */
+        void rescan();
+
+        /**
+         * Find the master matching the capture settings, darks first then bias.
+         * Gain, offset, bit depth, stretch and binning must match and the master must cover the subframe.
+         * Darks must be within exposureTolerance (ratio) of the exposure, and masters within
+         * temperatureTolerance (C) of the sensor temperature when it is known.
+         */
+        std::shared_ptr<MasterFrame> find(const MasterKey &key, double exposureTolerance, double temperatureTolerance) const;
+
+        /** Find the most recent flat master covering the subframe */
+        std::shared_ptr<MasterFrame> findFlat(const MasterKey &key) const;
+
+        /** Write a frame as master in the library, created when missing, returns the file path, empty and errno set on error */
+        std::string save(const MasterKey &key, const uint8_t *data);
+
+        size_t size() const { return mEntries.size(); }
+
+    private:
+        struct Entry
+        {
+            std::string path;
+            MasterKey key;
+            time_t modified;
+        };
+
+        std::string mDirectory;
+        std::vector<Entry> mEntries;
+};
+
+// Flat field correction
+// The reciprocal of the flat master is normalized to its mean, per CFA channel for bayer
+// sensors, and kept in fixed point so that the correction is a multiply and a shift.
+class FlatField
+{
+    public:
+        // reciprocal gains are Q2.14, from 0 to 4
+        static const int fractionBits = 14;
+
+        /** Build the reciprocal of a flat master, normalized per 2x2 CFA channel when bayer */
+        bool load(const MasterFrame &master, bool bayer);
+
+        /** Forget the loaded flat */
+        void clear();
+
+        bool isLoaded() const { return !mReciprocal.empty(); }
+        const std::string &path() const { return mPath; }
+
+        /** Does the flat cover the subframe */
+        bool covers(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+
+        /** Correct an unbinned 8 or 16 bits subframe at sensor offset x, y */
+        void apply(uint8_t *frame, uint32_t bitDepth, uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+
+    private:
+        MasterKey mKey;
+        std::string mPath;
+        std::vector<uint16_t> mReciprocal;
+};
+
+/** Compare capture settings, sensor temperature within 0.5 C */
+bool sameSettings(const MasterKey &a, const MasterKey &b);
+
+/** Create a directory and its missing parents, false and errno set on error */
+bool makeDirectory(const std::string &path);
+
+/** Subtract a master from a subframe, saturating at 0 */
+void subtract(uint8_t *frame, const MasterFrame &master, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+/** Saturating subtraction kernels */
+void subtract(uint16_t *frame, const uint16_t *master, size_t pixels);
+void subtract(uint8_t *frame, const uint8_t *master, size_t pixels);
+
+/** Fixed point multiply kernels, frame = frame * reciprocal >> fractionBits, saturating */
+void multiply(uint16_t *frame, const uint16_t *reciprocal, size_t pixels);
+void multiply(uint8_t *frame, const uint16_t *reciprocal, size_t pixels);
+
+}
@@ -0,0 +1,66 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstdint>
+
+#include "libsv305/SVBCameraSDK.h"
+
+// Colour filter array helpers
+// Patterns describe the 2x2 cell at the sensor origin, sites are addressed in sensor
+// coordinates so that subframe offsets keep the right parity.
+namespace Cfa
+{
+
+enum Color { RED, GREEN, BLUE, MONO };
+
+/** Colour of the site at sensor x, y */
+inline Color color(SVB_BAYER_PATTERN pattern, uint32_t x, uint32_t y)
+{
+    static const Color cells[4][4] =
+    {
+        {RED, GREEN, GREEN, BLUE},  // SVB_BAYER_RG
+        {BLUE, GREEN, GREEN, RED},  // SVB_BAYER_BG
+        {GREEN, RED, BLUE, GREEN},  // SVB_BAYER_GR
+        {GREEN, BLUE, RED, GREEN},  // SVB_BAYER_GB
+    };
+    return cells[pattern & 3][((y & 1) << 1) | (x & 1)];
+}
+
+/** Pattern seen by a subframe starting at sensor x, y */
+inline SVB_BAYER_PATTERN shift(SVB_BAYER_PATTERN pattern, uint32_t x, uint32_t y)
+{
+    // swapping columns and rows of the 2x2 cell
+    static const SVB_BAYER_PATTERN swapColumns[4] = {SVB_BAYER_GR, SVB_BAYER_GB, SVB_BAYER_RG, SVB_BAYER_BG};
+    static const SVB_BAYER_PATTERN swapRows[4] = {SVB_BAYER_GB, SVB_BAYER_GR, SVB_BAYER_BG, SVB_BAYER_RG};
+    if (x & 1)
+        pattern = swapColumns[pattern & 3];
+    if (y & 1)
+        pattern = swapRows[pattern & 3];
+    return pattern;
+}
+
+}
@@ -0,0 +1,243 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_debayer.h"
+#include "svb_cfa.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void average(const uint8_t *a, const uint8_t *b, uint8_t *out, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_avg_epu8(va, vb));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16)
+        vst1q_u8(out + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+#endif
+    for (; i < n; i++)
+        out[i] = (a[i] + b[i] + 1) >> 1;
+}
+
+void average(const uint16_t *a, const uint16_t *b, uint16_t *out, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_avg_epu16(va, vb));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+        vst1q_u16(out + i, vrhaddq_u16(vld1q_u16(a + i), vld1q_u16(b + i)));
+#endif
+    for (; i < n; i++)
+        out[i] = (uint32_t(a[i]) + b[i] + 1) >> 1;
+}
+
+template <typename T>
+static inline void edgeGreenScalar(const T *west, const T *east, const T *north, const T *south, const T *horizontal,
+                                   const T *vertical, const T *cross, T *out, size_t i, size_t n)
+{
+    for (; i < n; i++)
+    {
+        T dh = west[i] > east[i] ? west[i] - east[i] : east[i] - west[i];
+        T dv = north[i] > south[i] ? north[i] - south[i] : south[i] - north[i];
+        out[i] = dh < dv ? horizontal[i] : (dv < dh ? vertical[i] : cross[i]);
+    }
+}
+
+void edgeGreen(const uint8_t *west, const uint8_t *east, const uint8_t *north, const uint8_t *south,
+               const uint8_t *horizontal, const uint8_t *vertical, const uint8_t *cross, uint8_t *out, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(west + i));
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i *>(east + i));
+        __m128i no = _mm_loadu_si128(reinterpret_cast<const __m128i *>(north + i));
+        __m128i so = _mm_loadu_si128(reinterpret_cast<const __m128i *>(south + i));
+        __m128i dh = _mm_or_si128(_mm_subs_epu8(w, e), _mm_subs_epu8(e, w));
+        __m128i dv = _mm_or_si128(_mm_subs_epu8(no, so), _mm_subs_epu8(so, no));
+        // masks are set where the gradient is not smaller
+        __m128i hNotSmaller = _mm_cmpeq_epi8(_mm_subs_epu8(dv, dh), zero);
+        __m128i vNotSmaller = _mm_cmpeq_epi8(_mm_subs_epu8(dh, dv), zero);
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(horizontal + i));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vertical + i));
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cross + i));
+        __m128i g = _mm_or_si128(_mm_and_si128(vNotSmaller, x), _mm_andnot_si128(vNotSmaller, v));
+        g = _mm_or_si128(_mm_and_si128(hNotSmaller, g), _mm_andnot_si128(hNotSmaller, h));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), g);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t dh = vabdq_u8(vld1q_u8(west + i), vld1q_u8(east + i));
+        uint8x16_t dv = vabdq_u8(vld1q_u8(north + i), vld1q_u8(south + i));
+        uint8x16_t g = vbslq_u8(vcltq_u8(dv, dh), vld1q_u8(vertical + i), vld1q_u8(cross + i));
+        vst1q_u8(out + i, vbslq_u8(vcltq_u8(dh, dv), vld1q_u8(horizontal + i), g));
+    }
+#endif
+    edgeGreenScalar(west, east, north, south, horizontal, vertical, cross, out, i, n);
+}
+
+void edgeGreen(const uint16_t *west, const uint16_t *east, const uint16_t *north, const uint16_t *south,
+               const uint16_t *horizontal, const uint16_t *vertical, const uint16_t *cross, uint16_t *out, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(west + i));
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i *>(east + i));
+        __m128i no = _mm_loadu_si128(reinterpret_cast<const __m128i *>(north + i));
+        __m128i so = _mm_loadu_si128(reinterpret_cast<const __m128i *>(south + i));
+        __m128i dh = _mm_or_si128(_mm_subs_epu16(w, e), _mm_subs_epu16(e, w));
+        __m128i dv = _mm_or_si128(_mm_subs_epu16(no, so), _mm_subs_epu16(so, no));
+        __m128i hNotSmaller = _mm_cmpeq_epi16(_mm_subs_epu16(dv, dh), zero);
+        __m128i vNotSmaller = _mm_cmpeq_epi16(_mm_subs_epu16(dh, dv), zero);
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(horizontal + i));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vertical + i));
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cross + i));
+        __m128i g = _mm_or_si128(_mm_and_si128(vNotSmaller, x), _mm_andnot_si128(vNotSmaller, v));
+        g = _mm_or_si128(_mm_and_si128(hNotSmaller, g), _mm_andnot_si128(hNotSmaller, h));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), g);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t dh = vabdq_u16(vld1q_u16(west + i), vld1q_u16(east + i));
+        uint16x8_t dv = vabdq_u16(vld1q_u16(north + i), vld1q_u16(south + i));
+        uint16x8_t g = vbslq_u16(vcltq_u16(dv, dh), vld1q_u16(vertical + i), vld1q_u16(cross + i));
+        vst1q_u16(out + i, vbslq_u16(vcltq_u16(dh, dv), vld1q_u16(horizontal + i), g));
+    }
+#endif
+    edgeGreenScalar(west, east, north, south, horizontal, vertical, cross, out, i, n);
+}
+
+void Debayer::process(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, SVB_BAYER_PATTERN pattern,
+                      int bitDepth, Method method)
+{
+    if (bitDepth > 8)
+        process(reinterpret_cast<const uint16_t *>(src), reinterpret_cast<uint16_t *>(dst), width, height, pattern, method);
+    else
+        process(src, dst, width, height, pattern, method);
+}
+
+template <typename T>
+void Debayer::process(const T *src, T *dst, uint32_t width, uint32_t height, SVB_BAYER_PATTERN pattern, Method method)
+{
+    if (width < 2 || height < 2)
+        return;
+
+    // three padded source rows (mirrored borders keep the colour parity) and the row averages
+    const size_t padded = width + 2;
+    enum { ROW_UP, ROW_CENTER, ROW_DOWN, HORIZONTAL, VERTICAL, CROSS, DIAGONAL, GREEN, ROWS };
+    mScratch.resize(ROWS * padded * sizeof(T));
+    T *rows[ROWS];
+    for (int i = 0; i < ROWS; i++)
+        rows[i] = reinterpret_cast<T *>(mScratch.data()) + i * padded;
+
+    auto pad = [&](T *out, uint32_t y)
+    {
+        const T *in = src + size_t(y) * width;
+        memcpy(out + 1, in, width * sizeof(T));
+        out[0] = in[1];
+        out[width + 1] = in[width - 2];
+    };
+
+    pad(rows[ROW_DOWN], 0);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        // roll the rows, mirrored at the top and bottom
+        std::swap(rows[ROW_UP], rows[ROW_CENTER]);
+        std::swap(rows[ROW_CENTER], rows[ROW_DOWN]);
+        if (y + 1 < height)
+            pad(rows[ROW_DOWN], y + 1);
+        else
+            memcpy(rows[ROW_DOWN], rows[ROW_UP], padded * sizeof(T));
+        if (y == 0)
+            memcpy(rows[ROW_UP], rows[ROW_DOWN], padded * sizeof(T));
+
+        const T *up = rows[ROW_UP], *center = rows[ROW_CENTER], *down = rows[ROW_DOWN];
+        T *h = rows[HORIZONTAL], *v = rows[VERTICAL], *x = rows[CROSS], *d = rows[DIAGONAL], *g = rows[GREEN];
+
+        // h, x, d and g are indexed by output column, v by padded column
+        average(center, center + 2, h, width);
+        average(up, down, v, padded);
+        average(h, v + 1, x, width);
+        average(v, v + 2, d, width);
+        if (method == EDGE_AWARE)
+            edgeGreen(center, center + 2, up + 1, down + 1, h, v + 1, x, g, width);
+        else
+            g = x;
+
+        // the row holds red or blue next to green
+        T *out = dst + size_t(y) * width * 3;
+        const T *c = center + 1;
+        for (uint32_t column = 0; column < width; column++, out += 3)
+        {
+            switch (Cfa::color(pattern, column, y))
+            {
+                case Cfa::RED:
+                    out[0] = c[column];
+                    out[1] = g[column];
+                    out[2] = d[column];
+                    break;
+                case Cfa::BLUE:
+                    out[0] = d[column];
+                    out[1] = g[column];
+                    out[2] = c[column];
+                    break;
+                default:
+                    // green, red and blue are either side of it
+                    bool redRow = Cfa::color(pattern, column ^ 1, y) == Cfa::RED;
+                    out[0] = redRow ? h[column] : v[column + 1];
+                    out[1] = c[column];
+                    out[2] = redRow ? v[column + 1] : h[column];
+                    break;
+            }
+        }
+    }
+}
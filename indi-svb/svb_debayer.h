@@ -0,0 +1,68 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "libsv305/SVBCameraSDK.h"
+
+// Bayer to interleaved RGB
+// Rows are interpolated from running averages of their neighbours (horizontal, vertical,
+// cross and diagonal), each computed over the whole row with SIMD rounding averages.
+class Debayer
+{
+    public:
+        enum Method
+        {
+            BILINEAR,
+            EDGE_AWARE  // green is interpolated along the smallest gradient
+        };
+
+        /**
+         * Debayer a 8 or 16 bits mosaic to RGB of the same depth, pattern is the one of the
+         * first pixel of src (see Cfa::shift for subframes)
+         */
+        void process(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, SVB_BAYER_PATTERN pattern,
+                     int bitDepth, Method method);
+
+    private:
+        template <typename T> void process(const T *src, T *dst, uint32_t width, uint32_t height,
+                                           SVB_BAYER_PATTERN pattern, Method method);
+
+        std::vector<uint8_t> mScratch;
+};
+
+/** Rounding average of two rows */
+void average(const uint8_t *a, const uint8_t *b, uint8_t *out, size_t n);
+void average(const uint16_t *a, const uint16_t *b, uint16_t *out, size_t n);
+
+/** Edge directed green, horizontal average where the row is smoother than the column, vertical where it is not */
+void edgeGreen(const uint8_t *west, const uint8_t *east, const uint8_t *north, const uint8_t *south,
+               const uint8_t *horizontal, const uint8_t *vertical, const uint8_t *cross, uint8_t *out, size_t n);
+void edgeGreen(const uint16_t *west, const uint16_t *east, const uint16_t *north, const uint16_t *south,
+               const uint16_t *horizontal, const uint16_t *vertical, const uint16_t *cross, uint16_t *out, size_t n);
@@ -0,0 +1,460 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_delta.h"
+#include "svb_bitstream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// the valid bits are at the top of the accumulator, zeros are read past the end
+struct BitReader
+{
+    const uint8_t *in, *end;
+    uint64_t bits = 0;
+    int count = 0;
+    size_t padding = 0;
+
+    BitReader(const uint8_t *in, size_t size) : in(in), end(in + size) {}
+
+    void refill()
+    {
+        while (count <= 56)
+        {
+            uint64_t byte = 0;
+            if (in < end)
+                byte = *in++;
+            else
+                padding++;
+            bits |= byte << (56 - count);
+            count += 8;
+        }
+    }
+
+    uint32_t get(int n)
+    {
+        if (n == 0)
+            return 0;
+        refill();
+        uint32_t value = static_cast<uint32_t>(bits >> (64 - n));
+        bits <<= n;
+        count -= n;
+        return value;
+    }
+
+    // zeros ended by a one, false past limit
+    bool unary(uint32_t limit, uint32_t &value)
+    {
+        value = 0;
+        for (;;)
+        {
+            refill();
+            if (bits == 0)
+            {
+                value += count;
+                count = 0;
+                if (value > limit)
+                    return false;
+                continue;
+            }
+            int zeros = __builtin_clzll(bits);
+            value += zeros;
+            bits = (bits << zeros) << 1;
+            count -= zeros + 1;
+            return value <= limit;
+        }
+    }
+
+    // did the reads stay in the payload
+    bool overrun() const { return padding * 8 > static_cast<size_t>(count); }
+};
+
+inline uint16_t zigzag16(uint16_t cur, uint16_t pred)
+{
+    int16_t d = static_cast<int16_t>(cur - pred);
+    return static_cast<uint16_t>((static_cast<uint16_t>(d) << 1) ^ (d >> 15));
+}
+
+inline uint16_t zigzag8(uint8_t cur, uint8_t pred)
+{
+    int8_t d = static_cast<int8_t>(cur - pred);
+    return static_cast<uint8_t>((static_cast<uint8_t>(d) << 1) ^ (d >> 7));
+}
+
+inline int32_t unzigzag(uint32_t z)
+{
+    return static_cast<int32_t>(z >> 1) ^ -static_cast<int32_t>(z & 1);
+}
+
+// mapped residuals of cur predicted by pred, returns their sum
+uint64_t residuals(const uint16_t *cur, const uint16_t *pred, size_t n, uint16_t *out)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i d = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + i)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(pred + i)));
+        __m128i z = _mm_xor_si128(_mm_add_epi16(d, d), _mm_srai_epi16(d, 15));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), z);
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(z, zero), _mm_unpackhi_epi16(z, zero)));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    sum = uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__ARM_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 8 <= n; i += 8)
+    {
+        int16x8_t d = vreinterpretq_s16_u16(vsubq_u16(vld1q_u16(cur + i), vld1q_u16(pred + i)));
+        uint16x8_t z = vreinterpretq_u16_s16(veorq_s16(vshlq_n_s16(d, 1), vshrq_n_s16(d, 15)));
+        vst1q_u16(out + i, z);
+        acc = vpadalq_u16(acc, z);
+    }
+    sum = uint64_t(vgetq_lane_u32(acc, 0)) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#endif
+    for (; i < n; i++)
+    {
+        out[i] = zigzag16(cur[i], pred[i]);
+        sum += out[i];
+    }
+    return sum;
+}
+
+uint64_t residuals(const uint8_t *cur, const uint8_t *pred, size_t n, uint16_t *out)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i d = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + i)),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i *>(pred + i)));
+        __m128i z = _mm_xor_si128(_mm_add_epi8(d, d), _mm_cmpgt_epi8(zero, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi8(z, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8), _mm_unpackhi_epi8(z, zero));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(z, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    sum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 16 <= n; i += 16)
+    {
+        int8x16_t d = vreinterpretq_s8_u8(vsubq_u8(vld1q_u8(cur + i), vld1q_u8(pred + i)));
+        uint8x16_t z = vreinterpretq_u8_s8(veorq_s8(vshlq_n_s8(d, 1), vshrq_n_s8(d, 7)));
+        vst1q_u16(out + i, vmovl_u8(vget_low_u8(z)));
+        vst1q_u16(out + i + 8, vmovl_u8(vget_high_u8(z)));
+        acc = vpadalq_u16(acc, vpaddlq_u8(z));
+    }
+    sum = uint64_t(vgetq_lane_u32(acc, 0)) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#endif
+    for (; i < n; i++)
+    {
+        out[i] = zigzag8(cur[i], pred[i]);
+        sum += out[i];
+    }
+    return sum;
+}
+
+// left neighbour of the same channel, the first samples from the row above
+template <typename T>
+uint64_t spatialResiduals(const T *row, const T *above, size_t n, uint32_t channels, uint16_t *out)
+{
+    uint64_t sum = 0;
+    for (uint32_t c = 0; c < channels && c < n; c++)
+    {
+        T pred = above != nullptr ? above[c] : 0;
+        out[c] = sizeof(T) == 2 ? zigzag16(row[c], pred) : zigzag8(row[c], pred);
+        sum += out[c];
+    }
+    if (n > channels)
+        sum += residuals(row + channels, row, n - channels, out + channels);
+    return sum;
+}
+
+// code of a block: 0 all zeros, k + 1, or maxCode for raw samples
+template <int codeBits, int bBits>
+void encodeBlock(BitStream::Writer &writer, const uint16_t *z, size_t count)
+{
+    const int maxCode = (1 << codeBits) - 1;
+    uint64_t sum = 0;
+    for (size_t j = 0; j < count; j++)
+        sum += z[j];
+    if (sum == 0)
+    {
+        BitStream::putZeroBlock(writer, codeBits);
+        return;
+    }
+
+    // best split around log2 of the mean
+    uint64_t mean = sum / count;
+    int k0 = 0;
+    while ((mean >> (k0 + 1)) > 0)
+        k0++;
+    int best = -1;
+    uint64_t bestBits = uint64_t(count) * bBits;
+    for (int k = std::max(k0 - 1, 0); k <= std::min(k0 + 1, maxCode - 2); k++)
+    {
+        uint64_t bits = count * uint64_t(k + 1);
+        for (size_t j = 0; j < count; j++)
+            bits += z[j] >> k;
+        if (bits < bestBits)
+        {
+            bestBits = bits;
+            best = k;
+        }
+    }
+
+    if (best < 0)
+        BitStream::putRawBlock(writer, z, count, codeBits, maxCode, bBits);
+    else
+        BitStream::putRiceBlock(writer, z, count, codeBits, best);
+}
+
+template <int codeBits, int bBits>
+bool decodeBlock(BitReader &reader, uint16_t *z, size_t count)
+{
+    const int maxCode = (1 << codeBits) - 1;
+    int code = reader.get(codeBits);
+    if (code == 0)
+    {
+        std::fill(z, z + count, 0);
+    }
+    else if (code == maxCode)
+    {
+        for (size_t j = 0; j < count; j++)
+            z[j] = reader.get(bBits);
+    }
+    else
+    {
+        int k = code - 1;
+        uint32_t limit = ((1u << bBits) - 1) >> k;
+        for (size_t j = 0; j < count; j++)
+        {
+            uint32_t quotient;
+            if (!reader.unary(limit, quotient))
+                return false;
+            z[j] = static_cast<uint16_t>((quotient << k) | reader.get(k));
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void encodeResiduals(BitStream::Writer &writer, const uint16_t *z, size_t n)
+{
+    for (size_t i = 0; i < n; i += Delta::blockSize)
+    {
+        size_t count = std::min<size_t>(Delta::blockSize, n - i);
+        if (sizeof(T) == 2)
+            encodeBlock<4, 16>(writer, z + i, count);
+        else
+            encodeBlock<3, 8>(writer, z + i, count);
+    }
+}
+
+template <typename T>
+bool decodeResiduals(BitReader &reader, uint16_t *z, size_t n)
+{
+    for (size_t i = 0; i < n; i += Delta::blockSize)
+    {
+        size_t count = std::min<size_t>(Delta::blockSize, n - i);
+        bool ok = sizeof(T) == 2 ? decodeBlock<4, 16>(reader, z + i, count) : decodeBlock<3, 8>(reader, z + i, count);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+}
+
+namespace Delta
+{
+
+bool readHeader(const uint8_t *packet, size_t size, PacketHeader &header)
+{
+    if (size < sizeof(PacketHeader))
+        return false;
+    memcpy(&header, packet, sizeof(header));
+    if (memcmp(header.magic, packetMagic, sizeof(packetMagic)) != 0 || header.version != packetVersion)
+        return false;
+    if ((header.bitDepth != 8 && header.bitDepth != 16) || header.type > DELTA)
+        return false;
+    if (header.width == 0 || header.height == 0 || header.width > 65536 || header.height > 65536)
+        return false;
+    return header.payloadSize <= size - sizeof(PacketHeader);
+}
+
+size_t Encoder::encode(const uint8_t *frame, uint32_t width, uint32_t height, int32_t colorId, int bitDepth,
+                       uint64_t timestamp)
+{
+    uint32_t channels = colorId == colorRGB ? 3 : 1;
+    size_t rowSamples = size_t(width) * channels;
+    size_t frameBytes = rowSamples * height * (bitDepth / 8);
+
+    bool changed = mHeader.width != width || mHeader.height != height || mHeader.colorId != colorId ||
+                   mHeader.bitDepth != bitDepth;
+    mKeyframe = mKeyRequest || changed || mSinceKey + 1 >= std::max(mKeyInterval, 1u);
+    mKeyRequest = false;
+    mSinceKey = mKeyframe ? 0 : mSinceKey + 1;
+
+    memcpy(mHeader.magic, packetMagic, sizeof(packetMagic));
+    mHeader.version = packetVersion;
+    mHeader.type = mKeyframe ? KEYFRAME : DELTA;
+    mHeader.bitDepth = static_cast<uint8_t>(bitDepth);
+    mHeader.width = width;
+    mHeader.height = height;
+    mHeader.colorId = colorId;
+    mHeader.sequence++;
+    mHeader.timestamp = timestamp;
+
+    // row mode bits, block codes and raw samples at most
+    size_t blocks = (rowSamples + blockSize - 1) / blockSize;
+    size_t bound = (height * (1 + blocks * 4 + rowSamples * bitDepth) + 7) / 8 + 8;
+    if (mPacket.size() < sizeof(PacketHeader) + bound)
+        mPacket.resize(sizeof(PacketHeader) + bound);
+    mSpatial.resize(rowSamples);
+    mTemporal.resize(rowSamples);
+    if (changed)
+        mReference.assign(frameBytes, 0);
+
+    uint8_t *payload = mPacket.data() + sizeof(PacketHeader);
+    mHeader.payloadSize = static_cast<uint32_t>(bitDepth == 16 ?
+                          encodeRows(reinterpret_cast<const uint16_t *>(frame),
+                                     reinterpret_cast<const uint16_t *>(mReference.data()), payload) :
+                          encodeRows(frame, mReference.data(), payload));
+    memcpy(mPacket.data(), &mHeader, sizeof(mHeader));
+    mSize = sizeof(PacketHeader) + mHeader.payloadSize;
+
+    memcpy(mReference.data(), frame, frameBytes);
+    return mSize;
+}
+
+template <typename T>
+size_t Encoder::encodeRows(const T *frame, const T *reference, uint8_t *out)
+{
+    uint32_t channels = mHeader.colorId == colorRGB ? 3 : 1;
+    size_t n = size_t(mHeader.width) * channels;
+    BitStream::Writer writer(out);
+    for (uint32_t y = 0; y < mHeader.height; y++)
+    {
+        const T *row = frame + y * n;
+        uint64_t spatial = spatialResiduals(row, y > 0 ? row - n : nullptr, n, channels, mSpatial.data());
+        if (mKeyframe)
+        {
+            encodeResiduals<T>(writer, mSpatial.data(), n);
+            continue;
+        }
+
+        // temporal unless the row moved
+        uint64_t temporal = residuals(row, reference + y * n, n, mTemporal.data());
+        writer.put(spatial < temporal ? 1 : 0, 1);
+        encodeResiduals<T>(writer, spatial < temporal ? mSpatial.data() : mTemporal.data(), n);
+    }
+    writer.flush();
+    return writer.out - out;
+}
+
+bool Decoder::decode(const uint8_t *packet, size_t size)
+{
+    PacketHeader header;
+    if (!readHeader(packet, size, header))
+    {
+        mValid = false;
+        return false;
+    }
+
+    bool keyframe = header.type == KEYFRAME;
+    if (!keyframe && (!mValid || header.sequence != mHeader.sequence + 1 || header.width != mHeader.width ||
+                      header.height != mHeader.height || header.colorId != mHeader.colorId ||
+                      header.bitDepth != mHeader.bitDepth))
+    {
+        mValid = false;
+        return false;
+    }
+
+    uint32_t channels = header.colorId == colorRGB ? 3 : 1;
+    size_t rowSamples = size_t(header.width) * channels;
+    if (keyframe)
+        mFrame.resize(rowSamples * header.height * (header.bitDepth / 8));
+    mResiduals.resize(rowSamples);
+    mHeader = header;
+
+    const uint8_t *payload = packet + sizeof(PacketHeader);
+    mValid = header.bitDepth == 16 ?
+             decodeRows(reinterpret_cast<uint16_t *>(mFrame.data()), payload, header.payloadSize, keyframe) :
+             decodeRows(mFrame.data(), payload, header.payloadSize, keyframe);
+    return mValid;
+}
+
+template <typename T>
+bool Decoder::decodeRows(T *frame, const uint8_t *payload, size_t size, bool keyframe)
+{
+    uint32_t channels = mHeader.colorId == colorRGB ? 3 : 1;
+    size_t n = size_t(mHeader.width) * channels;
+    uint16_t *z = mResiduals.data();
+    BitReader reader(payload, size);
+    for (uint32_t y = 0; y < mHeader.height; y++)
+    {
+        T *row = frame + y * n;
+        bool spatial = keyframe || reader.get(1) == 1;
+        if (!decodeResiduals<T>(reader, z, n))
+            return false;
+
+        if (!spatial)
+        {
+            // the previous frame is in place
+            for (size_t i = 0; i < n; i++)
+                row[i] = static_cast<T>(row[i] + unzigzag(z[i]));
+            continue;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            T pred = i >= channels ? row[i - channels] : y > 0 ? row[i - n] : 0;
+            row[i] = static_cast<T>(pred + unzigzag(z[i]));
+        }
+    }
+    return !reader.overrun();
+}
+
+}
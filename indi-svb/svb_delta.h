@@ -0,0 +1,122 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Delta stream codec
+// Lossless transport of full bit depth stream frames. A keyframe predicts each sample from its
+// left neighbour of the same channel, the frames in between predict each row from the previous
+// frame or from the left neighbour, whichever is smaller. Residuals are mapped to unsigned by
+// interleaving the signs and Rice coded in blocks of 32 samples. The decoder does not depend on
+// INDI, clients link the svbdelta library to read the packets.
+namespace Delta
+{
+
+enum PacketType { KEYFRAME = 0, DELTA = 1 };
+
+// packet header, little endian, the payload follows
+struct PacketHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint8_t type;
+    uint8_t bitDepth;           // 8 or 16
+    uint32_t width, height;
+    int32_t colorId;            // SER color id, RGB (100) frames are interleaved
+    uint32_t sequence;          // deltas apply to the frame of sequence - 1
+    uint64_t timestamp;         // UTC microseconds of the capture
+    uint32_t payloadSize;
+    uint32_t reserved;
+};
+static_assert(sizeof(PacketHeader) == 40, "packet header must stay 40 bytes");
+
+const char packetMagic[4] = {'S', 'V', 'B', 'D'};
+const uint16_t packetVersion = 1;
+const uint32_t blockSize = 32;
+const int32_t colorRGB = 100;
+
+/** Check a packet and read its header */
+bool readHeader(const uint8_t *packet, size_t size, PacketHeader &header);
+
+class Encoder
+{
+    public:
+        /** Keyframe every interval frames, 1 sends keyframes only */
+        void setKeyInterval(uint32_t interval) { mKeyInterval = interval; }
+
+        /** Next frame is a keyframe */
+        void requestKeyframe() { mKeyRequest = true; }
+
+        /** Encode a frame, a keyframe when due or when the format changes, returns the packet size */
+        size_t encode(const uint8_t *frame, uint32_t width, uint32_t height, int32_t colorId, int bitDepth,
+                      uint64_t timestamp);
+
+        const uint8_t *data() const { return mPacket.data(); }
+        size_t size() const { return mSize; }
+        bool isKeyframe() const { return mKeyframe; }
+
+    private:
+        template <typename T> size_t encodeRows(const T *frame, const T *reference, uint8_t *out);
+
+        PacketHeader mHeader {};
+        uint32_t mKeyInterval = 30;
+        uint32_t mSinceKey = 0;
+        bool mKeyRequest = true;
+        bool mKeyframe = false;
+
+        std::vector<uint8_t> mReference;        // previous frame
+        std::vector<uint8_t> mPacket;
+        size_t mSize = 0;
+        std::vector<uint16_t> mSpatial, mTemporal;
+};
+
+class Decoder
+{
+    public:
+        /**
+         * Decode a packet, false if it is not valid or if it is a delta whose reference frame was
+         * not decoded, the next keyframe resynchronizes the decoder
+         */
+        bool decode(const uint8_t *packet, size_t size);
+
+        /** Last decoded frame and its header */
+        const std::vector<uint8_t> &frame() const { return mFrame; }
+        const PacketHeader &header() const { return mHeader; }
+
+    private:
+        template <typename T> bool decodeRows(T *frame, const uint8_t *payload, size_t size, bool keyframe);
+
+        PacketHeader mHeader {};
+        bool mValid = false;
+        std::vector<uint8_t> mFrame;
+        std::vector<uint16_t> mResiduals;
+};
+
+}
@@ -26,14 +26,20 @@
 
 #include "svb_ccd.h"
 #include "svb_helpers.h"
+#include "svb_unpack.h"
+#include "svb_cfa.h"
 
 #include "config.h"
 
 #include <stream/streammanager.h>
-#include <indielapsedtimer.h>
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
 #include <cmath>
+#include <cstring>
+#include <ctime>
 #include <vector>
 #include <map>
 #include <unistd.h>
@@ -41,454 +47,3456 @@
 #define MAX_EXP_RETRIES 3
 #define VERBOSE_EXPOSURE 3
 
+#define CALIBRATION_TAB "Calibration"
+
 SVBDevice::SVBDevice()
 {
-    SVBTemperature();
+    SVBTemperature();
+    mEventWriter.setCompletion([this](const std::string & path, int error)
+    {
+        if (error != 0)
+            LOGF_ERROR("Failed to save the event %s (%s)", path.c_str(), strerror(error));
+    });
+}
+
+SVBDevice::~SVBDevice()
+{
+    mWorker.quit();
+    if (mFreezeThread.joinable())
+        mFreezeThread.join();
+    mEventWriter.stop();
+    // the writer publishes its completions, drain it before the properties go
+    mAsyncWriter.stop();
+}
+
+bool SVBDevice::createControls(int piNumberOfControls)
+{
+    auto r = SVBTemperature::createControls(piNumberOfControls);
+
+    if (r)
+    {
+        // live stacking
+        LiveStackSP[LIVE_STACK_ON].fill("LIVE_STACK_ON", "On", ISS_OFF);
+        LiveStackSP[LIVE_STACK_OFF].fill("LIVE_STACK_OFF", "Off", ISS_ON);
+        LiveStackSP.fill(getDeviceName(), "LIVE_STACK", "Live stack", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        LiveStackNP[LIVE_STACK_FRAMES].fill("LIVE_STACK_FRAMES", "Publish every (frames)", "%.f", 1, 1000, 1, 10);
+        LiveStackNP[LIVE_STACK_INTERVAL].fill("LIVE_STACK_INTERVAL", "Publish every (s, 0 off)", "%.1f", 0, 600, 1, 0);
+        LiveStackNP[LIVE_STACK_KAPPA].fill("LIVE_STACK_KAPPA", "Rejection (sigma, 0 off)", "%.1f", 0, 10, 0.5, 3);
+        LiveStackNP.fill(getDeviceName(), "LIVE_STACK_SETTINGS", "Live stack", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        LiveStackControlSP[LIVE_STACK_RESET].fill("LIVE_STACK_RESET", "Reset", ISS_OFF);
+        LiveStackControlSP[LIVE_STACK_SNAPSHOT].fill("LIVE_STACK_SNAPSHOT", "Snapshot", ISS_OFF);
+        LiveStackControlSP.fill(getDeviceName(), "LIVE_STACK_CONTROL", "Live stack", STREAM_TAB, IP_RW, ISR_ATMOST1, 60,
+                                IPS_IDLE);
+
+        LiveStackInfoNP[LIVE_STACK_STACKED].fill("LIVE_STACK_STACKED", "Stacked frames", "%.f", 0, 65535, 1, 0);
+        LiveStackInfoNP[LIVE_STACK_REJECTED].fill("LIVE_STACK_REJECTED", "Rejected pixels (%)", "%.3f", 0, 100, 1, 0);
+        LiveStackInfoNP.fill(getDeviceName(), "LIVE_STACK_INFO", "Live stack", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        // frame statistics
+        FrameStatsNP[STATS_MEAN].fill("STATS_MEAN", "Mean", "%.1f", 0, 65535, 0, 0);
+        FrameStatsNP[STATS_MEDIAN].fill("STATS_MEDIAN", "Median", "%.f", 0, 65535, 0, 0);
+        FrameStatsNP[STATS_STDDEV].fill("STATS_STDDEV", "Standard deviation", "%.1f", 0, 65535, 0, 0);
+        FrameStatsNP[STATS_MIN].fill("STATS_MIN", "Min", "%.f", 0, 65535, 0, 0);
+        FrameStatsNP[STATS_MAX].fill("STATS_MAX", "Max", "%.f", 0, 65535, 0, 0);
+        FrameStatsNP[STATS_SATURATED].fill("STATS_SATURATED", "Saturated pixels", "%.f", 0, 1e9, 0, 0);
+        FrameStatsNP[STATS_SATURATED_PERCENT].fill("STATS_SATURATED_PERCENT", "Saturated (%)", "%.3f", 0, 100, 0, 0);
+        FrameStatsNP.fill(getDeviceName(), "FRAME_STATISTICS", "Frame statistics", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+        mStatsTimer.start();
+
+        // auto exposure while streaming
+        AutoExposureSP[AUTO_EXPOSURE_OFF].fill("AUTO_EXPOSURE_OFF", "Off", ISS_ON);
+        AutoExposureSP[AUTO_EXPOSURE_EXPOSURE].fill("AUTO_EXPOSURE_EXPOSURE", "Exposure", ISS_OFF);
+        AutoExposureSP[AUTO_EXPOSURE_EXPOSURE_GAIN].fill("AUTO_EXPOSURE_EXPOSURE_GAIN", "Exposure and gain", ISS_OFF);
+        AutoExposureSP.fill(getDeviceName(), "STREAM_AUTO_EXPOSURE", "Auto exposure", STREAM_TAB, IP_RW, ISR_1OFMANY, 60,
+                            IPS_IDLE);
+
+        AutoExposureNP[AUTO_EXPOSURE_TARGET].fill("AUTO_EXPOSURE_TARGET", "Target level (%)", "%.f", 1, 99, 1, 40);
+        AutoExposureNP[AUTO_EXPOSURE_PERCENTILE].fill("AUTO_EXPOSURE_PERCENTILE", "Measured percentile", "%.1f", 1, 100, 1, 50);
+        AutoExposureNP[AUTO_EXPOSURE_TOLERANCE].fill("AUTO_EXPOSURE_TOLERANCE", "Tolerance (%)", "%.f", 1, 50, 1, 10);
+        AutoExposureNP[AUTO_EXPOSURE_MAX_STEP].fill("AUTO_EXPOSURE_MAX_STEP", "Max step (x)", "%.1f", 1.1, 10, 0.1, 2);
+        AutoExposureNP[AUTO_EXPOSURE_MAX_EXPOSURE].fill("AUTO_EXPOSURE_MAX_EXPOSURE", "Max exposure (ms, 0 frame rate)",
+                "%.f", 0, 10000, 1, 0);
+        AutoExposureNP.fill(getDeviceName(), "STREAM_AUTO_EXPOSURE_SETTINGS", "Auto exposure", STREAM_TAB, IP_RW, 60,
+                            IPS_IDLE);
+
+        AutoExposureInfoNP[AUTO_EXPOSURE_INFO_EXPOSURE].fill("AUTO_EXPOSURE_INFO_EXPOSURE", "Exposure (ms)", "%.3f", 0,
+                1e6, 0, 0);
+        AutoExposureInfoNP[AUTO_EXPOSURE_INFO_GAIN].fill("AUTO_EXPOSURE_INFO_GAIN", "Gain", "%.f", 0, 1e6, 0, 0);
+        AutoExposureInfoNP[AUTO_EXPOSURE_INFO_LEVEL].fill("AUTO_EXPOSURE_INFO_LEVEL", "Level (%)", "%.1f", 0, 100, 0, 0);
+        AutoExposureInfoNP.fill(getDeviceName(), "STREAM_AUTO_EXPOSURE_INFO", "Auto exposure", STREAM_TAB, IP_RO, 60,
+                                IPS_IDLE);
+
+        // star detection
+        StarDetectionSP[STAR_DETECTION_ON].fill("STAR_DETECTION_ON", "On", ISS_OFF);
+        StarDetectionSP[STAR_DETECTION_OFF].fill("STAR_DETECTION_OFF", "Off", ISS_ON);
+        StarDetectionSP.fill(getDeviceName(), "STAR_DETECTION", "Star detection", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60,
+                             IPS_IDLE);
+
+        StarDetectionNP[STAR_DETECTION_KAPPA].fill("STAR_DETECTION_KAPPA", "Threshold (sigma)", "%.1f", 1, 50, 0.5, 5);
+        StarDetectionNP[STAR_DETECTION_MIN_PIXELS].fill("STAR_DETECTION_MIN_PIXELS", "Min pixels", "%.f", 1, 1000, 1, 3);
+        StarDetectionNP[STAR_DETECTION_MAX_PIXELS].fill("STAR_DETECTION_MAX_PIXELS", "Max pixels", "%.f", 10, 1e6, 100, 10000);
+        StarDetectionNP[STAR_DETECTION_MAX_STARS].fill("STAR_DETECTION_MAX_STARS", "Max stars", "%.f", 1, 10000, 10, 500);
+        StarDetectionNP.fill(getDeviceName(), "STAR_DETECTION_SETTINGS", "Star detection", IMAGE_SETTINGS_TAB, IP_RW, 60,
+                             IPS_IDLE);
+
+        StarInfoNP[STAR_INFO_COUNT].fill("STAR_INFO_COUNT", "Stars", "%.f", 0, 10000, 0, 0);
+        StarInfoNP[STAR_INFO_HFR].fill("STAR_INFO_HFR", "Median HFR (px)", "%.2f", 0, 1000, 0, 0);
+        StarInfoNP[STAR_INFO_FWHM].fill("STAR_INFO_FWHM", "Median FWHM (px)", "%.2f", 0, 1000, 0, 0);
+        StarInfoNP[STAR_INFO_BACKGROUND].fill("STAR_INFO_BACKGROUND", "Background", "%.1f", 0, 65535, 0, 0);
+        StarInfoNP[STAR_INFO_NOISE].fill("STAR_INFO_NOISE", "Noise", "%.1f", 0, 65535, 0, 0);
+        StarInfoNP.fill(getDeviceName(), "STAR_INFO", "Stars", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+
+        StarListBP[0].fill("STAR_LIST", "Star list", ".csv");
+        StarListBP.fill(getDeviceName(), "STAR_LIST", "Star list", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+        mStarTimer.start();
+
+        // focus mode, region center 0, 0 is the brightest star
+        FocusModeSP[FOCUS_MODE_ON].fill("FOCUS_MODE_ON", "On", ISS_OFF);
+        FocusModeSP[FOCUS_MODE_OFF].fill("FOCUS_MODE_OFF", "Off", ISS_ON);
+        FocusModeSP.fill(getDeviceName(), "STREAM_FOCUS_MODE", "Focus mode", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        FocusRegionNP[FOCUS_REGION_X].fill("FOCUS_REGION_X", "Center X (0 star)", "%.f", 0, cameraProperty.MaxWidth, 1, 0);
+        FocusRegionNP[FOCUS_REGION_Y].fill("FOCUS_REGION_Y", "Center Y (0 star)", "%.f", 0, cameraProperty.MaxHeight, 1, 0);
+        FocusRegionNP[FOCUS_REGION_SIZE].fill("FOCUS_REGION_SIZE", "Size", "%.f", 16, 1024, 16, 128);
+        FocusRegionNP[FOCUS_THUMBNAIL_EVERY].fill("FOCUS_THUMBNAIL_EVERY", "Thumbnail every (frames, 0 off)", "%.f", 0, 1000,
+                1, 0);
+        FocusRegionNP[FOCUS_THUMBNAIL_SCALE].fill("FOCUS_THUMBNAIL_SCALE", "Thumbnail downsampling", "%.f", 1, 8, 1, 2);
+        FocusRegionNP.fill(getDeviceName(), "STREAM_FOCUS_REGION", "Focus mode", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        FocusMetricNP[FOCUS_METRIC_SEQUENCE].fill("FOCUS_METRIC_SEQUENCE", "Frame", "%.f", 0, 4294967295.0, 0, 0);
+        FocusMetricNP[FOCUS_METRIC_TIMESTAMP].fill("FOCUS_METRIC_TIMESTAMP", "Timestamp (s)", "%.3f", 0, 1e12, 0, 0);
+        FocusMetricNP[FOCUS_METRIC_HFR].fill("FOCUS_METRIC_HFR", "HFR (px)", "%.2f", 0, 1000, 0, 0);
+        FocusMetricNP[FOCUS_METRIC_FWHM].fill("FOCUS_METRIC_FWHM", "FWHM (px)", "%.2f", 0, 1000, 0, 0);
+        FocusMetricNP[FOCUS_METRIC_SHARPNESS].fill("FOCUS_METRIC_SHARPNESS", "Laplacian variance", "%.f", 0, 1e12, 0, 0);
+        FocusMetricNP[FOCUS_METRIC_STARS].fill("FOCUS_METRIC_STARS", "Stars", "%.f", 0, 10000, 0, 0);
+        FocusMetricNP.fill(getDeviceName(), "STREAM_FOCUS_METRIC", "Focus metric", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        FocusThumbnailBP[0].fill("FOCUS_THUMBNAIL", "Thumbnail", ".pgm");
+        FocusThumbnailBP.fill(getDeviceName(), "STREAM_FOCUS_THUMBNAIL", "Focus thumbnail", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        // guide loop through the ST4 port
+        GuideLoopSP[GUIDE_LOOP_OFF].fill("GUIDE_LOOP_OFF", "Off", ISS_ON);
+        GuideLoopSP[GUIDE_LOOP_CALIBRATE].fill("GUIDE_LOOP_CALIBRATE", "Calibrate", ISS_OFF);
+        GuideLoopSP[GUIDE_LOOP_GUIDE].fill("GUIDE_LOOP_GUIDE", "Guide", ISS_OFF);
+        GuideLoopSP.fill(getDeviceName(), "GUIDE_LOOP", "Guide loop", GUIDE_CONTROL_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        GuideSettingsNP[GUIDE_AGGRESSIVENESS_RA].fill("GUIDE_AGGRESSIVENESS_RA", "RA aggressiveness", "%.2f", 0, 1.5, 0.05, 0.7);
+        GuideSettingsNP[GUIDE_AGGRESSIVENESS_DEC].fill("GUIDE_AGGRESSIVENESS_DEC", "DEC aggressiveness", "%.2f", 0, 1.5, 0.05,
+                0.7);
+        GuideSettingsNP[GUIDE_HYSTERESIS].fill("GUIDE_HYSTERESIS", "Hysteresis", "%.2f", 0, 0.9, 0.05, 0.1);
+        GuideSettingsNP[GUIDE_MIN_MOVE].fill("GUIDE_MIN_MOVE", "Min move (px)", "%.2f", 0, 5, 0.05, 0.15);
+        GuideSettingsNP[GUIDE_MAX_PULSE].fill("GUIDE_MAX_PULSE", "Max pulse (ms)", "%.f", 10, 5000, 10, 1000);
+        GuideSettingsNP[GUIDE_CALIBRATION_PULSE].fill("GUIDE_CALIBRATION_PULSE", "Calibration pulse (ms)", "%.f", 50, 5000, 50,
+                500);
+        GuideSettingsNP[GUIDE_CALIBRATION_DISTANCE].fill("GUIDE_CALIBRATION_DISTANCE", "Calibration distance (px)", "%.f", 5,
+                100, 1, 15);
+        GuideSettingsNP[GUIDE_SEARCH_RADIUS].fill("GUIDE_SEARCH_RADIUS", "Search radius (px)", "%.f", 2, 100, 1, 10);
+        GuideSettingsNP[GUIDE_REGION_SIZE].fill("GUIDE_REGION_SIZE", "Region size", "%.f", 32, 1024, 16, 128);
+        GuideSettingsNP.fill(getDeviceName(), "GUIDE_LOOP_SETTINGS", "Guide loop", GUIDE_CONTROL_TAB, IP_RW, 60, IPS_IDLE);
+
+        GuideStateTP[0].fill("GUIDE_LOOP_STATE", "State", mGuider.stateName());
+        GuideStateTP.fill(getDeviceName(), "GUIDE_LOOP_STATE", "Guide loop", GUIDE_CONTROL_TAB, IP_RO, 60, IPS_IDLE);
+
+        GuideErrorNP[GUIDE_ERROR_FRAME].fill("GUIDE_ERROR_FRAME", "Frame", "%.f", 0, 4294967295.0, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_TIMESTAMP].fill("GUIDE_ERROR_TIMESTAMP", "Timestamp (s)", "%.3f", 0, 1e12, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_X].fill("GUIDE_ERROR_X", "Star X (px)", "%.2f", 0, 65535, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_Y].fill("GUIDE_ERROR_Y", "Star Y (px)", "%.2f", 0, 65535, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_RA].fill("GUIDE_ERROR_RA", "RA error (px)", "%.2f", -1000, 1000, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_DEC].fill("GUIDE_ERROR_DEC", "DEC error (px)", "%.2f", -1000, 1000, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_PULSE_RA].fill("GUIDE_ERROR_PULSE_RA", "RA pulse (ms, + west)", "%.f", -5000, 5000, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_PULSE_DEC].fill("GUIDE_ERROR_PULSE_DEC", "DEC pulse (ms, + north)", "%.f", -5000, 5000, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_RMS_RA].fill("GUIDE_ERROR_RMS_RA", "RA RMS (px)", "%.2f", 0, 1000, 0, 0);
+        GuideErrorNP[GUIDE_ERROR_RMS_DEC].fill("GUIDE_ERROR_RMS_DEC", "DEC RMS (px)", "%.2f", 0, 1000, 0, 0);
+        GuideErrorNP.fill(getDeviceName(), "GUIDE_LOOP_ERROR", "Guide error", GUIDE_CONTROL_TAB, IP_RO, 60, IPS_IDLE);
+
+        GuideCalibrationNP[GUIDE_CALIBRATION_RATE_RA].fill("GUIDE_CALIBRATION_RATE_RA", "RA rate (px/s)", "%.2f", 0, 1e6, 0, 0);
+        GuideCalibrationNP[GUIDE_CALIBRATION_ANGLE_RA].fill("GUIDE_CALIBRATION_ANGLE_RA", "RA angle (deg)", "%.1f", -180, 180,
+                0, 0);
+        GuideCalibrationNP[GUIDE_CALIBRATION_RATE_DEC].fill("GUIDE_CALIBRATION_RATE_DEC", "DEC rate (px/s)", "%.2f", 0, 1e6, 0,
+                0);
+        GuideCalibrationNP[GUIDE_CALIBRATION_ANGLE_DEC].fill("GUIDE_CALIBRATION_ANGLE_DEC", "DEC angle (deg)", "%.1f", -180,
+                180, 0, 0);
+        GuideCalibrationNP.fill(getDeviceName(), "GUIDE_LOOP_CALIBRATION", "Guide calibration", GUIDE_CONTROL_TAB, IP_RO, 60,
+                                IPS_IDLE);
+
+        // debayer, streams RGB
+        DebayerSP[DEBAYER_OFF].fill("DEBAYER_OFF", "Off", ISS_ON);
+        DebayerSP[DEBAYER_BILINEAR].fill("DEBAYER_BILINEAR", "Bilinear", ISS_OFF);
+        DebayerSP[DEBAYER_EDGE_AWARE].fill("DEBAYER_EDGE_AWARE", "Edge aware", ISS_OFF);
+        DebayerSP.fill(getDeviceName(), "STREAM_DEBAYER", "Debayer", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        // SER recording of the stream
+        SerRecordSP[SER_RECORD_ON].fill("SER_RECORD_ON", "On", ISS_OFF);
+        SerRecordSP[SER_RECORD_OFF].fill("SER_RECORD_OFF", "Off", ISS_ON);
+        SerRecordSP.fill(getDeviceName(), "SER_RECORD", "SER recording", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        const char *recordHome = getenv("HOME");
+        SerFileTP[SER_DIRECTORY].fill("SER_DIRECTORY", "Directory", recordHome ? recordHome : "/tmp");
+        SerFileTP[SER_PREFIX].fill("SER_PREFIX", "Prefix", "svb");
+        SerFileTP.fill(getDeviceName(), "SER_RECORD_FILE", "SER file", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        SerOptionsNP[SER_MAX_FILE_SIZE].fill("SER_MAX_FILE_SIZE", "File size limit (MB, 0 none)", "%.f", 0, 1e6, 100, 4000);
+        SerOptionsNP.fill(getDeviceName(), "SER_RECORD_OPTIONS", "SER file", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        SerDirectSP[SER_DIRECT_ON].fill("SER_DIRECT_ON", "On", ISS_OFF);
+        SerDirectSP[SER_DIRECT_OFF].fill("SER_DIRECT_OFF", "Off", ISS_ON);
+        SerDirectSP.fill(getDeviceName(), "SER_RECORD_DIRECT", "Direct I/O", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        SerInfoNP[SER_INFO_FRAMES].fill("SER_INFO_FRAMES", "Frames", "%.f", 0, 1e12, 0, 0);
+        SerInfoNP[SER_INFO_SIZE].fill("SER_INFO_SIZE", "Size (MB)", "%.1f", 0, 1e12, 0, 0);
+        SerInfoNP[SER_INFO_FILES].fill("SER_INFO_FILES", "Files", "%.f", 0, 1e6, 0, 0);
+        SerInfoNP[SER_INFO_RATE].fill("SER_INFO_RATE", "Rate (MB/s)", "%.1f", 0, 1e6, 0, 0);
+        SerInfoNP.fill(getDeviceName(), "SER_RECORD_INFO", "SER recording", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        // flight recorder, ring file of the last seconds of stream
+        FlightRecorderSP[FLIGHT_RECORDER_ON].fill("FLIGHT_RECORDER_ON", "On", ISS_OFF);
+        FlightRecorderSP[FLIGHT_RECORDER_OFF].fill("FLIGHT_RECORDER_OFF", "Off", ISS_ON);
+        FlightRecorderSP.fill(getDeviceName(), "FLIGHT_RECORDER", "Flight recorder", STREAM_TAB, IP_RW, ISR_1OFMANY, 60,
+                              IPS_IDLE);
+
+        std::string ring = std::string(recordHome ? recordHome : "/tmp") + "/.indi/svb_flight_recorder_" +
+                           mCameraInfo.CameraSN + ".ring";
+        FlightRecorderTP[0].fill("RING", "Ring file", ring.c_str());
+        FlightRecorderTP.fill(getDeviceName(), "FLIGHT_RECORDER_FILE", "Flight recorder", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        FlightRecorderNP[FLIGHT_RECORDER_SIZE].fill("FLIGHT_RECORDER_SIZE", "Ring size (MB)", "%.f", 16, 1e6, 64, 1024);
+        FlightRecorderNP[FLIGHT_RECORDER_SECONDS].fill("FLIGHT_RECORDER_SECONDS", "Pre-trigger (s)", "%.1f", 0.1, 3600, 1, 10);
+        FlightRecorderNP.fill(getDeviceName(), "FLIGHT_RECORDER_SETTINGS", "Flight recorder", STREAM_TAB, IP_RW, 60,
+                              IPS_IDLE);
+
+        FlightTriggerSP[0].fill("FLIGHT_RECORDER_FREEZE", "Freeze", ISS_OFF);
+        FlightTriggerSP.fill(getDeviceName(), "FLIGHT_RECORDER_TRIGGER", "Flight recorder", STREAM_TAB, IP_RW, ISR_ATMOST1, 60,
+                             IPS_IDLE);
+
+        FlightRecorderInfoNP[FLIGHT_INFO_FRAMES].fill("FLIGHT_INFO_FRAMES", "Frames in ring", "%.f", 0, 1e9, 0, 0);
+        FlightRecorderInfoNP[FLIGHT_INFO_SPAN].fill("FLIGHT_INFO_SPAN", "Ring span (s)", "%.1f", 0, 1e9, 0, 0);
+        FlightRecorderInfoNP[FLIGHT_INFO_FROZEN].fill("FLIGHT_INFO_FROZEN", "Frozen files", "%.f", 0, 1e9, 0, 0);
+        FlightRecorderInfoNP[FLIGHT_INFO_LAST].fill("FLIGHT_INFO_LAST", "Last freeze (frames)", "%.f", 0, 1e9, 0, 0);
+        FlightRecorderInfoNP.fill(getDeviceName(), "FLIGHT_RECORDER_INFO", "Flight recorder", STREAM_TAB, IP_RO, 60,
+                                  IPS_IDLE);
+
+        // transient detection, events saved in the SER directory
+        TransientSP[TRANSIENT_ON].fill("TRANSIENT_ON", "On", ISS_OFF);
+        TransientSP[TRANSIENT_OFF].fill("TRANSIENT_OFF", "Off", ISS_ON);
+        TransientSP.fill(getDeviceName(), "TRANSIENT_DETECTION", "Transients", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        TransientNP[TRANSIENT_KAPPA].fill("TRANSIENT_KAPPA", "Threshold (sigma)", "%.1f", 2, 50, 0.5, 6);
+        TransientNP[TRANSIENT_MIN_PIXELS].fill("TRANSIENT_MIN_PIXELS", "Changed pixels per tile", "%.f", 1, 1024, 1, 8);
+        TransientNP[TRANSIENT_MAX_AREA].fill("TRANSIENT_MAX_AREA", "Scene change (% tiles)", "%.f", 1, 100, 5, 25);
+        TransientNP[TRANSIENT_PRE].fill("TRANSIENT_PRE", "Frames before", "%.f", 0, 10000, 1, 25);
+        TransientNP[TRANSIENT_POST].fill("TRANSIENT_POST", "Frames after", "%.f", 1, 10000, 1, 25);
+        TransientNP[TRANSIENT_RING].fill("TRANSIENT_RING", "Ring size (MB)", "%.f", 16, 1e5, 64, 256);
+        TransientNP.fill(getDeviceName(), "TRANSIENT_SETTINGS", "Transients", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        TransientEventNP[EVENT_COUNT].fill("EVENT_COUNT", "Events", "%.f", 0, 1e9, 0, 0);
+        TransientEventNP[EVENT_FRAMES].fill("EVENT_FRAMES", "Active frames", "%.f", 0, 1e9, 0, 0);
+        TransientEventNP[EVENT_X].fill("EVENT_X", "X", "%.f", 0, 1e5, 0, 0);
+        TransientEventNP[EVENT_Y].fill("EVENT_Y", "Y", "%.f", 0, 1e5, 0, 0);
+        TransientEventNP[EVENT_WIDTH].fill("EVENT_WIDTH", "Width", "%.f", 0, 1e5, 0, 0);
+        TransientEventNP[EVENT_HEIGHT].fill("EVENT_HEIGHT", "Height", "%.f", 0, 1e5, 0, 0);
+        TransientEventNP[EVENT_PEAK].fill("EVENT_PEAK", "Peak (ADU)", "%.f", 0, 65535, 0, 0);
+        TransientEventNP[EVENT_NOISE].fill("EVENT_NOISE", "Noise (ADU)", "%.1f", 0, 65535, 0, 0);
+        TransientEventNP.fill(getDeviceName(), "TRANSIENT_EVENT", "Last event", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        TransientEventTP[EVENT_TIME].fill("EVENT_TIME", "Time (UTC)", "");
+        TransientEventTP[EVENT_FILE].fill("EVENT_FILE", "File", "");
+        TransientEventTP.fill(getDeviceName(), "TRANSIENT_EVENT_FILE", "Last event", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        // lossless delta encoded stream for remote preview
+        DeltaStreamSP[DELTA_STREAM_ON].fill("DELTA_STREAM_ON", "On", ISS_OFF);
+        DeltaStreamSP[DELTA_STREAM_OFF].fill("DELTA_STREAM_OFF", "Off", ISS_ON);
+        DeltaStreamSP.fill(getDeviceName(), "DELTA_STREAM", "Delta stream", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        DeltaStreamNP[DELTA_STREAM_KEY_INTERVAL].fill("DELTA_STREAM_KEY_INTERVAL", "Keyframe interval", "%.f", 1, 1000, 1, 30);
+        DeltaStreamNP[DELTA_STREAM_MAX_RATE].fill("DELTA_STREAM_MAX_RATE", "Max rate (fps, 0 all)", "%.1f", 0, 200, 1, 10);
+        DeltaStreamNP.fill(getDeviceName(), "DELTA_STREAM_SETTINGS", "Delta stream", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        DeltaStreamInfoNP[DELTA_STREAM_RATIO].fill("DELTA_STREAM_RATIO", "Ratio", "%.2f", 0, 1e3, 0, 0);
+        DeltaStreamInfoNP[DELTA_STREAM_BANDWIDTH].fill("DELTA_STREAM_BANDWIDTH", "Bandwidth (Mbit/s)", "%.2f", 0, 1e6, 0, 0);
+        DeltaStreamInfoNP[DELTA_STREAM_ENCODE].fill("DELTA_STREAM_ENCODE", "Encode (ms)", "%.2f", 0, 1e6, 0, 0);
+        DeltaStreamInfoNP.fill(getDeviceName(), "DELTA_STREAM_INFO", "Delta stream", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        DeltaStreamBP[0].fill("DELTA_FRAME", "Frame", ".svbd");
+        DeltaStreamBP.fill(getDeviceName(), "DELTA_STREAM_FRAME", "Delta frame", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        // shared memory ring of the stream
+        SharedRingSP[SHARED_RING_ON].fill("SHARED_RING_ON", "On", ISS_OFF);
+        SharedRingSP[SHARED_RING_OFF].fill("SHARED_RING_OFF", "Off", ISS_ON);
+        SharedRingSP.fill(getDeviceName(), "SHARED_RING", "Shared memory", STREAM_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        SharedRingNP[SHARED_RING_SLOTS].fill("SHARED_RING_SLOTS", "Frames", "%.f", 2, 64, 1, 8);
+        SharedRingNP.fill(getDeviceName(), "SHARED_RING_SETTINGS", "Shared memory", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+        SharedRingTP[SHARED_RING_NAME].fill("SHARED_RING_NAME", "Name", "");
+        SharedRingTP.fill(getDeviceName(), "SHARED_RING_NAME", "Shared memory", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+        // asynchronous local save of the exposures
+        AsyncSaveSP[ASYNC_SAVE_ON].fill("ASYNC_SAVE_ON", "On", ISS_OFF);
+        AsyncSaveSP[ASYNC_SAVE_OFF].fill("ASYNC_SAVE_OFF", "Off", ISS_ON);
+        AsyncSaveSP.fill(getDeviceName(), "ASYNC_SAVE", "Async local save", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        AsyncSaveFileTP[ASYNC_SAVE_DIRECTORY].fill("ASYNC_SAVE_DIRECTORY", "Directory", recordHome ? recordHome : "/tmp");
+        AsyncSaveFileTP[ASYNC_SAVE_PREFIX].fill("ASYNC_SAVE_PREFIX", "Prefix", "IMAGE");
+        AsyncSaveFileTP.fill(getDeviceName(), "ASYNC_SAVE_FILE", "Async save file", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+        AsyncSaveNP[ASYNC_SAVE_DEPTH].fill("ASYNC_SAVE_DEPTH", "Files in flight", "%.f", 1, 16, 1, 4);
+        AsyncSaveNP.fill(getDeviceName(), "ASYNC_SAVE_SETTINGS", "Async save", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+        AsyncSaveInfoNP[ASYNC_SAVE_QUEUED].fill("ASYNC_SAVE_QUEUED", "Queued", "%.f", 0, 1e6, 0, 0);
+        AsyncSaveInfoNP[ASYNC_SAVE_IN_FLIGHT].fill("ASYNC_SAVE_IN_FLIGHT", "In flight", "%.f", 0, 1e6, 0, 0);
+        AsyncSaveInfoNP[ASYNC_SAVE_WRITTEN].fill("ASYNC_SAVE_WRITTEN", "Written", "%.f", 0, 1e12, 0, 0);
+        AsyncSaveInfoNP[ASYNC_SAVE_FAILED].fill("ASYNC_SAVE_FAILED", "Failed", "%.f", 0, 1e12, 0, 0);
+        AsyncSaveInfoNP[ASYNC_SAVE_RATE].fill("ASYNC_SAVE_RATE", "Throughput (MB/s)", "%.1f", 0, 1e6, 0, 0);
+        AsyncSaveInfoNP.fill(getDeviceName(), "ASYNC_SAVE_INFO", "Async save", OPTIONS_TAB, IP_RO, 60, IPS_IDLE);
+
+        // capture threads tuning
+        ThreadAffinityTP[THREAD_AFFINITY_CPUS].fill("THREAD_AFFINITY_CPUS", "Cores (0,2-3)", "");
+        ThreadAffinityTP.fill(getDeviceName(), "THREAD_AFFINITY", "Capture cores", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+        ThreadSchedulingSP[THREAD_SCHEDULING_NORMAL].fill("THREAD_SCHEDULING_NORMAL", "Normal", ISS_ON);
+        ThreadSchedulingSP[THREAD_SCHEDULING_NICE].fill("THREAD_SCHEDULING_NICE", "Nice", ISS_OFF);
+        ThreadSchedulingSP[THREAD_SCHEDULING_FIFO].fill("THREAD_SCHEDULING_FIFO", "Real time", ISS_OFF);
+        ThreadSchedulingSP.fill(getDeviceName(), "THREAD_SCHEDULING", "Capture scheduling", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 60,
+                                IPS_IDLE);
+
+        ThreadPriorityNP[THREAD_PRIORITY_NICE].fill("THREAD_PRIORITY_NICE", "Nice", "%.f", -20, 19, 1, -5);
+        ThreadPriorityNP[THREAD_PRIORITY_FIFO].fill("THREAD_PRIORITY_FIFO", "Real time priority", "%.f", 1, 99, 1, 10);
+        ThreadPriorityNP.fill(getDeviceName(), "THREAD_PRIORITY", "Capture priority", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+        ThreadInfoTP[THREAD_CAPTURE].fill("THREAD_CAPTURE", "Capture", "");
+        ThreadInfoTP[THREAD_TIMER].fill("THREAD_TIMER", "Exposure timer", "");
+        ThreadInfoTP.fill(getDeviceName(), "THREAD_INFO", "Capture threads", OPTIONS_TAB, IP_RO, 60, IPS_IDLE);
+
+        // Rice tile compressed FITS of the exposures
+        TileCompressionSP[TILE_COMPRESSION_ON].fill("TILE_COMPRESSION_ON", "On", ISS_OFF);
+        TileCompressionSP[TILE_COMPRESSION_OFF].fill("TILE_COMPRESSION_OFF", "Off", ISS_ON);
+        TileCompressionSP.fill(getDeviceName(), "FITS_TILE_COMPRESSION", "Rice compression", OPTIONS_TAB, IP_RW, ISR_1OFMANY,
+                               60, IPS_IDLE);
+
+        CompressionInfoNP[COMPRESSION_RATIO].fill("COMPRESSION_RATIO", "Ratio", "%.2f", 0, 1e3, 0, 0);
+        CompressionInfoNP[COMPRESSION_TIME].fill("COMPRESSION_TIME", "Time (ms)", "%.f", 0, 1e6, 0, 0);
+        CompressionInfoNP[COMPRESSION_SIZE].fill("COMPRESSION_SIZE", "Size (MB)", "%.2f", 0, 1e6, 0, 0);
+        CompressionInfoNP.fill(getDeviceName(), "FITS_TILE_COMPRESSION_INFO", "Compression", OPTIONS_TAB, IP_RO, 60, IPS_IDLE);
+
+        // binning of bayer frames, mono mixes the colours
+        BinningModeSP[BIN_MODE_MONO].fill("BIN_MODE_MONO", "Mono", ISS_ON);
+        BinningModeSP[BIN_MODE_BAYER].fill("BIN_MODE_BAYER", "Bayer", ISS_OFF);
+        BinningModeSP[BIN_MODE_SUPERPIXEL].fill("BIN_MODE_SUPERPIXEL", "Superpixel RGB", ISS_OFF);
+        BinningModeSP.fill(getDeviceName(), "CCD_BINNING_MODE", "Binning mode", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60,
+                           IPS_IDLE);
+
+        // dark and bias subtraction, masters library per camera
+        DarkSubtractSP[DARK_SUBTRACT_ON].fill("DARK_SUBTRACT_ON", "On", ISS_OFF);
+        DarkSubtractSP[DARK_SUBTRACT_OFF].fill("DARK_SUBTRACT_OFF", "Off", ISS_ON);
+        DarkSubtractSP.fill(getDeviceName(), "DARK_SUBTRACTION", "Dark subtraction", CALIBRATION_TAB, IP_RW, ISR_1OFMANY, 60,
+                            IPS_IDLE);
+
+        FlatFieldSP[FLAT_FIELD_ON].fill("FLAT_FIELD_ON", "On", ISS_OFF);
+        FlatFieldSP[FLAT_FIELD_OFF].fill("FLAT_FIELD_OFF", "Off", ISS_ON);
+        FlatFieldSP.fill(getDeviceName(), "FLAT_FIELD", "Flat field", CALIBRATION_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        const char *home = getenv("HOME");
+        std::string directory = std::string(home ? home : "/tmp") + "/.indi/svb_calibration/" + mCameraInfo.CameraSN;
+        CalibrationLibraryTP[0].fill("DIR", "Directory", directory.c_str());
+        CalibrationLibraryTP.fill(getDeviceName(), "CALIBRATION_LIBRARY", "Masters library", CALIBRATION_TAB, IP_RW, 60,
+                                  IPS_IDLE);
+        mCalibrationLibrary.setDirectory(directory);
+
+        CalibrationToleranceNP[TOLERANCE_EXPOSURE].fill("TOLERANCE_EXPOSURE", "Exposure (%)", "%.f", 0, 100, 1, 10);
+        CalibrationToleranceNP[TOLERANCE_TEMPERATURE].fill("TOLERANCE_TEMPERATURE", "Temperature (C)", "%.1f", 0, 50, 0.5, 2);
+        CalibrationToleranceNP.fill(getDeviceName(), "CALIBRATION_TOLERANCE", "Master tolerance", CALIBRATION_TAB, IP_RW, 60,
+                                    IPS_IDLE);
+
+        CalibrationSaveSP[0].fill("SAVE_MASTER", "Save last dark/bias/flat", ISS_OFF);
+        CalibrationSaveSP.fill(getDeviceName(), "CALIBRATION_SAVE", "Master", CALIBRATION_TAB, IP_RW, ISR_ATMOST1, 60,
+                               IPS_IDLE);
+
+        CalibrationMasterTP[MASTER_IN_USE_DARK].fill("DARK_MASTER", "Dark master", "None");
+        CalibrationMasterTP[MASTER_IN_USE_FLAT].fill("FLAT_MASTER", "Flat master", "None");
+        CalibrationMasterTP.fill(getDeviceName(), "CALIBRATION_MASTER", "Masters in use", CALIBRATION_TAB, IP_RO, 60,
+                                 IPS_IDLE);
+
+        // hot pixels, map stored in the masters library
+        HotPixelSP[HOT_PIXELS_ON].fill("HOT_PIXELS_ON", "On", ISS_OFF);
+        HotPixelSP[HOT_PIXELS_OFF].fill("HOT_PIXELS_OFF", "Off", ISS_ON);
+        HotPixelSP.fill(getDeviceName(), "HOT_PIXELS", "Hot pixels", CALIBRATION_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+        HotPixelNP[HOT_PIXELS_KAPPA].fill("HOT_PIXELS_KAPPA", "Kappa (sigma)", "%.1f", 3, 50, 0.5, 6);
+        HotPixelNP[HOT_PIXELS_LEARN_FRAMES].fill("HOT_PIXELS_LEARN_FRAMES", "Learn frames", "%.f", 4, 1000, 1, 30);
+        HotPixelNP.fill(getDeviceName(), "HOT_PIXELS_SETTINGS", "Hot pixels", CALIBRATION_TAB, IP_RW, 60, IPS_IDLE);
+
+        HotPixelControlSP[HOT_PIXELS_BUILD].fill("HOT_PIXELS_BUILD", "From last dark", ISS_OFF);
+        HotPixelControlSP[HOT_PIXELS_LEARN].fill("HOT_PIXELS_LEARN", "Learn from stream", ISS_OFF);
+        HotPixelControlSP[HOT_PIXELS_CLEAR].fill("HOT_PIXELS_CLEAR", "Clear", ISS_OFF);
+        HotPixelControlSP.fill(getDeviceName(), "HOT_PIXELS_CONTROL", "Hot pixels map", CALIBRATION_TAB, IP_RW, ISR_ATMOST1,
+                               60, IPS_IDLE);
+
+        HotPixelInfoNP[HOT_PIXELS_COUNT].fill("HOT_PIXELS_COUNT", "Pixels in map", "%.f", 0, 1e9, 0, 0);
+        HotPixelInfoNP[HOT_PIXELS_CORRECTED].fill("HOT_PIXELS_CORRECTED", "Corrected in frame", "%.f", 0, 1e9, 0, 0);
+        HotPixelInfoNP.fill(getDeviceName(), "HOT_PIXELS_INFO", "Hot pixels", CALIBRATION_TAB, IP_RO, 60, IPS_IDLE);
+
+        mHotPixels.setSensor(cameraProperty.MaxWidth, cameraProperty.MaxHeight, HasBayer(),
+                             static_cast<SVB_BAYER_PATTERN>(cameraProperty.BayerPattern));
+        loadHotPixels();
+    }
+
+    return r;
+}
+
+bool SVBDevice::updateProperties()
+{
+    SVBTemperature::updateProperties();
+
+    if (isConnected())
+    {
+        // live stacking
+        defineProperty(LiveStackSP);
+        defineProperty(LiveStackNP);
+        defineProperty(LiveStackControlSP);
+        defineProperty(LiveStackInfoNP);
+
+        // frame statistics
+        defineProperty(FrameStatsNP);
+
+        // auto exposure
+        defineProperty(AutoExposureSP);
+        defineProperty(AutoExposureNP);
+        defineProperty(AutoExposureInfoNP);
+
+        // star detection
+        defineProperty(StarDetectionSP);
+        defineProperty(StarDetectionNP);
+        defineProperty(StarInfoNP);
+        defineProperty(StarListBP);
+
+        // focus mode
+        defineProperty(FocusModeSP);
+        defineProperty(FocusRegionNP);
+        defineProperty(FocusMetricNP);
+        defineProperty(FocusThumbnailBP);
+
+        // guide loop, cameras with an ST4 port only
+        if (HasST4Port())
+        {
+            defineProperty(GuideLoopSP);
+            defineProperty(GuideSettingsNP);
+            defineProperty(GuideStateTP);
+            defineProperty(GuideErrorNP);
+            defineProperty(GuideCalibrationNP);
+        }
+
+        // SER recording
+        defineProperty(SerRecordSP);
+        defineProperty(SerFileTP);
+        defineProperty(SerOptionsNP);
+        defineProperty(SerDirectSP);
+        defineProperty(SerInfoNP);
+
+        // flight recorder
+        defineProperty(FlightRecorderSP);
+        defineProperty(FlightRecorderTP);
+        defineProperty(FlightRecorderNP);
+        defineProperty(FlightTriggerSP);
+        defineProperty(FlightRecorderInfoNP);
+
+        // transient detection
+        defineProperty(TransientSP);
+        defineProperty(TransientNP);
+        defineProperty(TransientEventNP);
+        defineProperty(TransientEventTP);
+
+        // delta stream
+        defineProperty(DeltaStreamSP);
+        defineProperty(DeltaStreamNP);
+        defineProperty(DeltaStreamInfoNP);
+        defineProperty(DeltaStreamBP);
+
+        // shared memory ring
+        defineProperty(SharedRingSP);
+        defineProperty(SharedRingNP);
+        defineProperty(SharedRingTP);
+
+        // asynchronous local save
+        defineProperty(AsyncSaveSP);
+        defineProperty(AsyncSaveFileTP);
+        defineProperty(AsyncSaveNP);
+        defineProperty(AsyncSaveInfoNP);
+
+        // capture threads, named and tuned from the start
+        defineProperty(ThreadAffinityTP);
+        defineProperty(ThreadSchedulingSP);
+        defineProperty(ThreadPriorityNP);
+        defineProperty(ThreadInfoTP);
+        tuneThreads();
+
+        // tile compression
+        defineProperty(TileCompressionSP);
+        defineProperty(CompressionInfoNP);
+
+        // debayer, color cameras only
+        if (HasBayer())
+        {
+            defineProperty(DebayerSP);
+            defineProperty(BinningModeSP);
+        }
+
+        // calibration
+        defineProperty(DarkSubtractSP);
+        defineProperty(FlatFieldSP);
+        defineProperty(CalibrationLibraryTP);
+        defineProperty(CalibrationToleranceNP);
+        defineProperty(CalibrationSaveSP);
+        defineProperty(CalibrationMasterTP);
+        defineProperty(HotPixelSP);
+        defineProperty(HotPixelNP);
+        defineProperty(HotPixelControlSP);
+        defineProperty(HotPixelInfoNP);
+    }
+    else
+    {
+        // live stacking
+        deleteProperty(LiveStackSP.getName());
+        deleteProperty(LiveStackNP.getName());
+        deleteProperty(LiveStackControlSP.getName());
+        deleteProperty(LiveStackInfoNP.getName());
+
+        // the stack and the processing buffers return to the memory budget
+        {
+            std::unique_lock<std::mutex> guard(ccdBufferLock);
+            mStacker.reset();
+            mStackBuffer.clear();
+            mStackBuffer.shrink_to_fit();
+            releaseMemory(mStackGrant);
+            releaseBuffer(mRgbBuffer);
+            releaseBuffer(mBinBuffer);
+        }
+
+        // frame statistics
+        deleteProperty(FrameStatsNP.getName());
+
+        // auto exposure
+        deleteProperty(AutoExposureSP.getName());
+        deleteProperty(AutoExposureNP.getName());
+        deleteProperty(AutoExposureInfoNP.getName());
+
+        // star detection
+        deleteProperty(StarDetectionSP.getName());
+        deleteProperty(StarDetectionNP.getName());
+        deleteProperty(StarInfoNP.getName());
+        deleteProperty(StarListBP.getName());
+
+        // focus mode
+        deleteProperty(FocusModeSP.getName());
+        deleteProperty(FocusRegionNP.getName());
+        deleteProperty(FocusMetricNP.getName());
+        deleteProperty(FocusThumbnailBP.getName());
+
+        // guide loop
+        if (HasST4Port())
+        {
+            deleteProperty(GuideLoopSP.getName());
+            deleteProperty(GuideSettingsNP.getName());
+            deleteProperty(GuideStateTP.getName());
+            deleteProperty(GuideErrorNP.getName());
+            deleteProperty(GuideCalibrationNP.getName());
+        }
+
+        // SER recording
+        deleteProperty(SerRecordSP.getName());
+        deleteProperty(SerFileTP.getName());
+        deleteProperty(SerOptionsNP.getName());
+        deleteProperty(SerDirectSP.getName());
+        deleteProperty(SerInfoNP.getName());
+
+        // flight recorder
+        deleteProperty(FlightRecorderSP.getName());
+        deleteProperty(FlightRecorderTP.getName());
+        deleteProperty(FlightRecorderNP.getName());
+        deleteProperty(FlightTriggerSP.getName());
+        deleteProperty(FlightRecorderInfoNP.getName());
+
+        // transient detection
+        deleteProperty(TransientSP.getName());
+        deleteProperty(TransientNP.getName());
+        deleteProperty(TransientEventNP.getName());
+        deleteProperty(TransientEventTP.getName());
+
+        // delta stream
+        deleteProperty(DeltaStreamSP.getName());
+        deleteProperty(DeltaStreamNP.getName());
+        deleteProperty(DeltaStreamInfoNP.getName());
+        deleteProperty(DeltaStreamBP.getName());
+
+        // shared memory ring, the readers see it closed
+        deleteProperty(SharedRingSP.getName());
+        deleteProperty(SharedRingNP.getName());
+        deleteProperty(SharedRingTP.getName());
+        {
+            std::unique_lock<std::mutex> guard(mSharedRingLock);
+            mSharedRing.close();
+            releaseMemory(mSharedRingGrant);
+        }
+
+        // asynchronous local save
+        deleteProperty(AsyncSaveSP.getName());
+        deleteProperty(AsyncSaveFileTP.getName());
+        deleteProperty(AsyncSaveNP.getName());
+        deleteProperty(AsyncSaveInfoNP.getName());
+
+        // capture threads
+        deleteProperty(ThreadAffinityTP.getName());
+        deleteProperty(ThreadSchedulingSP.getName());
+        deleteProperty(ThreadPriorityNP.getName());
+        deleteProperty(ThreadInfoTP.getName());
+
+        // tile compression
+        deleteProperty(TileCompressionSP.getName());
+        deleteProperty(CompressionInfoNP.getName());
+
+        // debayer
+        if (HasBayer())
+        {
+            deleteProperty(DebayerSP.getName());
+            deleteProperty(BinningModeSP.getName());
+        }
+
+        // calibration
+        deleteProperty(DarkSubtractSP.getName());
+        deleteProperty(FlatFieldSP.getName());
+        deleteProperty(CalibrationLibraryTP.getName());
+        deleteProperty(CalibrationToleranceNP.getName());
+        deleteProperty(CalibrationSaveSP.getName());
+        deleteProperty(CalibrationMasterTP.getName());
+        deleteProperty(HotPixelSP.getName());
+        deleteProperty(HotPixelNP.getName());
+        deleteProperty(HotPixelControlSP.getName());
+        deleteProperty(HotPixelInfoNP.getName());
+    }
+
+    return true;
+}
+
+bool SVBDevice::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n)
+{
+    if (!strcmp(dev, getDeviceName()))
+    {
+        // live stack settings, read by the streaming worker
+        if (LiveStackNP.isNameMatch(name))
+        {
+            LiveStackNP.update(values, names, n);
+            LiveStackNP.setState(IPS_OK);
+            LiveStackNP.apply();
+            return true;
+        }
+
+        // master tolerances, the master is selected again on the next frame
+        if (CalibrationToleranceNP.isNameMatch(name))
+        {
+            std::unique_lock<std::mutex> guard(mCalibrationLock);
+            CalibrationToleranceNP.update(values, names, n);
+            CalibrationToleranceNP.setState(IPS_OK);
+            CalibrationToleranceNP.apply();
+            mDarkSelected = false;
+            return true;
+        }
+
+        // auto exposure settings, used from the next frame
+        if (AutoExposureNP.isNameMatch(name))
+        {
+            AutoExposureNP.update(values, names, n);
+            AutoExposureNP.setState(IPS_OK);
+            AutoExposureNP.apply();
+            return true;
+        }
+
+        // star detection settings, used from the next frame
+        if (StarDetectionNP.isNameMatch(name))
+        {
+            StarDetectionNP.update(values, names, n);
+            StarDetectionNP.setState(IPS_OK);
+            StarDetectionNP.apply();
+            return true;
+        }
+
+        // focus region, used from the next stream
+        if (FocusRegionNP.isNameMatch(name))
+        {
+            FocusRegionNP.update(values, names, n);
+            FocusRegionNP.setState(IPS_OK);
+            FocusRegionNP.apply();
+            return true;
+        }
+
+        // guide loop settings, used from the next frame
+        if (GuideSettingsNP.isNameMatch(name))
+        {
+            GuideSettingsNP.update(values, names, n);
+            GuideSettingsNP.setState(IPS_OK);
+            GuideSettingsNP.apply();
+            return true;
+        }
+
+        // SER file size limit, used from the next file
+        if (SerOptionsNP.isNameMatch(name))
+        {
+            SerOptionsNP.update(values, names, n);
+            SerOptionsNP.setState(IPS_OK);
+            SerOptionsNP.apply();
+            return true;
+        }
+
+        // flight recorder size, used from the next stream, and freeze window
+        if (FlightRecorderNP.isNameMatch(name))
+        {
+            FlightRecorderNP.update(values, names, n);
+            FlightRecorderNP.setState(IPS_OK);
+            FlightRecorderNP.apply();
+            return true;
+        }
+
+        // transient settings, the ring size is used from the next stream
+        if (TransientNP.isNameMatch(name))
+        {
+            TransientNP.update(values, names, n);
+            TransientNP.setState(IPS_OK);
+            TransientNP.apply();
+            return true;
+        }
+
+        // shared memory slots, the ring is created again when open
+        if (SharedRingNP.isNameMatch(name))
+        {
+            SharedRingNP.update(values, names, n);
+            SharedRingNP.setState(!mSharedRing.isOpen() || startSharedRing() ? IPS_OK : IPS_ALERT);
+            SharedRingNP.apply();
+            return true;
+        }
+
+        // delta stream settings, used from the next frame
+        if (DeltaStreamNP.isNameMatch(name))
+        {
+            DeltaStreamNP.update(values, names, n);
+            DeltaStreamNP.setState(IPS_OK);
+            DeltaStreamNP.apply();
+            return true;
+        }
+
+        // async save depth, the writer restarts when running
+        if (AsyncSaveNP.isNameMatch(name))
+        {
+            AsyncSaveNP.update(values, names, n);
+            AsyncSaveNP.setState(!mAsyncWriter.isRunning() || startAsyncSave() ? IPS_OK : IPS_ALERT);
+            AsyncSaveNP.apply();
+            return true;
+        }
+
+        // capture threads nice level and real time priority
+        if (ThreadPriorityNP.isNameMatch(name))
+        {
+            ThreadPriorityNP.update(values, names, n);
+            ThreadPriorityNP.setState(IPS_OK);
+            ThreadPriorityNP.apply();
+            tuneThreads();
+            return true;
+        }
+
+        // hot pixels settings
+        if (HotPixelNP.isNameMatch(name))
+        {
+            HotPixelNP.update(values, names, n);
+            HotPixelNP.setState(IPS_OK);
+            HotPixelNP.apply();
+            return true;
+        }
+    }
+
+    return SVBTemperature::ISNewNumber(dev, name, values, names, n);
+}
+
+bool SVBDevice::ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n)
+{
+    if (!strcmp(dev, getDeviceName()))
+    {
+        // live stack enable
+        if (LiveStackSP.isNameMatch(name))
+        {
+            LiveStackSP.update(states, names, n);
+            LiveStackSP.setState(IPS_OK);
+            LiveStackSP.apply();
+            mStackResetRequest = true;
+            LOGF_INFO("Live stack is now %s", LiveStackSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        // auto exposure mode, the loop starts over from the current settings
+        if (AutoExposureSP.isNameMatch(name))
+        {
+            AutoExposureSP.update(states, names, n);
+            AutoExposureSP.setState(IPS_OK);
+            AutoExposureSP.apply();
+            LOGF_INFO("Stream auto exposure is now %s", AutoExposureSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        // star detection enable
+        if (StarDetectionSP.isNameMatch(name))
+        {
+            StarDetectionSP.update(states, names, n);
+            StarDetectionSP.setState(IPS_OK);
+            StarDetectionSP.apply();
+            LOGF_INFO("Star detection is now %s", StarDetectionSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        // focus mode, used from the next stream
+        if (FocusModeSP.isNameMatch(name))
+        {
+            FocusModeSP.update(states, names, n);
+            FocusModeSP.setState(IPS_OK);
+            FocusModeSP.apply();
+            if (Streamer->isStreaming())
+                LOG_INFO("Focus mode change will take effect when streaming restarts");
+            return true;
+        }
+
+        // guide loop, changes apply at once when the loop is streaming
+        if (GuideLoopSP.isNameMatch(name))
+        {
+            GuideLoopSP.update(states, names, n);
+            GuideLoopSP.setState(IPS_OK);
+            int mode = GuideLoopSP.findOnSwitchIndex();
+            if (mGuideActive)
+            {
+                std::unique_lock<std::mutex> guard(ccdBufferLock);
+                if (mode == GUIDE_LOOP_OFF)
+                {
+                    mGuider.stop();
+                    publishGuideLoop();
+                }
+                else if (!startGuideLoop(mode))
+                {
+                    GuideLoopSP.setState(IPS_ALERT);
+                }
+            }
+            else if (mode == GUIDE_LOOP_GUIDE && !mGuider.isCalibrated())
+            {
+                LOG_WARN("Guide loop is not calibrated, calibrate first");
+                GuideLoopSP.setState(IPS_ALERT);
+            }
+            else if (Streamer->isStreaming())
+            {
+                LOG_INFO("Guide loop change will take effect when streaming restarts");
+            }
+            GuideLoopSP.apply();
+            return true;
+        }
+
+        // SER recording, the streaming thread starts and stops it
+        if (SerRecordSP.isNameMatch(name))
+        {
+            SerRecordSP.update(states, names, n);
+            SerRecordSP.setState(IPS_OK);
+            SerRecordSP.apply();
+            if (SerRecordSP[SER_RECORD_ON].getState() == ISS_ON && !Streamer->isStreaming())
+                LOG_INFO("SER recording will start with the stream");
+            return true;
+        }
+
+        // SER direct I/O, used from the next recording
+        if (SerDirectSP.isNameMatch(name))
+        {
+            SerDirectSP.update(states, names, n);
+            SerDirectSP.setState(IPS_OK);
+            SerDirectSP.apply();
+            return true;
+        }
+
+        // flight recorder, the streaming thread opens and closes the ring
+        if (FlightRecorderSP.isNameMatch(name))
+        {
+            FlightRecorderSP.update(states, names, n);
+            FlightRecorderSP.setState(IPS_OK);
+            FlightRecorderSP.apply();
+            if (FlightRecorderSP[FLIGHT_RECORDER_ON].getState() == ISS_ON && !Streamer->isStreaming())
+                LOG_INFO("Flight recorder will start with the stream");
+            return true;
+        }
+
+        // flight recorder freeze, started by the streaming thread on its next frame
+        if (FlightTriggerSP.isNameMatch(name))
+        {
+            FlightTriggerSP.reset();
+            if (!Streamer->isStreaming() || FlightRecorderSP[FLIGHT_RECORDER_ON].getState() != ISS_ON)
+            {
+                LOG_ERROR("Flight recorder is not recording");
+                FlightTriggerSP.setState(IPS_ALERT);
+            }
+            else
+            {
+                mFreezeRequested = true;
+                FlightTriggerSP.setState(IPS_BUSY);
+            }
+            FlightTriggerSP.apply();
+            return true;
+        }
+
+        // shared memory ring, the readers get its name from SHARED_RING_NAME
+        if (SharedRingSP.isNameMatch(name))
+        {
+            SharedRingSP.update(states, names, n);
+            SharedRingSP.setState(startSharedRing() ? IPS_OK : IPS_ALERT);
+            SharedRingSP.apply();
+            return true;
+        }
+
+        // delta stream, a client joining starts from a keyframe
+        if (DeltaStreamSP.isNameMatch(name))
+        {
+            DeltaStreamSP.update(states, names, n);
+            DeltaStreamSP.setState(IPS_OK);
+            DeltaStreamSP.apply();
+            mDeltaEncoder.requestKeyframe();
+            if (DeltaStreamSP[DELTA_STREAM_ON].getState() == ISS_ON)
+                LOG_INFO("Delta frames are sent on DELTA_STREAM_FRAME, disable the CCD1 BLOB to save the bandwidth");
+            return true;
+        }
+
+        // transient detection, the streaming thread allocates the ring
+        if (TransientSP.isNameMatch(name))
+        {
+            TransientSP.update(states, names, n);
+            TransientSP.setState(IPS_OK);
+            TransientSP.apply();
+            if (TransientSP[TRANSIENT_ON].getState() == ISS_ON && !Streamer->isStreaming())
+                LOG_INFO("Transient detection will start with the stream");
+            return true;
+        }
+
+        // asynchronous local save, queued files are written before the writer stops
+        if (AsyncSaveSP.isNameMatch(name))
+        {
+            AsyncSaveSP.update(states, names, n);
+            AsyncSaveSP.setState(startAsyncSave() ? IPS_OK : IPS_ALERT);
+            AsyncSaveSP.apply();
+            return true;
+        }
+
+        // capture threads scheduling policy
+        if (ThreadSchedulingSP.isNameMatch(name))
+        {
+            ThreadSchedulingSP.update(states, names, n);
+            ThreadSchedulingSP.setState(IPS_OK);
+            ThreadSchedulingSP.apply();
+            tuneThreads();
+            return true;
+        }
+
+        // tile compression, the compressed image replaces the CCD1 image
+        if (TileCompressionSP.isNameMatch(name))
+        {
+            TileCompressionSP.update(states, names, n);
+            TileCompressionSP.setState(IPS_OK);
+            TileCompressionSP.apply();
+            if (TileCompressionSP[TILE_COMPRESSION_ON].getState() == ISS_ON)
+                LOG_INFO("Exposures are sent as tile compressed FITS (.fits.fz) on CCD1");
+            return true;
+        }
+
+        // debayer method, used from the next stream
+        if (DebayerSP.isNameMatch(name))
+        {
+            DebayerSP.update(states, names, n);
+            DebayerSP.setState(IPS_OK);
+            DebayerSP.apply();
+            if (Streamer->isStreaming())
+                LOG_INFO("Debayer change will take effect when streaming restarts");
+            return true;
+        }
+
+        // binning mode, streams use it from their next start
+        if (BinningModeSP.isNameMatch(name))
+        {
+            BinningModeSP.update(states, names, n);
+            BinningModeSP.setState(IPS_OK);
+            BinningModeSP.apply();
+            if (BinningModeSP[BIN_MODE_SUPERPIXEL].getState() == ISS_ON && PrimaryCCD.getBinX() % 2 != 0)
+                LOG_WARN("Superpixel needs an even binning, odd binnings use the bayer mode");
+            if (Streamer->isStreaming())
+                LOG_INFO("Binning mode change will take effect when streaming restarts");
+            return true;
+        }
+
+        // live stack reset and snapshot
+        if (LiveStackControlSP.isNameMatch(name))
+        {
+            LiveStackControlSP.update(states, names, n);
+            auto control = LiveStackControlSP.findOnSwitchIndex();
+            LiveStackControlSP.reset();
+
+            if (control == LIVE_STACK_RESET)
+            {
+                mStackResetRequest = true;
+                LOG_INFO("Live stack reset\n");
+            }
+            else if (control == LIVE_STACK_SNAPSHOT)
+            {
+                if (mStacker.frames() == 0)
+                {
+                    LOG_WARN("Live stack is empty\n");
+                    LiveStackControlSP.setState(IPS_ALERT);
+                    LiveStackControlSP.apply();
+                    return true;
+                }
+
+                if (Streamer->isStreaming())
+                {
+                    // uploaded by the streaming worker with the next stacked frame
+                    mStackSnapshotRequest = true;
+                }
+                else
+                {
+                    mStackBuffer.resize(mStacker.pixels() * mStacker.bitDepth() / 8);
+                    mStacker.render(mStackBuffer.data());
+                    if (!uploadStack())
+                    {
+                        LiveStackControlSP.setState(IPS_ALERT);
+                        LiveStackControlSP.apply();
+                        return true;
+                    }
+                }
+            }
+
+            LiveStackControlSP.setState(IPS_OK);
+            LiveStackControlSP.apply();
+            return true;
+        }
+
+        // dark subtraction enable
+        if (DarkSubtractSP.isNameMatch(name))
+        {
+            std::unique_lock<std::mutex> guard(mCalibrationLock);
+            DarkSubtractSP.update(states, names, n);
+            DarkSubtractSP.setState(IPS_OK);
+            DarkSubtractSP.apply();
+            mDarkSelected = false;
+            LOGF_INFO("Dark subtraction is now %s", DarkSubtractSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        // flat field enable
+        if (FlatFieldSP.isNameMatch(name))
+        {
+            std::unique_lock<std::mutex> guard(mCalibrationLock);
+            FlatFieldSP.update(states, names, n);
+            FlatFieldSP.setState(IPS_OK);
+            FlatFieldSP.apply();
+            mFlatSelected = false;
+            LOGF_INFO("Flat field is now %s", FlatFieldSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        // hot pixels correction enable
+        if (HotPixelSP.isNameMatch(name))
+        {
+            HotPixelSP.update(states, names, n);
+            HotPixelSP.setState(IPS_OK);
+            HotPixelSP.apply();
+            LOGF_INFO("Hot pixels correction is now %s", HotPixelSP.findOnSwitch()->getLabel());
+            return true;
+        }
+
+        // hot pixels map
+        if (HotPixelControlSP.isNameMatch(name))
+        {
+            HotPixelControlSP.update(states, names, n);
+            int action = HotPixelControlSP.findOnSwitchIndex();
+            HotPixelControlSP.reset();
+            HotPixelControlSP.setState(IPS_OK);
+
+            const double kappa = HotPixelNP[HOT_PIXELS_KAPPA].getValue();
+            if (action == HOT_PIXELS_BUILD)
+            {
+                // the frame buffer must hold a raw unbinned dark, as it was taken
+                if (!mLastExposureValid || Streamer->isStreaming() || mLastExposureBinned ||
+                    mLastExposureType != INDI::CCDChip::DARK_FRAME)
+                {
+                    LOG_ERROR("Error, take an unbinned dark exposure first, while not streaming");
+                    HotPixelControlSP.setState(IPS_ALERT);
+                }
+                else
+                {
+                    HotPixelMap::Subframe subframe {mLastExposureKey.x, mLastExposureKey.y, mLastExposureKey.width,
+                                                    mLastExposureKey.height, mLastExposureKey.bitDepth};
+                    std::unique_lock<std::mutex> bufferGuard(ccdBufferLock);
+                    std::unique_lock<std::mutex> guard(mCalibrationLock);
+                    size_t count = mHotPixels.build(PrimaryCCD.getFrameBuffer(), subframe, kappa);
+                    LOGF_INFO("%d hot pixels found in the dark frame", static_cast<int>(count));
+                    if (!saveHotPixels())
+                        HotPixelControlSP.setState(IPS_ALERT);
+                    guard.unlock();
+                    bufferGuard.unlock();
+                }
+            }
+            else if (action == HOT_PIXELS_LEARN)
+            {
+                std::unique_lock<std::mutex> guard(mCalibrationLock);
+                size_t frames = static_cast<size_t>(HotPixelNP[HOT_PIXELS_LEARN_FRAMES].getValue());
+                mHotPixelLearner.start(frames, kappa);
+                guard.unlock();
+                LOGF_INFO("Learning hot pixels from the next %d streamed frames", static_cast<int>(frames));
+                HotPixelControlSP.setState(IPS_BUSY);
+            }
+            else if (action == HOT_PIXELS_CLEAR)
+            {
+                std::unique_lock<std::mutex> guard(mCalibrationLock);
+                mHotPixelLearner.stop();
+                mHotPixels.clear();
+                unlink(hotPixelsPath().c_str());
+                guard.unlock();
+                LOG_INFO("Hot pixels map cleared");
+            }
+
+            HotPixelInfoNP[HOT_PIXELS_COUNT].setValue(mHotPixels.size());
+            HotPixelInfoNP.apply();
+            HotPixelControlSP.apply();
+            return true;
+        }
+
+        // save the last dark, bias or flat exposure in the masters library
+        if (CalibrationSaveSP.isNameMatch(name))
+        {
+            CalibrationSaveSP.reset();
+
+            // the frame type and binning the buffer was taken with, not the current ones
+            auto frameType = mLastExposureType;
+            if (!mLastExposureValid || Streamer->isStreaming() || mLastExposureBinned ||
+                frameType == INDI::CCDChip::LIGHT_FRAME)
+            {
+                LOG_ERROR("Error, take an unbinned dark, bias or flat exposure first, while not streaming");
+                CalibrationSaveSP.setState(IPS_ALERT);
+                CalibrationSaveSP.apply();
+                return true;
+            }
+
+            Calibration::MasterKey key = mLastExposureKey;
+            switch (frameType)
+            {
+                case INDI::CCDChip::DARK_FRAME:
+                    key.type = Calibration::MASTER_DARK;
+                    break;
+                case INDI::CCDChip::BIAS_FRAME:
+                    key.type = Calibration::MASTER_BIAS;
+                    break;
+                default:
+                    key.type = Calibration::MASTER_FLAT;
+                    break;
+            }
+
+            std::unique_lock<std::mutex> bufferGuard(ccdBufferLock);
+            std::unique_lock<std::mutex> guard(mCalibrationLock);
+            std::string path = mCalibrationLibrary.save(key, PrimaryCCD.getFrameBuffer());
+            int error = errno;
+            mDarkSelected = false;
+            mFlatSelected = false;
+            guard.unlock();
+            bufferGuard.unlock();
+
+            if (path.empty())
+            {
+                LOGF_ERROR("Error, unable to write master in %s (%s)", mCalibrationLibrary.directory().c_str(), strerror(error));
+                CalibrationSaveSP.setState(IPS_ALERT);
+            }
+            else
+            {
+                LOGF_INFO("Master saved as %s", path.c_str());
+                CalibrationSaveSP.setState(IPS_OK);
+            }
+            CalibrationSaveSP.apply();
+            return true;
+        }
+    }
+
+    return SVBTemperature::ISNewSwitch(dev, name, states, names, n);
+}
+
+bool SVBDevice::ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n)
+{
+    if (!strcmp(dev, getDeviceName()))
+    {
+        // masters library directory
+        if (CalibrationLibraryTP.isNameMatch(name))
+        {
+            std::unique_lock<std::mutex> guard(mCalibrationLock);
+            CalibrationLibraryTP.update(texts, names, n);
+            mCalibrationLibrary.setDirectory(CalibrationLibraryTP[0].getText());
+            mDarkSelected = false;
+            mFlatSelected = false;
+            loadHotPixels();
+            guard.unlock();
+
+            LOGF_INFO("%d masters in library %s", static_cast<int>(mCalibrationLibrary.size()),
+                      CalibrationLibraryTP[0].getText());
+            CalibrationLibraryTP.setState(IPS_OK);
+            CalibrationLibraryTP.apply();
+            return true;
+        }
+
+        // flight recorder ring file, used from the next stream
+        if (FlightRecorderTP.isNameMatch(name))
+        {
+            FlightRecorderTP.update(texts, names, n);
+            FlightRecorderTP.setState(IPS_OK);
+            FlightRecorderTP.apply();
+            return true;
+        }
+
+        // async save directory and file prefix, used from the next exposure
+        if (AsyncSaveFileTP.isNameMatch(name))
+        {
+            AsyncSaveFileTP.update(texts, names, n);
+            AsyncSaveFileTP.setState(IPS_OK);
+            AsyncSaveFileTP.apply();
+            return true;
+        }
+
+        // SER directory and file prefix, used from the next recording
+        if (SerFileTP.isNameMatch(name))
+        {
+            SerFileTP.update(texts, names, n);
+            SerFileTP.setState(IPS_OK);
+            SerFileTP.apply();
+            return true;
+        }
+
+        // capture threads cores, any core when empty
+        if (ThreadAffinityTP.isNameMatch(name))
+        {
+            cpu_set_t cpus;
+            if (texts[0][0] != '\0' && !ThreadTuning::parseCpus(texts[0], cpus))
+            {
+                LOGF_ERROR("Invalid core list \"%s\", expected cores and ranges as 0,2-3", texts[0]);
+                ThreadAffinityTP.setState(IPS_ALERT);
+                ThreadAffinityTP.apply();
+                return true;
+            }
+            ThreadAffinityTP.update(texts, names, n);
+            ThreadAffinityTP.setState(IPS_OK);
+            ThreadAffinityTP.apply();
+            tuneThreads();
+            return true;
+        }
+    }
+
+    return SVBTemperature::ISNewText(dev, name, texts, names, n);
+}
+
+bool SVBDevice::saveConfigItems(FILE *fp)
+{
+    SVBTemperature::saveConfigItems(fp);
+
+    // live stacking
+    LiveStackSP.save(fp);
+    LiveStackNP.save(fp);
+
+    // auto exposure
+    AutoExposureSP.save(fp);
+    AutoExposureNP.save(fp);
+
+    // star detection
+    StarDetectionSP.save(fp);
+    StarDetectionNP.save(fp);
+
+    // focus mode
+    FocusRegionNP.save(fp);
+
+    // SER recording
+    SerFileTP.save(fp);
+    SerOptionsNP.save(fp);
+    SerDirectSP.save(fp);
+
+    // flight recorder
+    FlightRecorderTP.save(fp);
+    FlightRecorderNP.save(fp);
+
+    // transient detection
+    TransientSP.save(fp);
+    TransientNP.save(fp);
+
+    // delta stream
+    DeltaStreamSP.save(fp);
+    DeltaStreamNP.save(fp);
+
+    // shared memory ring
+    SharedRingNP.save(fp);
+    SharedRingSP.save(fp);
+
+    // asynchronous local save
+    AsyncSaveFileTP.save(fp);
+    AsyncSaveNP.save(fp);
+    AsyncSaveSP.save(fp);
+
+    // capture threads
+    ThreadAffinityTP.save(fp);
+    ThreadSchedulingSP.save(fp);
+    ThreadPriorityNP.save(fp);
+
+    // tile compression
+    TileCompressionSP.save(fp);
+
+    // guide loop
+    if (HasST4Port())
+        GuideSettingsNP.save(fp);
+
+    // debayer
+    if (HasBayer())
+    {
+        DebayerSP.save(fp);
+        BinningModeSP.save(fp);
+    }
+
+    // calibration
+    DarkSubtractSP.save(fp);
+    FlatFieldSP.save(fp);
+    HotPixelSP.save(fp);
+    HotPixelNP.save(fp);
+    CalibrationLibraryTP.save(fp);
+    CalibrationToleranceNP.save(fp);
+
+    return true;
+}
+
+#if INDI_VERSION_MAJOR >= 1 && INDI_VERSION_MINOR >= 9 && INDI_VERSION_RELEASE >= 7
+void SVBDevice::addFITSKeywords(INDI::CCDChip *targetChip)
+#else
+void SVBDevice::addFITSKeywords(fitsfile *fptr, INDI::CCDChip *targetChip)
+#endif
+{
+#if INDI_VERSION_MAJOR >= 1 && INDI_VERSION_MINOR >= 9 && INDI_VERSION_RELEASE >= 7
+    SVBTemperature::addFITSKeywords(targetChip);
+    auto fptr = *targetChip->fitsFilePointer();
+#else
+    SVBTemperature::addFITSKeywords(fptr, targetChip);
+#endif
+
+    // report raw frame statistics and calibration in FITS file
+    int _status = 0;
+    if (mExposureStatsValid)
+    {
+        fits_update_key_dbl(fptr, "RAWMEAN", mExposureStats.mean, 3, "Raw frame mean", &_status);
+        fits_update_key_lng(fptr, "RAWMED", mExposureStats.median, "Raw frame median", &_status);
+        fits_update_key_dbl(fptr, "RAWSTD", mExposureStats.stddev, 3, "Raw frame standard deviation", &_status);
+        fits_update_key_lng(fptr, "RAWMIN", mExposureStats.min, "Raw frame min", &_status);
+        fits_update_key_lng(fptr, "RAWMAX", mExposureStats.max, "Raw frame max", &_status);
+        fits_update_key_lng(fptr, "RAWSAT", mExposureStats.saturated, "Raw frame saturated pixels", &_status);
+    }
+    if (!mLastDarkMaster.empty())
+    {
+        std::string master = mLastDarkMaster.substr(mLastDarkMaster.find_last_of('/') + 1);
+        fits_update_key_str(fptr, "DARKSUB", master.c_str(), "Master subtracted by the driver", &_status);
+    }
+    if (!mLastFlatMaster.empty())
+    {
+        std::string master = mLastFlatMaster.substr(mLastFlatMaster.find_last_of('/') + 1);
+        fits_update_key_str(fptr, "FLATCORR", master.c_str(), "Flat master applied by the driver", &_status);
+    }
+    if (mLastHotPixels > 0)
+    {
+        fits_update_key_lng(fptr, "HOTPIX", mLastHotPixels, "Hot pixels corrected by the driver", &_status);
+    }
+    if (mLastStarsValid)
+    {
+        fits_update_key_lng(fptr, "STARS", mLastStars, "Stars detected by the driver", &_status);
+        fits_update_key_dbl(fptr, "HFR", mLastHFR, 3, "Median half flux radius (px)", &_status);
+    }
+}
+
+void SVBDevice::workerStreamVideo(const std::atomic_bool &isAboutToQuit)
+{
+    LOG_INFO("framing\n");
+
+    // stream init
+    // NOTE : SV305M is MONO
+    // if mono binning, no more bayer
+    // the bayer pattern follows the subframe offset parity
+    SVB_BAYER_PATTERN pattern = Cfa::shift(static_cast<SVB_BAYER_PATTERN>(cameraProperty.BayerPattern), x_offset, y_offset);
+    int debayer = isBinningActive() ? DEBAYER_OFF : DebayerSP.findOnSwitchIndex();
+    int binMode = binningMode();
+    bool isColor = HasBayer() && binMode != BIN_MODE_MONO;
+    if (isColor && (debayer != DEBAYER_OFF || binMode == BIN_MODE_SUPERPIXEL))
+    {
+        Streamer->setPixelFormat(INDI_RGB, bitDepth);
+    }
+    else
+    {
+        debayer = DEBAYER_OFF;
+        Streamer->setPixelFormat(Helpers::pixelFormat(mCurrentVideoFormat, pattern, isColor), bitDepth);
+    }
+    Streamer->setSize(PrimaryCCD.getSubW() / PrimaryCCD.getBinX(), PrimaryCCD.getSubH() / PrimaryCCD.getBinY());
+    Debayer::Method debayerMethod = (debayer == DEBAYER_EDGE_AWARE) ? Debayer::EDGE_AWARE : Debayer::BILINEAR;
+
+    SerWriter::Format recordFormat = serFormat(pattern, isColor, binMode);
+
+    double ExposureRequest = 1.0 / Streamer->getTargetFPS();
+    long uSecs = static_cast<long>(ExposureRequest * 950000.0);
+    mAutoExposure.reset(uSecs, ControlsN[CCD_GAIN_N].value);
+
+    // the stream overwrites the last exposure
+    mLastExposureValid = false;
+
+    // buffers the budget refused are asked again
+    mRgbBuffer.denied = 0;
+    mBinBuffer.denied = 0;
+
+    // stop camera
+    auto ret = SVBStopVideoCapture(mCameraInfo.CameraID);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, stop camera failed  (%s).", Helpers::toString(ret));
+    }
+
+    ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, uSecs, SVB_FALSE);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
+    }
+
+    // set ROI back
+    ret = setTransferROI(x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(ret));
+    }
+    LOG_INFO("Subframe set\n");
+
+    // set camera normal mode
+    ret = SVBSetCameraMode(mCameraInfo.CameraID, SVB_MODE_NORMAL);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera normal mode failed (%s).", Helpers::toString(ret));
+    }
+    LOG_INFO("Camera normal mode\n");
+
+    ret = SVBStartVideoCapture(mCameraInfo.CameraID);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to start video capture (%s).", Helpers::toString(ret));
+    }
+
+    while (!isAboutToQuit)
+    {
+        tuneThread(THREAD_CAPTURE);
+        uint8_t *imageBuffer = PrimaryCCD.getFrameBuffer();
+        int waitMS = static_cast<int>((std::max(ExposureRequest, uSecs / 1000000.0) * 2000.0) + 500);
+
+        // only the bytes of the ROI are read and processed
+        std::unique_lock<std::mutex> guard(ccdBufferLock);
+        ret = getVideoData(imageBuffer, mTransfer.bytes, waitMS);
+        if (ret != SVB_SUCCESS)
+        {
+            if (ret != SVB_ERROR_TIMEOUT)
+            {
+                Streamer->setStream(false);
+                LOGF_ERROR("Failed to read video data (%s).", Helpers::toString(ret));
+                break;
+            }
+
+            usleep(100);
+            continue;
+        }
+        auto captured = SerWriter::Clock::now();
+
+        // stretching 12bits depth to 16bits depth, with statistics
+        stretchFrame(imageBuffer, true);
+
+        // auto exposure, the camera keeps capturing
+        autoExposeFrame(imageBuffer, uSecs);
+
+        // dark subtraction, flat field and hot pixels
+        calibrateFrame(imageBuffer, uSecs / 1000000.0);
+        flatFieldFrame(imageBuffer);
+        hotPixelFrame(imageBuffer, true);
+
+        // the consumers below get the binned frame, read again from the chip
+        if (!binFrame())
+        {
+            guard.unlock();
+            continue;
+        }
+        imageBuffer = PrimaryCCD.getFrameBuffer();
+
+        // guiding, the region is streamed too so that the loop can be supervised
+        if (mGuideActive)
+            guideFrame(imageBuffer);
+
+        // focus mode, only the metrics are published
+        if (mFocusActive)
+        {
+            focusFrame(imageBuffer);
+            guard.unlock();
+            continue;
+        }
+
+        // stars of the binned frame
+        detectStars(imageBuffer, true);
+
+        // live stacking, only the rendered stack is streamed
+        if (LiveStackSP[LIVE_STACK_ON].getState() == ISS_ON)
+        {
+            uint32_t pixels = (PrimaryCCD.getSubW() / PrimaryCCD.getBinX()) * (PrimaryCCD.getSubH() / PrimaryCCD.getBinY());
+            if (binMode == BIN_MODE_SUPERPIXEL)
+                pixels *= 3;
+            bool snapshot = false;
+            if (stackFrame(imageBuffer, pixels, snapshot))
+            {
+                if (debayer != DEBAYER_OFF)
+                    streamRGB(mStackBuffer.data(), pattern, debayerMethod);
+                else if (binMode == BIN_MODE_SUPERPIXEL)
+                    streamPlanarRGB(mStackBuffer.data());
+                else
+                    Streamer->newFrame(mStackBuffer.data(), mStackBuffer.size());
+            }
+            guard.unlock();
+
+            if (snapshot)
+                uploadStack();
+            continue;
+        }
+
+        // debayered streams are recorded raw, superpixel ones interleaved
+        const uint8_t *recorded = imageBuffer;
+        if (debayer != DEBAYER_OFF)
+        {
+            streamRGB(imageBuffer, pattern, debayerMethod);
+        }
+        else if (binMode == BIN_MODE_SUPERPIXEL)
+        {
+            if (!streamPlanarRGB(imageBuffer))
+            {
+                guard.unlock();
+                continue;
+            }
+            recorded = mRgbBuffer.data();
+        }
+        else
+        {
+            size_t pixels = size_t(PrimaryCCD.getSubW() / PrimaryCCD.getBinX()) * (PrimaryCCD.getSubH() / PrimaryCCD.getBinY());
+            Streamer->newFrame(imageBuffer, pixels * (bitDepth / 8));
+        }
+        recordFrame(recorded, captured, recordFormat);
+        flightFrame(recorded, captured, recordFormat);
+        transientFrame(recorded, captured, recordFormat);
+        deltaFrame(recorded, captured, recordFormat);
+        sharedFrame(recorded, captured, recordFormat);
+        guard.unlock();
+    }
+
+    // exposures take the gain of the controls
+    restoreManualGain();
+    if (mSerRecorder.isRecording())
+        stopRecording();
+    if (mFlightRecorder.isOpen())
+        stopFlightRecorder();
+    if (mEventActive)
+        saveEvent(mEventLast, recordFormat);
+    // the stream is over, the ring is freed once its events are written
+    mEventWriter.wait();
+    mTransientRing.reset(0, 1);
+    releaseMemory(mTransientGrant);
+}
+
+bool SVBDevice::StartStreaming()
+{
+    // stream in RAW8, the exposure frame format is restored when streaming stops
+    if (StreamFormatSP[STREAM_FORMAT_RAW8].getState() == ISS_ON && frameFormat != FORMAT_RAW8)
+    {
+        int format = frameFormat;
+        if (setFrameFormat(FORMAT_RAW8))
+        {
+            exposureFrameFormat = format;
+            LOG_INFO("Streaming in Raw 8 bits\n");
+        }
+    }
+
+    // every stream starts a new stack
+    mStackResetRequest = true;
+
+    // and a new delta stream
+    mDeltaEncoder.requestKeyframe();
+    mDeltaTimer.start();
+    mDeltaStatsTimer.start();
+    mDeltaBytes = mDeltaRawBytes = 0;
+    mDeltaFrames = 0;
+    mDeltaEncodeTime = 0;
+
+    // guiding and focus mode stream a small region around the star, guiding first
+    mFocusSequence = 0;
+    mFocusActive = false;
+    mGuideActive = false;
+    mRegionActive = false;
+    int guideMode = HasST4Port() ? GuideLoopSP.findOnSwitchIndex() : GUIDE_LOOP_OFF;
+    if ((guideMode == GUIDE_LOOP_CALIBRATE || guideMode == GUIDE_LOOP_GUIDE) && startGuideLoop(guideMode))
+    {
+        mRegionActive = startRegion(static_cast<int>(GuideSettingsNP[GUIDE_REGION_SIZE].getValue()), 0, 0);
+        mGuideActive = mRegionActive;
+        if (!mGuideActive)
+        {
+            mGuider.stop();
+            publishGuideLoop();
+        }
+    }
+    else if (FocusModeSP[FOCUS_MODE_ON].getState() == ISS_ON)
+    {
+        mRegionActive = startRegion(static_cast<int>(FocusRegionNP[FOCUS_REGION_SIZE].getValue()),
+                                    FocusRegionNP[FOCUS_REGION_X].getValue(), FocusRegionNP[FOCUS_REGION_Y].getValue());
+        mFocusActive = mRegionActive;
+    }
+
+    mWorker.start(std::bind(&SVBDevice::workerStreamVideo, this, std::placeholders::_1));
+    return true;
+}
+
+bool SVBDevice::StopStreaming()
+{
+    mWorker.quit();
+    LOG_INFO("stop framing\n");
+
+    // restore the subframe of the guiding or focus mode
+    mFocusActive = false;
+    if (mGuideActive)
+    {
+        mGuideActive = false;
+        mGuider.stop();
+        publishGuideLoop();
+    }
+    if (mRegionActive)
+    {
+        mRegionActive = false;
+        UpdateCCDFrame(mRegionRestore[0], mRegionRestore[1], mRegionRestore[2], mRegionRestore[3]);
+    }
+
+    // restore exposure frame format
+    if (exposureFrameFormat != -1)
+    {
+        int format = exposureFrameFormat;
+        exposureFrameFormat = -1;
+        setFrameFormat(format);
+    }
+
+    resetCaptureModeAndRoi(SVB_MODE_TRIG_SOFT);
+
+    return true;
+}
+
+void SVBDevice::resetCaptureModeAndRoi(SVB_CAMERA_MODE mode)
+{
+    // stop camera
+    auto status = SVBStopVideoCapture(mCameraInfo.CameraID);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, stop camera failed (%s).", Helpers::toString(status));
+    }
+
+    // set camera back to trigger mode
+    status = SVBSetCameraMode(mCameraInfo.CameraID, mode);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera mode %d failed (%s).", mode, Helpers::toString(status));
+    }
+    LOG_INFO("Camera soft trigger mode\n");
+
+    // set ROI back
+    status = setTransferROI(x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(status));
+    }
+    LOG_INFO("Subframe set\n");
+
+    // start camera
+    status = SVBStartVideoCapture(mCameraInfo.CameraID);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, start camera failed (%s).", Helpers::toString(status));
+    }
+}
+
+void SVBDevice::workerExposure(const std::atomic_bool &isAboutToQuit, float duration)
+{   
+    tuneThread(THREAD_CAPTURE);
+
+    if (exposureWorkaroundEnable && exposureWorkaroundDuration > 0)
+        workaroundExposure(0.5);
+
+    PrimaryCCD.setExposureDuration(duration);
+
+    LOGF_DEBUG("StartExposure->setexp : %.3fs", duration);
+
+    auto ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, duration * 1000 * 1000, SVB_FALSE);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
+        PrimaryCCD.setExposureFailed();
+        return;
+    }
+
+    if (duration > VERBOSE_EXPOSURE)
+        LOGF_INFO("Taking a %g seconds frame...", duration);
+
+        /*
+    ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_BLACK_LEVEL, 30, SVB_FALSE);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to set offset (%s).", Helpers::toString(ret));
+        PrimaryCCD.setExposureFailed();
+        return;
+    }*/
+
+    ret = SVBSendSoftTrigger(mCameraInfo.CameraID);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to send soft trigger (%s).", Helpers::toString(ret));
+        PrimaryCCD.setExposureFailed();
+        return;
+    }
+
+    SVB_ERROR_CODE status;
+    uint8_t *imageBuffer = nullptr;
+
+    usleep(duration * 1000 * 1000);
+    do
+    {
+        if (isAboutToQuit)
+            return;
+        imageBuffer = PrimaryCCD.getFrameBuffer();
+        std::unique_lock<std::mutex> guard(ccdBufferLock);
+        status = getVideoData(imageBuffer, mTransfer.bytes, 100);
+        guard.unlock();
+
+        if (ret != SVB_SUCCESS && ret != SVB_ERROR_TIMEOUT)
+        {
+            LOGF_ERROR("Exposure failed, status %d (%s).", ret, Helpers::toString(ret));
+            PrimaryCCD.setExposureFailed();
+            return;
+        }
+    } while (status != SVB_SUCCESS);
+
+    PrimaryCCD.setExposureLeft(0.0);
+    LOG_INFO("Exposure done, downloading image...");
+
+    // stretching 12bits depth to 16bits depth, with statistics
+    stretchFrame(imageBuffer, false);
+
+    // dark subtraction, dark and bias frames are kept raw for masters
+    // flats are dark subtracted only, lights are flat fielded too
+    auto frameType = PrimaryCCD.getFrameType();
+    mLastExposureKey = calibrationKey(Calibration::MASTER_DARK, duration);
+    mLastExposureType = frameType;
+    mLastExposureBinned = isBinningActive();
+    mLastExposureValid = true;
+    if (frameType == INDI::CCDChip::LIGHT_FRAME || frameType == INDI::CCDChip::FLAT_FRAME)
+        mLastDarkMaster = calibrateFrame(imageBuffer, duration);
+    else
+        mLastDarkMaster.clear();
+    if (frameType == INDI::CCDChip::LIGHT_FRAME)
+        mLastFlatMaster = flatFieldFrame(imageBuffer);
+    else
+        mLastFlatMaster.clear();
+    if (frameType == INDI::CCDChip::LIGHT_FRAME || frameType == INDI::CCDChip::FLAT_FRAME)
+        mLastHotPixels = hotPixelFrame(imageBuffer, false);
+    else
+        mLastHotPixels = 0;
+
+    // binning if needed, the chip frame is read again for the binned frame
+    if (!binFrame())
+    {
+        LOG_ERROR("Exposure failed, the memory budget denies the binning buffer");
+        mLastExposureValid = false;
+        PrimaryCCD.setExposureFailed();
+        return;
+    }
+    imageBuffer = PrimaryCCD.getFrameBuffer();
+
+    // stars of light frames
+    mLastStarsValid = frameType == INDI::CCDChip::LIGHT_FRAME && detectStars(imageBuffer, false);
+    if (mLastStarsValid)
+    {
+        mLastStars = mStarDetector.stars().size();
+        mLastHFR = mStarDetector.medianHFR();
+    }
+
+    // encode the frame once for the compressed CCD1 image and the writer, the disk write does not delay the next exposure
+    bool compress = TileCompressionSP[TILE_COMPRESSION_ON].getState() == ISS_ON;
+    bool upload = UploadSP[UPLOAD_CLIENT].getState() == ISS_ON || UploadSP[UPLOAD_BOTH].getState() == ISS_ON;
+    bool save = AsyncSaveSP[ASYNC_SAVE_ON].getState() == ISS_ON && mAsyncWriter.isRunning();
+    bool sent = false;
+    bool saved = false;
+    void *memptr = nullptr;
+    size_t memsize = 0;
+    if (((compress && upload) || save) && encodeExposure(compress, memptr, memsize))
+    {
+        if (compress && upload)
+        {
+            sendCompressed(memptr, memsize);
+            sent = true;
+        }
+        if (save)
+            saved = saveExposure(memptr, memsize);
+        else
+            free(memptr);
+    }
+
+    // exposure done, the async writer replaces the local save of INDI
+    completeExposure(sent, saved);
+
+    long currentValue;
+    SVB_BOOL bauto;
+    status = SVBGetControlValue(mCameraInfo.CameraID, SVB_BLACK_LEVEL, &currentValue, &bauto);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera get %s failed (%s).", Helpers::toString(SVB_BLACK_LEVEL), Helpers::toString(status));
+    }
+
+    LOGF_INFO("Current offset: %d", currentValue);
+
+    inExposure = false;
+}
+
+void SVBDevice::workaroundExposure(float duration)
+{
+    long uSecs = static_cast<long>(duration * 1000 * 1000);
+    int waitMS = static_cast<int>((duration * 2000.0) + 500);
+
+    // stop camera
+    auto ret = SVBStopVideoCapture(mCameraInfo.CameraID);
+
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, stop camera failed  (%s).", Helpers::toString(ret));
+    }
+
+    ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, uSecs, SVB_FALSE);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
+    }
+
+    // set camera normal mode
+    ret = SVBSetCameraMode(mCameraInfo.CameraID, SVB_MODE_NORMAL);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera normal mode failed (%s).", Helpers::toString(ret));
+    }
+    LOG_INFO("Camera normal mode\n");
+
+    // set ROI back
+    ret = setTransferROI(x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(ret));
+    }
+    LOG_INFO("Subframe set\n");
+
+    ret = SVBStartVideoCapture(mCameraInfo.CameraID);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to start video capture (%s).", Helpers::toString(ret));
+    }
+
+    // set ROI back
+    ret = setTransferROI(x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(ret));
+    }
+    LOG_INFO("Subframe set\n");
+
+    ret = SVBStartVideoCapture(mCameraInfo.CameraID);
+    if (ret != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Failed to start video capture (%s).", Helpers::toString(ret));
+    }
+
+    LOG_INFO("Workaround exposure in progress...");
+
+    usleep(uSecs);
+    do
+    {
+        std::unique_lock<std::mutex> guard(ccdBufferLock);
+        ret = SVBGetVideoData(mCameraInfo.CameraID, nullptr, mTransfer.bytes, waitMS);
+        guard.unlock();
+
+        if (ret != SVB_SUCCESS && ret != SVB_ERROR_TIMEOUT)
+        {
+            LOGF_ERROR("Workaround Exposure failed, status %d (%s).", ret, Helpers::toString(ret));
+            PrimaryCCD.setExposureFailed();
+            return;
+        }
+
+        usleep(100);
+    } while (ret != SVB_SUCCESS);
+
+    resetCaptureModeAndRoi(SVB_MODE_TRIG_SOFT);
+}
+
+void SVBDevice::workerTimerExposure(const std::atomic_bool &isAboutToQuit, float duration)
+{
+    tuneThread(THREAD_TIMER);
+    INDI::ElapsedTimer exposureTimer;
+
+    do
+    {
+        float delay = 0.1;
+        float timeLeft = std::max(duration - exposureTimer.elapsed() / 1000.0, 0.0);
+
+        /*
+         * Check the status every second until the time left is
+         * about one second, after which decrease the poll interval
+         *
+         * For expsoures with more than a second left try
+         * to keep the displayed "exposure left" value at
+         * a full second boundary, which keeps the
+         * count down neat
+         */
+        if (timeLeft > 1.1)
+        {
+            delay = std::max(timeLeft - std::trunc(timeLeft), 0.005f);
+            timeLeft = std::round(timeLeft);
+        }
+
+        if (timeLeft > 0)
+        {
+            PrimaryCCD.setExposureLeft(timeLeft);
+        }
+
+        usleep(delay * 1000 * 1000);
+
+        if (isAboutToQuit)
+            return;
+
+    } while (inExposure);
+}
+
+bool SVBDevice::StartExposure(float duration)
+{
+    float c_exp = duration;
+    // checks for time limits
+    if (c_exp < minExposure)
+    {
+        LOGF_WARN("Exposure shorter than minimum duration %g s requested. \n Setting exposure time to %g s.\n", duration,
+                  minExposure);
+        c_exp = minExposure;
+    }
+
+    if (c_exp > maxExposure)
+    {
+        LOGF_WARN("Exposure greater than minimum duration %g s requested. \n Setting exposure time to %g s.\n", duration,
+                  maxExposure);
+        c_exp = maxExposure;
+    }
+
+    inExposure = true;
+    mWorker.start(std::bind(&SVBDevice::workerExposure, this, std::placeholders::_1, c_exp));
+    mExposureTimerWorker.start(std::bind(&SVBDevice::workerTimerExposure, this, std::placeholders::_1, c_exp));
+
+    return true;
+}
+
+bool SVBDevice::AbortExposure()
+{
+    LOG_INFO("Aborting exposure...");
+    mWorker.quit();
+    inExposure = false;
+    mExposureTimerWorker.quit();
+
+    LOG_INFO("Reset capture mode...");
+    resetCaptureModeAndRoi(SVB_MODE_TRIG_SOFT);
+
+    return true;
+}
+
+bool SVBDevice::isCapturing()
+{
+    return inExposure || SVBTemperature::isCapturing();
+}
+
+// subframing
+bool SVBDevice::UpdateCCDFrame(int x, int y, int w, int h)
+{
+    if ((x + w) > cameraProperty.MaxWidth || (y + h) > cameraProperty.MaxHeight || w % 8 != 0 || h % 2 != 0)
+    {
+        LOG_ERROR("Error : Subframe out of range");
+        return false;
+    }
+
+    // stop framing
+    auto status = SVBStopVideoCapture(mCameraInfo.CameraID);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, stop camera failed (%s)", Helpers::toString(status));
+        return false;
+    }
+
+    // change ROI
+    status = setTransferROI(x, y, w, h);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, camera set subframe failed (%s)", Helpers::toString(status));
+        return false;
+    }
+    LOG_INFO("Subframe set\n");
+
+    // start framing
+    status = SVBStartVideoCapture(mCameraInfo.CameraID);
+    if (status != SVB_SUCCESS)
+    {
+        LOGF_ERROR("Error, start camera failed (%s)", Helpers::toString(status));
+        return false;
+    }
+
+    x_offset = x;
+    y_offset = y;
+
+    return INDI::CCD::UpdateCCDFrame(x, y, w, h);
+}
+
+bool SVBDevice::UpdateCCDBin(int hor, int ver)
+{
+    INDI_UNUSED(ver);
+
+    // the guide calibration is in binned pixels
+    if (hor != PrimaryCCD.getBinX())
+        mGuider.clearCalibration();
+
+    PrimaryCCD.setBin(hor, hor);
+
+    return UpdateCCDFrame(PrimaryCCD.getSubX(), PrimaryCCD.getSubY(), PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+}
+
+bool SVBDevice::isBinningActive()
+{
+    return PrimaryCCD.getBinX() > 1;
 }
 
-SVBDevice::~SVBDevice()
+void SVBDevice::stretchFrame(uint8_t *frame, bool streaming)
 {
-    mWorker.quit();
+    size_t pixels = size_t(mTransfer.width) * mTransfer.height;
+    const FrameStats::Result &stats = mStats.process(frame, pixels, bitDepth, bitDepth == 16 ? bitStretch : 0);
+
+    if (!streaming)
+    {
+        mExposureStats = stats;
+        mExposureStatsValid = true;
+    }
+    else if (mStatsTimer.elapsed() < 1000)
+    {
+        return;
+    }
+    mStatsTimer.start();
+
+    FrameStatsNP[STATS_MEAN].setValue(stats.mean);
+    FrameStatsNP[STATS_MEDIAN].setValue(stats.median);
+    FrameStatsNP[STATS_STDDEV].setValue(stats.stddev);
+    FrameStatsNP[STATS_MIN].setValue(stats.min);
+    FrameStatsNP[STATS_MAX].setValue(stats.max);
+    FrameStatsNP[STATS_SATURATED].setValue(stats.saturated);
+    FrameStatsNP[STATS_SATURATED_PERCENT].setValue(pixels > 0 ? 100.0 * stats.saturated / pixels : 0);
+    FrameStatsNP.setState(IPS_OK);
+    FrameStatsNP.apply();
 }
 
-void SVBDevice::workerStreamVideo(const std::atomic_bool &isAboutToQuit)
+bool SVBDevice::autoExposeFrame(const uint8_t *frame, long &exposure)
 {
-    LOG_INFO("framing\n");
+    int mode = AutoExposureSP.findOnSwitchIndex();
+    if (mode == AUTO_EXPOSURE_OFF || mode < 0)
+    {
+        // follow manual changes
+        restoreManualGain();
+        mAutoExposure.reset(exposure, ControlsN[CCD_GAIN_N].value);
+        return false;
+    }
 
-    // stream init
-    // NOTE : SV305M is MONO
-    // if binning, no more bayer
-    if (strcmp(mCameraInfo.FriendlyName, "SVBONY SV305M PRO") == 0 || isBinningActive())
+    // full scale of the stretched data
+    uint32_t fullScale = 255;
+    if (bitDepth == 16)
+        fullScale = std::min((1u << std::min(cameraProperty.MaxBitDepth + bitStretch, 16)) - 1, 65535u);
+    mAutoExposure.measure(frame, mTransfer.width, mTransfer.height, bitDepth, fullScale);
+
+    // the frame rate bounds the exposure unless a longer one is allowed
+    double limit = AutoExposureNP[AUTO_EXPOSURE_MAX_EXPOSURE].getValue() * 1000.0;
+    if (limit <= 0)
+        limit = 950000.0 / Streamer->getTargetFPS();
+
+    AutoExposure::Settings settings;
+    settings.target = AutoExposureNP[AUTO_EXPOSURE_TARGET].getValue() / 100.0;
+    settings.percentile = AutoExposureNP[AUTO_EXPOSURE_PERCENTILE].getValue() / 100.0;
+    settings.tolerance = AutoExposureNP[AUTO_EXPOSURE_TOLERANCE].getValue() / 100.0;
+    settings.maxStep = AutoExposureNP[AUTO_EXPOSURE_MAX_STEP].getValue();
+    settings.minExposure = std::max(minExposure * 1000000.0, 1.0);
+    settings.maxExposure = std::min(limit, maxExposure * 1000000.0);
+    settings.minGain = ControlsN[CCD_GAIN_N].min;
+    settings.maxGain = ControlsN[CCD_GAIN_N].max;
+    settings.adjustGain = (mode == AUTO_EXPOSURE_EXPOSURE_GAIN);
+
+    double previousGain = mAutoExposure.gain();
+    bool changed = mAutoExposure.update(settings);
+
+    AutoExposureInfoNP[AUTO_EXPOSURE_INFO_LEVEL].setValue(mAutoExposure.level() * 100.0);
+    if (!changed)
+        return false;
+
+    // exposure and gain are changed while the camera is capturing
+    if (mAutoExposure.exposure() != exposure)
     {
-        Streamer->setPixelFormat(INDI_MONO, bitDepth);
+        exposure = static_cast<long>(mAutoExposure.exposure());
+        auto ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, exposure, SVB_FALSE);
+        if (ret != SVB_SUCCESS)
+            LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
     }
-    else
+
+    if (mAutoExposure.gain() != previousGain)
     {
-        Streamer->setPixelFormat(INDI_BAYER_GRBG, bitDepth);
+        // the gain control belongs to the main thread, the auto gain is only published with the auto exposure
+        auto ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_GAIN, static_cast<long>(mAutoExposure.gain()), SVB_FALSE);
+        if (ret != SVB_SUCCESS)
+            LOGF_ERROR("Error, camera set control %s failed (%s)", Helpers::toString(SVB_GAIN), Helpers::toString(ret));
     }
-    Streamer->setSize(PrimaryCCD.getSubW() / PrimaryCCD.getBinX(), PrimaryCCD.getSubH() / PrimaryCCD.getBinY());
 
-    double ExposureRequest = 1.0 / Streamer->getTargetFPS();
-    long uSecs = static_cast<long>(ExposureRequest * 950000.0);
+    AutoExposureInfoNP[AUTO_EXPOSURE_INFO_EXPOSURE].setValue(exposure / 1000.0);
+    AutoExposureInfoNP[AUTO_EXPOSURE_INFO_GAIN].setValue(mAutoExposure.gain());
+    AutoExposureInfoNP.setState(IPS_OK);
+    AutoExposureInfoNP.apply();
+    return true;
+}
 
-    // stop camera
-    auto ret = SVBStopVideoCapture(mCameraInfo.CameraID);
+void SVBDevice::restoreManualGain()
+{
+    double gain = ControlsN[CCD_GAIN_N].value;
+    if (mAutoExposure.gain() == gain)
+        return;
+    auto ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_GAIN, static_cast<long>(gain), SVB_FALSE);
     if (ret != SVB_SUCCESS)
+        LOGF_ERROR("Error, camera set control %s failed (%s)", Helpers::toString(SVB_GAIN), Helpers::toString(ret));
+}
+
+int SVBDevice::binningMode()
+{
+    if (!HasBayer() || !isBinningActive())
+        return BIN_MODE_MONO;
+
+    int mode = BinningModeSP.findOnSwitchIndex();
+    if (mode == BIN_MODE_SUPERPIXEL && PrimaryCCD.getBinX() % 2 != 0)
+        return BIN_MODE_BAYER;
+    return mode < 0 ? BIN_MODE_MONO : mode;
+}
+
+bool SVBDevice::binFrame()
+{
+    int mode = binningMode();
+
+    // superpixel frames are RGB planes, FITS NAXIS3 = 3
+    PrimaryCCD.setNAxis(mode == BIN_MODE_SUPERPIXEL ? 3 : 2);
+
+    if (!isBinningActive())
+        return true;
+
+    // binned in a driver buffer then copied back, the chip binning would swap the pool buffer for its own
+    uint32_t width = PrimaryCCD.getSubW();
+    uint32_t height = PrimaryCCD.getSubH();
+    uint32_t bin = PrimaryCCD.getBinX();
+    size_t size = size_t(width / bin) * (height / bin) * (bitDepth / 8) * (mode == BIN_MODE_SUPERPIXEL ? 3 : 1);
+    if (!resizeBuffer(mBinBuffer, size, "Binning buffer"))
+        return false;
+
+    if (mode == BIN_MODE_MONO)
     {
-        LOGF_ERROR("Error, stop camera failed  (%s).", Helpers::toString(ret));
+        mColorBinning.mono(PrimaryCCD.getFrameBuffer(), mBinBuffer.data(), width, height, bin, bitDepth);
+    }
+    else if (mode == BIN_MODE_SUPERPIXEL)
+    {
+        SVB_BAYER_PATTERN pattern = Cfa::shift(static_cast<SVB_BAYER_PATTERN>(cameraProperty.BayerPattern), x_offset, y_offset);
+        mColorBinning.superpixel(PrimaryCCD.getFrameBuffer(), mBinBuffer.data(), width, height, bin, pattern, bitDepth, true);
+    }
+    else
+    {
+        mColorBinning.bayer(PrimaryCCD.getFrameBuffer(), mBinBuffer.data(), width, height, bin, bitDepth);
     }
 
-    ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, uSecs, SVB_FALSE);
-    if (ret != SVB_SUCCESS)
+    memcpy(PrimaryCCD.getFrameBuffer(), mBinBuffer.data(), std::min<size_t>(size, PrimaryCCD.getFrameBufferSize()));
+    return true;
+}
+
+bool SVBDevice::detectStars(const uint8_t *frame, bool streaming)
+{
+    if (StarDetectionSP[STAR_DETECTION_ON].getState() != ISS_ON)
+        return false;
+    if (streaming && mStarTimer.elapsed() < 1000)
+        return false;
+    mStarTimer.start();
+
+    // superpixel frames are RGB planes, stars are detected on the green one
+    uint32_t width = PrimaryCCD.getSubW() / PrimaryCCD.getBinX();
+    uint32_t height = PrimaryCCD.getSubH() / PrimaryCCD.getBinY();
+    if (binningMode() == BIN_MODE_SUPERPIXEL && isBinningActive())
+        frame += size_t(width) * height * (bitDepth / 8);
+
+    StarDetector::Settings settings;
+    settings.kappa = StarDetectionNP[STAR_DETECTION_KAPPA].getValue();
+    settings.minPixels = static_cast<uint32_t>(StarDetectionNP[STAR_DETECTION_MIN_PIXELS].getValue());
+    settings.maxPixels = static_cast<uint32_t>(StarDetectionNP[STAR_DETECTION_MAX_PIXELS].getValue());
+    settings.maxStars = static_cast<size_t>(StarDetectionNP[STAR_DETECTION_MAX_STARS].getValue());
+    mStarDetector.detect(frame, width, height, bitDepth, settings);
+
+    mBrightestStarValid = false;
+    for (const auto &star : mStarDetector.stars())
     {
-        LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
+        if (star.saturated)
+            continue;
+        mBrightestStarX = x_offset + (star.x + 0.5) * PrimaryCCD.getBinX();
+        mBrightestStarY = y_offset + (star.y + 0.5) * PrimaryCCD.getBinY();
+        mBrightestStarValid = true;
+        break;
     }
 
-    // set ROI back
-    ret = SVBSetROIFormat(mCameraInfo.CameraID, x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH(), 1);
-    if (ret != SVB_SUCCESS)
+    StarInfoNP[STAR_INFO_COUNT].setValue(mStarDetector.stars().size());
+    StarInfoNP[STAR_INFO_HFR].setValue(mStarDetector.medianHFR());
+    StarInfoNP[STAR_INFO_FWHM].setValue(mStarDetector.medianFWHM());
+    StarInfoNP[STAR_INFO_BACKGROUND].setValue(mStarDetector.background());
+    StarInfoNP[STAR_INFO_NOISE].setValue(mStarDetector.noise());
+    StarInfoNP.setState(IPS_OK);
+    StarInfoNP.apply();
+
+    // the list stays valid until the next detection
+    mStarList = mStarDetector.toCSV();
+    StarListBP[0].setBlob(const_cast<char *>(mStarList.data()));
+    StarListBP[0].setBlobLen(mStarList.size());
+    StarListBP[0].setSize(mStarList.size());
+    StarListBP[0].setFormat(".csv");
+    StarListBP.setState(IPS_OK);
+    StarListBP.apply();
+    return true;
+}
+
+bool SVBDevice::startRegion(int size, double cx, double cy)
+{
+    // whole binned pixels, width multiple of 8
+    int bin = PrimaryCCD.getBinX();
+    size *= bin;
+    size = std::min(size, std::min<int>(cameraProperty.MaxWidth, cameraProperty.MaxHeight));
+    size -= size % (8 * bin);
+    if (size <= 0)
+        return false;
+
+    // requested center, else the brightest star, else the current subframe center
+    if (cx == 0 && cy == 0)
     {
-        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(ret));
+        if (mBrightestStarValid)
+        {
+            cx = mBrightestStarX;
+            cy = mBrightestStarY;
+        }
+        else
+        {
+            cx = PrimaryCCD.getSubX() + PrimaryCCD.getSubW() / 2.0;
+            cy = PrimaryCCD.getSubY() + PrimaryCCD.getSubH() / 2.0;
+        }
     }
-    LOG_INFO("Subframe set\n");
 
-    // set camera normal mode
-    ret = SVBSetCameraMode(mCameraInfo.CameraID, SVB_MODE_NORMAL);
-    if (ret != SVB_SUCCESS)
+    // even offsets keep the bayer pattern
+    int x = std::max(0, std::min(static_cast<int>(cx) - size / 2, static_cast<int>(cameraProperty.MaxWidth) - size)) & ~1;
+    int y = std::max(0, std::min(static_cast<int>(cy) - size / 2, static_cast<int>(cameraProperty.MaxHeight) - size)) & ~1;
+
+    mRegionRestore[0] = PrimaryCCD.getSubX();
+    mRegionRestore[1] = PrimaryCCD.getSubY();
+    mRegionRestore[2] = PrimaryCCD.getSubW();
+    mRegionRestore[3] = PrimaryCCD.getSubH();
+    if (!UpdateCCDFrame(x, y, size, size))
+        return false;
+
+    LOGF_INFO("Streaming %dx%d region at %d, %d", size, size, x, y);
+    return true;
+}
+
+void SVBDevice::focusFrame(const uint8_t *frame)
+{
+    uint32_t width = PrimaryCCD.getSubW() / PrimaryCCD.getBinX();
+    uint32_t height = PrimaryCCD.getSubH() / PrimaryCCD.getBinY();
+
+    // superpixel frames are measured on the green plane, raw bayer frames compare same colour pixels
+    int mode = binningMode();
+    uint32_t step = 1;
+    if (mode == BIN_MODE_SUPERPIXEL && isBinningActive())
+        frame += size_t(width) * height * (bitDepth / 8);
+    else if (HasBayer() && (mode == BIN_MODE_BAYER || !isBinningActive()))
+        step = 2;
+
+    StarDetector::Settings settings;
+    settings.kappa = StarDetectionNP[STAR_DETECTION_KAPPA].getValue();
+    settings.minPixels = static_cast<uint32_t>(StarDetectionNP[STAR_DETECTION_MIN_PIXELS].getValue());
+    settings.maxPixels = static_cast<uint32_t>(StarDetectionNP[STAR_DETECTION_MAX_PIXELS].getValue());
+    settings.maxStars = static_cast<size_t>(StarDetectionNP[STAR_DETECTION_MAX_STARS].getValue());
+    const FocusMetric::Result &result = mFocusMetric.process(frame, width, height, bitDepth, step, settings);
+
+    auto now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    mFocusSequence++;
+    FocusMetricNP[FOCUS_METRIC_SEQUENCE].setValue(mFocusSequence);
+    FocusMetricNP[FOCUS_METRIC_TIMESTAMP].setValue(now);
+    FocusMetricNP[FOCUS_METRIC_HFR].setValue(result.hfr);
+    FocusMetricNP[FOCUS_METRIC_FWHM].setValue(result.fwhm);
+    FocusMetricNP[FOCUS_METRIC_SHARPNESS].setValue(result.sharpness);
+    FocusMetricNP[FOCUS_METRIC_STARS].setValue(result.stars);
+    FocusMetricNP.setState(IPS_OK);
+    FocusMetricNP.apply();
+
+    uint32_t every = static_cast<uint32_t>(FocusRegionNP[FOCUS_THUMBNAIL_EVERY].getValue());
+    if (every == 0 || mFocusSequence % every != 0)
+        return;
+
+    // the thumbnail stays valid until the next one
+    const std::string &thumbnail = mFocusMetric.thumbnail(frame, width, height, bitDepth,
+                                   static_cast<uint32_t>(FocusRegionNP[FOCUS_THUMBNAIL_SCALE].getValue()));
+    FocusThumbnailBP[0].setBlob(const_cast<char *>(thumbnail.data()));
+    FocusThumbnailBP[0].setBlobLen(thumbnail.size());
+    FocusThumbnailBP[0].setSize(thumbnail.size());
+    FocusThumbnailBP[0].setFormat(".pgm");
+    FocusThumbnailBP.setState(IPS_OK);
+    FocusThumbnailBP.apply();
+}
+
+bool SVBDevice::startGuideLoop(int mode)
+{
+    if (mode == GUIDE_LOOP_CALIBRATE)
     {
-        LOGF_ERROR("Error, camera normal mode failed (%s).", Helpers::toString(ret));
+        mGuider.startCalibration();
+    }
+    else if (!mGuider.startGuiding())
+    {
+        LOG_ERROR("Guide loop is not calibrated, calibrate first");
+        return false;
     }
-    LOG_INFO("Camera normal mode\n");
 
-    ret = SVBStartVideoCapture(mCameraInfo.CameraID);
-    if (ret != SVB_SUCCESS)
+    mGuideSequence = 0;
+    mGuideSettling = false;
+    publishGuideLoop();
+    return true;
+}
+
+void SVBDevice::guideFrame(const uint8_t *frame)
+{
+    // frames exposed while the mount moved
+    if (!mPulseScheduler.isIdle())
+        return;
+    if (mGuideSettling)
     {
-        LOGF_ERROR("Failed to start video capture (%s).", Helpers::toString(ret));
+        mGuideSettling = false;
+        return;
     }
 
-    while (!isAboutToQuit)
+    // superpixel frames are tracked on the green plane
+    uint32_t width = PrimaryCCD.getSubW() / PrimaryCCD.getBinX();
+    uint32_t height = PrimaryCCD.getSubH() / PrimaryCCD.getBinY();
+    if (binningMode() == BIN_MODE_SUPERPIXEL && isBinningActive())
+        frame += size_t(width) * height * (bitDepth / 8);
+
+    StarDetector::Settings detection;
+    detection.kappa = StarDetectionNP[STAR_DETECTION_KAPPA].getValue();
+    detection.minPixels = static_cast<uint32_t>(StarDetectionNP[STAR_DETECTION_MIN_PIXELS].getValue());
+    detection.maxPixels = static_cast<uint32_t>(StarDetectionNP[STAR_DETECTION_MAX_PIXELS].getValue());
+    detection.maxStars = 16;
+    mGuideDetector.detect(frame, width, height, bitDepth, detection);
+
+    Guider::Settings settings;
+    settings.aggressivenessRA = GuideSettingsNP[GUIDE_AGGRESSIVENESS_RA].getValue();
+    settings.aggressivenessDEC = GuideSettingsNP[GUIDE_AGGRESSIVENESS_DEC].getValue();
+    settings.hysteresis = GuideSettingsNP[GUIDE_HYSTERESIS].getValue();
+    settings.minMove = GuideSettingsNP[GUIDE_MIN_MOVE].getValue();
+    settings.maxPulse = GuideSettingsNP[GUIDE_MAX_PULSE].getValue();
+    settings.calibrationPulse = GuideSettingsNP[GUIDE_CALIBRATION_PULSE].getValue();
+    settings.calibrationDistance = GuideSettingsNP[GUIDE_CALIBRATION_DISTANCE].getValue();
+    settings.searchRadius = GuideSettingsNP[GUIDE_SEARCH_RADIUS].getValue();
+
+    Guider::State previous = mGuider.state();
+    Guider::Pulse pulse = mGuider.update(mGuideDetector.stars(), settings);
+    if (mGuider.state() != previous)
+        publishGuideLoop();
+
+    // telemetry of every frame, an external guider can supervise the loop
+    auto now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    mGuideSequence++;
+    GuideErrorNP[GUIDE_ERROR_FRAME].setValue(mGuideSequence);
+    GuideErrorNP[GUIDE_ERROR_TIMESTAMP].setValue(now);
+    GuideErrorNP[GUIDE_ERROR_X].setValue(mGuider.x());
+    GuideErrorNP[GUIDE_ERROR_Y].setValue(mGuider.y());
+    GuideErrorNP[GUIDE_ERROR_RA].setValue(mGuider.errorRA());
+    GuideErrorNP[GUIDE_ERROR_DEC].setValue(mGuider.errorDEC());
+    GuideErrorNP[GUIDE_ERROR_PULSE_RA].setValue(pulse.ra);
+    GuideErrorNP[GUIDE_ERROR_PULSE_DEC].setValue(pulse.dec);
+    GuideErrorNP[GUIDE_ERROR_RMS_RA].setValue(mGuider.rmsRA());
+    GuideErrorNP[GUIDE_ERROR_RMS_DEC].setValue(mGuider.rmsDEC());
+    GuideErrorNP.setState(mGuider.state() == Guider::LOST ? IPS_ALERT : IPS_OK);
+    GuideErrorNP.apply();
+
+    if (pulse.ra == 0 && pulse.dec == 0)
+        return;
+
+    // RA and DEC together, the capture thread does not wait for the mount
+    mGuideSettling = true;
+    if (pulse.ra != 0)
+        mPulseScheduler.request(PulseScheduler::RA, pulse.ra, PulseScheduler::REPLACE);
+    if (pulse.dec != 0)
+        mPulseScheduler.request(PulseScheduler::DEC, pulse.dec, PulseScheduler::REPLACE);
+}
+
+void SVBDevice::publishGuideLoop()
+{
+    Guider::State state = mGuider.state();
+    GuideStateTP[0].setText(mGuider.stateName());
+    switch (state)
     {
-        uint8_t *imageBuffer = PrimaryCCD.getFrameBuffer();
-        uint32_t totalBytes = PrimaryCCD.getFrameBufferSize();
-        int waitMS = static_cast<int>((ExposureRequest * 2000.0) + 500);
+        case Guider::CALIBRATING:
+            GuideStateTP.setState(IPS_BUSY);
+            break;
+        case Guider::GUIDING:
+            GuideStateTP.setState(IPS_OK);
+            break;
+        case Guider::LOST:
+        case Guider::FAILED:
+            GuideStateTP.setState(IPS_ALERT);
+            break;
+        default:
+            GuideStateTP.setState(IPS_IDLE);
+            break;
+    }
+    GuideStateTP.apply();
 
-        std::unique_lock<std::mutex> guard(ccdBufferLock);
-        ret = SVBGetVideoData(mCameraInfo.CameraID, imageBuffer, totalBytes, waitMS);
-        if (ret != SVB_SUCCESS)
-        {
-            if (ret != SVB_ERROR_TIMEOUT)
-            {
-                Streamer->setStream(false);
-                LOGF_ERROR("Failed to read video data (%s).", Helpers::toString(ret));
-                break;
-            }
+    // a successful calibration goes on guiding
+    if (state == Guider::GUIDING && GuideLoopSP[GUIDE_LOOP_CALIBRATE].getState() == ISS_ON)
+    {
+        LOGF_INFO("Guide calibration done, RA %.2f px/s at %.1f deg, DEC %.2f px/s at %.1f deg",
+                  mGuider.rateRA() * 1000.0, mGuider.angleRA(), mGuider.rateDEC() * 1000.0, mGuider.angleDEC());
+        GuideLoopSP.reset();
+        GuideLoopSP[GUIDE_LOOP_GUIDE].setState(ISS_ON);
+        GuideLoopSP.setState(IPS_OK);
+        GuideLoopSP.apply();
+
+        GuideCalibrationNP[GUIDE_CALIBRATION_RATE_RA].setValue(mGuider.rateRA() * 1000.0);
+        GuideCalibrationNP[GUIDE_CALIBRATION_ANGLE_RA].setValue(mGuider.angleRA());
+        GuideCalibrationNP[GUIDE_CALIBRATION_RATE_DEC].setValue(mGuider.rateDEC() * 1000.0);
+        GuideCalibrationNP[GUIDE_CALIBRATION_ANGLE_DEC].setValue(mGuider.angleDEC());
+        GuideCalibrationNP.setState(IPS_OK);
+        GuideCalibrationNP.apply();
+    }
+    else if (state == Guider::FAILED)
+    {
+        LOG_ERROR("Guide calibration failed, the star was lost or did not move enough");
+        GuideLoopSP.setState(IPS_ALERT);
+        GuideLoopSP.apply();
+        GuideCalibrationNP.setState(IPS_ALERT);
+        GuideCalibrationNP.apply();
+    }
+}
 
-            usleep(100);
-            continue;
-        }
+SerWriter::Format SVBDevice::serFormat(SVB_BAYER_PATTERN pattern, bool isColor, int binMode)
+{
+    SerWriter::Format format;
+    format.width = PrimaryCCD.getSubW() / PrimaryCCD.getBinX();
+    format.height = PrimaryCCD.getSubH() / PrimaryCCD.getBinY();
+    format.bitDepth = bitDepth;
+    format.instrument = mCameraInfo.FriendlyName;
+
+    const int32_t bayerIds[4] = {SerWriter::BAYER_RGGB, SerWriter::BAYER_BGGR, SerWriter::BAYER_GRBG, SerWriter::BAYER_GBRG};
+    if (binMode == BIN_MODE_SUPERPIXEL)
+        format.colorId = SerWriter::RGB;
+    else if (isColor && pattern >= SVB_BAYER_RG && pattern <= SVB_BAYER_GB)
+        format.colorId = bayerIds[pattern];
+    else
+        format.colorId = SerWriter::MONO;
+    return format;
+}
 
-        // stretching 12bits depth to 16bits depth
-        if (bitDepth == 16 && (bitStretch != 0))
-        {
-            u_int16_t *tmp = (u_int16_t *)imageBuffer;
-            for (int i = 0; i < totalBytes / 2; i++)
-            {
-                tmp[i] <<= bitStretch;
-            }
-        }
+void SVBDevice::recordFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format)
+{
+    if (SerRecordSP[SER_RECORD_ON].getState() != ISS_ON)
+    {
+        if (mSerRecorder.isRecording())
+            stopRecording();
+        return;
+    }
 
-        if (isBinningActive())
+    if (!mSerRecorder.isRecording())
+    {
+        const char *directory = SerFileTP[SER_DIRECTORY].getText();
+        uint64_t limit = static_cast<uint64_t>(SerOptionsNP[SER_MAX_FILE_SIZE].getValue()) << 20;
+        bool direct = SerDirectSP[SER_DIRECT_ON].getState() == ISS_ON;
+        if (!mSerRecorder.start(directory, SerFileTP[SER_PREFIX].getText(), format, limit, direct))
         {
-            PrimaryCCD.binFrame();
+            LOGF_ERROR("Failed to start SER recording in %s (%s)", directory, strerror(errno));
+            SerRecordSP.reset();
+            SerRecordSP[SER_RECORD_OFF].setState(ISS_ON);
+            SerRecordSP.setState(IPS_ALERT);
+            SerRecordSP.apply();
+            return;
         }
+        LOGF_INFO("SER recording to %s%s", mSerRecorder.path().c_str(), mSerRecorder.isDirect() ? " with direct I/O" : "");
+        mSerPublishedBytes = 0;
+        mSerTimer.start();
+        SerRecordSP.setState(IPS_BUSY);
+        SerRecordSP.apply();
+    }
 
-        Streamer->newFrame(imageBuffer, totalBytes);
-        guard.unlock();
+    if (!mSerRecorder.add(frame, captured))
+    {
+        LOGF_ERROR("SER recording failed, %s (%s)", mSerRecorder.path().c_str(), strerror(errno));
+        stopRecording();
+        SerRecordSP.reset();
+        SerRecordSP[SER_RECORD_OFF].setState(ISS_ON);
+        SerRecordSP.setState(IPS_ALERT);
+        SerRecordSP.apply();
+        return;
     }
+
+    if (mSerTimer.elapsed() >= 1000)
+        publishRecording();
 }
 
-bool SVBDevice::StartStreaming()
+void SVBDevice::stopRecording()
 {
-    mWorker.start(std::bind(&SVBDevice::workerStreamVideo, this, std::placeholders::_1));
-    return true;
+    if (!mSerRecorder.stop())
+        LOGF_ERROR("Failed to close %s (%s)", mSerRecorder.path().c_str(), strerror(errno));
+    LOGF_INFO("SER recording stopped, %llu frames in %u files", static_cast<unsigned long long>(mSerRecorder.frames()),
+              mSerRecorder.files());
+    publishRecording();
+    if (SerRecordSP.getState() == IPS_BUSY)
+    {
+        SerRecordSP.setState(IPS_OK);
+        SerRecordSP.apply();
+    }
 }
 
-bool SVBDevice::StopStreaming()
+void SVBDevice::publishRecording()
 {
-    mWorker.quit();
-    LOG_INFO("stop framing\n");
+    double seconds = mSerTimer.elapsed() / 1000.0;
+    uint64_t bytes = mSerRecorder.bytes();
+    SerInfoNP[SER_INFO_FRAMES].setValue(mSerRecorder.frames());
+    SerInfoNP[SER_INFO_SIZE].setValue(bytes / 1048576.0);
+    SerInfoNP[SER_INFO_FILES].setValue(mSerRecorder.files());
+    SerInfoNP[SER_INFO_RATE].setValue(seconds > 0 ? (bytes - mSerPublishedBytes) / 1048576.0 / seconds : 0);
+    SerInfoNP.setState(mSerRecorder.isRecording() ? IPS_BUSY : IPS_OK);
+    SerInfoNP.apply();
+    mSerPublishedBytes = bytes;
+    mSerTimer.start();
+}
 
-    resetCaptureModeAndRoi(SVB_MODE_TRIG_SOFT);
+void SVBDevice::flightFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format)
+{
+    if (FlightRecorderSP[FLIGHT_RECORDER_ON].getState() != ISS_ON)
+    {
+        if (mFlightRecorder.isOpen())
+            stopFlightRecorder();
+        return;
+    }
 
-    return true;
+    if (!mFlightRecorder.isOpen())
+    {
+        const char *ring = FlightRecorderTP[0].getText();
+        uint64_t size = static_cast<uint64_t>(FlightRecorderNP[FLIGHT_RECORDER_SIZE].getValue()) << 20;
+        if (!mFlightRecorder.open(ring, size, format))
+        {
+            LOGF_ERROR("Failed to open the flight recorder ring %s (%s)", ring, strerror(errno));
+            FlightRecorderSP.reset();
+            FlightRecorderSP[FLIGHT_RECORDER_OFF].setState(ISS_ON);
+            FlightRecorderSP.setState(IPS_ALERT);
+            FlightRecorderSP.apply();
+            return;
+        }
+        LOGF_INFO("Flight recorder ring %s, %u frames", ring, mFlightRecorder.slots());
+        mFlightTimer.start();
+        FlightRecorderSP.setState(IPS_BUSY);
+        FlightRecorderSP.apply();
+    }
+
+    mFlightRecorder.add(frame, captured);
+
+    if (mFreezeRequested.exchange(false))
+        freezeFlightRecorder();
+
+    if (mFlightTimer.elapsed() >= 1000)
+        publishFlightRecorder();
 }
 
-void SVBDevice::resetCaptureModeAndRoi(SVB_CAMERA_MODE mode)
+void SVBDevice::freezeFlightRecorder()
 {
-    // stop camera
-    auto status = SVBStopVideoCapture(mCameraInfo.CameraID);
-    if (status != SVB_SUCCESS)
+    if (mFreezeBusy)
     {
-        LOGF_ERROR("Error, stop camera failed (%s).", Helpers::toString(status));
+        LOG_WARN("Flight recorder freeze already in progress");
+        return;
     }
+    if (mFreezeThread.joinable())
+        mFreezeThread.join();
+
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+    std::string path = std::string(SerFileTP[SER_DIRECTORY].getText()) + "/" + SerFileTP[SER_PREFIX].getText() +
+                       "_freeze_" + stamp + ".ser";
+    double seconds = FlightRecorderNP[FLIGHT_RECORDER_SECONDS].getValue();
+
+    // the streaming thread keeps writing the ring, the copy skips the frames it overwrites
+    mFreezeBusy = true;
+    mFreezeThread = std::thread([this, path, seconds]()
+    {
+        uint32_t frames = 0;
+        bool ok = mFlightRecorder.freeze(path, seconds, frames);
+        if (ok)
+        {
+            LOGF_INFO("Flight recorder froze %u frames in %s", frames, path.c_str());
+            mFrozenFiles++;
+            FlightRecorderInfoNP[FLIGHT_INFO_FROZEN].setValue(mFrozenFiles);
+            FlightRecorderInfoNP[FLIGHT_INFO_LAST].setValue(frames);
+        }
+        else
+        {
+            LOGF_ERROR("Flight recorder freeze to %s failed (%s)", path.c_str(), strerror(errno));
+        }
+        FlightTriggerSP.setState(ok ? IPS_OK : IPS_ALERT);
+        FlightTriggerSP.apply();
+        mFreezeBusy = false;
+    });
+}
 
-    // set camera back to trigger mode
-    status = SVBSetCameraMode(mCameraInfo.CameraID, mode);
-    if (status != SVB_SUCCESS)
+void SVBDevice::stopFlightRecorder()
+{
+    // the freeze reads the ring, it ends before the ring is unmapped
+    if (mFreezeThread.joinable())
+        mFreezeThread.join();
+    if (mFreezeRequested.exchange(false))
     {
-        LOGF_ERROR("Error, camera mode %d failed (%s).", mode, Helpers::toString(status));
+        FlightTriggerSP.setState(IPS_ALERT);
+        FlightTriggerSP.apply();
     }
-    LOG_INFO("Camera soft trigger mode\n");
 
-    // set ROI back
-    status = SVBSetROIFormat(mCameraInfo.CameraID, x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH(), 1);
-    if (status != SVB_SUCCESS)
+    publishFlightRecorder();
+    mFlightRecorder.close();
+    LOG_INFO("Flight recorder stopped");
+    if (FlightRecorderSP.getState() == IPS_BUSY)
     {
-        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(status));
+        FlightRecorderSP.setState(IPS_OK);
+        FlightRecorderSP.apply();
     }
-    LOG_INFO("Subframe set\n");
+}
 
-    // start camera
-    status = SVBStartVideoCapture(mCameraInfo.CameraID);
-    if (status != SVB_SUCCESS)
+void SVBDevice::publishFlightRecorder()
+{
+    FlightRecorderInfoNP[FLIGHT_INFO_FRAMES].setValue(mFlightRecorder.frames());
+    FlightRecorderInfoNP[FLIGHT_INFO_SPAN].setValue(mFlightRecorder.span());
+    FlightRecorderInfoNP.setState(mFlightRecorder.isOpen() ? IPS_BUSY : IPS_OK);
+    FlightRecorderInfoNP.apply();
+    mFlightTimer.start();
+}
+
+void SVBDevice::transientFrame(const uint8_t *frame, SerWriter::Clock::time_point captured,
+                               const SerWriter::Format &format)
+{
+    if (TransientSP[TRANSIENT_ON].getState() != ISS_ON)
     {
-        LOGF_ERROR("Error, start camera failed (%s).", Helpers::toString(status));
+        if (mEventActive)
+            saveEvent(mEventLast, format);
+        // the ring is freed on a later frame when it still holds frames to write
+        if (mTransientRing.frameSize() > 0 && mTransientRing.pinned() == 0)
+        {
+            mTransientRing.reset(0, 1);
+            releaseMemory(mTransientGrant);
+        }
+        return;
+    }
+
+    // the ring holds the frames before and after an event, and the event itself
+    size_t frameSize = SerWriter::frameSize(format);
+    uint64_t pre = static_cast<uint64_t>(TransientNP[TRANSIENT_PRE].getValue());
+    uint64_t post = static_cast<uint64_t>(TransientNP[TRANSIENT_POST].getValue());
+    if (mTransientRing.frameSize() != frameSize)
+    {
+        // the detection restarts once the writer released the frames of the previous format
+        if (mTransientRing.pinned() != 0)
+            return;
+
+        // the memory budget may shorten the ring, down to the frames of one event
+        size_t minimum = (pre + post + 2) * frameSize;
+        size_t wanted = std::max(static_cast<size_t>(TransientNP[TRANSIENT_RING].getValue()) << 20, minimum);
+        mTransientRing.reset(0, 1);
+        if (!reserveMemory(mTransientGrant, wanted, minimum, "Transient ring"))
+        {
+            TransientSP[TRANSIENT_ON].setState(ISS_OFF);
+            TransientSP[TRANSIENT_OFF].setState(ISS_ON);
+            TransientSP.setState(IPS_ALERT);
+            TransientSP.apply();
+            return;
+        }
+        mTransientRing.reset(frameSize, mTransientGrant.bytes / frameSize);
+        mTransientDetector.reset();
+        mEventActive = false;
+        LOGF_INFO("Transient detection, %d frames ring", static_cast<int>(mTransientRing.capacity()));
+    }
+    uint64_t sequence = mTransientRing.add(frame, captured);
+    if (sequence == 0)
+    {
+        LOG_DEBUG("Transient ring full of frames to write, frame skipped");
+        return;
+    }
+
+    TransientDetector::Settings settings;
+    settings.kappa = TransientNP[TRANSIENT_KAPPA].getValue();
+    settings.minPixels = static_cast<uint32_t>(TransientNP[TRANSIENT_MIN_PIXELS].getValue());
+    settings.maxArea = TransientNP[TRANSIENT_MAX_AREA].getValue() / 100.0;
+    settings.backgroundShift = 4;
+    uint32_t channels = format.colorId == SerWriter::RGB ? 3 : 1;
+
+    if (mTransientDetector.process(frame, format.width, format.height, channels, format.bitDepth, settings))
+    {
+        const auto &detection = mTransientDetector.detection();
+        if (!mEventActive)
+        {
+            mEventActive = true;
+            mEventFirst = sequence;
+            mEventStart = std::max(mTransientRing.oldest(), sequence > pre ? sequence - pre : 1);
+            mEvent = detection;
+
+            char stamp[32];
+            time_t now = time(nullptr);
+            struct tm utc;
+            gmtime_r(&now, &utc);
+            strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+            mEventTime = stamp;
+        }
+        else
+        {
+            // the event keeps its first centroid, the box grows with the trail
+            mEvent.x0 = std::min(mEvent.x0, detection.x0);
+            mEvent.y0 = std::min(mEvent.y0, detection.y0);
+            mEvent.x1 = std::max(mEvent.x1, detection.x1);
+            mEvent.y1 = std::max(mEvent.y1, detection.y1);
+            mEvent.peak = std::max(mEvent.peak, detection.peak);
+            mEvent.tiles = std::max(mEvent.tiles, detection.tiles);
+        }
+        mEventLast = sequence;
     }
+
+    // the event ends after the frames following it, or when the ring is full
+    if (mEventActive && (sequence - mEventLast >= post || sequence - mEventStart + 1 >= mTransientRing.capacity()))
+        saveEvent(sequence, format);
 }
 
-void SVBDevice::workerExposure(const std::atomic_bool &isAboutToQuit, float duration)
-{   
+void SVBDevice::saveEvent(uint64_t last, const SerWriter::Format &format)
+{
+    mEventActive = false;
+    mEvents++;
+
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+    char index[16];
+    snprintf(index, sizeof(index), "_%03u.ser", mEvents);
+    std::string path = std::string(SerFileTP[SER_DIRECTORY].getText()) + "/" + SerFileTP[SER_PREFIX].getText() + "_event_" +
+                       stamp + index;
+
+    TransientEventNP[EVENT_COUNT].setValue(mEvents);
+    TransientEventNP[EVENT_FRAMES].setValue(mEventLast - mEventFirst + 1);
+    TransientEventNP[EVENT_X].setValue(mEvent.x);
+    TransientEventNP[EVENT_Y].setValue(mEvent.y);
+    TransientEventNP[EVENT_WIDTH].setValue(mEvent.x1 - mEvent.x0);
+    TransientEventNP[EVENT_HEIGHT].setValue(mEvent.y1 - mEvent.y0);
+    TransientEventNP[EVENT_PEAK].setValue(mEvent.peak);
+    TransientEventNP[EVENT_NOISE].setValue(mTransientDetector.noise());
+    TransientEventNP.setState(IPS_OK);
+    TransientEventNP.apply();
+    TransientEventTP[EVENT_TIME].setText(mEventTime.c_str());
+    TransientEventTP[EVENT_FILE].setText(path.c_str());
+    TransientEventTP.setState(IPS_OK);
+    TransientEventTP.apply();
+    LOGF_INFO("Transient event at %.0f, %.0f, %u active frames, peak %u", mEvent.x, mEvent.y,
+              static_cast<unsigned>(mEventLast - mEventFirst + 1), mEvent.peak);
+
+    // the frames are written from the ring, the stream goes on while they are
+    mEventWriter.write(path, format, std::max(mEventStart, mTransientRing.oldest()), last);
+}
 
-    if (exposureWorkaroundEnable && exposureWorkaroundDuration > 0)
-        workaroundExposure(0.5);
+// UTC microseconds of a time of the capture clock
+static uint64_t utcMicroseconds(SerWriter::Clock::time_point captured)
+{
+    auto utc = std::chrono::system_clock::now() -
+               std::chrono::duration_cast<std::chrono::system_clock::duration>(SerWriter::Clock::now() - captured);
+    return std::chrono::duration_cast<std::chrono::microseconds>(utc.time_since_epoch()).count();
+}
 
-    PrimaryCCD.setExposureDuration(duration);
+void SVBDevice::deltaFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format)
+{
+    if (DeltaStreamSP[DELTA_STREAM_ON].getState() != ISS_ON)
+        return;
 
-    LOGF_DEBUG("StartExposure->setexp : %.3fs", duration);
+    // deltas are taken from the last sent frame, skipped frames are not encoded
+    double maxRate = DeltaStreamNP[DELTA_STREAM_MAX_RATE].getValue();
+    if (maxRate > 0 && mDeltaTimer.elapsed() < 1000.0 / maxRate)
+        return;
+    mDeltaTimer.start();
+
+    auto now = SerWriter::Clock::now();
+    uint64_t timestamp = utcMicroseconds(captured);
+
+    mDeltaEncoder.setKeyInterval(static_cast<uint32_t>(DeltaStreamNP[DELTA_STREAM_KEY_INTERVAL].getValue()));
+    size_t size = mDeltaEncoder.encode(frame, format.width, format.height, format.colorId, format.bitDepth, timestamp);
+    mDeltaEncodeTime += std::chrono::duration<double, std::milli>(SerWriter::Clock::now() - now).count();
+    mDeltaBytes += size;
+    mDeltaRawBytes += SerWriter::frameSize(format);
+    mDeltaFrames++;
+
+    DeltaStreamBP[0].setBlob(const_cast<uint8_t *>(mDeltaEncoder.data()));
+    DeltaStreamBP[0].setBlobLen(size);
+    DeltaStreamBP[0].setSize(size);
+    DeltaStreamBP[0].setFormat(".svbd");
+    DeltaStreamBP.setState(IPS_OK);
+    DeltaStreamBP.apply();
+
+    // statistics every second
+    double elapsed = mDeltaStatsTimer.elapsed();
+    if (elapsed >= 1000)
+    {
+        DeltaStreamInfoNP[DELTA_STREAM_RATIO].setValue(static_cast<double>(mDeltaRawBytes) / mDeltaBytes);
+        DeltaStreamInfoNP[DELTA_STREAM_BANDWIDTH].setValue(mDeltaBytes * 8 / (elapsed * 1000));
+        DeltaStreamInfoNP[DELTA_STREAM_ENCODE].setValue(mDeltaEncodeTime / mDeltaFrames);
+        DeltaStreamInfoNP.setState(IPS_OK);
+        DeltaStreamInfoNP.apply();
+        mDeltaStatsTimer.start();
+        mDeltaBytes = mDeltaRawBytes = 0;
+        mDeltaFrames = 0;
+        mDeltaEncodeTime = 0;
+    }
+}
+
+bool SVBDevice::startSharedRing()
+{
+    std::unique_lock<std::mutex> guard(mSharedRingLock);
+    if (SharedRingSP[SHARED_RING_ON].getState() != ISS_ON)
+    {
+        if (mSharedRing.isOpen())
+            LOGF_INFO("Shared memory ring %s closed", mSharedRing.name().c_str());
+        mSharedRing.close();
+        releaseMemory(mSharedRingGrant);
+        SharedRingTP[SHARED_RING_NAME].setText("");
+        SharedRingTP.setState(IPS_IDLE);
+        SharedRingTP.apply();
+        return true;
+    }
+
+    // the object is named after the device, slots fit a full 16 bits frame
+    std::string name = std::string("/indi_svb_") + getDeviceName();
+    for (size_t i = 1; i < name.size(); i++)
+        if (!isalnum(static_cast<unsigned char>(name[i])))
+            name[i] = '_';
+    uint32_t slots = static_cast<uint32_t>(SharedRingNP[SHARED_RING_SLOTS].getValue());
+    size_t frameSize = size_t(cameraProperty.MaxWidth) * cameraProperty.MaxHeight * 2;
+
+    // the memory budget may take slots away, down to two
+    mSharedRing.close();
+    bool granted = reserveMemory(mSharedRingGrant, slots * frameSize, std::min<uint32_t>(slots, 2) * frameSize,
+                                 "Shared memory ring");
+    if (granted)
+        slots = static_cast<uint32_t>(mSharedRingGrant.bytes / frameSize);
+    if (!granted || !mSharedRing.open(name, slots, frameSize))
+    {
+        if (granted)
+            LOGF_ERROR("Failed to create the shared memory ring %s (%s)", name.c_str(), strerror(errno));
+        releaseMemory(mSharedRingGrant);
+        SharedRingTP[SHARED_RING_NAME].setText("");
+        SharedRingTP.setState(IPS_ALERT);
+        SharedRingTP.apply();
+        return false;
+    }
+
+    LOGF_INFO("Shared memory ring %s, %d frames", name.c_str(), static_cast<int>(slots));
+    SharedRingTP[SHARED_RING_NAME].setText(name.c_str());
+    SharedRingTP.setState(IPS_OK);
+    SharedRingTP.apply();
+    return true;
+}
 
-    auto ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, duration * 1000 * 1000, SVB_FALSE);
-    if (ret != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
-        PrimaryCCD.setExposureFailed();
+void SVBDevice::sharedFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format)
+{
+    std::unique_lock<std::mutex> guard(mSharedRingLock);
+    if (!mSharedRing.isOpen())
         return;
-    }
 
-    if (duration > VERBOSE_EXPOSURE)
-        LOGF_INFO("Taking a %g seconds frame...", duration);
+    if (!mSharedRing.add(frame, SerWriter::frameSize(format), format.width, format.height, format.bitDepth, format.colorId,
+                         utcMicroseconds(captured)))
+        LOG_WARN("Frame larger than the shared memory slots\n");
+}
 
-        /*
-    ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_BLACK_LEVEL, 30, SVB_FALSE);
-    if (ret != SVB_SUCCESS)
+bool SVBDevice::startAsyncSave()
+{
+    std::unique_lock<std::mutex> guard(mAsyncSaveLock);
+    mAsyncWriter.stop();
+    if (AsyncSaveSP[ASYNC_SAVE_ON].getState() != ISS_ON)
     {
-        LOGF_ERROR("Failed to set offset (%s).", Helpers::toString(ret));
-        PrimaryCCD.setExposureFailed();
-        return;
-    }*/
+        publishAsyncSave();
+        return true;
+    }
 
-    ret = SVBSendSoftTrigger(mCameraInfo.CameraID);
-    if (ret != SVB_SUCCESS)
+    // a few exposures may wait behind the files in flight
+    size_t depth = static_cast<size_t>(AsyncSaveNP[ASYNC_SAVE_DEPTH].getValue());
+    mAsyncWriter.setCompletion([this](const std::string & path, int error)
     {
-        LOGF_ERROR("Failed to send soft trigger (%s).", Helpers::toString(ret));
-        PrimaryCCD.setExposureFailed();
-        return;
+        if (error != 0)
+            LOGF_ERROR("Failed to save %s (%s)", path.c_str(), strerror(error));
+        else
+            LOGF_DEBUG("Saved %s", path.c_str());
+        publishAsyncSave();
+    });
+    if (!mAsyncWriter.start(depth, depth * 2))
+    {
+        LOGF_ERROR("Failed to start the async writer (%s)", strerror(errno));
+        return false;
     }
+    LOGF_INFO("Async local save with %s, %d files in flight, it replaces the local save of the upload mode",
+              AsyncWriter::toString(mAsyncWriter.backend()), static_cast<int>(depth));
+    publishAsyncSave();
+    return true;
+}
 
-    SVB_ERROR_CODE status;
-    uint8_t *imageBuffer = nullptr;
+bool SVBDevice::encodeExposure(bool compressed, void *&memptr, size_t &memsize)
+{
+    long naxes[3] = { PrimaryCCD.getSubW() / PrimaryCCD.getBinX(), PrimaryCCD.getSubH() / PrimaryCCD.getBinY(), 3 };
+    int naxis = PrimaryCCD.getNAxis();
+    long long pixels = static_cast<long long>(naxes[0]) * naxes[1] * (naxis == 3 ? 3 : 1);
+    int bpp = PrimaryCCD.getBPP();
+
+    INDI::ElapsedTimer timer;
+    memsize = 2880;
+    memptr = malloc(memsize);
+    if (memptr == nullptr)
+    {
+        LOG_ERROR("Failed to allocate the FITS buffer");
+        return false;
+    }
 
-    usleep(duration * 1000 * 1000);
-    do
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    fits_create_memfile(&fptr, &memptr, &memsize, 2880, realloc, &status);
+    if (!compressed)
+        fits_create_img(fptr, bpp == 16 ? USHORT_IMG : BYTE_IMG, naxis, naxes, &status);
+    else
+        fits_create_img(fptr, BYTE_IMG, 0, nullptr, &status);
+    if (status == 0)
     {
-        if (isAboutToQuit)
-            return;
-        imageBuffer = PrimaryCCD.getFrameBuffer();
+        // the buffer lock keeps the chip FITS pointer and the frame to this encoder
         std::unique_lock<std::mutex> guard(ccdBufferLock);
-        status = SVBGetVideoData(mCameraInfo.CameraID, imageBuffer, PrimaryCCD.getFrameBufferSize(), 100);
-        guard.unlock();
 
-        if (ret != SVB_SUCCESS && ret != SVB_ERROR_TIMEOUT)
+        // tile compressed image, a Rice tile per row (planes of a RGB frame are rows too)
+        if (compressed)
         {
-            LOGF_ERROR("Exposure failed, status %d (%s).", ret, Helpers::toString(ret));
-            PrimaryCCD.setExposureFailed();
-            return;
+            uint32_t rows = naxes[1] * (naxis == 3 ? 3 : 1);
+            mTileCompressor.compress(PrimaryCCD.getFrameBuffer(), naxes[0], rows, bpp);
+
+            char column[] = "COMPRESSED_DATA", format[] = "1PB";
+            char *columns[] = { column }, *formats[] = { format };
+            fits_create_tbl(fptr, BINARY_TBL, rows, 1, columns, formats, nullptr, "COMPRESSED_IMAGE", &status);
+
+            int zimage = 1;
+            long tile = 1;
+            fits_update_key(fptr, TLOGICAL, "ZIMAGE", &zimage, "extension contains compressed image", &status);
+            fits_update_key_lng(fptr, "ZBITPIX", bpp, "data type of original image", &status);
+            fits_update_key_lng(fptr, "ZNAXIS", naxis, "dimension of original image", &status);
+            fits_update_key_lng(fptr, "ZNAXIS1", naxes[0], "length of original image axis", &status);
+            fits_update_key_lng(fptr, "ZNAXIS2", naxes[1], "length of original image axis", &status);
+            if (naxis == 3)
+                fits_update_key_lng(fptr, "ZNAXIS3", naxes[2], "length of original image axis", &status);
+            fits_update_key_lng(fptr, "ZTILE1", naxes[0], "size of tiles to be compressed", &status);
+            fits_update_key_lng(fptr, "ZTILE2", tile, "size of tiles to be compressed", &status);
+            if (naxis == 3)
+                fits_update_key_lng(fptr, "ZTILE3", tile, "size of tiles to be compressed", &status);
+            fits_update_key_str(fptr, "ZCMPTYPE", "RICE_1", "compression algorithm", &status);
+            fits_update_key_str(fptr, "ZNAME1", "BLOCKSIZE", "compression block size", &status);
+            fits_update_key_lng(fptr, "ZVAL1", Rice::blockSize, "pixels per block", &status);
+            fits_update_key_str(fptr, "ZNAME2", "BYTEPIX", "bytes per pixel (1, 2, 4, or 8)", &status);
+            fits_update_key_lng(fptr, "ZVAL2", bpp / 8, "bytes per pixel (1, 2, 4, or 8)", &status);
+            if (bpp == 16)
+            {
+                fits_update_key_dbl(fptr, "BZERO", 32768, -1, "offset data range to that of unsigned short", &status);
+                fits_update_key_dbl(fptr, "BSCALE", 1, -1, "default scaling factor", &status);
+            }
         }
-    } while (status != SVB_SUCCESS);
 
-    PrimaryCCD.setExposureLeft(0.0);
-    LOG_INFO("Exposure done, downloading image...");
+#if INDI_VERSION_MAJOR >= 1 && INDI_VERSION_MINOR >= 9 && INDI_VERSION_RELEASE >= 7
+        fitsfile **chipFits = PrimaryCCD.fitsFilePointer();
+        fitsfile *previous = *chipFits;
+        *chipFits = fptr;
+        addFITSKeywords(&PrimaryCCD);
+        *chipFits = previous;
+#else
+        addFITSKeywords(fptr, &PrimaryCCD);
+#endif
+        if (!compressed)
+            fits_write_img(fptr, bpp == 16 ? TUSHORT : TBYTE, 1, pixels, PrimaryCCD.getFrameBuffer(), &status);
+        else
+            for (size_t row = 0; row < mTileCompressor.tiles() && status == 0; row++)
+                fits_write_col(fptr, TBYTE, 1, row + 1, 1, mTileCompressor.tileSize(row),
+                               const_cast<uint8_t *>(mTileCompressor.tile(row)), &status);
+    }
+    if (fptr != nullptr)
+        fits_close_file(fptr, &status);
+    if (status != 0)
+    {
+        char error[FLEN_STATUS];
+        fits_get_errstatus(status, error);
+        LOGF_ERROR("Failed to encode the FITS file (%s)", error);
+        free(memptr);
+        memptr = nullptr;
+        return false;
+    }
 
-    // stretching 12bits depth to 16bits depth
-    if (bitDepth == 16 && (bitStretch != 0))
+    if (compressed)
     {
-        u_int16_t *tmp = (u_int16_t *)imageBuffer;
-        for (int i = 0; i < PrimaryCCD.getFrameBufferSize() / 2; i++)
-        {
-            tmp[i] <<= bitStretch;
-        }
+        double raw = static_cast<double>(pixels) * (bpp / 8);
+        CompressionInfoNP[COMPRESSION_RATIO].setValue(raw / memsize);
+        CompressionInfoNP[COMPRESSION_TIME].setValue(timer.elapsed());
+        CompressionInfoNP[COMPRESSION_SIZE].setValue(memsize / 1048576.0);
+        CompressionInfoNP.setState(IPS_OK);
+        CompressionInfoNP.apply();
     }
+    return true;
+}
+
+void SVBDevice::sendCompressed(void *memptr, size_t memsize)
+{
+    // the image property of the primary chip, clients read fpack files as FITS
+    INDI::PropertyBlob imageBP = getProperty("CCD1");
+    imageBP[0].setBlob(memptr);
+    imageBP[0].setBlobLen(memsize);
+    imageBP[0].setSize(memsize);
+    imageBP[0].setFormat(".fits.fz");
+    imageBP.setState(IPS_OK);
+    imageBP.apply();
+}
 
-    // binning if needed
-    if (isBinningActive())
-        PrimaryCCD.binFrame();
+void SVBDevice::completeExposure(bool sent, bool saved)
+{
+    // INDI uploads and saves what the driver did not, a frame of no bytes is neither uploaded nor saved
+    int mode = UploadSP.findOnSwitchIndex();
+    bool send = (mode == UPLOAD_CLIENT || mode == UPLOAD_BOTH) && !sent;
+    bool save = (mode == UPLOAD_LOCAL || mode == UPLOAD_BOTH) && !saved;
+    uint32_t size = PrimaryCCD.getFrameBufferSize();
+    UploadSP.reset();
+    if (send || save)
+        UploadSP[send && save ? UPLOAD_BOTH : send ? UPLOAD_CLIENT : UPLOAD_LOCAL].setState(ISS_ON);
+    else
+        PrimaryCCD.setFrameBufferSize(0, false);
 
-    // exposure done
     ExposureComplete(&PrimaryCCD);
 
-    long currentValue;
-    SVB_BOOL bauto;
-    status = SVBGetControlValue(mCameraInfo.CameraID, SVB_BLACK_LEVEL, &currentValue, &bauto);
-    if (status != SVB_SUCCESS)
+    UploadSP.reset();
+    UploadSP[mode].setState(ISS_ON);
+    PrimaryCCD.setFrameBufferSize(size, false);
+}
+
+bool SVBDevice::saveExposure(void *memptr, size_t memsize)
+{
+    std::unique_lock<std::mutex> saveGuard(mAsyncSaveLock);
+    if (!mAsyncWriter.isRunning())
     {
-        LOGF_ERROR("Error, camera get %s failed (%s).", Helpers::toString(SVB_BLACK_LEVEL), Helpers::toString(status));
+        free(memptr);
+        return false;
     }
 
-    LOGF_INFO("Current offset: %d", currentValue);
-
-    inExposure = false;
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+    char index[16];
+    snprintf(index, sizeof(index), "_%03u.fits", mAsyncSaveIndex++);
+    std::string path = std::string(AsyncSaveFileTP[ASYNC_SAVE_DIRECTORY].getText()) + "/" +
+                       AsyncSaveFileTP[ASYNC_SAVE_PREFIX].getText() + "_" + stamp + index;
+
+    bool queued = mAsyncWriter.write(path, static_cast<uint8_t *>(memptr), memsize);
+    if (!queued)
+        LOGF_ERROR("Failed to queue %s (%s)", path.c_str(), strerror(errno));
+    else
+        LOGF_INFO("Saving %s", path.c_str());
+    publishAsyncSave();
+    return queued;
 }
 
-void SVBDevice::workaroundExposure(float duration)
+void SVBDevice::publishAsyncSave()
 {
-    long uSecs = static_cast<long>(duration * 1000 * 1000);
-    int waitMS = static_cast<int>((duration * 2000.0) + 500);
+    auto stats = mAsyncWriter.stats();
+    AsyncSaveInfoNP[ASYNC_SAVE_QUEUED].setValue(stats.queued);
+    AsyncSaveInfoNP[ASYNC_SAVE_IN_FLIGHT].setValue(stats.inFlight);
+    AsyncSaveInfoNP[ASYNC_SAVE_WRITTEN].setValue(stats.written);
+    AsyncSaveInfoNP[ASYNC_SAVE_FAILED].setValue(stats.failed);
+    AsyncSaveInfoNP[ASYNC_SAVE_RATE].setValue(stats.throughput);
+    AsyncSaveInfoNP.setState(stats.queued + stats.inFlight > 0 ? IPS_BUSY : stats.failed > 0 ? IPS_ALERT : IPS_OK);
+    AsyncSaveInfoNP.apply();
+}
 
-    // stop camera
-    auto ret = SVBStopVideoCapture(mCameraInfo.CameraID);
+bool SVBDevice::streamPlanarRGB(const uint8_t *frame)
+{
+    size_t pixels = size_t(PrimaryCCD.getSubW() / PrimaryCCD.getBinX()) * (PrimaryCCD.getSubH() / PrimaryCCD.getBinY());
+    if (!resizeBuffer(mRgbBuffer, pixels * 3 * (bitDepth / 8), "RGB buffer"))
+        return false;
 
-    if (ret != SVB_SUCCESS)
+    if (bitDepth == 8)
     {
-        LOGF_ERROR("Error, stop camera failed  (%s).", Helpers::toString(ret));
+        uint8_t *rgb = mRgbBuffer.data();
+        for (size_t i = 0; i < pixels; i++)
+            for (int c = 0; c < 3; c++)
+                rgb[i * 3 + c] = frame[c * pixels + i];
     }
-
-    ret = SVBSetControlValue(mCameraInfo.CameraID, SVB_EXPOSURE, uSecs, SVB_FALSE);
-    if (ret != SVB_SUCCESS)
+    else
     {
-        LOGF_ERROR("Failed to set exposure duration (%s).", Helpers::toString(ret));
+        const uint16_t *planes = reinterpret_cast<const uint16_t *>(frame);
+        uint16_t *rgb = reinterpret_cast<uint16_t *>(mRgbBuffer.data());
+        for (size_t i = 0; i < pixels; i++)
+            for (int c = 0; c < 3; c++)
+                rgb[i * 3 + c] = planes[c * pixels + i];
     }
 
-    // set camera normal mode
-    ret = SVBSetCameraMode(mCameraInfo.CameraID, SVB_MODE_NORMAL);
-    if (ret != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, camera normal mode failed (%s).", Helpers::toString(ret));
-    }
-    LOG_INFO("Camera normal mode\n");
+    Streamer->newFrame(mRgbBuffer.data(), mRgbBuffer.size());
+    return true;
+}
 
-    // set ROI back
-    ret = SVBSetROIFormat(mCameraInfo.CameraID, x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH(), 1);
-    if (ret != SVB_SUCCESS)
+bool SVBDevice::stackFrame(const uint8_t *frame, uint32_t pixels, bool &snapshot)
+{
+    if (mStackResetRequest.exchange(false))
     {
-        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(ret));
+        mStacker.reset();
+        mStackPublishedFrames = 0;
+        mStackTimer.start();
     }
-    LOG_INFO("Subframe set\n");
 
-    ret = SVBStartVideoCapture(mCameraInfo.CameraID);
-    if (ret != SVB_SUCCESS)
+    // the stack and its rendering are granted with the geometry, a denied stack stops the stacking
+    size_t stackBytes = LiveStacker::memorySize(pixels) + pixels * (bitDepth / 8);
+    if (mStackGrant.bytes != stackBytes && !reserveMemory(mStackGrant, stackBytes, stackBytes, "Live stack"))
     {
-        LOGF_ERROR("Failed to start video capture (%s).", Helpers::toString(ret));
+        mStacker.reset();
+        mStackBuffer.clear();
+        mStackBuffer.shrink_to_fit();
+        LiveStackSP[LIVE_STACK_ON].setState(ISS_OFF);
+        LiveStackSP[LIVE_STACK_OFF].setState(ISS_ON);
+        LiveStackSP.setState(IPS_ALERT);
+        LiveStackSP.apply();
+        return false;
     }
 
-    // set ROI back
-    ret = SVBSetROIFormat(mCameraInfo.CameraID, x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH(), 1);
-    if (ret != SVB_SUCCESS)
+    mStacker.setKappa(LiveStackNP[LIVE_STACK_KAPPA].getValue());
+    bool full = mStacker.isFull();
+    mStacker.add(frame, pixels, bitDepth);
+    int bin = PrimaryCCD.getBinX();
+    mStackGeometry = StackGeometry {PrimaryCCD.getSubX(), PrimaryCCD.getSubY(), PrimaryCCD.getSubW(), PrimaryCCD.getSubH(), bin,
+                                    static_cast<int>(pixels / (size_t(PrimaryCCD.getSubW() / bin) * (PrimaryCCD.getSubH() / bin)))};
+    if (!full && mStacker.isFull())
     {
-        LOGF_ERROR("Error, camera set subframe failed (%s).", Helpers::toString(ret));
+        LOGF_WARN("Live stack full at %d frames, new frames are dropped until it is reset",
+                  static_cast<int>(LiveStacker::maxFrames));
+        LiveStackInfoNP.setState(IPS_ALERT);
+        LiveStackInfoNP.apply();
     }
-    LOG_INFO("Subframe set\n");
 
-    ret = SVBStartVideoCapture(mCameraInfo.CameraID);
-    if (ret != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Failed to start video capture (%s).", Helpers::toString(ret));
-    }
+    // the stack restarted on a geometry change
+    if (mStacker.frames() < mStackPublishedFrames)
+        mStackPublishedFrames = 0;
 
-    LOG_INFO("Workaround exposure in progress...");
+    snapshot = mStackSnapshotRequest.exchange(false);
+    double interval = LiveStackNP[LIVE_STACK_INTERVAL].getValue();
+    bool publish = snapshot ||
+                   mStacker.frames() - mStackPublishedFrames >= LiveStackNP[LIVE_STACK_FRAMES].getValue() ||
+                   (interval > 0 && mStackTimer.elapsed() >= interval * 1000);
+    if (!publish)
+        return false;
 
-    usleep(uSecs);
-    do
-    {
-        std::unique_lock<std::mutex> guard(ccdBufferLock);
-        ret = SVBGetVideoData(mCameraInfo.CameraID, nullptr, PrimaryCCD.getFrameBufferSize(), waitMS);
-        guard.unlock();
+    mStackPublishedFrames = mStacker.frames();
+    mStackTimer.start();
 
-        if (ret != SVB_SUCCESS && ret != SVB_ERROR_TIMEOUT)
-        {
-            LOGF_ERROR("Workaround Exposure failed, status %d (%s).", ret, Helpers::toString(ret));
-            PrimaryCCD.setExposureFailed();
-            return;
-        }
+    mStackBuffer.resize(pixels * bitDepth / 8);
+    mStacker.render(mStackBuffer.data());
 
-        usleep(100);
-    } while (ret != SVB_SUCCESS);
+    LiveStackInfoNP[LIVE_STACK_STACKED].setValue(mStacker.frames());
+    LiveStackInfoNP[LIVE_STACK_REJECTED].setValue(100.0 * mStacker.rejected() / (double(pixels) * mStacker.frames()));
+    LiveStackInfoNP.setState(mStacker.isFull() ? IPS_ALERT : IPS_OK);
+    LiveStackInfoNP.apply();
 
-    resetCaptureModeAndRoi(SVB_MODE_TRIG_SOFT);
+    return true;
 }
 
-void SVBDevice::workerTimerExposure(const std::atomic_bool &isAboutToQuit, float duration)
+Calibration::MasterKey SVBDevice::calibrationKey(uint32_t type, double exposure)
 {
-    INDI::ElapsedTimer exposureTimer;
+    Calibration::MasterKey key;
+    key.type = type;
+    key.width = PrimaryCCD.getSubW();
+    key.height = PrimaryCCD.getSubH();
+    key.x = x_offset;
+    key.y = y_offset;
+    // frames are binned by the driver after calibration
+    key.bin = 1;
+    key.bitDepth = bitDepth;
+    key.stretch = (bitDepth == 16) ? bitStretch : 0;
+    key.gain = static_cast<int32_t>(ControlsN[CCD_GAIN_N].value);
+    key.offset = static_cast<int32_t>(ControlsN[CCD_DOFFSET_N].value);
+    key.exposure = exposure;
+    // sensor temperature is only polled for cooled cameras
+    key.temperature = HasCooler() ? mCurrentTemperature : NAN;
+    return key;
+}
 
-    do
+std::string SVBDevice::calibrateFrame(uint8_t *frame, double exposure)
+{
+    std::unique_lock<std::mutex> guard(mCalibrationLock);
+
+    if (DarkSubtractSP[DARK_SUBTRACT_ON].getState() != ISS_ON)
+        return std::string();
+
+    // select a master when the capture settings change
+    Calibration::MasterKey key = calibrationKey(Calibration::MASTER_DARK, exposure);
+    if (!mDarkSelected || !Calibration::sameSettings(key, mDarkKey))
     {
-        float delay = 0.1;
-        float timeLeft = std::max(duration - exposureTimer.elapsed() / 1000.0, 0.0);
+        mDarkMaster = mCalibrationLibrary.find(key, CalibrationToleranceNP[TOLERANCE_EXPOSURE].getValue() / 100.0,
+                                               CalibrationToleranceNP[TOLERANCE_TEMPERATURE].getValue());
+        mDarkKey = key;
+        mDarkSelected = true;
+
+        if (mDarkMaster)
+            LOGF_INFO("Dark master %s selected", mDarkMaster->path().c_str());
+        else
+            LOG_WARN("No dark or bias master matches the capture settings");
+
+        CalibrationMasterTP[MASTER_IN_USE_DARK].setText(mDarkMaster ? mDarkMaster->path().c_str() : "None");
+        CalibrationMasterTP.setState(mDarkMaster ? IPS_OK : IPS_ALERT);
+        CalibrationMasterTP.apply();
+    }
 
-        /*
-         * Check the status every second until the time left is
-         * about one second, after which decrease the poll interval
-         *
-         * For expsoures with more than a second left try
-         * to keep the displayed "exposure left" value at
-         * a full second boundary, which keeps the
-         * count down neat
-         */
-        if (timeLeft > 1.1)
-        {
-            delay = std::max(timeLeft - std::trunc(timeLeft), 0.005f);
-            timeLeft = std::round(timeLeft);
-        }
+    if (!mDarkMaster)
+        return std::string();
 
-        if (timeLeft > 0)
+    Calibration::subtract(frame, *mDarkMaster, x_offset, y_offset, PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+    return mDarkMaster->path();
+}
+
+std::string SVBDevice::flatFieldFrame(uint8_t *frame)
+{
+    std::unique_lock<std::mutex> guard(mCalibrationLock);
+
+    if (FlatFieldSP[FLAT_FIELD_ON].getState() != ISS_ON)
+        return std::string();
+
+    // the reciprocal is computed once per flat, any subframe it covers is sliced out of it
+    Calibration::MasterKey key = calibrationKey(Calibration::MASTER_FLAT, 0);
+    bool sameSubframe = key.x == mFlatKey.x && key.y == mFlatKey.y && key.width == mFlatKey.width &&
+                        key.height == mFlatKey.height;
+    if (!mFlatSelected || !sameSubframe)
+    {
+        std::shared_ptr<Calibration::MasterFrame> master = mCalibrationLibrary.findFlat(key);
+        if (master == nullptr || master->path() != mFlatField.path())
         {
-            PrimaryCCD.setExposureLeft(timeLeft);
+            mFlatField.clear();
+            if (master != nullptr && mFlatField.load(*master, HasBayer()))
+                LOGF_INFO("Flat master %s selected", master->path().c_str());
+            else
+                LOG_WARN("No flat master covers the subframe");
         }
+        mFlatKey = key;
+        mFlatSelected = true;
 
-        usleep(delay * 1000 * 1000);
+        CalibrationMasterTP[MASTER_IN_USE_FLAT].setText(mFlatField.isLoaded() ? mFlatField.path().c_str() : "None");
+        CalibrationMasterTP.setState(mFlatField.isLoaded() ? IPS_OK : IPS_ALERT);
+        CalibrationMasterTP.apply();
+    }
 
-        if (isAboutToQuit)
-            return;
+    if (!mFlatField.covers(key.x, key.y, key.width, key.height))
+        return std::string();
 
-    } while (inExposure);
+    mFlatField.apply(frame, bitDepth, key.x, key.y, key.width, key.height);
+    return mFlatField.path();
 }
 
-bool SVBDevice::StartExposure(float duration)
+std::string SVBDevice::hotPixelsPath() const
 {
-    float c_exp = duration;
-    // checks for time limits
-    if (c_exp < minExposure)
+    return mCalibrationLibrary.directory() + "/hotpixels.svbh";
+}
+
+bool SVBDevice::saveHotPixels()
+{
+    std::string path = hotPixelsPath();
+    if (!Calibration::makeDirectory(mCalibrationLibrary.directory()) || !mHotPixels.save(path))
     {
-        LOGF_WARN("Exposure shorter than minimum duration %g s requested. \n Setting exposure time to %g s.\n", duration,
-                  minExposure);
-        c_exp = minExposure;
+        LOGF_ERROR("Error, unable to write %s (%s)", path.c_str(), strerror(errno));
+        return false;
     }
+    return true;
+}
 
-    if (c_exp > maxExposure)
+void SVBDevice::loadHotPixels()
+{
+    mHotPixels.clear();
+    if (mHotPixels.load(hotPixelsPath()))
+        LOGF_INFO("%d hot pixels in map", static_cast<int>(mHotPixels.size()));
+    HotPixelInfoNP[HOT_PIXELS_COUNT].setValue(mHotPixels.size());
+}
+
+size_t SVBDevice::hotPixelFrame(uint8_t *frame, bool learn)
+{
+    std::unique_lock<std::mutex> guard(mCalibrationLock);
+
+    HotPixelMap::Subframe subframe {static_cast<uint32_t>(x_offset), static_cast<uint32_t>(y_offset),
+                                    static_cast<uint32_t>(PrimaryCCD.getSubW()), static_cast<uint32_t>(PrimaryCCD.getSubH()),
+                                    static_cast<uint32_t>(bitDepth)};
+
+    // learning sees the frames before correction
+    if (learn && mHotPixelLearner.isLearning() && mHotPixelLearner.add(mHotPixels, frame, subframe))
     {
-        LOGF_WARN("Exposure greater than minimum duration %g s requested. \n Setting exposure time to %g s.\n", duration,
-                  maxExposure);
-        c_exp = maxExposure;
+        std::vector<uint32_t> learned = mHotPixelLearner.result();
+        mHotPixelLearner.stop();
+        mHotPixels.merge(learned);
+        LOGF_INFO("%d hot pixels learned, %d in map", static_cast<int>(learned.size()), static_cast<int>(mHotPixels.size()));
+        saveHotPixels();
+
+        HotPixelControlSP.setState(IPS_OK);
+        HotPixelControlSP.apply();
     }
 
-    inExposure = true;
-    mWorker.start(std::bind(&SVBDevice::workerExposure, this, std::placeholders::_1, c_exp));
-    mExposureTimerWorker.start(std::bind(&SVBDevice::workerTimerExposure, this, std::placeholders::_1, c_exp));
+    size_t corrected = 0;
+    if (HotPixelSP[HOT_PIXELS_ON].getState() == ISS_ON)
+        corrected = mHotPixels.correct(frame, subframe);
 
-    return true;
+    // published when it changes, not for every streamed frame
+    if (HotPixelInfoNP[HOT_PIXELS_CORRECTED].getValue() != corrected ||
+        HotPixelInfoNP[HOT_PIXELS_COUNT].getValue() != mHotPixels.size())
+    {
+        HotPixelInfoNP[HOT_PIXELS_COUNT].setValue(mHotPixels.size());
+        HotPixelInfoNP[HOT_PIXELS_CORRECTED].setValue(corrected);
+        HotPixelInfoNP.apply();
+    }
+    return corrected;
 }
 
-bool SVBDevice::AbortExposure()
+bool SVBDevice::streamRGB(const uint8_t *frame, SVB_BAYER_PATTERN pattern, Debayer::Method method)
 {
-    LOG_INFO("Aborting exposure...");
-    mWorker.quit();
-    inExposure = false;
-    mExposureTimerWorker.quit();
-
-    LOG_INFO("Reset capture mode...");
-    resetCaptureModeAndRoi(SVB_MODE_TRIG_SOFT);
+    uint32_t width = PrimaryCCD.getSubW();
+    uint32_t height = PrimaryCCD.getSubH();
+    if (!resizeBuffer(mRgbBuffer, size_t(width) * height * 3 * (bitDepth / 8), "RGB buffer"))
+        return false;
 
+    mDebayer.process(frame, mRgbBuffer.data(), width, height, pattern, bitDepth, method);
+    Streamer->newFrame(mRgbBuffer.data(), mRgbBuffer.size());
     return true;
 }
 
-// subframing
-bool SVBDevice::UpdateCCDFrame(int x, int y, int w, int h)
+bool SVBDevice::uploadStack()
 {
-    if ((x + w) > cameraProperty.MaxWidth || (y + h) > cameraProperty.MaxHeight || w % 8 != 0 || h % 2 != 0)
+    // the stack has the streamed geometry, binning included, while the chip may be back to the exposure one
+    const StackGeometry &stack = mStackGeometry;
+    std::unique_lock<std::mutex> guard(ccdBufferLock);
+    if (PrimaryCCD.getFrameBuffer() != mFramePool.buffer(0) || mStackBuffer.size() > mFramePool.bufferSize())
     {
-        LOG_ERROR("Error : Subframe out of range");
+        LOG_ERROR("Error, the live stack does not fit the frame buffer");
         return false;
     }
+    memcpy(PrimaryCCD.getFrameBuffer(), mStackBuffer.data(), mStackBuffer.size());
+    // the stack replaced the last exposure
+    mLastExposureValid = false;
+
+    int x = PrimaryCCD.getSubX(), y = PrimaryCCD.getSubY(), width = PrimaryCCD.getSubW(), height = PrimaryCCD.getSubH();
+    int binX = PrimaryCCD.getBinX(), binY = PrimaryCCD.getBinY();
+    int bpp = PrimaryCCD.getBPP(), naxis = PrimaryCCD.getNAxis();
+    uint32_t size = PrimaryCCD.getFrameBufferSize();
+    PrimaryCCD.setFrame(stack.x, stack.y, stack.width, stack.height);
+    PrimaryCCD.setBin(stack.bin, stack.bin);
+    PrimaryCCD.setBPP(mStacker.bitDepth());
+    PrimaryCCD.setNAxis(stack.channels == 3 ? 3 : 2);
+    PrimaryCCD.setFrameBufferSize(mStackBuffer.size(), false);
+
+    LOGF_INFO("Uploading live stack of %d frames", static_cast<int>(mStacker.frames()));
+    ExposureComplete(&PrimaryCCD);
 
-    // stop framing
-    auto status = SVBStopVideoCapture(mCameraInfo.CameraID);
-    if (status != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, stop camera failed (%s)", Helpers::toString(status));
-        return false;
-    }
+    PrimaryCCD.setFrame(x, y, width, height);
+    PrimaryCCD.setBin(binX, binY);
+    PrimaryCCD.setBPP(bpp);
+    PrimaryCCD.setNAxis(naxis);
+    PrimaryCCD.setFrameBufferSize(size, false);
+    return true;
+}
 
-    // change ROI
-    status = SVBSetROIFormat(mCameraInfo.CameraID, x, y, w, h, 1);
-    if (status != SVB_SUCCESS)
-    {
-        LOGF_ERROR("Error, camera set subframe failed (%s)", Helpers::toString(status));
-        return false;
-    }
-    LOG_INFO("Subframe set\n");
+SVB_ERROR_CODE SVBDevice::getVideoData(uint8_t *imageBuffer, uint32_t bufferSize, int waitMS)
+{
+    if (!mPackedTransfer || !Unpack::isPacked(mCurrentVideoFormat))
+        return SVBGetVideoData(mCameraInfo.CameraID, imageBuffer, bufferSize, waitMS);
 
-    // start framing
-    status = SVBStartVideoCapture(mCameraInfo.CameraID);
-    if (status != SVB_SUCCESS)
+    // only the subframe is transferred
+    size_t pixels = size_t(mTransfer.width) * mTransfer.height;
+    mPackedBuffer.resize(Unpack::packedSize(mCurrentVideoFormat, pixels));
+
+    auto ret = SVBGetVideoData(mCameraInfo.CameraID, mPackedBuffer.data(), mPackedBuffer.size(), waitMS);
+    if (ret == SVB_ERROR_BUFFER_TOO_SMALL)
     {
-        LOGF_ERROR("Error, start camera failed (%s)", Helpers::toString(status));
-        return false;
+        // SDK does not pack this format, read 16 bits containers until the format changes
+        LOGF_WARN("%s is not packed by the SDK, reading 16 bits frames.", Helpers::toPrettyString(mCurrentVideoFormat));
+        mPackedTransfer = false;
+        return SVBGetVideoData(mCameraInfo.CameraID, imageBuffer, bufferSize, waitMS);
     }
 
-    x_offset = x;
-    y_offset = y;
+    if (ret == SVB_SUCCESS)
+        Unpack::unpack(mCurrentVideoFormat, mPackedBuffer.data(), reinterpret_cast<uint16_t *>(imageBuffer), pixels);
 
-    return INDI::CCD::UpdateCCDFrame(x, y, w, h);
+    return ret;
 }
 
-bool SVBDevice::UpdateCCDBin(int hor, int ver)
+void SVBDevice::tuneThreads()
 {
-    INDI_UNUSED(ver);
-    PrimaryCCD.setBin(hor, hor);
+    {
+        std::unique_lock<std::mutex> guard(mThreadLock);
+        mThreadSettings.cpus = ThreadAffinityTP[THREAD_AFFINITY_CPUS].getText();
+        mThreadSettings.policy = static_cast<ThreadTuning::Policy>(ThreadSchedulingSP.findOnSwitchIndex());
+        mThreadSettings.nice = static_cast<int>(ThreadPriorityNP[THREAD_PRIORITY_NICE].getValue());
+        mThreadSettings.priority = static_cast<int>(ThreadPriorityNP[THREAD_PRIORITY_FIFO].getValue());
+        mThreadGeneration++;
+    }
 
-    return UpdateCCDFrame(PrimaryCCD.getSubX(), PrimaryCCD.getSubY(), PrimaryCCD.getSubW(), PrimaryCCD.getSubH());
+    // the pools keep their thread, a short job tunes it while idle
+    if (!isCapturing())
+    {
+        mWorker.start([this](const std::atomic_bool &) { tuneThread(THREAD_CAPTURE); });
+        mExposureTimerWorker.start([this](const std::atomic_bool &) { tuneThread(THREAD_TIMER); });
+    }
 }
 
-bool SVBDevice::isBinningActive()
+void SVBDevice::tuneThread(int thread)
 {
-    return PrimaryCCD.getBinX() > 1;
+    std::unique_lock<std::mutex> guard(mThreadLock);
+    if (mThreadApplied[thread] == mThreadGeneration)
+        return;
+    mThreadApplied[thread] = mThreadGeneration;
+    ThreadTuning::Settings settings = mThreadSettings;
+    guard.unlock();
+
+    // named after the camera so that top -H and perf tell the cameras apart
+    char name[16];
+    snprintf(name, sizeof(name), "svb%d %s", mCameraInfo.CameraID, thread == THREAD_CAPTURE ? "capture" : "timer");
+    ThreadTuning::setName(name);
+
+    std::string error;
+    bool applied = ThreadTuning::apply(settings, error);
+    std::string info = ThreadTuning::describe();
+    if (!applied)
+    {
+        LOGF_WARN("Thread %s tuning refused (%s), it needs CAP_SYS_NICE or the rtprio and nice limits", name,
+                  error.c_str());
+        info += " (" + error + ")";
+    }
+
+    guard.lock();
+    mThreadRefused[thread] = !applied;
+    ThreadInfoTP[thread].setText(info.c_str());
+    ThreadInfoTP.setState(mThreadRefused[THREAD_CAPTURE] || mThreadRefused[THREAD_TIMER] ? IPS_ALERT : IPS_OK);
+    ThreadInfoTP.apply();
 }
@@ -33,6 +33,29 @@
 
 #include "libsv305/SVBCameraSDK.h"
 #include "svb_temperature.h"
+#include "svb_stacker.h"
+#include "svb_calibration.h"
+#include "svb_hotpixels.h"
+#include "svb_debayer.h"
+#include "svb_binning.h"
+#include "svb_stats.h"
+#include "svb_autoexposure.h"
+#include "svb_stars.h"
+#include "svb_focus.h"
+#include "svb_guider.h"
+#include "svb_ser.h"
+#include "svb_writer.h"
+#include "svb_flightrecorder.h"
+#include "svb_transient.h"
+#include "svb_rice.h"
+#include "svb_delta.h"
+#include "svb_sharedring.h"
+#include "svb_threads.h"
+
+#include <indielapsedtimer.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 class SingleWorker;
 class SVBDevice: public SVBTemperature
@@ -45,6 +68,24 @@ class SVBDevice: public SVBTemperature
         virtual bool StartExposure(float duration) override;
         virtual bool AbortExposure() override;
 
+        virtual bool updateProperties() override;
+
+        /** Create number and switch controls for camera by querying the API */
+        bool createControls(int piNumberOfControls) override;
+
+        virtual bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
+        virtual bool ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n) override;
+        virtual bool ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n) override;
+
+        // Save config
+        virtual bool saveConfigItems(FILE *fp) override;
+
+        #if INDI_VERSION_MAJOR >= 1 && INDI_VERSION_MINOR >= 9 && INDI_VERSION_RELEASE >=7
+            virtual void addFITSKeywords(INDI::CCDChip *targetChip) override;
+        #else
+            virtual void addFITSKeywords(fitsfile *fptr, INDI::CCDChip *targetChip) override;
+        #endif
+
     protected:
 
         // Streaming
@@ -71,7 +112,431 @@ class SVBDevice: public SVBTemperature
         /** Get is binning is active */
         bool isBinningActive();
 
+        /** Binning mode used for the current bin, mono for mono cameras and superpixel needs an even bin */
+        int binningMode();
+
+        /** Bin the frame buffer in the current mode, superpixel frames are RGB planes, false when the budget
+         *  denies the binning buffer */
+        bool binFrame();
+
+        /** Read a frame from the camera, packed RAW10/RAW12 transfers are unpacked to 16 bits */
+        SVB_ERROR_CODE getVideoData(uint8_t *imageBuffer, uint32_t bufferSize, int waitMS);
+
+        // packed transfer buffer
+        std::vector<uint8_t> mPackedBuffer;
+
+        // Live stacking of streamed frames
+        LiveStacker mStacker;
+        std::vector<uint8_t> mStackBuffer;
+        MemoryBudget::Grant mStackGrant;   // the stack and its rendering, with the geometry
+        // subframe, binning and channels of the stacked frames, the chip takes them to upload the stack
+        struct StackGeometry
+        {
+            int x, y, width, height;
+            int bin;
+            int channels;
+        };
+        StackGeometry mStackGeometry {};
+        INDI::ElapsedTimer mStackTimer;
+        size_t mStackPublishedFrames = 0;
+        std::atomic_bool mStackResetRequest {false};
+        std::atomic_bool mStackSnapshotRequest {false};
+
+        /** Add a streamed frame to the stack, true when the stack is rendered in mStackBuffer for publishing,
+         *  snapshot is set when the rendered stack has to be uploaded too */
+        bool stackFrame(const uint8_t *frame, uint32_t pixels, bool &snapshot);
+
+        /** Upload the rendered stack as a CCD image, in the geometry it was stacked with, false when it does not fit */
+        bool uploadStack();
+
+        INDI::PropertySwitch LiveStackSP {2};
+        enum { LIVE_STACK_ON, LIVE_STACK_OFF };
+        INDI::PropertyNumber LiveStackNP {3};
+        enum { LIVE_STACK_FRAMES, LIVE_STACK_INTERVAL, LIVE_STACK_KAPPA };
+        INDI::PropertySwitch LiveStackControlSP {2};
+        enum { LIVE_STACK_RESET, LIVE_STACK_SNAPSHOT };
+        INDI::PropertyNumber LiveStackInfoNP {2};
+        enum { LIVE_STACK_STACKED, LIVE_STACK_REJECTED };
+
+        // frame statistics, taken with the 16 bits stretch
+        FrameStats mStats;
+        FrameStats::Result mExposureStats;
+        bool mExposureStatsValid = false;
+        INDI::ElapsedTimer mStatsTimer;
+
+        /** Stretch the subframe, take and publish its statistics, streams publish once per second */
+        void stretchFrame(uint8_t *frame, bool streaming);
+
+        INDI::PropertyNumber FrameStatsNP {7};
+        enum { STATS_MEAN, STATS_MEDIAN, STATS_STDDEV, STATS_MIN, STATS_MAX, STATS_SATURATED, STATS_SATURATED_PERCENT };
+
+        // auto exposure of the streamed frames
+        AutoExposure mAutoExposure;
+
+        /** Measure a streamed frame and apply the new exposure (us) and gain, true if exposure changed */
+        bool autoExposeFrame(const uint8_t *frame, long &exposure);
+
+        /** Set the camera back to the gain of the controls when the auto gain changed it */
+        void restoreManualGain();
+
+        INDI::PropertySwitch AutoExposureSP {3};
+        enum { AUTO_EXPOSURE_OFF, AUTO_EXPOSURE_EXPOSURE, AUTO_EXPOSURE_EXPOSURE_GAIN };
+        INDI::PropertyNumber AutoExposureNP {5};
+        enum { AUTO_EXPOSURE_TARGET, AUTO_EXPOSURE_PERCENTILE, AUTO_EXPOSURE_TOLERANCE, AUTO_EXPOSURE_MAX_STEP,
+               AUTO_EXPOSURE_MAX_EXPOSURE
+             };
+        INDI::PropertyNumber AutoExposureInfoNP {3};
+        enum { AUTO_EXPOSURE_INFO_EXPOSURE, AUTO_EXPOSURE_INFO_GAIN, AUTO_EXPOSURE_INFO_LEVEL };
+
+        // debayer of the streamed frames
+        Debayer mDebayer;
+        BudgetBuffer mRgbBuffer;
+
+        /** Debayer an unbinned subframe and send it to the streamer, false when the budget denies the buffer */
+        bool streamRGB(const uint8_t *frame, SVB_BAYER_PATTERN pattern, Debayer::Method method);
+
+        // mono and colour binning, in a driver buffer copied back to the frame
+        ColorBinning mColorBinning;
+        BudgetBuffer mBinBuffer;
+
+        /** Interleave the RGB planes of a superpixel binned frame and send it to the streamer, false when the
+         *  budget denies the buffer */
+        bool streamPlanarRGB(const uint8_t *frame);
+
+        INDI::PropertySwitch BinningModeSP {3};
+        enum { BIN_MODE_MONO, BIN_MODE_BAYER, BIN_MODE_SUPERPIXEL };
+
+        INDI::PropertySwitch DebayerSP {3};
+        enum { DEBAYER_OFF, DEBAYER_BILINEAR, DEBAYER_EDGE_AWARE };
+
+        // SER recording of the streamed frames, owned by the streaming thread
+        SerRecorder mSerRecorder;
+        INDI::ElapsedTimer mSerTimer;
+        uint64_t mSerPublishedBytes = 0;
+
+        /** SER format of the streamed frames */
+        SerWriter::Format serFormat(SVB_BAYER_PATTERN pattern, bool isColor, int binMode);
+
+        /** Start or stop the recording as requested and append a streamed frame */
+        void recordFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format);
+
+        /** Close the SER file and publish the recording totals */
+        void stopRecording();
+
+        /** Publish the recording totals, rate since the last call */
+        void publishRecording();
+
+        INDI::PropertySwitch SerRecordSP {2};
+        enum { SER_RECORD_ON, SER_RECORD_OFF };
+        INDI::PropertyText SerFileTP {2};
+        enum { SER_DIRECTORY, SER_PREFIX };
+        INDI::PropertyNumber SerOptionsNP {1};
+        enum { SER_MAX_FILE_SIZE };
+        INDI::PropertySwitch SerDirectSP {2};
+        enum { SER_DIRECT_ON, SER_DIRECT_OFF };
+        INDI::PropertyNumber SerInfoNP {4};
+        enum { SER_INFO_FRAMES, SER_INFO_SIZE, SER_INFO_FILES, SER_INFO_RATE };
+
+        // flight recorder ring of the stream, written by the streaming thread, frozen on its own thread
+        FlightRecorder mFlightRecorder;
+        std::thread mFreezeThread;
+        std::atomic_bool mFreezeRequested {false};
+        std::atomic_bool mFreezeBusy {false};
+        uint32_t mFrozenFiles = 0;
+        INDI::ElapsedTimer mFlightTimer;
+
+        /** Open the ring if requested, write a streamed frame and start the requested freeze */
+        void flightFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format);
+
+        /** Wait for the freeze in progress and close the ring */
+        void stopFlightRecorder();
+
+        /** Copy the last seconds of the ring into a SER file in the background */
+        void freezeFlightRecorder();
+
+        /** Publish the ring content and the frozen files */
+        void publishFlightRecorder();
+
+        INDI::PropertySwitch FlightRecorderSP {2};
+        enum { FLIGHT_RECORDER_ON, FLIGHT_RECORDER_OFF };
+        INDI::PropertyText FlightRecorderTP {1};
+        INDI::PropertyNumber FlightRecorderNP {2};
+        enum { FLIGHT_RECORDER_SIZE, FLIGHT_RECORDER_SECONDS };
+        INDI::PropertySwitch FlightTriggerSP {1};
+        INDI::PropertyNumber FlightRecorderInfoNP {4};
+        enum { FLIGHT_INFO_FRAMES, FLIGHT_INFO_SPAN, FLIGHT_INFO_FROZEN, FLIGHT_INFO_LAST };
+
+        // transient detection on the stream, events are saved from an in memory ring
+        TransientDetector mTransientDetector;
+        FrameRing mTransientRing;
+        MemoryBudget::Grant mTransientGrant;
+        bool mEventActive = false;
+        uint64_t mEventStart = 0, mEventFirst = 0, mEventLast = 0;
+        TransientDetector::Detection mEvent {};
+        std::string mEventTime;
+        uint32_t mEvents = 0;
+        EventWriter mEventWriter {mTransientRing};
+
+        /** Detect transients in a streamed frame and save the events when they end */
+        void transientFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format);
+
+        /** Publish the event and queue its frames, from the first saved to the last one, to the event writer */
+        void saveEvent(uint64_t last, const SerWriter::Format &format);
+
+        INDI::PropertySwitch TransientSP {2};
+        enum { TRANSIENT_ON, TRANSIENT_OFF };
+        INDI::PropertyNumber TransientNP {6};
+        enum { TRANSIENT_KAPPA, TRANSIENT_MIN_PIXELS, TRANSIENT_MAX_AREA, TRANSIENT_PRE, TRANSIENT_POST, TRANSIENT_RING };
+        INDI::PropertyNumber TransientEventNP {8};
+        enum { EVENT_COUNT, EVENT_FRAMES, EVENT_X, EVENT_Y, EVENT_WIDTH, EVENT_HEIGHT, EVENT_PEAK, EVENT_NOISE };
+        INDI::PropertyText TransientEventTP {2};
+        enum { EVENT_TIME, EVENT_FILE };
+
+        // lossless delta encoded stream, keyframes and deltas at full bit depth
+        Delta::Encoder mDeltaEncoder;
+        INDI::ElapsedTimer mDeltaTimer, mDeltaStatsTimer;
+        uint64_t mDeltaBytes = 0, mDeltaRawBytes = 0;
+        uint32_t mDeltaFrames = 0;
+        double mDeltaEncodeTime = 0;
+
+        /** Encode a streamed frame and send it, at most at the configured rate */
+        void deltaFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format);
+
+        INDI::PropertySwitch DeltaStreamSP {2};
+        enum { DELTA_STREAM_ON, DELTA_STREAM_OFF };
+        INDI::PropertyNumber DeltaStreamNP {2};
+        enum { DELTA_STREAM_KEY_INTERVAL, DELTA_STREAM_MAX_RATE };
+        INDI::PropertyNumber DeltaStreamInfoNP {3};
+        enum { DELTA_STREAM_RATIO, DELTA_STREAM_BANDWIDTH, DELTA_STREAM_ENCODE };
+        INDI::PropertyBlob DeltaStreamBP {1};
+
+        // shared memory ring of the stream for the clients on this host
+        SharedRing::Writer mSharedRing;
+        MemoryBudget::Grant mSharedRingGrant;
+        std::mutex mSharedRingLock;
+
+        /** Create the ring with the configured slots, close it when the ring is off */
+        bool startSharedRing();
+
+        /** Publish a streamed frame in the ring */
+        void sharedFrame(const uint8_t *frame, SerWriter::Clock::time_point captured, const SerWriter::Format &format);
+
+        INDI::PropertySwitch SharedRingSP {2};
+        enum { SHARED_RING_ON, SHARED_RING_OFF };
+        INDI::PropertyNumber SharedRingNP {1};
+        enum { SHARED_RING_SLOTS };
+        INDI::PropertyText SharedRingTP {1};
+        enum { SHARED_RING_NAME };
+
+        // asynchronous local save of the exposures, files are written in the background
+        AsyncWriter mAsyncWriter;
+        std::mutex mAsyncSaveLock;
+        uint32_t mAsyncSaveIndex = 0;
+
+        /** Start the writer with the configured depth, stop it when saving is off */
+        bool startAsyncSave();
+
+        /** Encode the completed exposure as FITS in memory, Rice tile compressed when asked */
+        bool encodeExposure(bool compressed, void *&memptr, size_t &memsize);
+
+        /** Queue an encoded exposure to the writer, which takes the buffer, false when it was not queued */
+        bool saveExposure(void *memptr, size_t memsize);
+
+        /** Publish the writer queue and throughput */
+        void publishAsyncSave();
+
+        INDI::PropertySwitch AsyncSaveSP {2};
+        enum { ASYNC_SAVE_ON, ASYNC_SAVE_OFF };
+        INDI::PropertyText AsyncSaveFileTP {2};
+        enum { ASYNC_SAVE_DIRECTORY, ASYNC_SAVE_PREFIX };
+        INDI::PropertyNumber AsyncSaveNP {1};
+        enum { ASYNC_SAVE_DEPTH };
+        INDI::PropertyNumber AsyncSaveInfoNP {5};
+        enum { ASYNC_SAVE_QUEUED, ASYNC_SAVE_IN_FLIGHT, ASYNC_SAVE_WRITTEN, ASYNC_SAVE_FAILED, ASYNC_SAVE_RATE };
+
+        // capture threads affinity and scheduling, each thread applies a new generation of the settings
+        enum { THREAD_CAPTURE, THREAD_TIMER, THREAD_COUNT };
+        ThreadTuning::Settings mThreadSettings {"", ThreadTuning::POLICY_NORMAL, 0, 10};
+        std::mutex mThreadLock;
+        uint32_t mThreadGeneration = 1;
+        uint32_t mThreadApplied[THREAD_COUNT] {};
+        bool mThreadRefused[THREAD_COUNT] {};
+
+        /** Name and tune the calling worker thread when the settings changed */
+        void tuneThread(int thread);
+
+        /** Tune the idle worker threads now, busy ones at their next frame or exposure */
+        void tuneThreads();
+
+        INDI::PropertyText ThreadAffinityTP {1};
+        enum { THREAD_AFFINITY_CPUS };
+        INDI::PropertySwitch ThreadSchedulingSP {3};
+        enum { THREAD_SCHEDULING_NORMAL, THREAD_SCHEDULING_NICE, THREAD_SCHEDULING_FIFO };
+        INDI::PropertyNumber ThreadPriorityNP {2};
+        enum { THREAD_PRIORITY_NICE, THREAD_PRIORITY_FIFO };
+        INDI::PropertyText ThreadInfoTP {THREAD_COUNT};
+
+        // tile compressed FITS of the completed exposures
+        TileCompressor mTileCompressor;
+
+        /** Send the compressed exposure to the clients as the CCD1 image */
+        void sendCompressed(void *memptr, size_t memsize);
+
+        /** Complete the exposure, INDI does not upload or save it again when the driver sent or saved it */
+        void completeExposure(bool sent, bool saved);
+
+        INDI::PropertySwitch TileCompressionSP {2};
+        enum { TILE_COMPRESSION_ON, TILE_COMPRESSION_OFF };
+        INDI::PropertyNumber CompressionInfoNP {3};
+        enum { COMPRESSION_RATIO, COMPRESSION_TIME, COMPRESSION_SIZE };
+
+        // Calibration, masters are subtracted before binning
+        Calibration::Library mCalibrationLibrary;
+        std::mutex mCalibrationLock;
+        std::shared_ptr<Calibration::MasterFrame> mDarkMaster;
+        Calibration::MasterKey mDarkKey;
+        bool mDarkSelected = false;
+        // settings of the last exposure, for saving it as master
+        Calibration::MasterKey mLastExposureKey;
+        INDI::CCDChip::CCD_FRAME mLastExposureType = INDI::CCDChip::LIGHT_FRAME;
+        bool mLastExposureBinned = false;
+        bool mLastExposureValid = false;
+        // master subtracted from the last exposure, reported in FITS
+        std::string mLastDarkMaster;
+        // flat reciprocal, loaded when the subframe changes
+        Calibration::FlatField mFlatField;
+        Calibration::MasterKey mFlatKey;
+        bool mFlatSelected = false;
+        std::string mLastFlatMaster;
+        // hot pixels map of the camera, in the masters library
+        HotPixelMap mHotPixels;
+        HotPixelLearner mHotPixelLearner;
+        size_t mLastHotPixels = 0;
+
+        /** Capture settings of the current subframe */
+        Calibration::MasterKey calibrationKey(uint32_t type, double exposure);
+
+        /** Subtract the matching dark or bias master, returns the master path, empty if none */
+        std::string calibrateFrame(uint8_t *frame, double exposure);
+
+        /** Divide by the flat master covering the subframe, returns the master path, empty if none */
+        std::string flatFieldFrame(uint8_t *frame);
+
+        /** Learn hot pixels from a streamed frame if requested, then correct them, returns the corrected pixels */
+        size_t hotPixelFrame(uint8_t *frame, bool learn);
+
+        /** Load the hot pixels map of the masters library */
+        void loadHotPixels();
+        std::string hotPixelsPath() const;
+
+        /** Write the hot pixels map in the masters library, created when missing, logs the error */
+        bool saveHotPixels();
+
+        INDI::PropertySwitch DarkSubtractSP {2};
+        enum { DARK_SUBTRACT_ON, DARK_SUBTRACT_OFF };
+        INDI::PropertySwitch FlatFieldSP {2};
+        enum { FLAT_FIELD_ON, FLAT_FIELD_OFF };
+        INDI::PropertyText CalibrationLibraryTP {1};
+        INDI::PropertyNumber CalibrationToleranceNP {2};
+        enum { TOLERANCE_EXPOSURE, TOLERANCE_TEMPERATURE };
+        INDI::PropertySwitch CalibrationSaveSP {1};
+        INDI::PropertyText CalibrationMasterTP {2};
+        enum { MASTER_IN_USE_DARK, MASTER_IN_USE_FLAT };
+
+        INDI::PropertySwitch HotPixelSP {2};
+        enum { HOT_PIXELS_ON, HOT_PIXELS_OFF };
+        INDI::PropertyNumber HotPixelNP {2};
+        enum { HOT_PIXELS_KAPPA, HOT_PIXELS_LEARN_FRAMES };
+        INDI::PropertySwitch HotPixelControlSP {3};
+        enum { HOT_PIXELS_BUILD, HOT_PIXELS_LEARN, HOT_PIXELS_CLEAR };
+        INDI::PropertyNumber HotPixelInfoNP {2};
+        enum { HOT_PIXELS_COUNT, HOT_PIXELS_CORRECTED };
+
+        // star detection, on the binned frame
+        StarDetector mStarDetector;
+        std::string mStarList;
+        INDI::ElapsedTimer mStarTimer;
+        // stars of the last exposure, reported in FITS
+        size_t mLastStars = 0;
+        double mLastHFR = 0;
+        bool mLastStarsValid = false;
+
+        /** Detect and publish the stars of the binned frame, streams publish once per second, true if detected */
+        bool detectStars(const uint8_t *frame, bool streaming);
+
+        INDI::PropertySwitch StarDetectionSP {2};
+        enum { STAR_DETECTION_ON, STAR_DETECTION_OFF };
+        INDI::PropertyNumber StarDetectionNP {4};
+        enum { STAR_DETECTION_KAPPA, STAR_DETECTION_MIN_PIXELS, STAR_DETECTION_MAX_PIXELS, STAR_DETECTION_MAX_STARS };
+        INDI::PropertyNumber StarInfoNP {5};
+        enum { STAR_INFO_COUNT, STAR_INFO_HFR, STAR_INFO_FWHM, STAR_INFO_BACKGROUND, STAR_INFO_NOISE };
+        INDI::PropertyBlob StarListBP {1};
+        // brightest unsaturated star of the last detection, sensor coordinates
+        double mBrightestStarX = 0, mBrightestStarY = 0;
+        bool mBrightestStarValid = false;
+
+        // guiding and focus mode stream a small region, the subframe is restored when the stream stops
+        bool mRegionActive = false;
+        int mRegionRestore[4] = {0, 0, 0, 0};
+
+        /** Move the subframe to a square region of binned size pixels, centered on the brightest star for 0, 0 */
+        bool startRegion(int size, double cx, double cy);
+
+        // focus mode, publishes the metrics of the region only
+        FocusMetric mFocusMetric;
+        bool mFocusActive = false;
+        uint32_t mFocusSequence = 0;
+
+        /** Measure a focus frame, publish its metrics and every Nth frame a thumbnail */
+        void focusFrame(const uint8_t *frame);
+
+        INDI::PropertySwitch FocusModeSP {2};
+        enum { FOCUS_MODE_ON, FOCUS_MODE_OFF };
+        INDI::PropertyNumber FocusRegionNP {5};
+        enum { FOCUS_REGION_X, FOCUS_REGION_Y, FOCUS_REGION_SIZE, FOCUS_THUMBNAIL_EVERY, FOCUS_THUMBNAIL_SCALE };
+        INDI::PropertyNumber FocusMetricNP {6};
+        enum { FOCUS_METRIC_SEQUENCE, FOCUS_METRIC_TIMESTAMP, FOCUS_METRIC_HFR, FOCUS_METRIC_FWHM, FOCUS_METRIC_SHARPNESS,
+               FOCUS_METRIC_STARS
+             };
+        INDI::PropertyBlob FocusThumbnailBP {1};
+
+        // guiding on the streamed region through the ST4 port
+        Guider mGuider;
+        StarDetector mGuideDetector;
+        bool mGuideActive = false;
+        // pulses run on the scheduler threads, frames exposed during a pulse are skipped
+        bool mGuideSettling = false;
+        uint32_t mGuideSequence = 0;
+
+        /** Start the calibration or the guiding, false if guiding is not calibrated */
+        bool startGuideLoop(int mode);
+
+        /** Track the guide star of a streamed frame and issue the correction */
+        void guideFrame(const uint8_t *frame);
+
+        /** Publish the loop state, and the calibration when it changed */
+        void publishGuideLoop();
+
+        INDI::PropertySwitch GuideLoopSP {3};
+        enum { GUIDE_LOOP_OFF, GUIDE_LOOP_CALIBRATE, GUIDE_LOOP_GUIDE };
+        INDI::PropertyNumber GuideSettingsNP {9};
+        enum { GUIDE_AGGRESSIVENESS_RA, GUIDE_AGGRESSIVENESS_DEC, GUIDE_HYSTERESIS, GUIDE_MIN_MOVE, GUIDE_MAX_PULSE,
+               GUIDE_CALIBRATION_PULSE, GUIDE_CALIBRATION_DISTANCE, GUIDE_SEARCH_RADIUS, GUIDE_REGION_SIZE
+             };
+        INDI::PropertyText GuideStateTP {1};
+        INDI::PropertyNumber GuideErrorNP {10};
+        enum { GUIDE_ERROR_FRAME, GUIDE_ERROR_TIMESTAMP, GUIDE_ERROR_X, GUIDE_ERROR_Y, GUIDE_ERROR_RA, GUIDE_ERROR_DEC,
+               GUIDE_ERROR_PULSE_RA, GUIDE_ERROR_PULSE_DEC, GUIDE_ERROR_RMS_RA, GUIDE_ERROR_RMS_DEC
+             };
+        INDI::PropertyNumber GuideCalibrationNP {4};
+        enum { GUIDE_CALIBRATION_RATE_RA, GUIDE_CALIBRATION_ANGLE_RA, GUIDE_CALIBRATION_RATE_DEC,
+               GUIDE_CALIBRATION_ANGLE_DEC
+             };
+
     private:
         float lastDuration;
-        bool inExposure;
+        bool inExposure = false;
+
+        /** Is an exposure or a stream using the frame buffer */
+        virtual bool isCapturing() override;
 };
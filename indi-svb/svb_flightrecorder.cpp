@@ -0,0 +1,235 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_flightrecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+static_assert(sizeof(FlightRecorder::FileHeader) <= FlightRecorder::pageSize, "flight recorder header must fit a page");
+
+static const char ringMagic[8] = {'S', 'V', 'B', 'R', 'I', 'N', 'G', 0};
+
+// .NET ticks of the unix epoch
+static const int64_t unixEpochTicks = 621355968000000000LL;
+
+static size_t alignPage(size_t size)
+{
+    return (size + FlightRecorder::pageSize - 1) & ~(FlightRecorder::pageSize - 1);
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    close();
+}
+
+bool FlightRecorder::open(const std::string &path, uint64_t fileSize, const SerWriter::Format &format)
+{
+    close();
+
+    size_t frameSize = SerWriter::frameSize(format);
+    size_t slotSize = alignPage(sizeof(SlotHeader) + frameSize);
+    uint64_t slots = fileSize > pageSize ? (fileSize - pageSize) / slotSize : 0;
+    if (frameSize == 0 || slots < 2 || slots > UINT32_MAX)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    size_t mapSize = pageSize + slots * slotSize;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    // the ring keeps its blocks from one stream to the next, the header marks it empty
+    if (ftruncate(fd, static_cast<off_t>(mapSize)) != 0 ||
+            (fallocate(fd, 0, 0, static_cast<off_t>(mapSize)) != 0 && errno != EOPNOTSUPP && errno != ENOSYS))
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    void *map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    mFd = fd;
+    mMap = static_cast<uint8_t *>(map);
+    mMapSize = mapSize;
+    mPath = path;
+    mFormat = format;
+    mSlots = static_cast<uint32_t>(slots);
+    mSlotSize = slotSize;
+    mFrameSize = frameSize;
+
+    // slots of a previous ring are cleared, they would pass for frames of this one
+    memset(mMap, 0, pageSize);
+    for (uint32_t i = 0; i < mSlots; i++)
+        reinterpret_cast<SlotHeader *>(mMap + pageSize + i * mSlotSize)->sequence = 0;
+
+    mHeader = reinterpret_cast<FileHeader *>(mMap);
+    memcpy(mHeader->magic, ringMagic, sizeof(ringMagic));
+    mHeader->version = version;
+    mHeader->headerSize = pageSize;
+    mHeader->slots = mSlots;
+    mHeader->slotSize = static_cast<uint32_t>(mSlotSize);
+    mHeader->frameSize = static_cast<uint32_t>(mFrameSize);
+    mHeader->width = format.width;
+    mHeader->height = format.height;
+    mHeader->bitDepth = format.bitDepth;
+    mHeader->colorId = format.colorId;
+    mHeader->sequence = 0;
+    return true;
+}
+
+void FlightRecorder::close()
+{
+    if (mMap != nullptr)
+        munmap(mMap, mMapSize);
+    if (mFd >= 0)
+        ::close(mFd);
+    mMap = nullptr;
+    mHeader = nullptr;
+    mFd = -1;
+    mSlots = 0;
+}
+
+FlightRecorder::SlotHeader *FlightRecorder::slot(uint64_t sequence) const
+{
+    return reinterpret_cast<SlotHeader *>(mMap + pageSize + (sequence % mSlots) * mSlotSize);
+}
+
+void FlightRecorder::add(const uint8_t *frame, SerWriter::Clock::time_point captured)
+{
+    if (mHeader == nullptr)
+        return;
+
+    uint64_t sequence = mHeader->sequence + 1;
+    SlotHeader *header = slot(sequence);
+
+    // a reader copying this slot sees the sequence change and drops it
+    __atomic_store_n(&header->sequence, 0, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto utc = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch());
+    header->utcTicks = unixEpochTicks + utc.count() / 100;
+    __atomic_store_n(&header->captured, std::chrono::duration_cast<std::chrono::nanoseconds>(captured.time_since_epoch()).count(),
+                     __ATOMIC_RELAXED);
+    header->size = static_cast<uint32_t>(mFrameSize);
+    memcpy(reinterpret_cast<uint8_t *>(header) + sizeof(SlotHeader), frame, mFrameSize);
+
+    __atomic_store_n(&header->sequence, sequence, __ATOMIC_RELEASE);
+    __atomic_store_n(&mHeader->sequence, sequence, __ATOMIC_RELEASE);
+}
+
+uint32_t FlightRecorder::frames() const
+{
+    if (mHeader == nullptr)
+        return 0;
+    return static_cast<uint32_t>(std::min<uint64_t>(mHeader->sequence, mSlots));
+}
+
+double FlightRecorder::span() const
+{
+    uint32_t count = frames();
+    if (count < 2)
+        return 0;
+    uint64_t newest = mHeader->sequence;
+    return (slot(newest)->captured - slot(newest - count + 1)->captured) / 1e9;
+}
+
+bool FlightRecorder::freeze(const std::string &path, double seconds, uint32_t &frames)
+{
+    frames = 0;
+    if (mHeader == nullptr)
+    {
+        errno = EBADF;
+        return false;
+    }
+
+    uint64_t newest = __atomic_load_n(&mHeader->sequence, __ATOMIC_ACQUIRE);
+    if (newest == 0)
+    {
+        errno = ENODATA;
+        return false;
+    }
+
+    // walk back to the first frame of the window
+    int64_t end = __atomic_load_n(&slot(newest)->captured, __ATOMIC_RELAXED);
+    int64_t window = static_cast<int64_t>(seconds * 1e9);
+    uint64_t oldest = newest;
+    while (oldest > 1 && newest - oldest + 1 < mSlots)
+    {
+        const SlotHeader *previous = slot(oldest - 1);
+        if (__atomic_load_n(&previous->sequence, __ATOMIC_ACQUIRE) != oldest - 1 ||
+                end - __atomic_load_n(&previous->captured, __ATOMIC_RELAXED) > window)
+            break;
+        oldest--;
+    }
+
+    SerWriter writer;
+    if (!writer.open(path, mFormat, false))
+        return false;
+
+    // seqlock read, the frame is kept when its sequence did not change during the copy
+    std::vector<uint8_t> frame(mFrameSize);
+    for (uint64_t sequence = oldest; sequence <= newest; sequence++)
+    {
+        const SlotHeader *header = slot(sequence);
+        if (__atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE) != sequence)
+            continue;
+        int64_t captured = __atomic_load_n(&header->captured, __ATOMIC_RELAXED);
+        memcpy(frame.data(), frameOf(header), mFrameSize);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (__atomic_load_n(&header->sequence, __ATOMIC_RELAXED) != sequence)
+            continue;
+
+        SerWriter::Clock::time_point time{std::chrono::duration_cast<SerWriter::Clock::duration>(std::chrono::nanoseconds(captured))};
+        if (!writer.add(frame.data(), time))
+        {
+            int error = errno;
+            writer.close();
+            errno = error;
+            return false;
+        }
+        frames++;
+    }
+    return writer.close();
+}
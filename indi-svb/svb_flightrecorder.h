@@ -0,0 +1,105 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include "svb_ser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Flight recorder
+// The stream is written continuously into a memory mapped ring file of fixed size, so that the
+// last seconds are always on disk and the file never grows. Slots are page aligned and hold a
+// frame behind a sequence number: a freeze copies the history into a SER file while the ring
+// is still written, and skips the slots overwritten during the copy.
+class FlightRecorder
+{
+    public:
+        // file layout, a header page then the slots
+        struct FileHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t headerSize;
+            uint32_t slots;
+            uint32_t slotSize;      // slot header and frame, page aligned
+            uint32_t frameSize;
+            uint32_t width, height;
+            uint32_t bitDepth;
+            int32_t colorId;        // SER colour id
+            uint64_t sequence;      // last frame written, 0 when empty
+        };
+
+        struct SlotHeader
+        {
+            uint64_t sequence;      // 0 while the slot is written
+            int64_t utcTicks;       // SER ticks, 100 ns since 0001-01-01
+            int64_t captured;       // monotonic clock, ns
+            uint32_t size;
+            uint32_t reserved;
+        };
+
+        static const size_t pageSize = 4096;
+        static const uint32_t version = 1;
+
+        ~FlightRecorder();
+
+        /** Create the ring file of fileSize bytes for frames of a format, returns false and sets errno on error */
+        bool open(const std::string &path, uint64_t fileSize, const SerWriter::Format &format);
+
+        /** Unmap and close the ring file, the frames stay in it */
+        void close();
+
+        /** Write a frame over the oldest one */
+        void add(const uint8_t *frame, SerWriter::Clock::time_point captured);
+
+        /** Copy the frames of the last seconds into a SER file, oldest first, may run while frames are added */
+        bool freeze(const std::string &path, double seconds, uint32_t &frames);
+
+        bool isOpen() const { return mHeader != nullptr; }
+        const std::string &path() const { return mPath; }
+        uint32_t slots() const { return mSlots; }
+
+        /** Frames in the ring and the time between the oldest and the newest */
+        uint32_t frames() const;
+        double span() const;
+
+    private:
+        SlotHeader *slot(uint64_t sequence) const;
+        const uint8_t *frameOf(const SlotHeader *slot) const { return reinterpret_cast<const uint8_t *>(slot) + sizeof(SlotHeader); }
+
+        std::string mPath;
+        SerWriter::Format mFormat;
+        int mFd = -1;
+        uint8_t *mMap = nullptr;
+        size_t mMapSize = 0;
+        FileHeader *mHeader = nullptr;
+        uint32_t mSlots = 0;
+        size_t mSlotSize = 0;
+        size_t mFrameSize = 0;
+};
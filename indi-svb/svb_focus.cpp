@@ -0,0 +1,113 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_focus.h"
+
+#include <algorithm>
+#include <cstdio>
+
+const FocusMetric::Result &FocusMetric::process(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth,
+        uint32_t step, const StarDetector::Settings &settings)
+{
+    mDetector.detect(frame, width, height, bitDepth, settings);
+    mResult.stars = mDetector.stars().size();
+    mResult.hfr = mDetector.medianHFR();
+    mResult.fwhm = mDetector.medianFWHM();
+
+    step = std::max(step, 1u);
+    if (bitDepth > 8)
+        mResult.sharpness = laplacianVariance(reinterpret_cast<const uint16_t *>(frame), width, height, step);
+    else
+        mResult.sharpness = laplacianVariance(frame, width, height, step);
+    return mResult;
+}
+
+template <typename T>
+double FocusMetric::laplacianVariance(const T *frame, uint32_t width, uint32_t height, uint32_t step) const
+{
+    if (width <= 2 * step || height <= 2 * step)
+        return 0;
+
+    // 4 neighbours Laplacian, integer sums are exact for 16 bits frames up to 2^30 pixels
+    int64_t sum = 0;
+    uint64_t sum2 = 0;
+    for (uint32_t y = step; y < height - step; y++)
+    {
+        const T *up = frame + size_t(y - step) * width;
+        const T *row = frame + size_t(y) * width;
+        const T *down = frame + size_t(y + step) * width;
+        for (uint32_t x = step; x < width - step; x++)
+        {
+            int64_t l = 4 * int64_t(row[x]) - row[x - step] - row[x + step] - up[x] - down[x];
+            sum += l;
+            sum2 += uint64_t(l * l);
+        }
+    }
+
+    const double n = double(width - 2 * step) * (height - 2 * step);
+    const double mean = sum / n;
+    return sum2 / n - mean * mean;
+}
+
+const std::string &FocusMetric::thumbnail(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth,
+        uint32_t factor)
+{
+    factor = std::max(factor, 1u);
+    if (bitDepth > 8)
+        downsample(reinterpret_cast<const uint16_t *>(frame), width, height, factor);
+    else
+        downsample(frame, width, height, factor);
+
+    const uint32_t thumbWidth = width / factor, thumbHeight = height / factor;
+    char header[64];
+    int headerSize = snprintf(header, sizeof(header), "P5\n%u %u\n255\n", thumbWidth, thumbHeight);
+    mThumbnail.assign(header, headerSize);
+    if (mBoxes.empty())
+        return mThumbnail;
+
+    // min to max stretch of the box sums
+    auto range = std::minmax_element(mBoxes.begin(), mBoxes.end());
+    const uint32_t low = *range.first;
+    const uint32_t span = std::max(*range.second - low, 1u);
+    mThumbnail.reserve(headerSize + mBoxes.size());
+    for (uint32_t box : mBoxes)
+        mThumbnail.push_back(static_cast<char>((uint64_t(box - low) * 255 + span / 2) / span));
+    return mThumbnail;
+}
+
+template <typename T>
+void FocusMetric::downsample(const T *frame, uint32_t width, uint32_t height, uint32_t factor)
+{
+    const uint32_t thumbWidth = width / factor, thumbHeight = height / factor;
+    mBoxes.assign(size_t(thumbWidth) * thumbHeight, 0);
+    for (uint32_t y = 0; y < thumbHeight * factor; y++)
+    {
+        const T *row = frame + size_t(y) * width;
+        uint32_t *box = mBoxes.data() + size_t(y / factor) * thumbWidth;
+        for (uint32_t x = 0; x < thumbWidth * factor; x++)
+            box[x / factor] += row[x];
+    }
+}
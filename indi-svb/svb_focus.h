@@ -0,0 +1,68 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "svb_stars.h"
+
+// Focus metrics of a small streamed region
+// HFR and FWHM are the medians of the stars detected in the region, the sharpness is the
+// variance of the Laplacian, which does not need stars and keeps working far from focus.
+class FocusMetric
+{
+    public:
+        struct Result
+        {
+            double hfr, fwhm;       // pixels, 0 without stars
+            double sharpness;       // Laplacian variance, squared ADU
+            size_t stars;
+        };
+
+        /**
+         * Measure a 8 or 16 bits frame, step is the distance between neighbours of the Laplacian,
+         * 2 on raw bayer frames so that only pixels of the same colour are compared
+         */
+        const Result &process(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth, uint32_t step,
+                              const StarDetector::Settings &settings);
+
+        /** Box downsampled 8 bits binary PGM of a 8 or 16 bits frame, stretched from min to max */
+        const std::string &thumbnail(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth, uint32_t factor);
+
+        const Result &result() const { return mResult; }
+
+    private:
+        template <typename T> double laplacianVariance(const T *frame, uint32_t width, uint32_t height, uint32_t step) const;
+        template <typename T> void downsample(const T *frame, uint32_t width, uint32_t height, uint32_t factor);
+
+        StarDetector mDetector;
+        Result mResult {0, 0, 0, 0};
+        std::vector<uint32_t> mBoxes;
+        std::string mThumbnail;
+};
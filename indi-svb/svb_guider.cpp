@@ -0,0 +1,300 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_guider.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Guider::startCalibration()
+{
+    mState = CALIBRATING;
+    mCalibrated = false;
+    mPhase = PHASE_RA_OUT;
+    mSteps = 0;
+    mTracking = false;
+    mMissed = 0;
+}
+
+bool Guider::startGuiding()
+{
+    if (!mCalibrated)
+        return false;
+
+    mState = GUIDING;
+    mLocked = false;
+    mPulseRA = mPulseDEC = 0;
+    mSumRA2 = mSumDEC2 = 0;
+    mGuideFrames = 0;
+    mMissed = 0;
+    return true;
+}
+
+void Guider::stop()
+{
+    mState = IDLE;
+    mTracking = false;
+}
+
+void Guider::clearCalibration()
+{
+    mCalibrated = false;
+    if (mState != IDLE)
+        mState = FAILED;
+}
+
+const char *Guider::stateName() const
+{
+    switch (mState)
+    {
+        case IDLE:
+            return "Idle";
+        case CALIBRATING:
+            return "Calibrating";
+        case GUIDING:
+            return "Guiding";
+        case LOST:
+            return "Star lost";
+        case FAILED:
+            return "Calibration failed";
+    }
+    return "Unknown";
+}
+
+double Guider::rateRA() const
+{
+    return std::hypot(mRAX, mRAY);
+}
+
+double Guider::rateDEC() const
+{
+    return std::hypot(mDECX, mDECY);
+}
+
+double Guider::angleRA() const
+{
+    return std::atan2(mRAY, mRAX) * 180.0 / M_PI;
+}
+
+double Guider::angleDEC() const
+{
+    return std::atan2(mDECY, mDECX) * 180.0 / M_PI;
+}
+
+double Guider::rmsRA() const
+{
+    return mGuideFrames > 0 ? std::sqrt(mSumRA2 / mGuideFrames) : 0;
+}
+
+double Guider::rmsDEC() const
+{
+    return mGuideFrames > 0 ? std::sqrt(mSumDEC2 / mGuideFrames) : 0;
+}
+
+bool Guider::track(const std::vector<StarDetector::Star> &stars, double radius)
+{
+    const StarDetector::Star *best = nullptr;
+    double bestDistance = radius * radius;
+    for (const auto &star : stars)
+    {
+        if (star.saturated)
+            continue;
+
+        // stars are sorted brightest first
+        if (!mTracking)
+        {
+            best = &star;
+            break;
+        }
+
+        double distance = (star.x - mX) * (star.x - mX) + (star.y - mY) * (star.y - mY);
+        if (distance <= bestDistance)
+        {
+            best = &star;
+            bestDistance = distance;
+        }
+    }
+
+    if (best == nullptr)
+        return false;
+
+    mX = best->x;
+    mY = best->y;
+    mTracking = true;
+    return true;
+}
+
+Guider::Pulse Guider::update(const std::vector<StarDetector::Star> &stars, const Settings &settings)
+{
+    Pulse pulse {0, 0};
+    if (mState == IDLE || mState == FAILED)
+        return pulse;
+
+    if (!track(stars, settings.searchRadius))
+    {
+        mErrorRA = mErrorDEC = 0;
+        if (++mMissed >= lostFrames)
+        {
+            // calibration can not resume, guiding does when the star comes back
+            if (mState == CALIBRATING)
+                mState = FAILED;
+            else
+                mState = LOST;
+        }
+        return pulse;
+    }
+    mMissed = 0;
+
+    if (mState == LOST)
+        mState = GUIDING;
+
+    if (mState == CALIBRATING)
+        return calibrate(settings);
+    return guide(settings);
+}
+
+Guider::Pulse Guider::calibrate(const Settings &settings)
+{
+    Pulse pulse {0, 0};
+    const int step = static_cast<int>(settings.calibrationPulse);
+
+    switch (mPhase)
+    {
+        case PHASE_RA_OUT:
+        case PHASE_DEC_OUT:
+        {
+            if (mSteps == 0)
+            {
+                mOriginX = mX;
+                mOriginY = mY;
+            }
+
+            double dx = mX - mOriginX, dy = mY - mOriginY;
+            if (mSteps > 0 && std::hypot(dx, dy) >= settings.calibrationDistance)
+            {
+                // pixels per ms of pulse, then go back to the origin
+                double duration = double(mSteps) * step;
+                if (mPhase == PHASE_RA_OUT)
+                {
+                    mRAX = dx / duration;
+                    mRAY = dy / duration;
+                    mPhase = PHASE_RA_BACK;
+                }
+                else
+                {
+                    mDECX = dx / duration;
+                    mDECY = dy / duration;
+                    mPhase = PHASE_DEC_BACK;
+                }
+                return calibrate(settings);
+            }
+
+            if (mSteps >= maxCalibrationSteps)
+            {
+                mState = FAILED;
+                return pulse;
+            }
+
+            mSteps++;
+            if (mPhase == PHASE_RA_OUT)
+                pulse.ra = step;
+            else
+                pulse.dec = step;
+            return pulse;
+        }
+
+        case PHASE_RA_BACK:
+        case PHASE_DEC_BACK:
+        {
+            if (mSteps > 0)
+            {
+                mSteps--;
+                if (mPhase == PHASE_RA_BACK)
+                    pulse.ra = -step;
+                else
+                    pulse.dec = -step;
+                return pulse;
+            }
+
+            if (mPhase == PHASE_RA_BACK)
+            {
+                mPhase = PHASE_DEC_OUT;
+                return calibrate(settings);
+            }
+
+            // axes must not be parallel
+            double cross = mRAX * mDECY - mRAY * mDECX;
+            if (std::fabs(cross) < 0.25 * rateRA() * rateDEC())
+            {
+                mState = FAILED;
+                return pulse;
+            }
+
+            mCalibrated = true;
+            startGuiding();
+            return pulse;
+        }
+    }
+
+    return pulse;
+}
+
+Guider::Pulse Guider::guide(const Settings &settings)
+{
+    Pulse pulse {0, 0};
+
+    // the lock position is the first guided star position
+    if (!mLocked)
+    {
+        mLockX = mX;
+        mLockY = mY;
+        mLocked = true;
+    }
+
+    // error in ms of west and north pulse, solving error = a * RA + b * DEC
+    double ex = mX - mLockX, ey = mY - mLockY;
+    double det = mRAX * mDECY - mRAY * mDECX;
+    double a = (ex * mDECY - ey * mDECX) / det;
+    double b = (mRAX * ey - mRAY * ex) / det;
+
+    mErrorRA = a * rateRA();
+    mErrorDEC = b * rateDEC();
+    mSumRA2 += mErrorRA * mErrorRA;
+    mSumDEC2 += mErrorDEC * mErrorDEC;
+    mGuideFrames++;
+
+    // correction opposite to the error, smoothed with the previous one
+    double ra = std::fabs(mErrorRA) < settings.minMove ? 0 : -a * settings.aggressivenessRA;
+    double dec = std::fabs(mErrorDEC) < settings.minMove ? 0 : -b * settings.aggressivenessDEC;
+    ra = (1.0 - settings.hysteresis) * ra + settings.hysteresis * mPulseRA;
+    dec = (1.0 - settings.hysteresis) * dec + settings.hysteresis * mPulseDEC;
+    mPulseRA = std::max(-settings.maxPulse, std::min(ra, settings.maxPulse));
+    mPulseDEC = std::max(-settings.maxPulse, std::min(dec, settings.maxPulse));
+
+    pulse.ra = static_cast<int>(std::lround(mPulseRA));
+    pulse.dec = static_cast<int>(std::lround(mPulseDEC));
+    return pulse;
+}
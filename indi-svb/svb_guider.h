@@ -0,0 +1,124 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "svb_stars.h"
+
+// Guiding loop on the streamed frames
+// The guide star is tracked from frame to frame, the calibration pulses the mount west then
+// north to measure the pixel motion per millisecond of pulse on each axis, and the guiding
+// projects the error on those axes into RA and DEC pulses with hysteresis and a dead band.
+class Guider
+{
+    public:
+        enum State { IDLE, CALIBRATING, GUIDING, LOST, FAILED };
+
+        struct Settings
+        {
+            double aggressivenessRA, aggressivenessDEC; // fraction of the error corrected
+            double hysteresis;                          // fraction of the previous pulse kept
+            double minMove;                             // dead band, pixels
+            double maxPulse;                            // ms
+            double calibrationPulse;                    // ms
+            double calibrationDistance;                 // pixels the star has to move on each axis
+            double searchRadius;                        // pixels the star can move between frames
+        };
+
+        // signed pulse durations, ms
+        struct Pulse
+        {
+            int ra;     // > 0 west, < 0 east
+            int dec;    // > 0 north, < 0 south
+        };
+
+        /** Start the calibration, guiding follows when it succeeds */
+        void startCalibration();
+
+        /** Guide on the star position of the next frame, false without calibration */
+        bool startGuiding();
+
+        void stop();
+
+        /** Forget the calibration, after a binning change */
+        void clearCalibration();
+
+        /** Track the guide star in the stars of a frame and return the pulse to issue */
+        Pulse update(const std::vector<StarDetector::Star> &stars, const Settings &settings);
+
+        State state() const { return mState; }
+        const char *stateName() const;
+        bool isCalibrated() const { return mCalibrated; }
+
+        /** Calibration rates in pixels per ms of pulse and axis angles in degrees */
+        double rateRA() const;
+        double rateDEC() const;
+        double angleRA() const;
+        double angleDEC() const;
+
+        /** Guide star position and error along the RA and DEC axes of the last frame, pixels */
+        double x() const { return mX; }
+        double y() const { return mY; }
+        double errorRA() const { return mErrorRA; }
+        double errorDEC() const { return mErrorDEC; }
+        double rmsRA() const;
+        double rmsDEC() const;
+
+    private:
+        // calibration steps before giving up on an axis
+        static const int maxCalibrationSteps = 25;
+        // frames without the guide star before the loop is lost
+        static const int lostFrames = 5;
+
+        enum Phase { PHASE_RA_OUT, PHASE_RA_BACK, PHASE_DEC_OUT, PHASE_DEC_BACK };
+
+        /** Find the star nearest to the last position, the brightest one on the first frame */
+        bool track(const std::vector<StarDetector::Star> &stars, double radius);
+        Pulse calibrate(const Settings &settings);
+        Pulse guide(const Settings &settings);
+
+        State mState = IDLE;
+        bool mCalibrated = false;
+        bool mTracking = false;
+        int mMissed = 0;
+
+        Phase mPhase = PHASE_RA_OUT;
+        int mSteps = 0;
+        double mOriginX = 0, mOriginY = 0;
+        // pixels per ms of west and north pulse
+        double mRAX = 0, mRAY = 0, mDECX = 0, mDECY = 0;
+
+        double mX = 0, mY = 0;
+        double mLockX = 0, mLockY = 0;
+        bool mLocked = false;
+        double mErrorRA = 0, mErrorDEC = 0;
+        double mPulseRA = 0, mPulseDEC = 0;
+        double mSumRA2 = 0, mSumDEC2 = 0;
+        size_t mGuideFrames = 0;
+};
@@ -0,0 +1,283 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_hotpixels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+static const char hotPixelsMagic[8] = {'S', 'V', 'B', 'H', 'O', 'T', 'P', 'X'};
+static const uint32_t hotPixelsVersion = 1;
+
+// candidates beyond 1% of the subframe are noise, not hot pixels
+static const size_t maxCandidatesRatio = 100;
+
+// on disk header, sorted indexes follow
+struct HotPixelsHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t count;
+};
+
+// same colour neighbours, {dx, dy}
+static const int monoNeighbours[8][2] = {{-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+static const int greenNeighbours[8][2] = {{-1, -1}, {1, -1}, {-1, 1}, {1, 1}, {-2, 0}, {2, 0}, {0, -2}, {0, 2}};
+static const int colorNeighbours[8][2] = {{-2, -2}, {0, -2}, {2, -2}, {-2, 0}, {2, 0}, {-2, 2}, {0, 2}, {2, 2}};
+
+void HotPixelMap::setSensor(uint32_t width, uint32_t height, bool bayer, SVB_BAYER_PATTERN pattern)
+{
+    if (width != mWidth || height != mHeight)
+        mIndex.clear();
+
+    mWidth = width;
+    mHeight = height;
+    mBayer = bayer;
+    mPattern = pattern;
+}
+
+bool HotPixelMap::load(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+        return false;
+
+    HotPixelsHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              memcmp(header.magic, hotPixelsMagic, sizeof(hotPixelsMagic)) == 0 &&
+              header.version == hotPixelsVersion && header.width == mWidth && header.height == mHeight;
+
+    std::vector<uint32_t> index;
+    if (ok)
+    {
+        index.resize(header.count);
+        ok = fread(index.data(), sizeof(uint32_t), index.size(), fp) == index.size() &&
+             std::is_sorted(index.begin(), index.end()) &&
+             (index.empty() || index.back() < size_t(mWidth) * mHeight);
+    }
+    fclose(fp);
+
+    if (ok)
+        mIndex.swap(index);
+    return ok;
+}
+
+bool HotPixelMap::save(const std::string &path) const
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr)
+        return false;
+
+    HotPixelsHeader header;
+    memcpy(header.magic, hotPixelsMagic, sizeof(hotPixelsMagic));
+    header.version = hotPixelsVersion;
+    header.width = mWidth;
+    header.height = mHeight;
+    header.count = mIndex.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(mIndex.data(), sizeof(uint32_t), mIndex.size(), fp) == mIndex.size();
+    return (fclose(fp) == 0) && ok;
+}
+
+size_t HotPixelMap::build(const uint8_t *frame, const Subframe &subframe, double kappa)
+{
+    mIndex = candidates(frame, subframe, kappa);
+    return mIndex.size();
+}
+
+void HotPixelMap::merge(const std::vector<uint32_t> &index)
+{
+    std::vector<uint32_t> merged;
+    merged.reserve(mIndex.size() + index.size());
+    std::set_union(mIndex.begin(), mIndex.end(), index.begin(), index.end(), std::back_inserter(merged));
+    mIndex.swap(merged);
+}
+
+std::vector<uint32_t> HotPixelMap::candidates(const uint8_t *frame, const Subframe &subframe, double kappa) const
+{
+    if (subframe.bitDepth > 8)
+        return findCandidates(reinterpret_cast<const uint16_t *>(frame), subframe, kappa);
+    else
+        return findCandidates(frame, subframe, kappa);
+}
+
+size_t HotPixelMap::correct(uint8_t *frame, const Subframe &subframe) const
+{
+    if (mIndex.empty())
+        return 0;
+
+    if (subframe.bitDepth > 8)
+        return replace(reinterpret_cast<uint16_t *>(frame), subframe);
+    else
+        return replace(frame, subframe);
+}
+
+template <typename T>
+uint32_t HotPixelMap::neighboursMedian(const T *frame, const Subframe &subframe, uint32_t column, uint32_t row) const
+{
+    const int (*offsets)[2] = monoNeighbours;
+    if (mBayer)
+        offsets = Cfa::color(mPattern, subframe.x + column, subframe.y + row) == Cfa::GREEN ? greenNeighbours : colorNeighbours;
+
+    uint32_t values[8];
+    int count = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        int x = int(column) + offsets[i][0];
+        int y = int(row) + offsets[i][1];
+        if (x < 0 || y < 0 || x >= int(subframe.width) || y >= int(subframe.height))
+            continue;
+        values[count++] = frame[size_t(y) * subframe.width + x];
+    }
+
+    if (count == 0)
+        return frame[size_t(row) * subframe.width + column];
+
+    std::nth_element(values, values + count / 2, values + count);
+    return values[count / 2];
+}
+
+template <typename T>
+std::vector<uint32_t> HotPixelMap::findCandidates(const T *frame, const Subframe &subframe, double kappa) const
+{
+    std::vector<uint32_t> result;
+    const size_t pixels = size_t(subframe.width) * subframe.height;
+    if (pixels == 0 || subframe.x + subframe.width > mWidth || subframe.y + subframe.height > mHeight)
+        return result;
+
+    // robust level and noise from about 64k samples, median and MAD
+    const size_t step = std::max<size_t>(1, pixels / 65536) | 1;
+    std::vector<uint32_t> samples;
+    samples.reserve(pixels / step + 1);
+    for (size_t i = 0; i < pixels; i += step)
+        samples.push_back(frame[i]);
+
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    const uint32_t median = samples[samples.size() / 2];
+    for (auto &sample : samples)
+        sample = sample > median ? sample - median : median - sample;
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    const double sigma = std::max(1.4826 * samples[samples.size() / 2], 1.0);
+
+    const uint32_t threshold = static_cast<uint32_t>(std::min(kappa * sigma, 65535.0));
+    const uint32_t level = std::min<uint32_t>(median + threshold, 65535);
+
+    // only pixels above the frame level are compared with their neighbours
+    for (uint32_t row = 0; row < subframe.height; row++)
+    {
+        const T *line = frame + size_t(row) * subframe.width;
+        for (uint32_t column = 0; column < subframe.width; column++)
+        {
+            if (line[column] <= level)
+                continue;
+
+            uint32_t neighbours = neighboursMedian(frame, subframe, column, row);
+            if (line[column] > neighbours + threshold)
+            {
+                result.push_back((subframe.y + row) * mWidth + subframe.x + column);
+                if (result.size() > pixels / maxCandidatesRatio)
+                    return std::vector<uint32_t>();
+            }
+        }
+    }
+
+    return result;
+}
+
+template <typename T>
+size_t HotPixelMap::replace(T *frame, const Subframe &subframe) const
+{
+    size_t replaced = 0;
+
+    for (uint32_t row = 0; row < subframe.height; row++)
+    {
+        // hot pixels of the row in the sorted index
+        const uint32_t first = (subframe.y + row) * mWidth + subframe.x;
+        auto it = std::lower_bound(mIndex.begin(), mIndex.end(), first);
+        for (; it != mIndex.end() && *it < first + subframe.width; ++it)
+        {
+            uint32_t column = *it - first;
+            frame[size_t(row) * subframe.width + column] = static_cast<T>(neighboursMedian(frame, subframe, column, row));
+            replaced++;
+        }
+    }
+
+    return replaced;
+}
+
+void HotPixelLearner::start(size_t frames, double kappa)
+{
+    mFrames = frames;
+    mLearned = 0;
+    mKappa = kappa;
+    mCounts.clear();
+}
+
+bool HotPixelLearner::add(const HotPixelMap &map, const uint8_t *frame, const HotPixelMap::Subframe &subframe)
+{
+    if (!isLearning())
+        return false;
+
+    // new subframe, start over
+    if (mLearned > 0 && memcmp(&subframe, &mSubframe, sizeof(subframe)) != 0)
+        start(mFrames, mKappa);
+    mSubframe = subframe;
+
+    // merge the frame candidates in the sorted counts
+    std::vector<uint32_t> candidates = map.candidates(frame, subframe, mKappa);
+    std::vector<std::pair<uint32_t, uint16_t>> counts;
+    counts.reserve(mCounts.size() + candidates.size());
+    auto it = mCounts.begin();
+    for (uint32_t index : candidates)
+    {
+        for (; it != mCounts.end() && it->first < index; ++it)
+            counts.push_back(*it);
+        if (it != mCounts.end() && it->first == index)
+            counts.emplace_back(index, (it++)->second + 1);
+        else
+            counts.emplace_back(index, 1);
+    }
+    counts.insert(counts.end(), it, mCounts.end());
+    mCounts.swap(counts);
+
+    return ++mLearned >= mFrames;
+}
+
+std::vector<uint32_t> HotPixelLearner::result() const
+{
+    std::vector<uint32_t> index;
+    for (const auto &count : mCounts)
+    {
+        if (count.second * 4 >= mLearned * 3)
+            index.push_back(count.first);
+    }
+    return index;
+}
@@ -0,0 +1,108 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "svb_cfa.h"
+
+// Hot pixels map
+// Hot pixels are kept as a sorted list of sensor indexes (y * sensor width + x), the
+// correction only visits the listed pixels of the subframe.
+class HotPixelMap
+{
+    public:
+        /** Subframe of a frame, in sensor coordinates */
+        struct Subframe
+        {
+            uint32_t x, y, width, height;
+            uint32_t bitDepth;
+        };
+
+        /** Sensor geometry and colour filter, mono when bayer is false */
+        void setSensor(uint32_t width, uint32_t height, bool bayer, SVB_BAYER_PATTERN pattern);
+
+        /** Read or write the map file, false on error */
+        bool load(const std::string &path);
+        bool save(const std::string &path) const;
+
+        void clear() { mIndex.clear(); }
+        size_t size() const { return mIndex.size(); }
+
+        /** Replace the map with the pixels of a dark frame standing kappa sigma above their neighbours */
+        size_t build(const uint8_t *frame, const Subframe &subframe, double kappa);
+
+        /** Merge sorted sensor indexes in the map */
+        void merge(const std::vector<uint32_t> &index);
+
+        /** Replace the hot pixels of the subframe by the median of their same colour neighbours */
+        size_t correct(uint8_t *frame, const Subframe &subframe) const;
+
+        /** Sensor indexes of the pixels standing kappa sigma above their same colour neighbours */
+        std::vector<uint32_t> candidates(const uint8_t *frame, const Subframe &subframe, double kappa) const;
+
+    private:
+        template <typename T> std::vector<uint32_t> findCandidates(const T *frame, const Subframe &subframe,
+                double kappa) const;
+        template <typename T> size_t replace(T *frame, const Subframe &subframe) const;
+        template <typename T> uint32_t neighboursMedian(const T *frame, const Subframe &subframe,
+                uint32_t column, uint32_t row) const;
+
+        uint32_t mWidth = 0, mHeight = 0;
+        bool mBayer = false;
+        SVB_BAYER_PATTERN mPattern = SVB_BAYER_RG;
+        std::vector<uint32_t> mIndex;
+};
+
+// Learn hot pixels from streamed frames
+// Pixels found above their neighbours in most of the frames are hot, stars and noise are not
+// at the same place frame after frame.
+class HotPixelLearner
+{
+    public:
+        /** Start learning over a number of frames */
+        void start(size_t frames, double kappa);
+        void stop() { mFrames = 0; mCounts.clear(); }
+
+        bool isLearning() const { return mFrames > 0; }
+        size_t learned() const { return mLearned; }
+
+        /** Count the candidates of a frame, true when the learning is done */
+        bool add(const HotPixelMap &map, const uint8_t *frame, const HotPixelMap::Subframe &subframe);
+
+        /** Sorted sensor indexes found in at least 3/4 of the frames */
+        std::vector<uint32_t> result() const;
+
+    private:
+        size_t mFrames = 0;
+        size_t mLearned = 0;
+        double mKappa = 6;
+        HotPixelMap::Subframe mSubframe {0, 0, 0, 0, 0};
+        std::vector<std::pair<uint32_t, uint16_t>> mCounts;
+};
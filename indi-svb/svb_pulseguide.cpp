@@ -0,0 +1,183 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_pulseguide.h"
+#include "svb_threads.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+const std::array<double, PulseScheduler::histogramBins - 1> PulseScheduler::histogramLimits =
+{
+    -10, -5, -2, -1, 1, 2, 5, 10, 20
+};
+
+PulseScheduler::~PulseScheduler()
+{
+    stop();
+}
+
+void PulseScheduler::start(Issuer issuer, Completion completion)
+{
+    stop();
+
+    std::unique_lock<std::mutex> guard(mLock);
+    mIssuer = issuer;
+    mCompletion = completion;
+    mQuit = false;
+    for (int axis = RA; axis <= DEC; axis++)
+    {
+        mAxes[axis].pending = 0;
+        mAxes[axis].running = false;
+        mAxes[axis].thread = std::thread(&PulseScheduler::run, this, static_cast<Axis>(axis));
+    }
+}
+
+void PulseScheduler::stop()
+{
+    {
+        std::unique_lock<std::mutex> guard(mLock);
+        mQuit = true;
+        mAxes[RA].pending = mAxes[DEC].pending = 0;
+    }
+    mWake.notify_all();
+
+    for (auto &axis : mAxes)
+        if (axis.thread.joinable())
+            axis.thread.join();
+}
+
+bool PulseScheduler::request(Axis axis, int ms, Policy policy)
+{
+    {
+        std::unique_lock<std::mutex> guard(mLock);
+        if (mQuit)
+            return false;
+
+        AxisState &state = mAxes[axis];
+        if (state.pending != 0)
+        {
+            mTiming.merged++;
+            state.pending = policy == MERGE ? state.pending + ms : ms;
+        }
+        else
+        {
+            state.pending = ms;
+            state.requested = Clock::now();
+        }
+
+        // a running pulse completes the axis, an idle one has nothing left to run
+        if (state.pending == 0 && !state.running)
+            return false;
+    }
+    mWake.notify_all();
+    return true;
+}
+
+bool PulseScheduler::isIdle() const
+{
+    std::unique_lock<std::mutex> guard(mLock);
+    for (const auto &axis : mAxes)
+        if (axis.running || axis.pending != 0)
+            return false;
+    return true;
+}
+
+PulseScheduler::Timing PulseScheduler::timing() const
+{
+    std::unique_lock<std::mutex> guard(mLock);
+    return mTiming;
+}
+
+void PulseScheduler::resetTiming()
+{
+    std::unique_lock<std::mutex> guard(mLock);
+    mTiming = Timing {};
+    mSumJitter = mSumLatency = 0;
+}
+
+void PulseScheduler::run(Axis axis)
+{
+    ThreadTuning::setName(axis == RA ? "svb pulse ra" : "svb pulse dec");
+    AxisState &state = mAxes[axis];
+    std::unique_lock<std::mutex> guard(mLock);
+
+    while (true)
+    {
+        mWake.wait(guard, [&]()
+        {
+            return mQuit || state.pending != 0;
+        });
+        if (mQuit)
+            return;
+
+        const int ms = state.pending;
+        const Clock::time_point requested = state.requested;
+        state.pending = 0;
+        state.running = true;
+        guard.unlock();
+
+        Clock::time_point begin = Clock::now();
+        bool ok = mIssuer(axis, ms);
+        Clock::time_point end = Clock::now();
+
+        // pulses of an axis do not overlap even if the SDK returned early
+        auto duration = std::chrono::milliseconds(std::abs(ms));
+        if (ok && end - begin < duration)
+            std::this_thread::sleep_until(begin + duration);
+
+        guard.lock();
+        state.running = false;
+        if (!ok)
+        {
+            mTiming.failed++;
+        }
+        else
+        {
+            const double actual = std::chrono::duration<double, std::milli>(end - begin).count();
+            const double latency = std::chrono::duration<double, std::milli>(begin - requested).count();
+            const double jitter = actual - std::abs(ms);
+
+            mTiming.pulses++;
+            mSumJitter += jitter;
+            mSumLatency += latency;
+            mTiming.meanJitter = mSumJitter / mTiming.pulses;
+            mTiming.meanLatency = mSumLatency / mTiming.pulses;
+            mTiming.maxJitter = std::max(mTiming.maxJitter, std::fabs(jitter));
+            size_t bin = std::upper_bound(histogramLimits.begin(), histogramLimits.end(), jitter) - histogramLimits.begin();
+            mTiming.histogram[bin]++;
+        }
+
+        // a pulse requested meanwhile goes on at once
+        if (state.pending == 0 && mCompletion)
+        {
+            guard.unlock();
+            mCompletion(axis);
+            guard.lock();
+        }
+    }
+}
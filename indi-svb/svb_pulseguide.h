@@ -0,0 +1,109 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Guide pulse scheduler
+// Each axis has its own thread issuing the blocking pulses, so that RA and DEC corrections
+// run together and callers never wait for the mount. A pulse requested while its axis is busy
+// is kept pending, merged with the pending one (signed sum) or replacing it. The duration of
+// every pulse is measured against the request and kept as a jitter histogram.
+class PulseScheduler
+{
+    public:
+        enum Axis { RA, DEC };
+        enum Policy { MERGE, REPLACE };
+
+        // blocking pulse on an axis, > 0 west or north, < 0 east or south, false on error
+        typedef std::function<bool(Axis axis, int ms)> Issuer;
+        // called from the axis thread when its pulses are done
+        typedef std::function<void(Axis axis)> Completion;
+
+        // jitter histogram, bins limits in ms
+        static const size_t histogramBins = 10;
+        static const std::array<double, histogramBins - 1> histogramLimits;
+
+        struct Timing
+        {
+            size_t pulses;          // issued
+            size_t merged;          // requests merged in, or replacing, a pending pulse
+            size_t failed;
+            double meanJitter;      // actual - requested, ms
+            double maxJitter;       // largest absolute jitter, ms
+            double meanLatency;     // request to pulse start, ms
+            std::array<size_t, histogramBins> histogram;
+        };
+
+        ~PulseScheduler();
+
+        /** Start the axis threads */
+        void start(Issuer issuer, Completion completion);
+
+        /** Drop pending pulses, wait for the running ones and stop the threads */
+        void stop();
+
+        /**
+         * Queue a signed pulse on an axis, 0 cancels the pending one.
+         * Returns false when the axis is left idle (opposite pulses merged to 0, a cancel), no completion follows.
+         */
+        bool request(Axis axis, int ms, Policy policy);
+
+        /** No pulse running nor pending */
+        bool isIdle() const;
+
+        Timing timing() const;
+        void resetTiming();
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct AxisState
+        {
+            std::thread thread;
+            int pending = 0;
+            Clock::time_point requested;
+            bool running = false;
+        };
+
+        void run(Axis axis);
+
+        mutable std::mutex mLock;
+        std::condition_variable mWake;
+        bool mQuit = true;
+        AxisState mAxes[2];
+        Issuer mIssuer;
+        Completion mCompletion;
+
+        Timing mTiming {};
+        double mSumJitter = 0, mSumLatency = 0;
+};
@@ -0,0 +1,210 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_rice.h"
+#include "svb_bitstream.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// fsBits codes the split of a block, fsMax flags a block stored raw on bBits
+template <typename T, int fsBits, int fsMax, int bBits>
+size_t riceCompress(const T *pixels, size_t n, uint8_t *out, uint32_t bias)
+{
+    const uint32_t mask = (1u << bBits) - 1;
+    BitStream::Writer writer(out);
+    if (n == 0)
+        return 0;
+
+    // first pixel as is, then the differences, mapped to unsigned by interleaving the signs
+    writer.put((pixels[0] ^ bias) & mask, bBits);
+    uint32_t previous = pixels[0];
+    uint32_t diff[Rice::blockSize];
+    for (size_t i = 0; i < n; i += Rice::blockSize)
+    {
+        size_t count = std::min(Rice::blockSize, n - i);
+        uint64_t sum = 0;
+        for (size_t j = 0; j < count; j++)
+        {
+            uint32_t next = pixels[i + j];
+            int32_t d = static_cast<int32_t>((next - previous) << (32 - bBits)) >> (32 - bBits);
+            diff[j] = static_cast<uint32_t>(d < 0 ? ~(d << 1) : d << 1) & mask;
+            sum += diff[j];
+            previous = next;
+        }
+
+        // split from the mean difference, as cfitsio does
+        double mean = (double(sum) - int(count / 2) - 1) / count;
+        uint32_t psum = static_cast<uint32_t>(std::max(mean, 0.0)) >> 1;
+        int fs = 0;
+        for (; psum > 0; fs++)
+            psum >>= 1;
+
+        // a block whose codes would outgrow its raw size is stored raw
+        bool raw = fs >= fsMax;
+        if (!raw && sum > 0)
+        {
+            uint64_t bits = 0;
+            for (size_t j = 0; j < count; j++)
+                bits += (diff[j] >> fs) + 1 + fs;
+            raw = bits >= count * bBits;
+        }
+
+        if (raw)
+            BitStream::putRawBlock(writer, diff, count, fsBits, fsMax + 1, bBits);
+        else if (sum == 0)
+            BitStream::putZeroBlock(writer, fsBits);
+        else
+            BitStream::putRiceBlock(writer, diff, count, fsBits, fs);
+    }
+    writer.flush();
+    return writer.out - out;
+}
+
+}
+
+namespace Rice
+{
+
+size_t bound(size_t n, int bitDepth)
+{
+    size_t blocks = (n + blockSize - 1) / blockSize;
+    int bBits = bitDepth == 16 ? 16 : 8;
+    int fsBits = bitDepth == 16 ? 4 : 3;
+    return (bBits + blocks * fsBits + n * bBits + 7) / 8;
+}
+
+size_t compress(const uint16_t *pixels, size_t n, uint8_t *out)
+{
+    return riceCompress<uint16_t, 4, 14, 16>(pixels, n, out, 0x8000);
+}
+
+size_t compress(const uint8_t *pixels, size_t n, uint8_t *out)
+{
+    return riceCompress<uint8_t, 3, 6, 8>(pixels, n, out, 0);
+}
+
+}
+
+TileCompressor::TileCompressor(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // the calling thread is a worker too
+    for (unsigned i = 1; i < threads; i++)
+        mThreads.emplace_back(&TileCompressor::worker, this);
+}
+
+TileCompressor::~TileCompressor()
+{
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mQuit = true;
+    }
+    mWork.notify_all();
+    for (auto &thread : mThreads)
+        thread.join();
+}
+
+void TileCompressor::compress(const uint8_t *frame, uint32_t width, uint32_t rows, int bitDepth)
+{
+    mFrame = frame;
+    mWidth = width;
+    mRows = rows;
+    mBitDepth = bitDepth;
+    mNextChunk = 0;
+    mChunks.resize((rows + chunkRows - 1) / chunkRows);
+    mTiles.resize(rows);
+
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mGeneration++;
+        mBusy = static_cast<unsigned>(mThreads.size());
+    }
+    mWork.notify_all();
+
+    compressChunks();
+
+    std::unique_lock<std::mutex> guard(mLock);
+    mDone.wait(guard, [this] { return mBusy == 0; });
+}
+
+size_t TileCompressor::size() const
+{
+    size_t size = 0;
+    for (const auto &tile : mTiles)
+        size += tile.size;
+    return size;
+}
+
+void TileCompressor::worker()
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(mLock);
+            mWork.wait(guard, [&] { return mQuit || mGeneration != generation; });
+            if (mQuit)
+                return;
+            generation = mGeneration;
+        }
+
+        compressChunks();
+
+        std::lock_guard<std::mutex> guard(mLock);
+        if (--mBusy == 0)
+            mDone.notify_all();
+    }
+}
+
+void TileCompressor::compressChunks()
+{
+    size_t pixelSize = mBitDepth == 16 ? 2 : 1;
+    size_t rowBound = Rice::bound(mWidth, mBitDepth);
+    for (uint32_t chunk = mNextChunk++; chunk < mChunks.size(); chunk = mNextChunk++)
+    {
+        uint32_t first = chunk * chunkRows;
+        uint32_t last = std::min(first + chunkRows, mRows);
+        std::vector<uint8_t> &buffer = mChunks[chunk];
+        if (buffer.size() < (last - first) * rowBound)
+            buffer.resize((last - first) * rowBound);
+
+        size_t offset = 0;
+        for (uint32_t row = first; row < last; row++)
+        {
+            const uint8_t *pixels = mFrame + size_t(row) * mWidth * pixelSize;
+            size_t size = mBitDepth == 16 ?
+                          Rice::compress(reinterpret_cast<const uint16_t *>(pixels), mWidth, buffer.data() + offset) :
+                          Rice::compress(pixels, mWidth, buffer.data() + offset);
+            mTiles[row] = Tile {chunk, offset, size};
+            offset += size;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Rice tile compression
+// Frames are compressed with the FITS tiled image Rice algorithm (RICE_1, blocks of 32 pixels,
+// one tile per row as fpack does), rows being shared out to a pool of worker threads. The tiles
+// are the COMPRESSED_DATA cells of a tile compressed FITS image.
+namespace Rice
+{
+
+static const size_t blockSize = 32;
+
+/** Largest compressed size of n pixels */
+size_t bound(size_t n, int bitDepth);
+
+/** Compress n pixels to out, 16 bits pixels are stored signed (BZERO 32768), returns the size */
+size_t compress(const uint16_t *pixels, size_t n, uint8_t *out);
+size_t compress(const uint8_t *pixels, size_t n, uint8_t *out);
+
+}
+
+class TileCompressor
+{
+    public:
+        explicit TileCompressor(unsigned threads = 0);
+        ~TileCompressor();
+
+        /** Compress rows of width 8 or 16 bits pixels, a tile per row */
+        void compress(const uint8_t *frame, uint32_t width, uint32_t rows, int bitDepth);
+
+        size_t tiles() const { return mTiles.size(); }
+        const uint8_t *tile(size_t index) const { return mChunks[mTiles[index].chunk].data() + mTiles[index].offset; }
+        size_t tileSize(size_t index) const { return mTiles[index].size; }
+
+        /** Compressed bytes of the last frame */
+        size_t size() const;
+
+    private:
+        struct Tile
+        {
+            uint32_t chunk;
+            size_t offset, size;
+        };
+
+        // rows compressed by a worker in one go
+        static const uint32_t chunkRows = 16;
+
+        void worker();
+        void compressChunks();
+
+        std::vector<std::thread> mThreads;
+        std::mutex mLock;
+        std::condition_variable mWork, mDone;
+        uint64_t mGeneration = 0;
+        unsigned mBusy = 0;
+        bool mQuit = false;
+
+        // current job
+        const uint8_t *mFrame = nullptr;
+        uint32_t mWidth = 0, mRows = 0;
+        int mBitDepth = 0;
+        std::atomic<uint32_t> mNextChunk {0};
+
+        std::vector<std::vector<uint8_t>> mChunks;
+        std::vector<Tile> mTiles;
+};
@@ -0,0 +1,288 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_ser.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+// .NET ticks of the unix epoch
+static const int64_t unixEpochTicks = 621355968000000000LL;
+
+static const size_t headerSize = 178;
+
+static void put32(std::vector<uint8_t> &header, size_t offset, int32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        header[offset + i] = static_cast<uint8_t>(uint32_t(value) >> (8 * i));
+}
+
+static void put64(uint8_t *data, int64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        data[i] = static_cast<uint8_t>(uint64_t(value) >> (8 * i));
+}
+
+static void putString(std::vector<uint8_t> &header, size_t offset, const std::string &text)
+{
+    memcpy(header.data() + offset, text.data(), std::min<size_t>(text.size(), 40));
+}
+
+SerWriter::~SerWriter()
+{
+    close();
+    free(mStaging);
+}
+
+size_t SerWriter::frameSize(const Format &format)
+{
+    return size_t(format.width) * format.height * (format.bitDepth > 8 ? 2 : 1) * (format.colorId == RGB ? 3 : 1);
+}
+
+std::vector<uint8_t> SerWriter::header() const
+{
+    std::vector<uint8_t> header(headerSize, 0);
+    memcpy(header.data(), "LUCAM-RECORDER", 14);
+    put32(header, 14, 0);
+    put32(header, 18, mFormat.colorId);
+    // 0 as written by the common capture tools for little endian data
+    put32(header, 22, 0);
+    put32(header, 26, mFormat.width);
+    put32(header, 30, mFormat.height);
+    put32(header, 34, mFormat.bitDepth);
+    put32(header, 38, frames());
+    putString(header, 42, mFormat.observer);
+    putString(header, 82, mFormat.instrument);
+    putString(header, 122, mFormat.telescope);
+
+    // start of the recording, local and UTC
+    time_t now = std::chrono::system_clock::to_time_t(mOpenTime);
+    struct tm local;
+    localtime_r(&now, &local);
+    int64_t utc = unixEpochTicks + std::chrono::duration_cast<std::chrono::microseconds>
+                  (mOpenTime.time_since_epoch()).count() * 10;
+    put64(header.data() + 162, utc + int64_t(local.tm_gmtoff) * 10000000);
+    put64(header.data() + 170, utc);
+    return header;
+}
+
+bool SerWriter::open(const std::string &path, const Format &format, bool direct)
+{
+    close();
+
+    mPath = path;
+    mFormat = format;
+    mStaged = 0;
+    mWritten = 0;
+    mTimestamps.clear();
+    mOpenClock = Clock::now();
+    mOpenTime = std::chrono::system_clock::now();
+
+    // file systems without O_DIRECT get buffered writes
+    mDirect = false;
+    if (direct)
+    {
+        mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        mDirect = mFd >= 0;
+    }
+    if (mFd < 0)
+        mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mFd < 0)
+        return false;
+
+    if (mDirect && mStaging == nullptr && posix_memalign(reinterpret_cast<void **>(&mStaging), blockSize, stagingSize) != 0)
+    {
+        mStaging = nullptr;
+        ::close(mFd);
+        mFd = -1;
+        errno = ENOMEM;
+        return false;
+    }
+
+    // the frame count is updated on close
+    std::vector<uint8_t> data = header();
+    if (mDirect)
+    {
+        memcpy(mStaging, data.data(), data.size());
+        mStaged = data.size();
+        return true;
+    }
+    return writeAll(data.data(), data.size());
+}
+
+bool SerWriter::writeAll(const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(mFd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+        mWritten += written;
+    }
+    return true;
+}
+
+bool SerWriter::flushStaging()
+{
+    bool ok = writeAll(mStaging, mStaged);
+    mStaged = 0;
+    return ok;
+}
+
+bool SerWriter::add(const uint8_t *frame, Clock::time_point captured)
+{
+    if (mFd < 0)
+    {
+        errno = EBADF;
+        return false;
+    }
+
+    auto offset = std::chrono::duration_cast<std::chrono::microseconds>(captured - mOpenClock);
+    mTimestamps.push_back(unixEpochTicks + std::chrono::duration_cast<std::chrono::microseconds>
+                          (mOpenTime.time_since_epoch() + offset).count() * 10);
+
+    // buffered files get the frame straight from the capture buffer
+    size_t size = frameSize();
+    if (!mDirect)
+        return writeAll(frame, size);
+
+    // direct files get whole staging buffers
+    while (size > 0)
+    {
+        size_t chunk = std::min(size, stagingSize - mStaged);
+        memcpy(mStaging + mStaged, frame, chunk);
+        mStaged += chunk;
+        frame += chunk;
+        size -= chunk;
+        if (mStaged == stagingSize && !flushStaging())
+            return false;
+    }
+    return true;
+}
+
+bool SerWriter::close()
+{
+    if (mFd < 0)
+        return true;
+
+    bool ok = true;
+
+    // the tail is not block sized, finish without O_DIRECT
+    if (mDirect)
+    {
+        int flags = fcntl(mFd, F_GETFL);
+        ok = flags >= 0 && fcntl(mFd, F_SETFL, flags & ~O_DIRECT) == 0;
+        ok = ok && flushStaging();
+    }
+
+    // timestamps trailer, then the header with the frame count
+    std::vector<uint8_t> trailer(mTimestamps.size() * 8);
+    for (size_t i = 0; i < mTimestamps.size(); i++)
+        put64(trailer.data() + i * 8, mTimestamps[i]);
+    ok = ok && writeAll(trailer.data(), trailer.size());
+
+    std::vector<uint8_t> data = header();
+    ok = ok && pwrite(mFd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size());
+
+    int error = errno;
+    if (::close(mFd) != 0)
+        ok = false;
+    else if (!ok)
+        errno = error;
+    mFd = -1;
+    return ok;
+}
+
+bool SerRecorder::start(const std::string &directory, const std::string &prefix, const SerWriter::Format &format,
+                        uint64_t maxFileSize, bool direct)
+{
+    stop();
+
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+
+    mBasePath = directory + "/" + prefix + "_" + stamp;
+    mFormat = format;
+    mMaxFileSize = maxFileSize;
+    mDirect = direct;
+    mFrames = mBytes = 0;
+    mFiles = 0;
+    return openNext();
+}
+
+bool SerRecorder::openNext()
+{
+    char index[16];
+    snprintf(index, sizeof(index), "_%03u.ser", mFiles);
+    if (!mWriter.open(mBasePath + index, mFormat, mDirect))
+        return false;
+    mFiles++;
+    return true;
+}
+
+bool SerRecorder::add(const uint8_t *frame, SerWriter::Clock::time_point captured)
+{
+    if (!mWriter.isOpen())
+    {
+        errno = EBADF;
+        return false;
+    }
+
+    // a file holds at least one frame
+    size_t size = mWriter.frameSize();
+    if (mMaxFileSize > 0 && mWriter.frames() > 0 && mWriter.size() + size > mMaxFileSize)
+    {
+        if (!mWriter.close() || !openNext())
+            return false;
+    }
+
+    if (!mWriter.add(frame, captured))
+        return false;
+
+    mFrames++;
+    mBytes += size;
+    return true;
+}
+
+bool SerRecorder::stop()
+{
+    return mWriter.close();
+}
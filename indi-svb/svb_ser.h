@@ -0,0 +1,132 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SER video writer
+// Frames are written with large sequential writes: straight from the capture buffer, or
+// through an aligned staging buffer written in whole blocks when the file is opened with
+// O_DIRECT. Timestamps come from the monotonic capture clock and are converted to UTC for
+// the trailer. Functions returning false leave errno set.
+class SerWriter
+{
+    public:
+        enum ColorId { MONO = 0, BAYER_RGGB = 8, BAYER_GRBG = 9, BAYER_GBRG = 10, BAYER_BGGR = 11, RGB = 100 };
+
+        typedef std::chrono::steady_clock Clock;
+
+        struct Format
+        {
+            uint32_t width, height;
+            uint32_t bitDepth;      // 8 or 16, little endian
+            int32_t colorId;
+            std::string observer, instrument, telescope;
+        };
+
+        // O_DIRECT needs block aligned buffers, sizes and offsets
+        static const size_t blockSize = 4096;
+        static const size_t stagingSize = 4 << 20;
+
+        ~SerWriter();
+
+        /** Create the file and write its header, direct asks for O_DIRECT */
+        bool open(const std::string &path, const Format &format, bool direct);
+
+        /** Append a frame captured at a time of the monotonic clock */
+        bool add(const uint8_t *frame, Clock::time_point captured);
+
+        /** Flush the frames, write the timestamps trailer and the frame count */
+        bool close();
+
+        bool isOpen() const { return mFd >= 0; }
+        bool isDirect() const { return mDirect; }
+        const std::string &path() const { return mPath; }
+        size_t frameSize() const { return frameSize(mFormat); }
+
+        /** Bytes of a frame of a format */
+        static size_t frameSize(const Format &format);
+        uint32_t frames() const { return static_cast<uint32_t>(mTimestamps.size()); }
+
+        /** Bytes of the file so far, without the trailer */
+        uint64_t size() const { return mWritten + mStaged; }
+
+    private:
+        bool writeAll(const uint8_t *data, size_t size);
+        bool flushStaging();
+        std::vector<uint8_t> header() const;
+
+        int mFd = -1;
+        bool mDirect = false;
+        std::string mPath;
+        Format mFormat;
+
+        uint8_t *mStaging = nullptr;
+        size_t mStaged = 0;
+        uint64_t mWritten = 0;
+
+        // UTC ticks (100 ns since 0001-01-01) of the frames, and the clocks at open
+        std::vector<int64_t> mTimestamps;
+        Clock::time_point mOpenClock;
+        std::chrono::system_clock::time_point mOpenTime;
+};
+
+// SER recording in files rotated at a size limit
+class SerRecorder
+{
+    public:
+        /** Start recording in directory/prefix_date_time_index.ser */
+        bool start(const std::string &directory, const std::string &prefix, const SerWriter::Format &format,
+                   uint64_t maxFileSize, bool direct);
+
+        /** Append a frame, rotating to the next file when the limit is reached */
+        bool add(const uint8_t *frame, SerWriter::Clock::time_point captured);
+
+        /** Close the current file */
+        bool stop();
+
+        bool isRecording() const { return mWriter.isOpen(); }
+        bool isDirect() const { return mWriter.isDirect(); }
+        const std::string &path() const { return mWriter.path(); }
+        uint64_t frames() const { return mFrames; }
+        uint64_t bytes() const { return mBytes; }
+        uint32_t files() const { return mFiles; }
+
+    private:
+        bool openNext();
+
+        SerWriter mWriter;
+        SerWriter::Format mFormat;
+        std::string mBasePath;
+        uint64_t mMaxFileSize = 0;
+        bool mDirect = false;
+        uint64_t mFrames = 0, mBytes = 0;
+        uint32_t mFiles = 0;
+};
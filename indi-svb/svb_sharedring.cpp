@@ -0,0 +1,290 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_sharedring.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace SharedRing
+{
+
+static_assert(sizeof(RingHeader) <= pageSize, "ring header must fit a page");
+static_assert(sizeof(SlotHeader) % 8 == 0, "frames must stay 8 bytes aligned");
+
+static size_t alignPage(size_t size)
+{
+    return (size + pageSize - 1) & ~(pageSize - 1);
+}
+
+// shared futex, the ring is mapped by several processes
+static void futexWake(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static void futexWait(const uint32_t *word, uint32_t value, int timeout)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    syscall(SYS_futex, word, FUTEX_WAIT, value, &ts, nullptr, 0);
+}
+
+Writer::~Writer()
+{
+    close();
+}
+
+bool Writer::open(const std::string &name, uint32_t slots, size_t frameSize)
+{
+    close();
+
+    size_t slotSize = alignPage(sizeof(SlotHeader) + frameSize);
+    if (frameSize == 0 || slots < 2 || slotSize > UINT32_MAX)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    size_t mapSize = pageSize + size_t(slots) * slotSize;
+
+    // readers of a stale ring keep their mapping, the new ring is a new object
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(mapSize)) == 0)
+        map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        errno = error;
+        return false;
+    }
+
+    mName = name;
+    mMap = static_cast<uint8_t *>(map);
+    mMapSize = mapSize;
+    mSlots = slots;
+    mSlotSize = slotSize;
+
+    // the object is new, slots are zero
+    mHeader = reinterpret_cast<RingHeader *>(mMap);
+    memcpy(mHeader->magic, ringMagic, sizeof(ringMagic));
+    mHeader->headerSize = pageSize;
+    mHeader->slots = slots;
+    mHeader->slotSize = static_cast<uint32_t>(slotSize);
+    mHeader->frameSize = static_cast<uint32_t>(slotSize - sizeof(SlotHeader));
+    mHeader->writerPid = static_cast<uint32_t>(getpid());
+    // readers check the version last
+    __atomic_store_n(&mHeader->version, ringVersion, __ATOMIC_RELEASE);
+    return true;
+}
+
+void Writer::close()
+{
+    if (mMap == nullptr)
+        return;
+
+    __atomic_store_n(&mHeader->closed, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&mHeader->futex, 1, __ATOMIC_RELEASE);
+    futexWake(&mHeader->futex);
+
+    munmap(mMap, mMapSize);
+    shm_unlink(mName.c_str());
+    mMap = nullptr;
+    mHeader = nullptr;
+    mSlots = 0;
+}
+
+bool Writer::add(const uint8_t *frame, size_t size, uint32_t width, uint32_t height, uint32_t bitDepth, int32_t colorId,
+                 uint64_t timestamp)
+{
+    if (mHeader == nullptr || size > mHeader->frameSize)
+        return false;
+
+    uint64_t sequence = mHeader->sequence + 1;
+    SlotHeader *header = reinterpret_cast<SlotHeader *>(mMap + pageSize + (sequence % mSlots) * mSlotSize);
+
+    // a reader of this slot sees the sequence change and drops the frame
+    __atomic_store_n(&header->sequence, 0, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(reinterpret_cast<uint8_t *>(header) + sizeof(SlotHeader), frame, size);
+    __atomic_store_n(&header->timestamp, timestamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->width, width, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->height, height, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->bitDepth, bitDepth, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->colorId, colorId, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->size, static_cast<uint32_t>(size), __ATOMIC_RELAXED);
+    __atomic_store_n(&header->sequence, sequence, __ATOMIC_RELEASE);
+    __atomic_store_n(&mHeader->sequence, sequence, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&mHeader->futex, 1, __ATOMIC_RELEASE);
+    futexWake(&mHeader->futex);
+    return true;
+}
+
+Reader::~Reader()
+{
+    close();
+}
+
+bool Reader::open(const std::string &name)
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    // the header tells the size of the ring, a ring still being created is not ready
+    struct stat st;
+    RingHeader header;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < pageSize ||
+            pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error != 0 ? error : EAGAIN;
+        return false;
+    }
+    size_t mapSize = header.headerSize + size_t(header.slots) * header.slotSize;
+    if (memcmp(header.magic, ringMagic, sizeof(ringMagic)) != 0 || header.version != ringVersion ||
+            header.headerSize != pageSize || header.slots < 2 || header.slotSize < sizeof(SlotHeader) + header.frameSize ||
+            mapSize > size_t(st.st_size))
+    {
+        ::close(fd);
+        errno = header.version == 0 ? EAGAIN : EINVAL;
+        return false;
+    }
+
+    void *map = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        errno = error;
+        return false;
+    }
+
+    mMap = static_cast<const uint8_t *>(map);
+    mMapSize = mapSize;
+    mHeader = reinterpret_cast<const RingHeader *>(mMap);
+    mLast = 0;
+    mSkipped = 0;
+    return true;
+}
+
+void Reader::close()
+{
+    if (mMap != nullptr)
+        munmap(const_cast<uint8_t *>(mMap), mMapSize);
+    mMap = nullptr;
+    mHeader = nullptr;
+}
+
+const SlotHeader *Reader::slot(uint64_t sequence) const
+{
+    return reinterpret_cast<const SlotHeader *>(mMap + pageSize + (sequence % mHeader->slots) * mHeader->slotSize);
+}
+
+bool Reader::next(Frame &frame, int timeout)
+{
+    if (mHeader == nullptr)
+    {
+        errno = EBADF;
+        return false;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    for (;;)
+    {
+        // the futex value is read first, a frame published after it ends the wait at once
+        uint32_t futex = __atomic_load_n(&mHeader->futex, __ATOMIC_ACQUIRE);
+        uint64_t newest = __atomic_load_n(&mHeader->sequence, __ATOMIC_ACQUIRE);
+        if (newest > mLast)
+        {
+            const SlotHeader *header = slot(newest);
+            if (__atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE) == newest)
+            {
+                frame.sequence = newest;
+                frame.timestamp = __atomic_load_n(&header->timestamp, __ATOMIC_RELAXED);
+                frame.width = __atomic_load_n(&header->width, __ATOMIC_RELAXED);
+                frame.height = __atomic_load_n(&header->height, __ATOMIC_RELAXED);
+                frame.bitDepth = __atomic_load_n(&header->bitDepth, __ATOMIC_RELAXED);
+                frame.colorId = __atomic_load_n(&header->colorId, __ATOMIC_RELAXED);
+                frame.size = __atomic_load_n(&header->size, __ATOMIC_RELAXED);
+                frame.data = reinterpret_cast<const uint8_t *>(header) + sizeof(SlotHeader);
+                if (isValid(frame) && frame.size <= mHeader->frameSize)
+                {
+                    if (mLast > 0)
+                        mSkipped += newest - mLast - 1;
+                    mLast = newest;
+                    return true;
+                }
+            }
+            // overwritten while reading, a newer frame is there
+            continue;
+        }
+
+        if (__atomic_load_n(&mHeader->closed, __ATOMIC_ACQUIRE))
+        {
+            errno = EPIPE;
+            return false;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+        {
+            errno = ETIMEDOUT;
+            return false;
+        }
+        futexWait(&mHeader->futex, futex, static_cast<int>(remaining.count()));
+    }
+}
+
+bool Reader::isValid(const Frame &frame) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return __atomic_load_n(&slot(frame.sequence)->sequence, __ATOMIC_RELAXED) == frame.sequence;
+}
+
+}
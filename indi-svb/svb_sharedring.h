@@ -0,0 +1,146 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Shared memory frame ring
+// The driver publishes the stream into a POSIX shared memory object so that clients on the same
+// host read the frames in place, without BLOB encoding. Slots are page aligned and hold a frame
+// behind a sequence number, 0 while the slot is written. Readers wait on a futex in the header
+// that the writer bumps with every frame, and check the slot sequence after using a frame: a
+// reader slower than the ring sees its frame overwritten and drops it. The reader does not
+// depend on INDI, clients link the svbshm library.
+namespace SharedRing
+{
+
+struct RingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slots;
+    uint32_t slotSize;          // slot header and frame, page aligned
+    uint32_t frameSize;         // largest frame
+    uint32_t writerPid;
+    uint32_t futex;             // bumped by every frame and when the ring closes
+    uint32_t closed;            // the writer is gone, readers should reopen
+    uint64_t sequence;          // last frame published, 0 when empty
+};
+
+struct SlotHeader
+{
+    uint64_t sequence;          // 0 while the slot is written
+    uint64_t timestamp;         // UTC microseconds of the capture
+    uint32_t width, height;
+    uint32_t bitDepth;          // 8 or 16, little endian
+    int32_t colorId;            // SER color id, RGB (100) frames are interleaved
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// a frame in place in the ring
+struct Frame
+{
+    uint64_t sequence;
+    uint64_t timestamp;
+    uint32_t width, height;
+    uint32_t bitDepth;
+    int32_t colorId;
+    uint32_t size;
+    const uint8_t *data;
+};
+
+const char ringMagic[8] = {'S', 'V', 'B', 'S', 'H', 'M', 'R', 0};
+const uint32_t ringVersion = 1;
+const size_t pageSize = 4096;
+
+class Writer
+{
+    public:
+        ~Writer();
+
+        /** Create the shared memory object, replacing a stale one, returns false and sets errno on error */
+        bool open(const std::string &name, uint32_t slots, size_t frameSize);
+
+        /** Wake the readers, unmap and unlink the object */
+        void close();
+
+        /** Publish a frame over the oldest one, false if it is larger than the slots */
+        bool add(const uint8_t *frame, size_t size, uint32_t width, uint32_t height, uint32_t bitDepth, int32_t colorId,
+                 uint64_t timestamp);
+
+        bool isOpen() const { return mHeader != nullptr; }
+        const std::string &name() const { return mName; }
+        uint32_t slots() const { return mSlots; }
+        uint64_t sequence() const { return mHeader != nullptr ? mHeader->sequence : 0; }
+
+    private:
+        std::string mName;
+        uint8_t *mMap = nullptr;
+        size_t mMapSize = 0;
+        RingHeader *mHeader = nullptr;
+        uint32_t mSlots = 0;
+        size_t mSlotSize = 0;
+};
+
+class Reader
+{
+    public:
+        ~Reader();
+
+        /** Map the ring of a writer, read only, returns false and sets errno on error */
+        bool open(const std::string &name);
+        void close();
+
+        /**
+         * Wait up to timeout ms for a frame newer than the last one returned and return the newest,
+         * in place. Returns false and sets errno to ETIMEDOUT, or EPIPE when the writer closed the ring.
+         */
+        bool next(Frame &frame, int timeout);
+
+        /** Was the frame still intact, to check once its data was used */
+        bool isValid(const Frame &frame) const;
+
+        bool isOpen() const { return mHeader != nullptr; }
+
+        /** Frames published but never returned, as the reader was slower than the writer */
+        uint64_t skipped() const { return mSkipped; }
+
+    private:
+        const SlotHeader *slot(uint64_t sequence) const;
+
+        const uint8_t *mMap = nullptr;
+        size_t mMapSize = 0;
+        const RingHeader *mHeader = nullptr;
+        uint64_t mLast = 0;
+        uint64_t mSkipped = 0;
+};
+
+}
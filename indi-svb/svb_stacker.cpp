@@ -0,0 +1,305 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_stacker.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__)
+static inline __m128i load4(const uint16_t *p)
+{
+    return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128());
+}
+
+static inline __m128i load4(const uint8_t *p)
+{
+    int32_t word;
+    memcpy(&word, p, sizeof(word));
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+}
+
+// unsigned 32 bits to float, the halves convert exactly so the sum rounds once as a scalar cast
+static inline __m128 toFloat(__m128i v)
+{
+    __m128 high = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+    __m128 low = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xffff)));
+    return _mm_add_ps(_mm_mul_ps(high, _mm_set1_ps(65536.0f)), low);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static inline uint32x4_t load4(const uint16_t *p)
+{
+    return vmovl_u16(vld1_u16(p));
+}
+
+static inline uint32x4_t load4(const uint8_t *p)
+{
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(word)))));
+}
+#endif
+
+void LiveStacker::reset()
+{
+    std::vector<uint32_t>().swap(mSum);
+    std::vector<uint16_t>().swap(mCount);
+    std::vector<float>().swap(mM2);
+    mPixels = 0;
+    mBitDepth = 0;
+    mFrames = 0;
+    mRejected = 0;
+}
+
+bool LiveStacker::add(const uint8_t *frame, size_t pixels, int bitDepth)
+{
+    // new geometry, start over
+    if (pixels != mPixels || bitDepth != mBitDepth)
+    {
+        reset();
+        mSum.assign(pixels, 0);
+        mCount.assign(pixels, 0);
+        mPixels = pixels;
+        mBitDepth = bitDepth;
+    }
+
+    if (isFull())
+        return false;
+
+    if (mKappa <= 0)
+    {
+        // variance is only tracked while rejecting
+        mM2.clear();
+        if (bitDepth == 8)
+            accumulate(frame);
+        else
+            accumulate(reinterpret_cast<const uint16_t *>(frame));
+    }
+    else
+    {
+        // rejection switched on during the stack, estimate the variance from now on
+        if (mM2.size() != mPixels)
+        {
+            std::fill(mCount.begin(), mCount.end(), 0);
+            std::fill(mSum.begin(), mSum.end(), 0);
+            mM2.assign(mPixels, 0.0f);
+            mFrames = 0;
+        }
+
+        if (bitDepth == 8)
+            mRejected += accumulateRejecting(frame);
+        else
+            mRejected += accumulateRejecting(reinterpret_cast<const uint16_t *>(frame));
+    }
+
+    mFrames++;
+    return true;
+}
+
+template <typename T>
+void LiveStacker::accumulate(const T *frame)
+{
+    uint32_t *sum = mSum.data();
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    if (sizeof(T) == 2)
+    {
+        for (; i + 8 <= mPixels; i += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + i));
+            __m128i *s = reinterpret_cast<__m128i *>(sum + i);
+            _mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(v, zero)));
+            _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(v, zero)));
+        }
+    }
+    else
+    {
+        for (; i + 16 <= mPixels; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + i));
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            __m128i *s = reinterpret_cast<__m128i *>(sum + i);
+            _mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(lo, zero)));
+            _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+            _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+            _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+        }
+    }
+#elif defined(__ARM_NEON)
+    if (sizeof(T) == 2)
+    {
+        for (; i + 8 <= mPixels; i += 8)
+        {
+            uint16x8_t v = vld1q_u16(reinterpret_cast<const uint16_t *>(frame + i));
+            vst1q_u32(sum + i, vaddw_u16(vld1q_u32(sum + i), vget_low_u16(v)));
+            vst1q_u32(sum + i + 4, vaddw_u16(vld1q_u32(sum + i + 4), vget_high_u16(v)));
+        }
+    }
+    else
+    {
+        for (; i + 8 <= mPixels; i += 8)
+        {
+            uint16x8_t v = vmovl_u8(vld1_u8(reinterpret_cast<const uint8_t *>(frame + i)));
+            vst1q_u32(sum + i, vaddw_u16(vld1q_u32(sum + i), vget_low_u16(v)));
+            vst1q_u32(sum + i + 4, vaddw_u16(vld1q_u32(sum + i + 4), vget_high_u16(v)));
+        }
+    }
+#endif
+
+    for (; i < mPixels; i++)
+        sum[i] += frame[i];
+
+    uint16_t *count = mCount.data();
+    for (i = 0; i < mPixels; i++)
+        count[i]++;
+}
+
+template <typename T>
+size_t LiveStacker::accumulateRejecting(const T *frame)
+{
+    const float kappa2 = static_cast<float>(mKappa * mKappa);
+    const bool rejecting = mFrames >= minRejectionFrames;
+    size_t rejected = 0;
+    uint32_t *sum = mSum.data();
+    uint16_t *count = mCount.data();
+    float *m2 = mM2.data();
+    size_t i = 0;
+
+    // four pixels per step, the same float operations as the scalar loop
+#if defined(__SSE2__)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 k2 = _mm_set1_ps(kappa2);
+    const __m128 rejectEnabled = _mm_castsi128_ps(_mm_set1_epi32(rejecting ? -1 : 0));
+    const __m128i ones = _mm_set1_epi32(-1);
+    for (; i + 4 <= mPixels; i += 4)
+    {
+        __m128i xi = load4(frame + i);
+        __m128 x = _mm_cvtepi32_ps(xi);
+        __m128i count16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(count + i));
+        __m128 n = _mm_cvtepi32_ps(_mm_unpacklo_epi16(count16, _mm_setzero_si128()));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sum + i));
+        __m128 variance = _mm_loadu_ps(m2 + i);
+
+        __m128 sampled = _mm_cmpgt_ps(n, _mm_setzero_ps());
+        __m128 mean = _mm_div_ps(toFloat(s), _mm_max_ps(n, one));
+        mean = _mm_or_ps(_mm_and_ps(sampled, mean), _mm_andnot_ps(sampled, x));
+        __m128 delta = _mm_sub_ps(x, mean);
+
+        // variance floor of 1 ADU keeps constant pixels from rejecting everything
+        __m128 limit = _mm_mul_ps(k2, _mm_add_ps(_mm_div_ps(variance, _mm_max_ps(_mm_sub_ps(n, one), one)), one));
+        __m128 reject = _mm_and_ps(_mm_and_ps(rejectEnabled, _mm_cmpgt_ps(n, one)),
+                                   _mm_cmpgt_ps(_mm_mul_ps(delta, delta), limit));
+        __m128i accept = _mm_xor_si128(_mm_castps_si128(reject), ones);
+        rejected += __builtin_popcount(_mm_movemask_ps(reject));
+
+        s = _mm_add_epi32(s, _mm_and_si128(xi, accept));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sum + i), s);
+        __m128 update = _mm_mul_ps(delta, _mm_sub_ps(x, _mm_div_ps(toFloat(s), _mm_add_ps(n, one))));
+        _mm_storeu_ps(m2 + i, _mm_add_ps(variance, _mm_and_ps(update, _mm_castsi128_ps(accept))));
+        count16 = _mm_sub_epi16(count16, _mm_packs_epi32(accept, accept));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(count + i), count16);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // vdivq_f32 is AArch64 only, 32 bits ARM runs the scalar loop
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const uint32x4_t rejectEnabled = vdupq_n_u32(rejecting ? 0xffffffff : 0);
+    for (; i + 4 <= mPixels; i += 4)
+    {
+        uint32x4_t xi = load4(frame + i);
+        float32x4_t x = vcvtq_f32_u32(xi);
+        uint16x4_t count16 = vld1_u16(count + i);
+        float32x4_t n = vcvtq_f32_u32(vmovl_u16(count16));
+        uint32x4_t s = vld1q_u32(sum + i);
+        float32x4_t variance = vld1q_f32(m2 + i);
+
+        uint32x4_t sampled = vcgtq_f32(n, vdupq_n_f32(0.0f));
+        float32x4_t mean = vbslq_f32(sampled, vdivq_f32(vcvtq_f32_u32(s), vmaxq_f32(n, one)), x);
+        float32x4_t delta = vsubq_f32(x, mean);
+
+        // variance floor of 1 ADU keeps constant pixels from rejecting everything
+        float32x4_t limit = vmulq_n_f32(vaddq_f32(vdivq_f32(variance, vmaxq_f32(vsubq_f32(n, one), one)), one), kappa2);
+        uint32x4_t reject = vandq_u32(vandq_u32(rejectEnabled, vcgtq_f32(n, one)),
+                                      vcgtq_f32(vmulq_f32(delta, delta), limit));
+        uint32x4_t accept = vmvnq_u32(reject);
+        rejected += vaddvq_u32(vshrq_n_u32(reject, 31));
+
+        s = vaddq_u32(s, vandq_u32(xi, accept));
+        vst1q_u32(sum + i, s);
+        float32x4_t update = vmulq_f32(delta, vsubq_f32(x, vdivq_f32(vcvtq_f32_u32(s), vaddq_f32(n, one))));
+        vst1q_f32(m2 + i, vaddq_f32(variance, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(update), accept))));
+        vst1_u16(count + i, vsub_u16(count16, vmovn_u32(accept)));
+    }
+#endif
+
+    for (; i < mPixels; i++)
+    {
+        const float x = frame[i];
+        const uint32_t n = mCount[i];
+        const float mean = n > 0 ? static_cast<float>(mSum[i]) / n : x;
+        const float delta = x - mean;
+
+        // variance floor of 1 ADU keeps constant pixels from rejecting everything
+        if (rejecting && n > 1 && delta * delta > kappa2 * (mM2[i] / (n - 1) + 1.0f))
+        {
+            rejected++;
+            continue;
+        }
+
+        mSum[i] += frame[i];
+        mCount[i] = n + 1;
+        mM2[i] += delta * (x - static_cast<float>(mSum[i]) / (n + 1));
+    }
+
+    return rejected;
+}
+
+template <typename T>
+void LiveStacker::renderMean(T *frame) const
+{
+    for (size_t i = 0; i < mPixels; i++)
+    {
+        const uint32_t n = mCount[i];
+        frame[i] = n > 0 ? static_cast<T>((mSum[i] + n / 2) / n) : 0;
+    }
+}
+
+void LiveStacker::render(uint8_t *frame) const
+{
+    if (mBitDepth == 8)
+        renderMean(frame);
+    else
+        renderMean(reinterpret_cast<uint16_t *>(frame));
+}
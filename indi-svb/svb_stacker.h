@@ -0,0 +1,80 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Live stacking of streamed frames
+// Frames are summed in a 32 bits accumulator, a per pixel running variance (Welford)
+// rejects samples further than kappa sigma from the running mean. Both paths are vectorized,
+// the stack holds up to maxFrames frames.
+class LiveStacker
+{
+    public:
+        /** Drop the stack and free its memory, the next frame sets the geometry */
+        void reset();
+
+        // per pixel counts are 16 bits, and the 32 bits sums hold as many 16 bits frames
+        static const size_t maxFrames = 65535;
+
+        /** Add a 8 or 16 bits frame of pixels, false when the stack is full and the frame dropped */
+        bool add(const uint8_t *frame, size_t pixels, int bitDepth);
+
+        /** Write the stacked mean, in the bit depth of the stacked frames */
+        void render(uint8_t *frame) const;
+
+        /** Memory of a stack of pixels, rejection included */
+        static size_t memorySize(size_t pixels) { return pixels * (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(float)); }
+
+        /** Sigma clipping factor, 0 disables rejection */
+        void setKappa(double kappa) { mKappa = kappa; }
+
+        size_t frames() const { return mFrames; }
+        bool isFull() const { return mFrames >= maxFrames; }
+        size_t rejected() const { return mRejected; }
+        size_t pixels() const { return mPixels; }
+        int bitDepth() const { return mBitDepth; }
+
+    private:
+        // rejection needs a few samples to estimate the variance
+        static const size_t minRejectionFrames = 3;
+
+        template <typename T> void accumulate(const T *frame);
+        template <typename T> size_t accumulateRejecting(const T *frame);
+        template <typename T> void renderMean(T *frame) const;
+
+        std::vector<uint32_t> mSum;
+        std::vector<uint16_t> mCount;
+        std::vector<float> mM2;
+
+        size_t mPixels = 0;
+        int mBitDepth = 0;
+        size_t mFrames = 0;
+        size_t mRejected = 0;
+        double mKappa = 3.0;
+};
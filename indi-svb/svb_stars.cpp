@@ -0,0 +1,352 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_stars.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+// run fn(i) for i in [0, n) on every core
+template <typename F>
+static void parallelFor(size_t n, F fn)
+{
+    size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n);
+    if (workers <= 1)
+    {
+        for (size_t i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto work = [&]()
+    {
+        for (size_t i = next++; i < n; i = next++)
+            fn(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < workers; t++)
+        threads.emplace_back(work);
+    work();
+    for (auto &thread : threads)
+        thread.join();
+}
+
+const std::vector<StarDetector::Star> &StarDetector::detect(const uint8_t *frame, uint32_t width, uint32_t height,
+        int bitDepth, const Settings &settings)
+{
+    if (bitDepth > 8)
+        detect(reinterpret_cast<const uint16_t *>(frame), width, height, 65535, settings);
+    else
+        detect(frame, width, height, 255, settings);
+    return mStars;
+}
+
+template <typename T>
+void StarDetector::estimateTile(const T *frame, uint32_t width, uint32_t height, uint32_t tx, uint32_t ty)
+{
+    const uint32_t x0 = tx * tileSize, x1 = std::min(x0 + tileSize, width);
+    const uint32_t y0 = ty * tileSize, y1 = std::min(y0 + tileSize, height);
+
+    // median and MAD of one pixel out of four
+    std::vector<uint32_t> samples;
+    samples.reserve((tileSize / 2) * (tileSize / 2));
+    for (uint32_t y = y0; y < y1; y += 2)
+        for (uint32_t x = x0; x < x1; x += 2)
+            samples.push_back(frame[size_t(y) * width + x]);
+
+    auto middle = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), middle, samples.end());
+    const uint32_t median = *middle;
+    for (auto &sample : samples)
+        sample = sample > median ? sample - median : median - sample;
+    std::nth_element(samples.begin(), middle, samples.end());
+
+    const size_t tile = size_t(ty) * mTilesX + tx;
+    mTileBackground[tile] = median;
+    mTileNoise[tile] = std::max(1.4826f * *middle, 1.0f);
+}
+
+template <typename T>
+void StarDetector::findRuns(const T *frame, uint32_t width, uint32_t y0, uint32_t y1, std::vector<Run> &runs,
+                            double kappa) const
+{
+    for (uint32_t y = y0; y < y1; y++)
+    {
+        const T *row = frame + size_t(y) * width;
+        bool inRun = false;
+        for (uint32_t x0 = 0; x0 < width; x0 += tileSize)
+        {
+            // threshold is constant over a tile
+            const uint32_t x1 = std::min(x0 + tileSize, width);
+            const float threshold = tileBackground(x0, y) + kappa * tileNoise(x0, y);
+            for (uint32_t x = x0; x < x1; x++)
+            {
+                bool above = row[x] > threshold;
+                if (above && !inRun)
+                    runs.push_back({y, x, x + 1, 0});
+                else if (above)
+                    runs.back().x1 = x + 1;
+                inRun = above;
+            }
+        }
+    }
+}
+
+uint32_t StarDetector::find(uint32_t run)
+{
+    while (mRuns[run].parent != run)
+    {
+        mRuns[run].parent = mRuns[mRuns[run].parent].parent;
+        run = mRuns[run].parent;
+    }
+    return run;
+}
+
+void StarDetector::unite(uint32_t a, uint32_t b)
+{
+    a = find(a);
+    b = find(b);
+    if (a != b)
+        mRuns[std::max(a, b)].parent = std::min(a, b);
+}
+
+template <typename T>
+bool StarDetector::measure(const T *frame, uint32_t width, uint32_t height, const std::vector<uint32_t> &component,
+                           uint32_t fullScale, Star &star) const
+{
+    // bounding box of the component, with a margin for the wings below the threshold
+    uint32_t left = UINT32_MAX, right = 0, top = UINT32_MAX, bottom = 0, pixels = 0;
+    bool saturated = false;
+    for (uint32_t index : component)
+    {
+        const Run &run = mRuns[index];
+        left = std::min(left, run.x0);
+        right = std::max(right, run.x1);
+        top = std::min(top, run.y);
+        bottom = std::max(bottom, run.y + 1);
+        pixels += run.x1 - run.x0;
+        for (uint32_t x = run.x0; x < run.x1 && !saturated; x++)
+            saturated = frame[size_t(run.y) * width + x] >= fullScale;
+    }
+    const uint32_t margin = 2;
+    left = left > margin ? left - margin : 0;
+    top = top > margin ? top - margin : 0;
+    right = std::min(right + margin, width);
+    bottom = std::min(bottom + margin, height);
+
+    // flux weighted centroid
+    double flux = 0, sx = 0, sy = 0, peak = 0;
+    for (uint32_t y = top; y < bottom; y++)
+    {
+        const T *row = frame + size_t(y) * width;
+        for (uint32_t x = left; x < right; x++)
+        {
+            double w = row[x] - tileBackground(x, y);
+            if (w <= 0)
+                continue;
+            flux += w;
+            sx += w * x;
+            sy += w * y;
+            peak = std::max(peak, w);
+        }
+    }
+    if (flux <= 0)
+        return false;
+
+    const double cx = sx / flux, cy = sy / flux;
+
+    // mean radius and second moment around the centroid
+    double sr = 0, sr2 = 0;
+    for (uint32_t y = top; y < bottom; y++)
+    {
+        const T *row = frame + size_t(y) * width;
+        for (uint32_t x = left; x < right; x++)
+        {
+            double w = row[x] - tileBackground(x, y);
+            if (w <= 0)
+                continue;
+            double r2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+            sr += w * std::sqrt(r2);
+            sr2 += w * r2;
+        }
+    }
+
+    star.x = cx;
+    star.y = cy;
+    star.flux = flux;
+    star.peak = peak;
+    star.hfr = sr / flux;
+    star.fwhm = 2.3548 * std::sqrt(sr2 / (2 * flux));
+    star.pixels = pixels;
+    star.saturated = saturated;
+    return true;
+}
+
+template <typename T>
+void StarDetector::detect(const T *frame, uint32_t width, uint32_t height, uint32_t fullScale, const Settings &settings)
+{
+    mStars.clear();
+    mRuns.clear();
+    if (width == 0 || height == 0)
+        return;
+
+    // background and noise per tile
+    mTilesX = (width + tileSize - 1) / tileSize;
+    mTilesY = (height + tileSize - 1) / tileSize;
+    mTileBackground.assign(size_t(mTilesX) * mTilesY, 0);
+    mTileNoise.assign(size_t(mTilesX) * mTilesY, 0);
+    parallelFor(size_t(mTilesX) * mTilesY, [&](size_t tile)
+    {
+        estimateTile(frame, width, height, tile % mTilesX, tile / mTilesX);
+    });
+
+    std::vector<float> sorted = mTileBackground;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    mBackground = sorted[sorted.size() / 2];
+    sorted = mTileNoise;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    mNoise = sorted[sorted.size() / 2];
+
+    // runs above the threshold, one band of tiles per task
+    std::vector<std::vector<Run>> bands(mTilesY);
+    parallelFor(mTilesY, [&](size_t band)
+    {
+        uint32_t y0 = band * tileSize;
+        findRuns(frame, width, y0, std::min(y0 + tileSize, height), bands[band], settings.kappa);
+    });
+    for (auto &band : bands)
+        mRuns.insert(mRuns.end(), band.begin(), band.end());
+    for (uint32_t i = 0; i < mRuns.size(); i++)
+        mRuns[i].parent = i;
+
+    // 8-connected runs of consecutive rows, runs are sorted by row then column
+    size_t previous = 0, current = 0;
+    while (current < mRuns.size())
+    {
+        const uint32_t y = mRuns[current].y;
+        size_t next = current;
+        while (next < mRuns.size() && mRuns[next].y == y)
+            next++;
+
+        if (previous < current && mRuns[previous].y + 1 == y)
+        {
+            size_t a = previous;
+            for (size_t b = current; b < next; b++)
+            {
+                while (a < current && mRuns[a].x1 < mRuns[b].x0)
+                    a++;
+                for (size_t c = a; c < current && mRuns[c].x0 <= mRuns[b].x1; c++)
+                    unite(c, b);
+            }
+        }
+
+        previous = current;
+        current = next;
+    }
+
+    // components as lists of runs, too small and too large ones dropped
+    std::vector<uint32_t> size(mRuns.size(), 0);
+    for (uint32_t i = 0; i < mRuns.size(); i++)
+        size[find(i)] += mRuns[i].x1 - mRuns[i].x0;
+
+    std::vector<uint32_t> componentOf(mRuns.size(), UINT32_MAX);
+    std::vector<std::vector<uint32_t>> components;
+    for (uint32_t i = 0; i < mRuns.size(); i++)
+    {
+        uint32_t root = mRuns[i].parent;
+        if (size[root] < settings.minPixels || size[root] > settings.maxPixels)
+            continue;
+        if (componentOf[root] == UINT32_MAX)
+        {
+            componentOf[root] = components.size();
+            components.emplace_back();
+        }
+        components[componentOf[root]].push_back(i);
+    }
+
+    // measure every component
+    std::vector<Star> stars(components.size());
+    std::vector<char> valid(components.size(), 0);
+    parallelFor(components.size(), [&](size_t i)
+    {
+        valid[i] = measure(frame, width, height, components[i], fullScale, stars[i]);
+    });
+
+    for (size_t i = 0; i < stars.size(); i++)
+        if (valid[i])
+            mStars.push_back(stars[i]);
+
+    std::sort(mStars.begin(), mStars.end(), [](const Star & a, const Star & b)
+    {
+        return a.flux > b.flux;
+    });
+    if (mStars.size() > settings.maxStars)
+        mStars.resize(settings.maxStars);
+}
+
+static double median(std::vector<double> values)
+{
+    if (values.empty())
+        return 0;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+double StarDetector::medianHFR() const
+{
+    std::vector<double> values;
+    for (const auto &star : mStars)
+        if (!star.saturated)
+            values.push_back(star.hfr);
+    return median(values);
+}
+
+double StarDetector::medianFWHM() const
+{
+    std::vector<double> values;
+    for (const auto &star : mStars)
+        if (!star.saturated)
+            values.push_back(star.fwhm);
+    return median(values);
+}
+
+std::string StarDetector::toCSV() const
+{
+    std::string csv = "x,y,flux,peak,hfr,fwhm,pixels,saturated\n";
+    char line[160];
+    for (const auto &star : mStars)
+    {
+        snprintf(line, sizeof(line), "%.2f,%.2f,%.1f,%.1f,%.3f,%.3f,%u,%d\n", star.x, star.y, star.flux, star.peak,
+                 star.hfr, star.fwhm, star.pixels, star.saturated ? 1 : 0);
+        csv += line;
+    }
+    return csv;
+}
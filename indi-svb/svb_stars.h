@@ -0,0 +1,104 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Star detection
+// The background and noise are estimated per tile, pixels above background + kappa sigma are
+// grouped in 8-connected components from runs, band by band on every core, then each
+// component is measured: flux weighted centroid, flux, peak, HFR and FWHM (second moments).
+class StarDetector
+{
+    public:
+        struct Settings
+        {
+            double kappa;           // detection threshold, sigma above background
+            uint32_t minPixels;     // smallest component
+            uint32_t maxPixels;     // largest component, bigger ones are not stars
+            size_t maxStars;        // brightest stars kept
+        };
+
+        struct Star
+        {
+            float x, y;             // centroid, pixel centers at integer coordinates
+            float flux;             // background subtracted
+            float peak;             // background subtracted
+            float hfr;              // flux weighted mean radius
+            float fwhm;
+            uint32_t pixels;
+            bool saturated;
+        };
+
+        /** Detect the stars of a 8 or 16 bits frame, brightest first */
+        const std::vector<Star> &detect(const uint8_t *frame, uint32_t width, uint32_t height, int bitDepth,
+                                        const Settings &settings);
+
+        const std::vector<Star> &stars() const { return mStars; }
+        double background() const { return mBackground; }
+        double noise() const { return mNoise; }
+
+        /** Median HFR and FWHM of the detected stars, 0 without stars */
+        double medianHFR() const;
+        double medianFWHM() const;
+
+        /** Star list as CSV text */
+        std::string toCSV() const;
+
+    private:
+        // runs of pixels above the threshold on a row, x1 excluded
+        struct Run
+        {
+            uint32_t y, x0, x1;
+            uint32_t parent;
+        };
+
+        static const uint32_t tileSize = 64;
+
+        template <typename T> void detect(const T *frame, uint32_t width, uint32_t height, uint32_t fullScale,
+                                          const Settings &settings);
+        template <typename T> void estimateTile(const T *frame, uint32_t width, uint32_t height, uint32_t tx, uint32_t ty);
+        template <typename T> void findRuns(const T *frame, uint32_t width, uint32_t y0, uint32_t y1, std::vector<Run> &runs,
+                                            double kappa) const;
+        template <typename T> bool measure(const T *frame, uint32_t width, uint32_t height,
+                                           const std::vector<uint32_t> &component, uint32_t fullScale, Star &star) const;
+
+        uint32_t find(uint32_t run);
+        void unite(uint32_t a, uint32_t b);
+
+        /** Background of the tile holding pixel x, y */
+        float tileBackground(uint32_t x, uint32_t y) const { return mTileBackground[(y / tileSize) * mTilesX + x / tileSize]; }
+        float tileNoise(uint32_t x, uint32_t y) const { return mTileNoise[(y / tileSize) * mTilesX + x / tileSize]; }
+
+        uint32_t mTilesX = 0, mTilesY = 0;
+        std::vector<float> mTileBackground, mTileNoise;
+        std::vector<Run> mRuns;
+        std::vector<Star> mStars;
+        double mBackground = 0, mNoise = 0;
+};
@@ -0,0 +1,148 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+const FrameStats::Result &FrameStats::process(uint8_t *frame, size_t pixels, int bitDepth, int stretch)
+{
+    if (bitDepth == 8)
+    {
+        mHistogram.assign(256, 0);
+        uint32_t *histogram = mHistogram.data();
+        for (size_t i = 0; i < pixels; i++)
+            histogram[frame[i]]++;
+        stretch = 0;
+    }
+    else
+    {
+        // raw values fit in 16 - stretch bits
+        mHistogram.assign(size_t(1) << (16 - stretch), 0);
+        uint32_t *histogram = mHistogram.data();
+        const uint32_t mask = uint32_t(mHistogram.size() - 1);
+        uint16_t *data = reinterpret_cast<uint16_t *>(frame);
+        size_t i = 0;
+
+        if (stretch != 0)
+        {
+#if defined(__SSE2__)
+            const __m128i count = _mm_cvtsi32_si128(stretch);
+            for (; i + 8 <= pixels; i += 8)
+            {
+                __m128i *p = reinterpret_cast<__m128i *>(data + i);
+                __m128i v = _mm_loadu_si128(p);
+                _mm_storeu_si128(p, _mm_sll_epi16(v, count));
+
+                alignas(16) uint16_t raw[8];
+                _mm_store_si128(reinterpret_cast<__m128i *>(raw), v);
+                for (int k = 0; k < 8; k++)
+                    histogram[raw[k] & mask]++;
+            }
+#elif defined(__ARM_NEON)
+            const int16x8_t count = vdupq_n_s16(stretch);
+            for (; i + 8 <= pixels; i += 8)
+            {
+                uint16x8_t v = vld1q_u16(data + i);
+                vst1q_u16(data + i, vshlq_u16(v, count));
+
+                uint16_t raw[8];
+                vst1q_u16(raw, v);
+                for (int k = 0; k < 8; k++)
+                    histogram[raw[k] & mask]++;
+            }
+#endif
+            for (; i < pixels; i++)
+            {
+                histogram[data[i] & mask]++;
+                data[i] <<= stretch;
+            }
+        }
+        else
+        {
+            for (; i < pixels; i++)
+                histogram[data[i]]++;
+        }
+    }
+
+    mResult.pixels = pixels;
+    summarize(stretch);
+    return mResult;
+}
+
+void FrameStats::summarize(int stretch)
+{
+    const uint32_t *histogram = mHistogram.data();
+    const size_t bins = mHistogram.size();
+
+    mResult = {0, 0, 0, 0, 0, 0, mResult.pixels};
+    if (mResult.pixels == 0)
+        return;
+
+    double sum = 0, sum2 = 0;
+    size_t seen = 0;
+    const size_t half = (mResult.pixels + 1) / 2;
+    bool first = true, median = false;
+    for (size_t bin = 0; bin < bins; bin++)
+    {
+        const uint32_t count = histogram[bin];
+        if (count == 0)
+            continue;
+
+        if (first)
+        {
+            mResult.min = bin;
+            first = false;
+        }
+        mResult.max = bin;
+
+        seen += count;
+        if (!median && seen >= half)
+        {
+            mResult.median = bin;
+            median = true;
+        }
+
+        sum += double(count) * bin;
+        sum2 += double(count) * bin * bin;
+    }
+
+    const double mean = sum / mResult.pixels;
+    const double scale = double(1 << stretch);
+    mResult.mean = mean * scale;
+    mResult.stddev = std::sqrt(std::max(sum2 / mResult.pixels - mean * mean, 0.0)) * scale;
+    mResult.median <<= stretch;
+    mResult.min <<= stretch;
+    mResult.max <<= stretch;
+    mResult.saturated = histogram[bins - 1];
+}
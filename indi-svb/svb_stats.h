@@ -0,0 +1,59 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Frame statistics
+// The histogram is taken on the raw values while the 16 bits stretch is applied, every other
+// statistic is read from the histogram.
+class FrameStats
+{
+    public:
+        struct Result
+        {
+            double mean;
+            double stddev;
+            uint32_t median;
+            uint32_t min, max;
+            size_t saturated;   // pixels at the full scale of the data
+            size_t pixels;
+        };
+
+        /** Stretch a 16 bits frame by a bit shift (0 for none, ignored for 8 bits) and take its statistics */
+        const Result &process(uint8_t *frame, size_t pixels, int bitDepth, int stretch);
+
+        const Result &result() const { return mResult; }
+        const std::vector<uint32_t> &histogram() const { return mHistogram; }
+
+    private:
+        void summarize(int stretch);
+
+        std::vector<uint32_t> mHistogram;
+        Result mResult {0, 0, 0, 0, 0, 0, 0};
+};
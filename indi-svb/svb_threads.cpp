@@ -0,0 +1,157 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_threads.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ThreadTuning
+{
+
+static pid_t threadId()
+{
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+bool parseCpus(const std::string &list, cpu_set_t &set)
+{
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    CPU_ZERO(&set);
+    const char *p = list.c_str();
+    while (*p != '\0')
+    {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p || first < 0)
+            return false;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtol(++p, &end, 10);
+            if (end == p || last < first)
+                return false;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < cores && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &set);
+        while (*p == ' ')
+            p++;
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return false;
+    }
+    return CPU_COUNT(&set) > 0;
+}
+
+void setName(const char *name)
+{
+    char truncated[16];
+    snprintf(truncated, sizeof(truncated), "%s", name);
+    pthread_setname_np(pthread_self(), truncated);
+}
+
+bool apply(const Settings &settings, std::string &error)
+{
+    error.clear();
+
+    // affinity, every core when no list is set
+    cpu_set_t set;
+    if (settings.cpus.empty())
+    {
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &set);
+    }
+    else if (!parseCpus(settings.cpus, set))
+        error += "invalid core list";
+    if (error.empty() && sched_setaffinity(threadId(), sizeof(set), &set) != 0)
+        error += std::string("affinity ") + strerror(errno);
+
+    // scheduling, a refused SCHED_FIFO falls back to the nice level
+    sched_param param {};
+    bool fifo = false;
+    if (settings.policy == POLICY_FIFO)
+    {
+        param.sched_priority = settings.priority;
+        int status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        fifo = status == 0;
+        if (!fifo)
+            error += std::string(error.empty() ? "" : ", ") + "SCHED_FIFO " + strerror(status);
+    }
+    if (!fifo)
+    {
+        param.sched_priority = 0;
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+        int nice = settings.policy == POLICY_NORMAL ? 0 : settings.nice;
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(threadId()), nice) != 0)
+            error += std::string(error.empty() ? "" : ", ") + "nice " + strerror(errno);
+    }
+    return error.empty();
+}
+
+std::string describe()
+{
+    std::string text = "cpus ";
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(threadId(), sizeof(set), &set) == 0)
+    {
+        // ranges of consecutive cores
+        bool first = true;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (!CPU_ISSET(cpu, &set))
+                continue;
+            int last = cpu;
+            while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set))
+                last++;
+            text += (first ? "" : ",") + std::to_string(cpu);
+            if (last > cpu)
+                text += "-" + std::to_string(last);
+            first = false;
+            cpu = last;
+        }
+    }
+
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy == SCHED_FIFO)
+        return text + ", SCHED_FIFO " + std::to_string(param.sched_priority);
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(threadId()));
+    return text + ", nice " + std::to_string(errno == 0 ? nice : 0);
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <sched.h>
+#include <string>
+
+// Thread tuning
+// Capture threads may be pinned to a core set and scheduled real time (SCHED_FIFO) or with a
+// nice level. Both need privileges (CAP_SYS_NICE, RLIMIT_RTPRIO or RLIMIT_NICE): a refused
+// request is reported and the thread keeps what it was granted.
+namespace ThreadTuning
+{
+
+enum Policy { POLICY_NORMAL, POLICY_NICE, POLICY_FIFO };
+
+struct Settings
+{
+    std::string cpus;       // core list as "0,2-3", empty for any core
+    Policy policy;
+    int nice;               // -20 to 19, also the fallback when SCHED_FIFO is refused
+    int priority;           // SCHED_FIFO priority, 1 to 99
+};
+
+/** Parse a core list, false when it is malformed or lists no existing core */
+bool parseCpus(const std::string &list, cpu_set_t &set);
+
+/** Name the calling thread, the kernel keeps 15 characters */
+void setName(const char *name);
+
+/** Apply the settings to the calling thread, false with the refused requests in error */
+bool apply(const Settings &settings, std::string &error);
+
+/** Affinity and scheduling of the calling thread, as "cpus 2-3, SCHED_FIFO 10" */
+std::string describe();
+
+}
@@ -0,0 +1,429 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_transient.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// sigma of a gaussian from its mean absolute deviation
+static const double madToSigma = 1.2533;
+
+// changed samples of a tile row, their summed difference and the largest one
+struct Segment
+{
+    uint32_t count;
+    uint64_t sum;
+    uint32_t peak;
+};
+
+// segments are a tile wide, the vector counters cannot overflow
+static void compare(const uint8_t *frame, const uint8_t *background, size_t n, uint8_t threshold, Segment &segment)
+{
+    size_t i = 0;
+    uint32_t count = 0, peak = 0;
+    uint64_t sum = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    __m128i sums = zero, counts = zero, peaks = zero;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(background + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(f, b), _mm_subs_epu8(b, f));
+        __m128i below = _mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(diff, zero));
+        counts = _mm_add_epi64(counts, _mm_sad_epu8(_mm_andnot_si128(below, one), zero));
+        peaks = _mm_max_epu8(peaks, diff);
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sums);
+    sum = lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), counts);
+    count = static_cast<uint32_t>(lanes[0] + lanes[1]);
+    uint8_t maxima[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(maxima), peaks);
+    peak = *std::max_element(maxima, maxima + 16);
+#elif defined(__ARM_NEON)
+    const uint8x16_t limit = vdupq_n_u8(threshold);
+    uint32x4_t sums = vdupq_n_u32(0);
+    uint16x8_t counts = vdupq_n_u16(0);
+    uint8x16_t peaks = vdupq_n_u8(0);
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(frame + i), vld1q_u8(background + i));
+        sums = vpadalq_u16(sums, vpaddlq_u8(diff));
+        counts = vpadalq_u8(counts, vshrq_n_u8(vcgtq_u8(diff, limit), 7));
+        peaks = vmaxq_u8(peaks, diff);
+    }
+    uint32_t sumLanes[4];
+    vst1q_u32(sumLanes, sums);
+    sum = uint64_t(sumLanes[0]) + sumLanes[1] + sumLanes[2] + sumLanes[3];
+    uint16_t countLanes[8];
+    vst1q_u16(countLanes, counts);
+    for (int k = 0; k < 8; k++)
+        count += countLanes[k];
+    uint8_t maxima[16];
+    vst1q_u8(maxima, peaks);
+    peak = *std::max_element(maxima, maxima + 16);
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t diff = frame[i] > background[i] ? frame[i] - background[i] : background[i] - frame[i];
+        sum += diff;
+        count += diff > threshold;
+        peak = std::max(peak, diff);
+    }
+    segment.count += count;
+    segment.sum += sum;
+    segment.peak = std::max(segment.peak, peak);
+}
+
+static void compare(const uint16_t *frame, const uint16_t *background, size_t n, uint16_t threshold, Segment &segment)
+{
+    size_t i = 0;
+    uint32_t count = 0, peak = 0;
+    uint64_t sum = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i limit = _mm_set1_epi16(static_cast<short>(threshold));
+    __m128i sums = zero, counts = zero;
+    // unsigned maximum through the signed one, biased
+    __m128i peaks = bias;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i *>(frame + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(background + i));
+        __m128i diff = _mm_or_si128(_mm_subs_epu16(f, b), _mm_subs_epu16(b, f));
+        __m128i below = _mm_cmpeq_epi16(_mm_subs_epu16(diff, limit), zero);
+        sums = _mm_add_epi32(sums, _mm_add_epi32(_mm_unpacklo_epi16(diff, zero), _mm_unpackhi_epi16(diff, zero)));
+        counts = _mm_add_epi16(counts, _mm_andnot_si128(below, one));
+        peaks = _mm_max_epi16(peaks, _mm_xor_si128(diff, bias));
+    }
+    uint32_t sumLanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sumLanes), sums);
+    sum = uint64_t(sumLanes[0]) + sumLanes[1] + sumLanes[2] + sumLanes[3];
+    uint16_t lanes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), counts);
+    for (int k = 0; k < 8; k++)
+        count += lanes[k];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_xor_si128(peaks, bias));
+    peak = *std::max_element(lanes, lanes + 8);
+#elif defined(__ARM_NEON)
+    const uint16x8_t limit = vdupq_n_u16(threshold);
+    uint32x4_t sums = vdupq_n_u32(0);
+    uint16x8_t counts = vdupq_n_u16(0);
+    uint16x8_t peaks = vdupq_n_u16(0);
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t diff = vabdq_u16(vld1q_u16(frame + i), vld1q_u16(background + i));
+        sums = vpadalq_u16(sums, diff);
+        counts = vaddq_u16(counts, vshrq_n_u16(vcgtq_u16(diff, limit), 15));
+        peaks = vmaxq_u16(peaks, diff);
+    }
+    uint32_t sumLanes[4];
+    vst1q_u32(sumLanes, sums);
+    sum = uint64_t(sumLanes[0]) + sumLanes[1] + sumLanes[2] + sumLanes[3];
+    uint16_t lanes[8];
+    vst1q_u16(lanes, counts);
+    for (int k = 0; k < 8; k++)
+        count += lanes[k];
+    vst1q_u16(lanes, peaks);
+    peak = *std::max_element(lanes, lanes + 8);
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t diff = frame[i] > background[i] ? frame[i] - background[i] : background[i] - frame[i];
+        sum += diff;
+        count += diff > threshold;
+        peak = std::max(peak, diff);
+    }
+    segment.count += count;
+    segment.sum += sum;
+    segment.peak = std::max(segment.peak, peak);
+}
+
+// exponential moving average, accumulator = background << shift
+// changed samples are clamped to the threshold, a transient barely moves the background while a
+// lasting change is still absorbed, slowly
+template <typename T>
+static void blend(const T *frame, uint32_t *accumulator, T *background, size_t n, uint32_t shift, T threshold)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t low = background[i] > threshold ? background[i] - threshold : 0;
+        uint32_t value = std::min(std::max<uint32_t>(frame[i], low), uint32_t(background[i]) + threshold);
+        accumulator[i] = accumulator[i] - (accumulator[i] >> shift) + value;
+        background[i] = static_cast<T>(accumulator[i] >> shift);
+    }
+}
+
+bool TransientDetector::process(const uint8_t *frame, uint32_t width, uint32_t height, uint32_t channels, int bitDepth,
+                                const Settings &settings)
+{
+    if (bitDepth != mBitDepth)
+    {
+        mBitDepth = bitDepth;
+        mFrames = 0;
+    }
+    if (bitDepth == 16)
+        return process(reinterpret_cast<const uint16_t *>(frame), width, height, channels, settings);
+    return process(frame, width, height, channels, settings);
+}
+
+template <typename T>
+bool TransientDetector::process(const T *frame, uint32_t width, uint32_t height, uint32_t channels, const Settings &settings)
+{
+    // 16 bits samples shifted by 15 still fit the accumulator
+    uint32_t shift = std::min<uint32_t>(settings.backgroundShift, 15);
+    size_t rowSamples = size_t(width) * channels;
+    size_t samples = rowSamples * height;
+    T *background = reinterpret_cast<T *>(mBackground.data());
+
+    // a new background
+    if (mFrames == 0 || width != mWidth || height != mHeight || channels != mChannels || shift != mShift)
+    {
+        mWidth = width;
+        mHeight = height;
+        mChannels = channels;
+        mShift = shift;
+        mAccumulator.resize(samples);
+        mBackground.resize(samples * sizeof(T));
+        background = reinterpret_cast<T *>(mBackground.data());
+        for (size_t i = 0; i < samples; i++)
+        {
+            mAccumulator[i] = uint32_t(frame[i]) << shift;
+            background[i] = frame[i];
+        }
+        mFrames = 1;
+        mNoise = 0;
+        mDetection = Detection();
+        return false;
+    }
+
+    // no noise estimate yet, every pixel would be changed
+    double limit = mNoise > 0 ? settings.kappa * mNoise : std::numeric_limits<T>::max();
+    T threshold = static_cast<T>(std::max(1.0, std::min<double>(limit, std::numeric_limits<T>::max())));
+
+    uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    uint32_t tilesY = (height + tileSize - 1) / tileSize;
+    size_t tileSamples = size_t(tileSize) * channels;
+    mTileCount.assign(size_t(tilesX) * tilesY, 0);
+    mTilePeak.assign(size_t(tilesX) * tilesY, 0);
+
+    uint64_t sum = 0;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const T *row = frame + y * rowSamples;
+        T *backgroundRow = background + y * rowSamples;
+        size_t tile = size_t(y / tileSize) * tilesX;
+        for (uint32_t tx = 0; tx < tilesX; tx++, tile++)
+        {
+            size_t x = tx * tileSamples;
+            Segment segment {0, 0, 0};
+            compare(row + x, backgroundRow + x, std::min(tileSamples, rowSamples - x), threshold, segment);
+            mTileCount[tile] += segment.count;
+            mTilePeak[tile] = std::max(mTilePeak[tile], segment.peak);
+            sum += segment.sum;
+        }
+        blend(row, mAccumulator.data() + y * rowSamples, backgroundRow, rowSamples, shift, threshold);
+    }
+    bool measured = mNoise > 0;
+    mNoise = std::max(sum / double(samples) * madToSigma, 0.5);
+    mFrames++;
+    if (!measured)
+        return false;
+
+    // active tiles
+    Detection detection {0, width, height, 0, 0, 0, 0, 0};
+    double weight = 0, cx = 0, cy = 0;
+    for (uint32_t ty = 0; ty < tilesY; ty++)
+    {
+        for (uint32_t tx = 0; tx < tilesX; tx++)
+        {
+            size_t tile = size_t(ty) * tilesX + tx;
+            if (mTileCount[tile] < settings.minPixels)
+                continue;
+            detection.tiles++;
+            detection.x0 = std::min(detection.x0, tx * tileSize);
+            detection.y0 = std::min(detection.y0, ty * tileSize);
+            detection.x1 = std::max(detection.x1, std::min((tx + 1) * tileSize, width));
+            detection.y1 = std::max(detection.y1, std::min((ty + 1) * tileSize, height));
+            detection.peak = std::max(detection.peak, mTilePeak[tile]);
+            weight += mTileCount[tile];
+            cx += mTileCount[tile] * std::min((tx + 0.5) * tileSize, double(width));
+            cy += mTileCount[tile] * std::min((ty + 0.5) * tileSize, double(height));
+        }
+    }
+    if (detection.tiles == 0)
+    {
+        mDetection = Detection();
+        return false;
+    }
+    detection.x = static_cast<float>(cx / weight);
+    detection.y = static_cast<float>(cy / weight);
+    mDetection = detection;
+
+    // the whole scene changed, the background restarts from the next frame
+    if (detection.tiles > settings.maxArea * tilesX * tilesY)
+    {
+        mFrames = 0;
+        return false;
+    }
+    return true;
+}
+
+void FrameRing::reset(size_t frameSize, size_t capacity)
+{
+    mFrameSize = frameSize;
+    mCapacity = std::max<size_t>(capacity, 1);
+    mFrames.clear();
+    mFrames.shrink_to_fit();
+    mFrames.resize(mFrameSize * mCapacity);
+    mCaptured.assign(mCapacity, SerWriter::Clock::time_point());
+    mSequence = 0;
+}
+
+uint64_t FrameRing::add(const uint8_t *frame, SerWriter::Clock::time_point captured)
+{
+    // the slot of the next frame holds a frame still to be written
+    uint64_t pinned = mPinned.load(std::memory_order_acquire);
+    if (pinned != 0 && mSequence + 1 >= pinned + mCapacity)
+        return 0;
+
+    mSequence++;
+    size_t slot = mSequence % mCapacity;
+    memcpy(mFrames.data() + slot * mFrameSize, frame, mFrameSize);
+    mCaptured[slot] = captured;
+    return mSequence;
+}
+
+const uint8_t *FrameRing::frame(uint64_t sequence) const
+{
+    if (sequence == 0 || sequence > mSequence || sequence < oldest())
+        return nullptr;
+    return mFrames.data() + (sequence % mCapacity) * mFrameSize;
+}
+
+EventWriter::~EventWriter()
+{
+    stop();
+}
+
+void EventWriter::write(const std::string &path, const SerWriter::Format &format, uint64_t first, uint64_t last)
+{
+    std::unique_lock<std::mutex> guard(mLock);
+    uint64_t pinned = mRing.pinned();
+    mRing.pin(pinned == 0 ? first : std::min(pinned, first));
+    mQueue.push_back({path, format, first, last});
+    if (!mThread.joinable())
+    {
+        mQuit = false;
+        mThread = std::thread(&EventWriter::run, this);
+    }
+    mCondition.notify_all();
+}
+
+void EventWriter::wait()
+{
+    std::unique_lock<std::mutex> guard(mLock);
+    mCondition.wait(guard, [this] { return mQueue.empty() && !mWriting; });
+}
+
+void EventWriter::stop()
+{
+    {
+        std::unique_lock<std::mutex> guard(mLock);
+        mQuit = true;
+        mCondition.notify_all();
+    }
+    if (mThread.joinable())
+        mThread.join();
+}
+
+void EventWriter::pinFrom(uint64_t sequence)
+{
+    if (!mQueue.empty())
+        sequence = std::min(sequence, mQueue.front().first);
+    mRing.pin(sequence);
+}
+
+void EventWriter::run()
+{
+    std::unique_lock<std::mutex> guard(mLock);
+    for (;;)
+    {
+        mCondition.wait(guard, [this] { return mQuit || !mQueue.empty(); });
+        if (mQueue.empty())
+            return;
+        Event event = mQueue.front();
+        mQueue.pop_front();
+        mWriting = true;
+        guard.unlock();
+
+        // each written frame goes back to the ring
+        SerWriter writer;
+        bool ok = writer.open(event.path, event.format, false);
+        int error = ok ? 0 : errno;
+        for (uint64_t sequence = event.first; sequence <= event.last; sequence++)
+        {
+            if (ok && !writer.add(mRing.pinnedFrame(sequence), mRing.captured(sequence)))
+            {
+                ok = false;
+                error = errno;
+            }
+            guard.lock();
+            pinFrom(sequence + 1);
+            guard.unlock();
+        }
+        if (!writer.close() && ok)
+            error = errno;
+
+        guard.lock();
+        if (mQueue.empty())
+            mRing.pin(0);
+        guard.unlock();
+        if (mCompletion)
+            mCompletion(event.path, error);
+        guard.lock();
+        mWriting = false;
+        mCondition.notify_all();
+    }
+}
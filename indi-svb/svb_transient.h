@@ -0,0 +1,176 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include "svb_ser.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Transient detection
+// Each frame is compared with a running background: the absolute difference is computed with
+// SIMD, thresholded at kappa sigma of the noise measured on the previous frame and counted per
+// tile. A frame is active when some tiles hold enough changed pixels, but not so many that the
+// whole scene changed (clouds, light), in which case the background restarts from the frame.
+class TransientDetector
+{
+    public:
+        struct Settings
+        {
+            double kappa;               // threshold, sigma of the frame to background difference
+            uint32_t minPixels;         // changed pixels for a tile to be active
+            double maxArea;             // fraction of active tiles above which the scene changed
+            uint32_t backgroundShift;   // background weight of a frame, 1 / 2^shift
+        };
+
+        // active tiles of a frame, in pixels
+        struct Detection
+        {
+            uint32_t tiles;
+            uint32_t x0, y0, x1, y1;    // bounding box of the active tiles, x1 and y1 excluded
+            float x, y;                 // centroid of the changed pixels counts
+            uint32_t peak;              // largest difference
+        };
+
+        static const uint32_t tileSize = 32;
+
+        /** Forget the background, the next frame starts a new one */
+        void reset() { mFrames = 0; }
+
+        /** Compare a frame of 8 or 16 bits samples, interleaved channels, then blend it in the background */
+        bool process(const uint8_t *frame, uint32_t width, uint32_t height, uint32_t channels, int bitDepth,
+                     const Settings &settings);
+
+        const Detection &detection() const { return mDetection; }
+        double noise() const { return mNoise; }
+
+    private:
+        template <typename T> bool process(const T *frame, uint32_t width, uint32_t height, uint32_t channels,
+                                           const Settings &settings);
+
+        uint64_t mFrames = 0;
+        uint32_t mWidth = 0, mHeight = 0, mChannels = 0, mShift = 0;
+        int mBitDepth = 0;
+        double mNoise = 0;
+
+        // background in fixed point, and rounded in the sample type
+        std::vector<uint32_t> mAccumulator;
+        std::vector<uint8_t> mBackground;
+        std::vector<uint32_t> mTileCount, mTilePeak;
+        Detection mDetection {};
+};
+
+// In memory ring of the last streamed frames, the history saved around an event.
+// Frames from a pinned sequence on are not overwritten, they are read by the event writer.
+class FrameRing
+{
+    public:
+        /** Allocate capacity frames of frameSize bytes, the ring starts empty, it must not be pinned */
+        void reset(size_t frameSize, size_t capacity);
+
+        /** Copy a frame over the oldest one, returns its sequence, from 1, or 0 when the oldest one is pinned */
+        uint64_t add(const uint8_t *frame, SerWriter::Clock::time_point captured);
+
+        /** Frame of a sequence still in the ring, nullptr otherwise */
+        const uint8_t *frame(uint64_t sequence) const;
+        SerWriter::Clock::time_point captured(uint64_t sequence) const { return mCaptured[sequence % mCapacity]; }
+
+        /** Frame of a pinned sequence, may be read from another thread */
+        const uint8_t *pinnedFrame(uint64_t sequence) const { return mFrames.data() + (sequence % mCapacity) * mFrameSize; }
+
+        /** Keep the frames from a sequence on, 0 to release them */
+        void pin(uint64_t sequence) { mPinned.store(sequence, std::memory_order_release); }
+        uint64_t pinned() const { return mPinned.load(std::memory_order_acquire); }
+
+        uint64_t sequence() const { return mSequence; }
+        uint64_t oldest() const { return mSequence >= mCapacity ? mSequence - mCapacity + 1 : 1; }
+        size_t capacity() const { return mCapacity; }
+        size_t frameSize() const { return mFrameSize; }
+
+    private:
+        std::vector<uint8_t> mFrames;
+        std::vector<SerWriter::Clock::time_point> mCaptured;
+        size_t mFrameSize = 0;
+        size_t mCapacity = 0;
+        uint64_t mSequence = 0;
+        std::atomic<uint64_t> mPinned {0};
+};
+
+// Event writer
+// A thread writes the queued events into SER files straight from the ring: the frames of an event
+// stay pinned until they are written, so that the stream neither copies nor waits for them. The
+// ring drops the new frames while it is full of pinned ones.
+class EventWriter
+{
+    public:
+        // called from the writer for every event, error is 0 or an errno value
+        typedef std::function<void(const std::string &path, int error)> Completion;
+
+        explicit EventWriter(FrameRing &ring) : mRing(ring) {}
+        ~EventWriter();
+
+        /** Queue the frames first to last of the ring, the thread starts with the first event */
+        void write(const std::string &path, const SerWriter::Format &format, uint64_t first, uint64_t last);
+
+        /** Wait for the queued events to be written */
+        void wait();
+
+        /** Write the queued events and stop */
+        void stop();
+
+        void setCompletion(const Completion &completion) { mCompletion = completion; }
+
+    private:
+        struct Event
+        {
+            std::string path;
+            SerWriter::Format format;
+            uint64_t first, last;
+        };
+
+        void run();
+
+        /** Pin the frames still to be written from a sequence on, lock held */
+        void pinFrom(uint64_t sequence);
+
+        FrameRing &mRing;
+        Completion mCompletion;
+        std::mutex mLock;
+        std::condition_variable mCondition;
+        std::deque<Event> mQueue;
+        bool mWriting = false;
+        bool mQuit = false;
+        std::thread mThread;
+};
@@ -0,0 +1,215 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "svb_unpack.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define UNPACK_SSSE3 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define UNPACK_NEON 1
+#endif
+
+namespace Unpack
+{
+
+static void raw10Scalar(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4, src += 5, dst += 4)
+    {
+        const uint8_t lsb = src[4];
+        dst[0] = (src[0] << 2) | (lsb & 0x03);
+        dst[1] = (src[1] << 2) | ((lsb >> 2) & 0x03);
+        dst[2] = (src[2] << 2) | ((lsb >> 4) & 0x03);
+        dst[3] = (src[3] << 2) | ((lsb >> 6) & 0x03);
+    }
+
+    // incomplete last group
+    for (size_t j = 0; i < pixels; i++, j++)
+        dst[j] = (src[j] << 2) | ((src[4] >> (2 * j)) & 0x03);
+}
+
+static void raw12Scalar(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 2 <= pixels; i += 2, src += 3, dst += 2)
+    {
+        dst[0] = (src[0] << 4) | (src[2] & 0x0F);
+        dst[1] = (src[1] << 4) | (src[2] >> 4);
+    }
+
+    // incomplete last group
+    if (i < pixels)
+        dst[0] = (src[0] << 4) | (src[2] & 0x0F);
+}
+
+#if defined(UNPACK_SSSE3)
+
+// 8 pixels (2 groups of 5 bytes) per iteration, every lane gets (MSB << 8 | LSB byte)
+__attribute__((target("ssse3")))
+static void raw10SSSE3(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    const __m128i shuffle = _mm_setr_epi8(4, 0, 4, 1, 4, 2, 4, 3, 9, 5, 9, 6, 9, 7, 9, 8);
+    // LSB << (6 - 2 * lane), so that a right shift by 6 extracts the lane bits
+    const __m128i lsbShift = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i msbMask = _mm_set1_epi16(0x03FC);
+    const __m128i lsbMask = _mm_set1_epi16(0x0003);
+    const __m128i byteMask = _mm_set1_epi16(0x00FF);
+
+    size_t i = 0;
+    // loads are 16 bytes wide, keep the last ones for the scalar loop
+    for (; i + 8 <= pixels && (i + 8) * 10 / 8 + 6 <= packedSize(SVB_IMG_RAW10, pixels); i += 8, src += 10, dst += 8)
+    {
+        __m128i w = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)), shuffle);
+        __m128i msb = _mm_and_si128(_mm_srli_epi16(w, 6), msbMask);
+        __m128i lsb = _mm_mullo_epi16(_mm_and_si128(w, byteMask), lsbShift);
+        lsb = _mm_and_si128(_mm_srli_epi16(lsb, 6), lsbMask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_or_si128(msb, lsb));
+    }
+
+    raw10Scalar(src, dst, pixels - i);
+}
+
+// 8 pixels (4 groups of 3 bytes) per iteration, every lane gets (MSB << 8 | LSB byte)
+__attribute__((target("ssse3")))
+static void raw12SSSE3(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 0, 2, 1, 5, 3, 5, 4, 8, 6, 8, 7, 11, 9, 11, 10);
+    // even pixels take the low nibble of the LSB byte, odd pixels the high one
+    const __m128i msbMask = _mm_setr_epi16(0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF);
+    const __m128i lsbMask = _mm_setr_epi16(0x000F, 0, 0x000F, 0, 0x000F, 0, 0x000F, 0);
+
+    size_t i = 0;
+    // loads are 16 bytes wide, keep the last ones for the scalar loop
+    for (; i + 8 <= pixels && (i + 8) * 12 / 8 + 4 <= packedSize(SVB_IMG_RAW12, pixels); i += 8, src += 12, dst += 8)
+    {
+        __m128i w = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)), shuffle);
+        __m128i p = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(w, 4), msbMask), _mm_and_si128(w, lsbMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), p);
+    }
+
+    raw12Scalar(src, dst, pixels - i);
+}
+
+#elif defined(UNPACK_NEON)
+
+// 8 pixels (2 groups of 5 bytes) per iteration, every lane gets (MSB << 8 | LSB byte)
+static void raw10NEON(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    static const uint8_t shuffleBytes[16] = {4, 0, 4, 1, 4, 2, 4, 3, 9, 5, 9, 6, 9, 7, 9, 8};
+    static const int16_t lsbShiftValues[8] = {0, -2, -4, -6, 0, -2, -4, -6};
+    const uint8x16_t shuffle = vld1q_u8(shuffleBytes);
+    const int16x8_t lsbShift = vld1q_s16(lsbShiftValues);
+
+    size_t i = 0;
+    // loads are 16 bytes wide, keep the last ones for the scalar loop
+    for (; i + 8 <= pixels && (i + 8) * 10 / 8 + 6 <= packedSize(SVB_IMG_RAW10, pixels); i += 8, src += 10, dst += 8)
+    {
+        uint16x8_t w = vreinterpretq_u16_u8(vqtbl1q_u8(vld1q_u8(src), shuffle));
+        uint16x8_t msb = vandq_u16(vshrq_n_u16(w, 6), vdupq_n_u16(0x03FC));
+        uint16x8_t lsb = vandq_u16(vshlq_u16(vandq_u16(w, vdupq_n_u16(0x00FF)), lsbShift), vdupq_n_u16(0x0003));
+        vst1q_u16(dst, vorrq_u16(msb, lsb));
+    }
+
+    raw10Scalar(src, dst, pixels - i);
+}
+
+// 32 pixels (16 groups of 3 bytes) per iteration, de-interleaved by vld3
+static void raw12NEON(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32, src += 48, dst += 32)
+    {
+        uint8x16x3_t b = vld3q_u8(src);
+        uint8x16_t lsbEven = vandq_u8(b.val[2], vdupq_n_u8(0x0F));
+        uint8x16_t lsbOdd = vshrq_n_u8(b.val[2], 4);
+
+        uint16x8x2_t low, high;
+        low.val[0]  = vorrq_u16(vshll_n_u8(vget_low_u8(b.val[0]), 4), vmovl_u8(vget_low_u8(lsbEven)));
+        low.val[1]  = vorrq_u16(vshll_n_u8(vget_low_u8(b.val[1]), 4), vmovl_u8(vget_low_u8(lsbOdd)));
+        high.val[0] = vorrq_u16(vshll_n_u8(vget_high_u8(b.val[0]), 4), vmovl_u8(vget_high_u8(lsbEven)));
+        high.val[1] = vorrq_u16(vshll_n_u8(vget_high_u8(b.val[1]), 4), vmovl_u8(vget_high_u8(lsbOdd)));
+        vst2q_u16(dst, low);
+        vst2q_u16(dst + 16, high);
+    }
+
+    raw12Scalar(src, dst, pixels - i);
+}
+
+#endif
+
+void raw10(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+#if defined(UNPACK_SSSE3)
+    static const bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+    if (hasSSSE3)
+    {
+        raw10SSSE3(src, dst, pixels);
+        return;
+    }
+#elif defined(UNPACK_NEON)
+    raw10NEON(src, dst, pixels);
+    return;
+#endif
+    raw10Scalar(src, dst, pixels);
+}
+
+void raw12(const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+#if defined(UNPACK_SSSE3)
+    static const bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+    if (hasSSSE3)
+    {
+        raw12SSSE3(src, dst, pixels);
+        return;
+    }
+#elif defined(UNPACK_NEON)
+    raw12NEON(src, dst, pixels);
+    return;
+#endif
+    raw12Scalar(src, dst, pixels);
+}
+
+void unpack(SVB_IMG_TYPE type, const uint8_t *src, uint16_t *dst, size_t pixels)
+{
+    switch (type)
+    {
+    case SVB_IMG_RAW10:
+    case SVB_IMG_Y10:
+        raw10(src, dst, pixels);
+        break;
+    case SVB_IMG_RAW12:
+    case SVB_IMG_Y12:
+        raw12(src, dst, pixels);
+        break;
+    default:
+        break;
+    }
+}
+
+}
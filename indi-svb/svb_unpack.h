@@ -0,0 +1,72 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "libsv305/SVBCameraSDK.h"
+
+// Packed 10/12 bits transfers (MIPI CSI-2 layout) unpacked to 16 bits containers
+namespace Unpack
+{
+
+/** Is the image type transferred packed on the wire */
+inline bool isPacked(SVB_IMG_TYPE type)
+{
+    switch (type)
+    {
+    case SVB_IMG_RAW10:
+    case SVB_IMG_RAW12:
+    case SVB_IMG_Y10:
+    case SVB_IMG_Y12: return true;
+    default:          return false;
+    }
+}
+
+/** Number of bytes transferred for pixels of a packed image type, rounded up to whole groups */
+inline size_t packedSize(SVB_IMG_TYPE type, size_t pixels)
+{
+    switch (type)
+    {
+    case SVB_IMG_RAW10:
+    case SVB_IMG_Y10:   return (pixels + 3) / 4 * 5;
+    case SVB_IMG_RAW12:
+    case SVB_IMG_Y12:   return (pixels + 1) / 2 * 3;
+    default:            return pixels * 2;
+    }
+}
+
+/** RAW10 : 4 pixels in 5 bytes, the 8 MSBs of each pixel then one byte holding the 2 LSBs */
+void raw10(const uint8_t *src, uint16_t *dst, size_t pixels);
+
+/** RAW12 : 2 pixels in 3 bytes, the 8 MSBs of each pixel then one byte holding the 4 LSBs */
+void raw12(const uint8_t *src, uint16_t *dst, size_t pixels);
+
+/** Unpack pixels of a packed image type to 16 bits */
+void unpack(SVB_IMG_TYPE type, const uint8_t *src, uint16_t *dst, size_t pixels);
+
+}
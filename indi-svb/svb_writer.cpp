@@ -0,0 +1,527 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "svb_writer.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// largest single write, io_uring lengths are 32 bits
+static const size_t maxWriteSize = 1 << 30;
+
+#ifdef HAVE_IO_URING
+
+// user data of the eventfd poll waking the ring worker
+static const uint64_t wakeupTag = UINT64_MAX;
+
+// io_uring set up with the raw system calls, without liburing
+struct AsyncWriter::Ring
+{
+    int fd = -1;
+    int event = -1;
+
+    void *sqMap = MAP_FAILED, *cqMap = MAP_FAILED, *sqeMap = MAP_FAILED;
+    size_t sqMapSize = 0, cqMapSize = 0, sqeMapSize = 0;
+
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    unsigned sqEntries = 0;
+    io_uring_sqe *sqes = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    unsigned toSubmit = 0;
+
+    ~Ring()
+    {
+        if (sqeMap != MAP_FAILED)
+            munmap(sqeMap, sqeMapSize);
+        if (cqMap != MAP_FAILED && cqMap != sqMap)
+            munmap(cqMap, cqMapSize);
+        if (sqMap != MAP_FAILED)
+            munmap(sqMap, sqMapSize);
+        if (event >= 0)
+            close(event);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool setup(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+            return false;
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+
+        sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED)
+            return false;
+        cqMap = single ? sqMap : mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                      IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED)
+            return false;
+        sqeMapSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqeMap = mmap(nullptr, sqeMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqeMap == MAP_FAILED)
+            return false;
+
+        auto sq = static_cast<uint8_t *>(sqMap);
+        sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+        sqes = static_cast<io_uring_sqe *>(sqeMap);
+
+        auto cq = static_cast<uint8_t *>(cqMap);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        event = eventfd(0, EFD_CLOEXEC);
+        return event >= 0;
+    }
+
+    /** Next free submission entry, cleared, nullptr when the ring is full */
+    io_uring_sqe *next()
+    {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        unsigned tail = *sqTail;
+        if (tail - head >= sqEntries)
+            return nullptr;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        toSubmit++;
+        return sqe;
+    }
+
+    /** Submit the new entries and wait for a completion */
+    int enter()
+    {
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (ret > 0)
+            toSubmit -= std::min<unsigned>(toSubmit, ret);
+        return ret;
+    }
+
+    /** Poll the eventfd, completes when the writer is woken up */
+    bool armWakeup()
+    {
+        io_uring_sqe *sqe = next();
+        if (sqe == nullptr)
+            return false;
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = event;
+        sqe->poll_events = POLLIN;
+        sqe->user_data = wakeupTag;
+        return true;
+    }
+
+    void wakeup()
+    {
+        uint64_t one = 1;
+        ssize_t ret = ::write(event, &one, sizeof(one));
+        (void)ret;
+    }
+};
+
+#else
+
+struct AsyncWriter::Ring
+{
+    void wakeup() {}
+};
+
+#endif
+
+AsyncWriter::AsyncWriter() = default;
+
+AsyncWriter::~AsyncWriter()
+{
+    stop();
+}
+
+const char *AsyncWriter::toString(Backend backend)
+{
+    switch (backend)
+    {
+        case BACKEND_IO_URING:
+            return "io_uring";
+        case BACKEND_THREADS:
+            return "threads";
+        default:
+            return "none";
+    }
+}
+
+bool AsyncWriter::start(size_t depth, size_t maxQueued, bool forceThreads)
+{
+    stop();
+
+    mDepth = std::max<size_t>(depth, 1);
+    mMaxQueued = std::max<size_t>(maxQueued, 1);
+    mQuit = false;
+
+    if (!forceThreads && startRing(mDepth))
+    {
+        mBackend = BACKEND_IO_URING;
+        mThreads.emplace_back(&AsyncWriter::workerRing, this);
+        return true;
+    }
+
+    mBackend = BACKEND_THREADS;
+    for (size_t i = 0; i < mDepth; i++)
+        mThreads.emplace_back(&AsyncWriter::workerThreads, this);
+    return true;
+}
+
+void AsyncWriter::stop()
+{
+    if (mBackend == BACKEND_NONE)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mQuit = true;
+    }
+    mQueueChanged.notify_all();
+    if (mRing)
+        mRing->wakeup();
+
+    for (auto &thread : mThreads)
+        thread.join();
+    mThreads.clear();
+    mRing.reset();
+    mBackend = BACKEND_NONE;
+}
+
+bool AsyncWriter::write(const std::string &path, uint8_t *data, size_t size)
+{
+    Job job;
+    job.path = path;
+    job.data.reset(data);
+    job.size = size;
+
+    std::unique_lock<std::mutex> guard(mLock);
+    if (mBackend == BACKEND_NONE)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    // bounded queue, wait for the writer
+    mQueueChanged.wait(guard, [this] { return mQuit || mQueue.size() < mMaxQueued; });
+    if (mQuit)
+    {
+        errno = ECANCELED;
+        return false;
+    }
+
+    mQueue.push_back(std::move(job));
+    guard.unlock();
+
+    mQueueChanged.notify_all();
+    if (mRing)
+        mRing->wakeup();
+    return true;
+}
+
+AsyncWriter::Stats AsyncWriter::stats() const
+{
+    std::lock_guard<std::mutex> guard(mLock);
+
+    Stats stats;
+    stats.queued = mQueue.size();
+    stats.inFlight = mInFlight;
+    stats.written = mWritten;
+    stats.failed = mFailed;
+    stats.bytes = mBytes;
+
+    double busy = mBusySeconds;
+    if (mInFlight > 0)
+        busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - mBusySince).count();
+    stats.throughput = busy > 0 ? mBytes / busy / 1e6 : 0;
+    return stats;
+}
+
+bool AsyncWriter::openJob(Job &job)
+{
+    job.fd = open(job.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (job.fd < 0)
+        return false;
+
+    // reserve the whole file, a full disk fails here rather than half way
+    if (job.size > 0 && fallocate(job.fd, 0, 0, static_cast<off_t>(job.size)) != 0 &&
+            errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        int error = errno;
+        close(job.fd);
+        unlink(job.path.c_str());
+        job.fd = -1;
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+void AsyncWriter::finishJob(Job &job, int error)
+{
+    if (job.fd >= 0)
+    {
+        if (close(job.fd) != 0 && error == 0)
+            error = errno;
+        if (error != 0)
+            unlink(job.path.c_str());
+        job.fd = -1;
+    }
+    job.data.reset();
+
+    endWrite(job.size, error);
+    if (mCompletion)
+        mCompletion(job.path, error);
+}
+
+void AsyncWriter::beginWrite()
+{
+    // lock held
+    if (mInFlight++ == 0)
+        mBusySince = std::chrono::steady_clock::now();
+}
+
+void AsyncWriter::endWrite(size_t bytes, int error)
+{
+    std::lock_guard<std::mutex> guard(mLock);
+    if (error != 0)
+        mFailed++;
+    else
+    {
+        mWritten++;
+        mBytes += bytes;
+    }
+    if (--mInFlight == 0)
+        mBusySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mBusySince).count();
+}
+
+void AsyncWriter::workerThreads()
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> guard(mLock);
+        mQueueChanged.wait(guard, [this] { return mQuit || !mQueue.empty(); });
+        if (mQueue.empty())
+            return;
+
+        Job job = std::move(mQueue.front());
+        mQueue.pop_front();
+        beginWrite();
+        guard.unlock();
+        mQueueChanged.notify_all();
+
+        if (!openJob(job))
+        {
+            finishJob(job, errno);
+            continue;
+        }
+
+        int error = 0;
+        while (job.done < job.size)
+        {
+            ssize_t ret = pwrite(job.fd, job.data.get() + job.done, std::min(job.size - job.done, maxWriteSize),
+                                 static_cast<off_t>(job.done));
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+            {
+                error = ret < 0 ? errno : EIO;
+                break;
+            }
+            job.done += ret;
+        }
+        finishJob(job, error);
+    }
+}
+
+#ifdef HAVE_IO_URING
+
+bool AsyncWriter::startRing(size_t depth)
+{
+    // files in flight and the wakeup poll
+    std::unique_ptr<Ring> ring(new Ring);
+    if (!ring->setup(static_cast<unsigned>(depth + 1)) || !ring->armWakeup())
+        return false;
+    mRing = std::move(ring);
+    return true;
+}
+
+void AsyncWriter::workerRing()
+{
+    Ring &ring = *mRing;
+    std::vector<Job> slots(mDepth);
+    std::vector<iovec> vectors(mDepth);
+    std::vector<bool> used(mDepth, false);
+
+    auto submit = [&](size_t slot)
+    {
+        Job &job = slots[slot];
+        vectors[slot].iov_base = job.data.get() + job.done;
+        vectors[slot].iov_len = std::min(job.size - job.done, maxWriteSize);
+
+        // the ring holds every slot and the wakeup poll, it is never full here
+        io_uring_sqe *sqe = ring.next();
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = job.fd;
+        sqe->off = job.done;
+        sqe->addr = reinterpret_cast<uintptr_t>(&vectors[slot]);
+        sqe->len = 1;
+        sqe->user_data = slot;
+    };
+
+    auto release = [&](size_t slot, int error)
+    {
+        finishJob(slots[slot], error);
+        slots[slot] = Job();
+        used[slot] = false;
+    };
+
+    for (;;)
+    {
+        // start the queued files while there are free slots
+        std::unique_lock<std::mutex> guard(mLock);
+        while (!mQueue.empty() && mInFlight < mDepth)
+        {
+            size_t slot = std::find(used.begin(), used.end(), false) - used.begin();
+            slots[slot] = std::move(mQueue.front());
+            mQueue.pop_front();
+            beginWrite();
+            guard.unlock();
+            mQueueChanged.notify_all();
+
+            if (!openJob(slots[slot]))
+                release(slot, errno);
+            else if (slots[slot].size == 0)
+                release(slot, 0);
+            else
+            {
+                used[slot] = true;
+                submit(slot);
+            }
+            guard.lock();
+        }
+        if (mQuit && mQueue.empty() && mInFlight == 0)
+            return;
+        guard.unlock();
+
+        if (ring.enter() < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // the ring is unusable, fail what is in flight and every file queued until stop()
+            int error = errno;
+            for (size_t slot = 0; slot < mDepth; slot++)
+                if (used[slot])
+                    release(slot, error);
+            for (;;)
+            {
+                guard.lock();
+                mQueueChanged.wait(guard, [this] { return mQuit || !mQueue.empty(); });
+                if (mQueue.empty())
+                    return;
+                Job job = std::move(mQueue.front());
+                mQueue.pop_front();
+                beginWrite();
+                guard.unlock();
+                mQueueChanged.notify_all();
+                finishJob(job, error);
+            }
+        }
+
+        // completions
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+            uint64_t slot = cqe.user_data;
+            int res = cqe.res;
+            __atomic_store_n(ring.cqHead, head + 1, __ATOMIC_RELEASE);
+
+            if (slot == wakeupTag)
+            {
+                uint64_t count;
+                ssize_t ret = read(ring.event, &count, sizeof(count));
+                (void)ret;
+                ring.armWakeup();
+                continue;
+            }
+
+            Job &job = slots[slot];
+            if (res == -EINTR || res == -EAGAIN)
+                submit(slot);
+            else if (res < 0)
+                release(slot, -res);
+            else if (res == 0)
+                release(slot, EIO);
+            else if ((job.done += res) < job.size)
+                submit(slot);
+            else
+                release(slot, 0);
+        }
+    }
+}
+
+#else
+
+bool AsyncWriter::startRing(size_t)
+{
+    return false;
+}
+
+void AsyncWriter::workerRing()
+{
+}
+
+#endif
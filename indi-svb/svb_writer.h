@@ -0,0 +1,124 @@
+/*
+    SVBONY CCD Driver
+
+    Copyright (C) 2022 Valerio Faiuolo (valerio.faiuolo@gmail.com)
+
+    Based on indi-sv305 driver:
+        - Jasem Mutlaq  (mutlaqja AT ikarustech DOT com) : generic-ccd skeleton
+        - Blaise-Florentin Collin  (thx8411 AT yahoo DOT fr) : main coding
+        - Tetsuya Kakura (jcpgm AT outlook DOT jp) : SV405CC support, fixes and code cleaning
+
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous file writer
+// Whole files are queued with the buffer holding their content and written in the background,
+// several at once, by io_uring when the kernel has it or by a pool of threads otherwise. Files
+// are pre-allocated with fallocate so that a full disk fails before the write and the extents
+// are laid out in one go. The queue is bounded: queueing waits while it is full.
+class AsyncWriter
+{
+    public:
+        enum Backend { BACKEND_NONE, BACKEND_IO_URING, BACKEND_THREADS };
+
+        struct Stats
+        {
+            size_t queued;          // files waiting
+            size_t inFlight;        // files being written
+            uint64_t written;       // files done
+            uint64_t failed;
+            uint64_t bytes;         // bytes of the files done
+            double throughput;      // MB/s while writing
+        };
+
+        // called from the writer for every file, error is 0 or an errno value
+        typedef std::function<void(const std::string &path, int error)> Completion;
+
+        AsyncWriter();
+        ~AsyncWriter();
+
+        /** Start the writer with depth files in flight, io_uring unless forceThreads */
+        bool start(size_t depth, size_t maxQueued, bool forceThreads = false);
+
+        /** Write the queued files and stop */
+        void stop();
+
+        /** Queue a file, the writer takes the malloc'd data and frees it when done */
+        bool write(const std::string &path, uint8_t *data, size_t size);
+
+        void setCompletion(const Completion &completion) { mCompletion = completion; }
+
+        Backend backend() const { return mBackend; }
+        bool isRunning() const { return mBackend != BACKEND_NONE; }
+        Stats stats() const;
+
+        static const char *toString(Backend backend);
+
+    private:
+        struct Job
+        {
+            std::string path;
+            std::unique_ptr<uint8_t, void (*)(void *)> data{nullptr, free};
+            size_t size = 0;
+            size_t done = 0;
+            int fd = -1;
+        };
+
+        struct Ring;
+
+        /** Create and pre-allocate the file of a job, false and errno set on error */
+        static bool openJob(Job &job);
+        void finishJob(Job &job, int error);
+
+        bool startRing(size_t depth);
+        void workerRing();
+        void workerThreads();
+
+        /** Account a file entering or leaving the in flight set */
+        void beginWrite();
+        void endWrite(size_t bytes, int error);
+
+        mutable std::mutex mLock;
+        std::condition_variable mQueueChanged;
+        std::deque<Job> mQueue;
+        size_t mMaxQueued = 0;
+        size_t mDepth = 0;
+        bool mQuit = false;
+
+        Backend mBackend = BACKEND_NONE;
+        std::vector<std::thread> mThreads;
+        std::unique_ptr<Ring> mRing;
+        Completion mCompletion;
+
+        size_t mInFlight = 0;
+        uint64_t mWritten = 0, mFailed = 0, mBytes = 0;
+        std::chrono::steady_clock::time_point mBusySince;
+        double mBusySeconds = 0;
+};